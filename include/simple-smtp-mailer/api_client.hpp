@@ -176,7 +176,6 @@ private:
     std::string getDomainFromConfig() const;
     std::string extractMessageId(const std::string& response_body);
     std::string urlEncode(const std::string& str);
-    std::string base64Encode(const std::string& str);
 };
 
 /**
@@ -255,8 +254,21 @@ public:
 
 private:
     APIClientConfig config_;
-    std::string buildRequestBody(const Email& email);
+    std::string buildRequestBody(const Email& email, const std::vector<std::string>& blob_ids);
     std::map<std::string, std::string> buildHeaders();
+
+    /**
+     * @brief Get the blob ID of an attachment, uploading it unless it was uploaded before
+     *
+     * Uploads go to the JMAP upload endpoint of the account in auth.username;
+     * blob IDs are remembered in the AttachmentCache per file version.
+     *
+     * @param path Attachment file
+     * @param blob_id Blob ID on success
+     * @param error Error message on failure
+     * @return true if the blob is available, false otherwise
+     */
+    bool uploadAttachment(const std::string& path, std::string& blob_id, std::string& error);
 };
 
 /**
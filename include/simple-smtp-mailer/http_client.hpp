@@ -23,10 +23,20 @@ enum class HTTPMethod {
  * @brief HTTP request structure
  */
 struct HTTPRequest {
+    /**
+     * @brief Pull-based request body source
+     *
+     * Fills the buffer and returns the number of bytes written, 0 at the end
+     * of the body, or BODY_READ_ABORT to fail the request.
+     */
+    using BodyReader = std::function<size_t(char* buffer, size_t size)>;
+    static constexpr size_t BODY_READ_ABORT = static_cast<size_t>(-1);
+    
     HTTPMethod method;
     std::string url;
     std::map<std::string, std::string> headers;
     std::string body;
+    BodyReader body_reader;     // Streams the body (chunked) instead of sending body
     std::map<std::string, std::string> query_params;
     int timeout_seconds;
     bool verify_ssl;
@@ -20,6 +20,7 @@ struct Email {
     std::string body;
     std::string html_body;
     std::vector<std::string> attachments;
+    std::vector<std::string> inline_attachments;    // Referenced from html_body as cid:<file name>
     
     /**
      * @brief Default constructor
@@ -85,6 +86,12 @@ struct Email {
      */
     void addAttachment(const std::string& file_path);
     
+    /**
+     * @brief Add inline attachment, e.g. an image shown in the HTML body
+     * @param file_path Path to attachment file; the HTML refers to it as cid:<file name>
+     */
+    void addInlineAttachment(const std::string& file_path);
+    
     /**
      * @brief Remove recipient address
      * @param address Recipient address to remove
@@ -179,17 +186,32 @@ struct Email {
     
     /**
      * @brief Convert email to RFC 2822 format
-     * @return RFC 2822 formatted email
+     * @return RFC 2822 formatted email (the same as toMIME())
      */
     std::string toRFC2822() const;
     
     /**
-     * @brief Convert email to MIME format
-     * @return MIME formatted email
+     * @brief Convert email to MIME format, including all parts and attachments
+     * @return MIME formatted email with CRLF line endings, or an empty string
+     *         if an attachment cannot be read
      */
     std::string toMIME() const;
 };
 
+/**
+ * @brief Server reply to a single RCPT TO command
+ */
+struct RecipientStatus {
+    std::string address;
+    bool accepted;
+    int reply_code;
+    std::string response;
+    
+    RecipientStatus() : accepted(false), reply_code(0) {}
+    RecipientStatus(const std::string& addr, bool ok, int code, const std::string& resp)
+        : address(addr), accepted(ok), reply_code(code), response(resp) {}
+};
+
 /**
  * @brief Result of SMTP operations
  */
@@ -198,9 +220,16 @@ struct SMTPResult {
     std::string message_id;
     std::string error_message;
     int error_code;
+    std::vector<RecipientStatus> recipients;  // Per-recipient RCPT TO outcome
     
     SMTPResult() : success(false), error_code(0) {}
     
+    /**
+     * @brief Get recipients the server refused
+     * @return Rejected recipient statuses
+     */
+    std::vector<RecipientStatus> getRejectedRecipients() const;
+    
     /**
      * @brief Create successful result
      * @param msg_id Message ID
@@ -268,6 +297,26 @@ public:
                        const std::string& body, 
                        const std::string& html_body);
     
+    /**
+     * @brief Render an email once for sending to many recipients
+     *
+     * The result holds the encoded body and every header except To, Date
+     * and Message-ID, which each send adds for its recipient. The email's
+     * To list is ignored; Cc is kept as a static header.
+     *
+     * @param email Email to render
+     * @return Prepared message, or nullptr on failure (see getLastError())
+     */
+    std::shared_ptr<const PreparedMessage> prepare(const Email& email);
+    
+    /**
+     * @brief Send a prepared message to one recipient
+     * @param message Prepared message
+     * @param recipient Envelope recipient, also used as the To header
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const PreparedMessage& message, const std::string& recipient);
+    
     /**
      * @brief Check if the mailer is properly configured
      * @return true if configured, false otherwise
@@ -294,13 +343,36 @@ public:
      * @brief Add email to queue for processing
      * @param email Email to queue
      * @param priority Priority level for processing
+     * @param send_at Earliest time to send; the default sends as soon as possible
+     * @return ACCEPTED once queued; FULL or CLOSED if the queue did not take it
+     */
+    EnqueueStatus enqueue(const Email& email, EmailPriority priority = EmailPriority::NORMAL,
+                          std::chrono::system_clock::time_point send_at = std::chrono::system_clock::time_point());
+    
+    /**
+     * @brief Add one recipient's copy of a prepared message to the queue
+     *
+     * Queue items share the prepared message rather than copying its body.
+     *
+     * @param message Prepared message
+     * @param recipient Envelope recipient, also used as the To header
+     * @param priority Priority level for processing
+     * @param send_at Earliest time to send; the default sends as soon as possible
+     * @return ACCEPTED once queued; FULL or CLOSED if the queue did not take it
      */
-    void enqueue(const Email& email, EmailPriority priority = EmailPriority::NORMAL);
+    EnqueueStatus enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                          EmailPriority priority = EmailPriority::NORMAL,
+                          std::chrono::system_clock::time_point send_at = std::chrono::system_clock::time_point());
     
     /**
      * @brief Start the email processing queue
+     *
+     * With a queue_dir configured, this instance takes over the spool and
+     * sends the mail other instances hand to it.
+     *
+     * @return false if the queue could not be started (see getLastError())
      */
-    void startQueue();
+    bool startQueue();
     
     /**
      * @brief Stop the email processing queue
@@ -7,6 +7,8 @@
 
 namespace ssmtp_mailer {
 
+class PreparedMessage;
+
 /**
  * @brief Email priority levels
  */
@@ -17,6 +19,15 @@ enum class EmailPriority {
     URGENT = 3
 };
 
+/**
+ * @brief Outcome of queueing an email
+ */
+enum class EnqueueStatus {
+    ACCEPTED,   // Queued, and stored if the queue is persistent
+    FULL,       // The queue holds max_queue_size emails already
+    CLOSED      // The queue takes no mail: closed, or the mail could not be stored
+};
+
 /**
  * @brief Email status in the queue
  */
@@ -42,6 +53,8 @@ struct QueueItem {
     std::string body;
     std::string html_body;
     std::vector<std::string> attachments;
+    std::vector<std::string> inline_attachments;
+    std::shared_ptr<const PreparedMessage> prepared;    // Shared content; body fields stay empty
     EmailPriority priority;
     EmailStatus status;
     std::chrono::system_clock::time_point created_at;
@@ -51,8 +64,12 @@ struct QueueItem {
     int retry_count;
     int max_retries;
     std::string error_message;
+    bool spooled;       // Subject, bodies and attachment lists are in the spool; those fields are empty
     
-    QueueItem() = default;
+    QueueItem()
+        : priority(EmailPriority::NORMAL), status(EmailStatus::PENDING),
+          retry_delay(std::chrono::seconds(60)),
+          retry_count(0), max_retries(3), spooled(false) {}
     
     QueueItem(const std::string& from, 
               const std::vector<std::string>& to,
@@ -63,7 +80,7 @@ struct QueueItem {
           created_at(std::chrono::system_clock::now()),
           last_attempt(std::chrono::system_clock::now()),
           retry_delay(std::chrono::seconds(60)),
-          retry_count(0), max_retries(3) {}
+          retry_count(0), max_retries(3), spooled(false) {}
 };
 
 /**
@@ -76,13 +93,54 @@ struct QueueConfig {
     std::chrono::seconds max_retry_delay;
     bool enable_priority_queuing;
     bool enable_scheduled_sending;
+    size_t max_workers_per_destination;         // Workers sending to one destination at a time
+    size_t destination_failure_threshold;       // Failures in a row before a destination is paused
+    std::chrono::seconds destination_backoff;   // First pause; doubles with each further failure
+    std::chrono::seconds max_destination_backoff;
+    size_t priority_aging;                      // Sends a waiting priority may be passed over; 0 is strict
+    size_t ingress_capacity;                    // Emails queued but not yet taken in by a worker
     
     QueueConfig()
         : max_queue_size(10000), max_workers(4),
           retry_delay(std::chrono::seconds(60)),
           max_retry_delay(std::chrono::seconds(3600)),
           enable_priority_queuing(true),
-          enable_scheduled_sending(true) {}
+          enable_scheduled_sending(true),
+          max_workers_per_destination(2),
+          destination_failure_threshold(3),
+          destination_backoff(std::chrono::seconds(30)),
+          max_destination_backoff(std::chrono::seconds(900)),
+          priority_aging(16),
+          ingress_capacity(1024) {}
+};
+
+/**
+ * @brief State of one destination's sub-queue
+ */
+struct QueueDestinationStats {
+    std::string destination;        // Recipient domain, or the key set with setDestinationFunction()
+    size_t ready;                   // Due and waiting for a worker
+    size_t in_flight;               // Workers sending to it now
+    size_t consecutive_failures;
+    bool paused;                    // Backing off after repeated failures
+    std::chrono::system_clock::time_point paused_until;
+    
+    QueueDestinationStats()
+        : ready(0), in_flight(0), consecutive_failures(0), paused(false) {}
+};
+
+/**
+ * @brief Statistics of one queue worker
+ */
+struct QueueWorkerStats {
+    size_t processed;       // Sent successfully
+    size_t failed;          // Failed permanently
+    size_t retried;         // Failed and queued for another attempt
+    bool busy;              // Sending at the time of the snapshot
+    std::chrono::system_clock::time_point last_activity;
+    
+    QueueWorkerStats()
+        : processed(0), failed(0), retried(0), busy(false) {}
 };
 
 /**
@@ -155,6 +155,7 @@ public:
 private:
     UnifiedMailerConfig config_;
     std::unique_ptr<class ConfigManager> smtp_config_;
+    std::unique_ptr<class SMTPConnectionPool> smtp_pool_;
     std::map<std::string, std::shared_ptr<BaseAPIClient>> api_clients_;
     
     // Statistics
@@ -1,7 +1,12 @@
 #include "ssmtp-mailer/api_client.hpp"
 #include "ssmtp-mailer/http_client.hpp"
 #include "ssmtp-mailer/mailer.hpp"
+#include "core/mime/attachment_cache.hpp"
+#include "utils/mapped_file.hpp"
 #include <sstream>
+#include <memory>
+#include <algorithm>
+#include <cstring>
 #include <json/json.h>
 
 namespace ssmtp_mailer {
@@ -19,8 +24,22 @@ APIResponse FastmailAPIClient::sendEmail(const Email& email) {
     }
     
     try {
+        // Attachments go up as blobs first when an account is configured
+        std::vector<std::string> blob_ids;
+        if (!config_.auth.username.empty()) {
+            for (const auto& attachment_path : email.attachments) {
+                std::string blob_id;
+                std::string error;
+                if (!uploadAttachment(attachment_path, blob_id, error)) {
+                    response.error_message = error;
+                    return response;
+                }
+                blob_ids.push_back(blob_id);
+            }
+        }
+
         // Build request body
-        std::string requestBody = buildRequestBody(email);
+        std::string requestBody = buildRequestBody(email, blob_ids);
         std::map<std::string, std::string> headers = buildHeaders();
         
         // Make HTTP request to Fastmail API
@@ -103,7 +122,7 @@ bool FastmailAPIClient::isValid() const {
            !config_.sender_email.empty();
 }
 
-std::string FastmailAPIClient::buildRequestBody(const Email& email) {
+std::string FastmailAPIClient::buildRequestBody(const Email& email, const std::vector<std::string>& blob_ids) {
     Json::Value root;
     
     // Fastmail API expects specific format
@@ -156,11 +175,20 @@ std::string FastmailAPIClient::buildRequestBody(const Email& email) {
     // Attachments
     if (!email.attachments.empty()) {
         Json::Value attachmentsArray;
-        for (const auto& attachment_path : email.attachments) {
+        for (size_t i = 0; i < email.attachments.size(); ++i) {
+            const std::string& attachment_path = email.attachments[i];
             Json::Value att;
-            att["filename"] = attachment_path;
-            // Note: In a real implementation, you'd read the file and get content type
-            att["contentType"] = "application/octet-stream";
+            if (i < blob_ids.size()) {
+                // Uploaded blob, referenced by ID
+                size_t slash = attachment_path.find_last_of("/\\");
+                att["blobId"] = blob_ids[i];
+                att["name"] = slash == std::string::npos ? attachment_path : attachment_path.substr(slash + 1);
+                att["type"] = "application/octet-stream";
+            } else {
+                att["filename"] = attachment_path;
+                // Note: In a real implementation, you'd read the file and get content type
+                att["contentType"] = "application/octet-stream";
+            }
             attachmentsArray.append(att);
         }
         root["attachments"] = attachmentsArray;
@@ -176,6 +204,59 @@ std::string FastmailAPIClient::buildRequestBody(const Email& email) {
     return writer.write(root);
 }
 
+bool FastmailAPIClient::uploadAttachment(const std::string& path, std::string& blob_id,
+                                         std::string& error) {
+    // Blob IDs are only valid for the account (and server) they were uploaded to
+    std::string provider = "fastmail:" + config_.request.base_url + ":" + config_.auth.username;
+    AttachmentCache& cache = AttachmentCache::getInstance();
+    if (cache.getBlobId(path, provider, blob_id)) {
+        return true;
+    }
+
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path, error)) {
+        return false;
+    }
+    file->adviseSequential();
+
+    auto httpClient = HTTPClientFactory::createClient();
+    httpClient->setTimeout(config_.request.timeout_seconds);
+    httpClient->setSSLVerification(config_.request.verify_ssl);
+
+    HTTPRequest request;
+    request.method = HTTPMethod::POST;
+    request.url = config_.request.base_url + "/jmap/upload/" + config_.auth.username + "/";
+    request.headers = buildHeaders();
+    request.headers["Content-Type"] = "application/octet-stream";
+
+    // Stream the raw file from the mapping; nothing is encoded or copied in full
+    std::shared_ptr<size_t> offset = std::make_shared<size_t>(0);
+    request.body_reader = [file, offset](char* buffer, size_t size) {
+        size_t count = std::min(size, file->size() - *offset);
+        std::memcpy(buffer, file->data() + *offset, count);
+        *offset += count;
+        return count;
+    };
+
+    HTTPResponse httpResponse = httpClient->sendRequest(request);
+    if (httpResponse.status_code < 200 || httpResponse.status_code >= 300) {
+        error = "Upload of " + path + " failed: HTTP " + std::to_string(httpResponse.status_code) +
+                ": " + httpResponse.body;
+        return false;
+    }
+
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(httpResponse.body, root) || !root.isMember("blobId")) {
+        error = "Upload of " + path + " returned no blobId";
+        return false;
+    }
+
+    blob_id = root["blobId"].asString();
+    cache.setBlobId(path, provider, blob_id);
+    return true;
+}
+
 std::map<std::string, std::string> FastmailAPIClient::buildHeaders() {
     std::map<std::string, std::string> headers;
     
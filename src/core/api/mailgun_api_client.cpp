@@ -1,5 +1,11 @@
 #include "ssmtp-mailer/api_client.hpp"
 #include "ssmtp-mailer/http_client.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/smtp/smtp_data_encoder.hpp"
+#include "utils/base64.hpp"
+#include "utils/email.hpp"
+#include <memory>
+#include <cstring>
 #include <sstream>
 #include <iostream>
 #include <algorithm>
@@ -7,6 +13,94 @@
 
 namespace ssmtp_mailer {
 
+namespace {
+
+// Message content is canonicalised in slices of this size
+const size_t UPLOAD_SLICE_SIZE = 64 * 1024;
+
+/**
+ * multipart/form-data body for the messages.mime endpoint, with the MIME
+ * message streamed from the Email as curl asks for it
+ */
+class MimeUploadBody {
+public:
+    MimeUploadBody(const Email& email, const std::string& prefix, const std::string& suffix)
+        : message_(email, email.generateMessageId()), encoder_(false),
+          prefix_(prefix), suffix_(suffix), stage_(Stage::PREFIX),
+          piece_offset_(0), pending_offset_(0) {}
+
+    bool good() const { return message_.good(); }
+    std::string getLastError() const { return message_.getLastError(); }
+
+    size_t read(char* buffer, size_t size) {
+        size_t written = 0;
+        while (written < size) {
+            if (pending_offset_ == pending_.size() && !refill()) {
+                if (!message_.good()) {
+                    return HTTPRequest::BODY_READ_ABORT;
+                }
+                break;
+            }
+            size_t count = std::min(size - written, pending_.size() - pending_offset_);
+            std::memcpy(buffer + written, pending_.data() + pending_offset_, count);
+            pending_offset_ += count;
+            written += count;
+        }
+        return written;
+    }
+
+private:
+    enum class Stage { PREFIX, MESSAGE, DONE };
+
+    bool refill() {
+        pending_.clear();
+        pending_offset_ = 0;
+
+        switch (stage_) {
+            case Stage::PREFIX:
+                pending_ = prefix_;
+                stage_ = Stage::MESSAGE;
+                return true;
+            case Stage::MESSAGE:
+                if (piece_offset_ == piece_.size) {
+                    bool transient = false;
+                    piece_offset_ = 0;
+                    if (!message_.next(piece_, transient)) {
+                        if (!message_.good()) {
+                            return false;
+                        }
+                        encoder_.finish(pending_);
+                        pending_ += suffix_;
+                        stage_ = Stage::DONE;
+                        return true;
+                    }
+                }
+                {
+                    // The uploaded message must use CRLF like one sent over SMTP
+                    size_t length = std::min(UPLOAD_SLICE_SIZE, piece_.size - piece_offset_);
+                    encoder_.encode(piece_.data + piece_offset_, length, pending_);
+                    piece_offset_ += length;
+                }
+                return true;
+            case Stage::DONE:
+                break;
+        }
+        return false;
+    }
+
+    MimeMessageStream message_;
+    SMTPDataEncoder encoder_;
+    std::string prefix_;
+    std::string suffix_;
+    Stage stage_;
+    ConstBuffer piece_;
+    size_t piece_offset_;
+    std::string pending_;
+    size_t pending_offset_;
+};
+
+} // anonymous namespace
+
 MailgunAPIClient::MailgunAPIClient(const APIClientConfig& config) : config_(config) {
     // Set default Mailgun configuration if not provided
     if (config_.request.base_url.empty()) {
@@ -40,9 +134,43 @@ APIResponse MailgunAPIClient::sendEmail(const Email& email) {
         return response;
     }
     
-    http_request.url = config_.request.base_url + "/" + domain + "/messages";
-    http_request.body = buildRequestBody(email);
     http_request.headers = buildHeaders();
+    if (email.hasAttachments()) {
+        // Attachments go up inside a raw MIME message streamed from disk
+        std::string boundary = "=_" + generateUniqueId();
+        std::string prefix;
+        std::string suffix = "\r\n--" + boundary + "--\r\n";
+        
+        auto addField = [&prefix, &boundary](const std::string& name, const std::string& value) {
+            prefix += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"" + name +
+                      "\"\r\n\r\n" + value + "\r\n";
+        };
+        for (const auto& recipient : email.getAllRecipients()) {
+            addField("to", recipient);
+        }
+        if (config_.enable_tracking) {
+            addField("o:tracking", "yes");
+            addField("o:tracking-opens", "yes");
+            addField("o:tracking-clicks", "yes");
+        }
+        addField("o:tag", "ssmtp-mailer");
+        prefix += "--" + boundary + "\r\nContent-Disposition: form-data; name=\"message\"; "
+                  "filename=\"message.mime\"\r\nContent-Type: message/rfc822\r\n\r\n";
+        
+        auto upload = std::make_shared<MimeUploadBody>(email, prefix, suffix);
+        if (!upload->good()) {
+            response.error_message = upload->getLastError();
+            return response;
+        }
+        http_request.url = config_.request.base_url + "/" + domain + "/messages.mime";
+        http_request.headers["Content-Type"] = "multipart/form-data; boundary=\"" + boundary + "\"";
+        http_request.body_reader = [upload](char* buffer, size_t size) {
+            return upload->read(buffer, size);
+        };
+    } else {
+        http_request.url = config_.request.base_url + "/" + domain + "/messages";
+        http_request.body = buildRequestBody(email);
+    }
     http_request.timeout_seconds = config_.request.timeout_seconds;
     http_request.verify_ssl = config_.request.verify_ssl;
     
@@ -241,35 +369,4 @@ std::string MailgunAPIClient::urlEncode(const std::string& str) {
     return escaped.str();
 }
 
-std::string MailgunAPIClient::base64Encode(const std::string& str) {
-    // Simple base64 encoding for Basic Auth
-    // In production, you might want to use a proper base64 library
-    static const std::string base64_chars = 
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-        "abcdefghijklmnopqrstuvwxyz"
-        "0123456789+/";
-    
-    std::string result;
-    int val = 0, valb = -6;
-    
-    for (unsigned char c : str) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            result.push_back(base64_chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    
-    if (valb > -6) {
-        result.push_back(base64_chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    }
-    
-    while (result.size() % 4) {
-        result.push_back('=');
-    }
-    
-    return result;
-}
-
 } // namespace ssmtp_mailer
@@ -1,5 +1,6 @@
 #include "core/auth/service_account_auth.hpp"
 #include "core/logging/logger.hpp"
+#include "utils/base64.hpp"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
@@ -119,32 +120,6 @@ std::string ServiceAccountAuth::createJWTPayload() {
     return payload.toStyledString();
 }
 
-std::string ServiceAccountAuth::base64UrlEncode(const std::string& input) {
-    // Convert to base64
-    BIO* bio = BIO_new(BIO_s_mem());
-    BIO* b64 = BIO_new(BIO_f_base64());
-    bio = BIO_push(b64, bio);
-    
-    BIO_set_flags(bio, BIO_FLAGS_BASE64_NO_NL);
-    BIO_write(bio, input.c_str(), static_cast<int>(input.length()));
-    BIO_flush(bio);
-    
-    BUF_MEM* bufferPtr;
-    BIO_get_mem_ptr(bio, &bufferPtr);
-    
-    std::string result(bufferPtr->data, bufferPtr->length);
-    
-    // Convert to URL-safe base64
-    std::replace(result.begin(), result.end(), '+', '-');
-    std::replace(result.begin(), result.end(), '/', '_');
-    
-    // Remove padding
-    result.erase(std::remove(result.end() - 2, result.end(), '='), result.end());
-    
-    BIO_free_all(bio);
-    return result;
-}
-
 std::string ServiceAccountAuth::rsaSign(const std::string& data) {
     BIO* bio = BIO_new_mem_buf(private_key_.c_str(), static_cast<int>(private_key_.length()));
     if (!bio) {
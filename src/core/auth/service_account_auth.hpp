@@ -97,7 +97,6 @@ private:
     
     // JWT token generation
     std::string createJWT();
-    std::string base64UrlEncode(const std::string& input);
     std::string signJWT(const std::string& header, const std::string& payload);
     
     // Load service account JSON
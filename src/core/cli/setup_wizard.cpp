@@ -218,6 +218,7 @@ bool SetupWizard::setupGlobalConfig() {
         file << "write_timeout = 60\n";
         file << "enable_rate_limiting = true\n";
         file << "rate_limit_per_minute = 100\n";
+        file << "direct_delivery = false\n";
         
         file.close();
         
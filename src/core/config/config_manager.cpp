@@ -3,9 +3,49 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
 
 namespace ssmtp_mailer {
 
+namespace {
+
+std::string trim(const std::string& value) {
+    size_t start = value.find_first_not_of(" \t\r");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(start, end - start + 1);
+}
+
+bool parseBool(const std::string& value, bool& result) {
+    std::string lower = value;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (lower == "true" || lower == "yes" || lower == "on" || lower == "1") {
+        result = true;
+        return true;
+    }
+    if (lower == "false" || lower == "no" || lower == "off" || lower == "0") {
+        result = false;
+        return true;
+    }
+    return false;
+}
+
+bool parseInt(const std::string& value, int& result) {
+    try {
+        size_t used = 0;
+        result = std::stoi(value, &used);
+        return used == value.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+} // anonymous namespace
+
 ConfigManager::ConfigManager() : is_valid_(false) {
     // Initialize with default values
 }
@@ -15,9 +55,21 @@ ConfigManager::~ConfigManager() {
 }
 
 bool ConfigManager::loadFromFile(const std::string& config_file) {
-    (void)config_file; // Suppress unused parameter warning
-    // For now, just set up some default domain configs
+    // Built-in provider configs, then the settings of the main file
     setupDefaultConfigs();
+    if (!loadMainConfig(config_file)) {
+        is_valid_ = false;
+        return false;
+    }
+    
+    std::string domains_dir = global_config_.domains_dir;
+    if (domains_dir.empty() && !global_config_.config_dir.empty()) {
+        domains_dir = global_config_.config_dir + "/domains";
+    }
+    if (!domains_dir.empty() && !loadDomainConfigs(domains_dir)) {
+        is_valid_ = false;
+        return false;
+    }
     is_valid_ = true;
     return true;
 }
@@ -92,6 +144,219 @@ bool ConfigManager::reload() {
     return load();
 }
 
+bool ConfigManager::loadMainConfig(const std::string& config_file) {
+    return parseConfigFile(config_file);
+}
+
+bool ConfigManager::loadDomainConfigs(const std::string& domains_dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    if (!fs::is_directory(domains_dir, ec)) {
+        return true;
+    }
+    
+    // One file per domain; *.conf.example templates are skipped
+    std::vector<std::string> files;
+    for (fs::directory_iterator it(domains_dir, ec), end; !ec && it != end; it.increment(ec)) {
+        if (it->path().extension() == ".conf") {
+            files.push_back(it->path().string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+    for (const auto& file : files) {
+        if (!parseConfigFile(file)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ConfigManager::parseConfigFile(const std::string& file_path) {
+    std::ifstream file(file_path);
+    if (!file.is_open()) {
+        last_error_ = "Cannot open configuration file: " + file_path;
+        return false;
+    }
+    
+    // INI format: [section] headers, key = value lines, # and ; comments
+    std::string section_name;
+    std::map<std::string, std::string> key_value_pairs;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        line_number++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';') {
+            continue;
+        }
+        
+        if (line[0] == '[') {
+            if (line.back() != ']') {
+                last_error_ = file_path + ":" + std::to_string(line_number) + ": malformed section header";
+                return false;
+            }
+            if (!section_name.empty() && !parseSection(section_name, key_value_pairs)) {
+                return false;
+            }
+            section_name = trim(line.substr(1, line.size() - 2));
+            key_value_pairs.clear();
+            continue;
+        }
+        
+        size_t equals = line.find('=');
+        if (equals == std::string::npos) {
+            last_error_ = file_path + ":" + std::to_string(line_number) + ": expected key = value";
+            return false;
+        }
+        std::string value = line.substr(equals + 1);
+        size_t comment = value.find(" #");
+        if (comment != std::string::npos) {
+            value.erase(comment);
+        }
+        key_value_pairs[trim(line.substr(0, equals))] = trim(value);
+    }
+    
+    if (!section_name.empty()) {
+        return parseSection(section_name, key_value_pairs);
+    }
+    return true;
+}
+
+bool ConfigManager::parseSection(const std::string& section_name,
+                                 const std::map<std::string, std::string>& key_value_pairs) {
+    if (section_name == "global") {
+        return parseGlobalConfig(key_value_pairs);
+    }
+    if (section_name.compare(0, 7, "domain:") == 0) {
+        return parseDomainConfig(section_name.substr(7), key_value_pairs);
+    }
+    // Users and address mappings are not configured from files yet
+    return true;
+}
+
+bool ConfigManager::parseDomainConfig(const std::string& section_name,
+                                      const std::map<std::string, std::string>& key_value_pairs) {
+    std::string name = trim(section_name);
+    if (name.empty()) {
+        last_error_ = "Domain section without a name";
+        return false;
+    }
+    
+    // A file may refine a built-in provider config
+    auto existing = domain_configs_.find(name);
+    DomainConfig domain = existing != domain_configs_.end() ? existing->second : DomainConfig();
+    domain.name = name;
+    for (const auto& pair : key_value_pairs) {
+        const std::string& key = pair.first;
+        const std::string& value = pair.second;
+        bool valid = true;
+        
+        if (key == "enabled") {
+            valid = parseBool(value, domain.enabled);
+        } else if (key == "smtp_server") {
+            domain.smtp_server = value;
+        } else if (key == "smtp_port") {
+            valid = parseInt(value, domain.smtp_port) && domain.smtp_port > 0 && domain.smtp_port < 65536;
+        } else if (key == "auth_method") {
+            domain.auth_method = value;
+        } else if (key == "service_account") {
+            domain.service_account = value;
+        } else if (key == "relay_account") {
+            domain.relay_account = value;
+        } else if (key == "username") {
+            domain.username = value;
+        } else if (key == "password") {
+            domain.password = value;
+        } else if (key == "oauth2_token") {
+            domain.oauth2_token = value;
+        } else if (key == "use_ssl") {
+            valid = parseBool(value, domain.use_ssl);
+        } else if (key == "use_starttls") {
+            valid = parseBool(value, domain.use_starttls);
+        } else if (key == "require_starttls") {
+            valid = parseBool(value, domain.require_starttls);
+        } else if (key == "ssl_verify_peer") {
+            valid = parseBool(value, domain.ssl_verify_peer);
+        } else if (key == "ssl_cert_file") {
+            domain.ssl_cert_file = value;
+        } else if (key == "ssl_key_file") {
+            domain.ssl_key_file = value;
+        } else if (key == "ssl_ca_file") {
+            domain.ssl_ca_file = value;
+        } else if (key == "use_curl_fallback") {
+            valid = parseBool(value, domain.use_curl_fallback);
+        } else if (key == "dkim_domain") {
+            domain.dkim_domain = value;
+        } else if (key == "dkim_selector") {
+            domain.dkim_selector = value;
+        } else if (key == "dkim_private_key_file") {
+            domain.dkim_private_key_file = value;
+        }
+        
+        if (!valid) {
+            last_error_ = "Invalid value for " + key + " in [domain:" + name + "]: " + value;
+            return false;
+        }
+    }
+    domain_configs_[name] = domain;
+    return true;
+}
+
+bool ConfigManager::parseGlobalConfig(const std::map<std::string, std::string>& key_value_pairs) {
+    GlobalConfig& global = global_config_;
+    for (const auto& pair : key_value_pairs) {
+        const std::string& key = pair.first;
+        const std::string& value = pair.second;
+        bool valid = true;
+        
+        if (key == "default_hostname") {
+            global.default_hostname = value;
+        } else if (key == "default_from") {
+            global.default_from = value;
+        } else if (key == "config_dir") {
+            global.config_dir = value;
+        } else if (key == "domains_dir") {
+            global.domains_dir = value;
+        } else if (key == "users_dir") {
+            global.users_dir = value;
+        } else if (key == "mappings_dir") {
+            global.mappings_dir = value;
+        } else if (key == "ssl_dir") {
+            global.ssl_dir = value;
+        } else if (key == "log_file") {
+            global.log_file = value;
+        } else if (key == "log_level") {
+            global.log_level = value;
+        } else if (key == "max_connections") {
+            valid = parseInt(value, global.max_connections);
+        } else if (key == "connection_timeout") {
+            valid = parseInt(value, global.connection_timeout);
+        } else if (key == "read_timeout") {
+            valid = parseInt(value, global.read_timeout);
+        } else if (key == "write_timeout") {
+            valid = parseInt(value, global.write_timeout);
+        } else if (key == "enable_rate_limiting") {
+            valid = parseBool(value, global.enable_rate_limiting);
+        } else if (key == "rate_limit_per_minute") {
+            valid = parseInt(value, global.rate_limit_per_minute);
+        } else if (key == "direct_delivery") {
+            valid = parseBool(value, global.direct_delivery);
+        } else if (key == "queue_dir") {
+            global.queue_dir = value;
+        } else if (key == "queue_sync") {
+            valid = parseBool(value, global.queue_sync);
+        } else if (key == "queue_commit_delay_ms") {
+            valid = parseInt(value, global.queue_commit_delay_ms) && global.queue_commit_delay_ms >= 0;
+        }
+        
+        if (!valid) {
+            last_error_ = "Invalid value for " + key + " in [global]: " + value;
+            return false;
+        }
+    }
+    return true;
+}
+
 void ConfigManager::setupDefaultConfigs() {
     // Set up some default domain configurations for common email providers
     
@@ -24,11 +24,18 @@ struct DomainConfig {
     std::string oauth2_token;
     bool use_ssl;
     bool use_starttls;
+    bool require_starttls;      // false = continue in plaintext when STARTTLS is not offered
+    bool ssl_verify_peer;
     std::string ssl_cert_file;
     std::string ssl_key_file;
     std::string ssl_ca_file;
+    bool use_curl_fallback;
+    std::string dkim_domain;            // Signing domain (d=); empty = name
+    std::string dkim_selector;          // DKIM signing is enabled when selector and key are set
+    std::string dkim_private_key_file;  // PEM, RSA (rsa-sha256) or Ed25519 (ed25519-sha256)
     
-    DomainConfig() : enabled(true), smtp_port(587), use_ssl(false), use_starttls(true) {}
+    DomainConfig() : enabled(true), smtp_port(587), use_ssl(false), use_starttls(true),
+                     require_starttls(true), ssl_verify_peer(true), use_curl_fallback(false) {}
 };
 
 /**
@@ -80,10 +87,16 @@ struct GlobalConfig {
     int write_timeout;
     bool enable_rate_limiting;
     int rate_limit_per_minute;
+    bool direct_delivery;       // Deliver to recipient MX hosts instead of the sender's relay
+    std::string queue_dir;      // Spool that keeps the queue across restarts; empty keeps it in memory
+    bool queue_sync;            // Enqueue waits until the mail is on disk
+    int queue_commit_delay_ms;  // Time a journal commit waits to batch more mail into one fsync
     
     GlobalConfig() : max_connections(10), connection_timeout(30), 
                      read_timeout(60), write_timeout(60), 
-                     enable_rate_limiting(true), rate_limit_per_minute(100) {}
+                     enable_rate_limiting(true), rate_limit_per_minute(100),
+                     direct_delivery(false),
+                     queue_sync(true), queue_commit_delay_ms(0) {}
 };
 
 /**
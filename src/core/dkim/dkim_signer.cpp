@@ -0,0 +1,419 @@
+#include "core/dkim/dkim_signer.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/base64.hpp"
+#include "utils/byte_scan.hpp"
+#include <openssl/pem.h>
+#include <openssl/err.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// Canonical body bytes collected before each digest update
+const size_t HASH_STAGING_SIZE = 64 * 1024;
+
+// RFC 8301 section 3.2: verifiers may reject RSA keys below 1024 bits
+const int MIN_RSA_KEY_BITS = 1024;
+
+bool isWhitespace(char c) {
+    return c == ' ' || c == '\t';
+}
+
+std::string toLower(const std::string& text) {
+    std::string lower = text;
+    std::transform(lower.begin(), lower.end(), lower.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return lower;
+}
+
+/**
+ * Relaxed header value (RFC 6376 section 3.4.2): unfolded, whitespace runs
+ * reduced to one space, no leading or trailing whitespace
+ */
+std::string relaxValue(const std::string& value) {
+    std::string relaxed;
+    relaxed.reserve(value.size());
+    bool space = false;
+    for (char c : value) {
+        if (c == '\r' || c == '\n') {
+            continue;
+        }
+        if (isWhitespace(c)) {
+            space = true;
+            continue;
+        }
+        if (space && !relaxed.empty()) {
+            relaxed.push_back(' ');
+        }
+        space = false;
+        relaxed.push_back(c);
+    }
+    return relaxed;
+}
+
+struct HeaderField {
+    std::string name;       // Lower case
+    std::string value;      // Unfolded, as it appeared after the colon
+};
+
+std::vector<HeaderField> parseHeaders(const std::string& headers) {
+    std::vector<HeaderField> fields;
+    size_t pos = 0;
+    while (pos < headers.size()) {
+        size_t end = headers.find('\n', pos);
+        if (end == std::string::npos) {
+            end = headers.size();
+        }
+        std::string line = headers.substr(pos, end - pos);
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        pos = end + 1;
+
+        if (!line.empty() && isWhitespace(line[0])) {
+            // Continuation of a folded field
+            if (!fields.empty()) {
+                fields.back().value += line;
+            }
+            continue;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            continue;
+        }
+        HeaderField field;
+        field.name = toLower(relaxValue(line.substr(0, colon)));
+        field.value = line.substr(colon + 1);
+        fields.push_back(std::move(field));
+    }
+    return fields;
+}
+
+std::string openSSLError() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown OpenSSL error";
+    }
+    char buffer[256];
+    ERR_error_string_n(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+} // anonymous namespace
+
+DKIMBodyHasher::DKIMBodyHasher()
+    : context_(EVP_MD_CTX_new()), pending_line_breaks_(0), pending_space_(false),
+      pending_cr_(false), has_content_(false) {
+    EVP_DigestInit_ex(context_, EVP_sha256(), nullptr);
+    staging_.reserve(HASH_STAGING_SIZE + 2);
+}
+
+DKIMBodyHasher::~DKIMBodyHasher() {
+    EVP_MD_CTX_free(context_);
+}
+
+void DKIMBodyHasher::update(const char* data, size_t length) {
+    const char* end = data + length;
+
+    while (data < end) {
+        if (pending_cr_) {
+            pending_cr_ = false;
+            if (*data == '\n') {
+                ++data;
+                continue;
+            }
+        }
+
+        const char* line_end = data + findLineBreak(data, static_cast<size_t>(end - data));
+        while (data < line_end) {
+            const char* run = data;
+            while (data < line_end && !isWhitespace(*data)) {
+                ++data;
+            }
+            if (data > run) {
+                // Line breaks and spaces held back so far turned out not to be trailing
+                for (; pending_line_breaks_ > 0; --pending_line_breaks_) {
+                    staging_.append("\r\n", 2);
+                }
+                if (pending_space_) {
+                    staging_.push_back(' ');
+                    pending_space_ = false;
+                }
+                staging_.append(run, static_cast<size_t>(data - run));
+                has_content_ = true;
+                if (staging_.size() >= HASH_STAGING_SIZE) {
+                    flush();
+                }
+            }
+            while (data < line_end && isWhitespace(*data)) {
+                pending_space_ = true;
+                ++data;
+            }
+        }
+
+        if (data < end) {
+            pending_cr_ = *data == '\r';
+            pending_line_breaks_++;
+            pending_space_ = false;
+            ++data;
+        }
+    }
+}
+
+std::string DKIMBodyHasher::finish() {
+    // A non-empty body ends with exactly one CRLF; an empty one hashes as nothing
+    if (has_content_) {
+        staging_.append("\r\n", 2);
+    }
+    flush();
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    EVP_DigestFinal_ex(context_, digest, &digest_length);
+
+    std::string encoded(base64EncodedLength(digest_length), '\0');
+    base64Encode(digest, digest_length, &encoded[0]);
+
+    EVP_DigestInit_ex(context_, EVP_sha256(), nullptr);
+    pending_line_breaks_ = 0;
+    pending_space_ = false;
+    pending_cr_ = false;
+    has_content_ = false;
+    return encoded;
+}
+
+void DKIMBodyHasher::flush() {
+    if (!staging_.empty()) {
+        EVP_DigestUpdate(context_, staging_.data(), staging_.size());
+        staging_.clear();
+    }
+}
+
+DKIMMessageHasher::DKIMMessageHasher() : in_body_(false) {
+}
+
+void DKIMMessageHasher::update(const char* data, size_t length) {
+    if (in_body_) {
+        body_.update(data, length);
+        return;
+    }
+
+    size_t search_from = headers_.size() < 3 ? 0 : headers_.size() - 3;
+    headers_.append(data, length);
+
+    size_t crlf = headers_.find("\r\n\r\n", search_from);
+    size_t lf = headers_.find("\n\n", search_from);
+    if (crlf == std::string::npos && lf == std::string::npos) {
+        return;
+    }
+
+    // Keep the line break that ends the last header; the rest is body
+    size_t header_end = crlf < lf ? crlf + 2 : lf + 1;
+    size_t body_start = crlf < lf ? crlf + 4 : lf + 2;
+    in_body_ = true;
+    body_.update(headers_.data() + body_start, headers_.size() - body_start);
+    headers_.resize(header_end);
+}
+
+std::string DKIMMessageHasher::finish(std::string& headers) {
+    headers = headers_;
+    headers_.clear();
+    in_body_ = false;
+    return body_.finish();
+}
+
+const std::vector<std::string>& DKIMSigner::signedHeaders() {
+    static const std::vector<std::string> headers = {
+        "from", "to", "cc", "subject", "date", "message-id", "reply-to",
+        "mime-version", "content-type", "content-transfer-encoding"
+    };
+    return headers;
+}
+
+DKIMSigner::DKIMSigner() : key_(nullptr), algorithm_(DKIMAlgorithm::RSA_SHA256) {
+}
+
+DKIMSigner::~DKIMSigner() {
+    EVP_PKEY_free(key_);
+}
+
+std::shared_ptr<const DKIMSigner> DKIMSigner::create(const std::string& domain, const std::string& selector,
+                                                     const std::string& key_file, std::string& error) {
+    BIO* bio = BIO_new_file(key_file.c_str(), "r");
+    if (!bio) {
+        error = "Cannot open DKIM key " + key_file + ": " + std::strerror(errno);
+        return nullptr;
+    }
+    EVP_PKEY* key = PEM_read_bio_PrivateKey(bio, nullptr, nullptr, nullptr);
+    BIO_free(bio);
+    if (!key) {
+        error = "Cannot parse DKIM key " + key_file + ": " + openSSLError();
+        return nullptr;
+    }
+
+    std::shared_ptr<DKIMSigner> signer(new DKIMSigner());
+    signer->key_ = key;
+    signer->domain_ = domain;
+    signer->selector_ = selector;
+
+    switch (EVP_PKEY_base_id(key)) {
+        case EVP_PKEY_RSA:
+            if (EVP_PKEY_bits(key) < MIN_RSA_KEY_BITS) {
+                error = "DKIM key " + key_file + " is shorter than " +
+                        std::to_string(MIN_RSA_KEY_BITS) + " bits";
+                return nullptr;
+            }
+            signer->algorithm_ = DKIMAlgorithm::RSA_SHA256;
+            break;
+        case EVP_PKEY_ED25519:
+            signer->algorithm_ = DKIMAlgorithm::ED25519_SHA256;
+            break;
+        default:
+            error = "DKIM key " + key_file + " is neither RSA nor Ed25519";
+            return nullptr;
+    }
+    return signer;
+}
+
+bool DKIMSigner::sign(const std::string& headers, const std::string& body_hash,
+                      std::string& signature, std::string& error) const {
+    std::vector<HeaderField> fields = parseHeaders(headers);
+
+    // Relaxed header canonicalisation (RFC 6376 section 3.4.2); with one
+    // instance of each header the last occurrence is the one signed
+    std::string data;
+    std::string header_list;
+    for (const auto& name : signedHeaders()) {
+        auto field = std::find_if(fields.rbegin(), fields.rend(),
+                                  [&name](const HeaderField& f) { return f.name == name; });
+        if (field == fields.rend()) {
+            continue;
+        }
+        data += name + ":" + relaxValue(field->value) + "\r\n";
+        header_list += (header_list.empty() ? "" : ":") + name;
+    }
+
+    std::string value = std::string("v=1; a=") +
+        (algorithm_ == DKIMAlgorithm::ED25519_SHA256 ? "ed25519-sha256" : "rsa-sha256") +
+        "; c=relaxed/relaxed; d=" + domain_ + "; s=" + selector_ + ";\r\n"
+        "\tt=" + std::to_string(static_cast<long long>(std::time(nullptr))) + "; h=" + header_list + ";\r\n"
+        "\tbh=" + body_hash + ";\r\n"
+        "\tb=";
+
+    // The signature header itself is signed with an empty b= and no CRLF
+    data += "dkim-signature:" + relaxValue(value);
+
+    std::string raw;
+    if (!signData(data, raw, error)) {
+        return false;
+    }
+    signature = "DKIM-Signature: " + value + base64Encode(raw) + "\r\n";
+    return true;
+}
+
+bool DKIMSigner::signData(const std::string& data, std::string& signature, std::string& error) const {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data.data());
+    size_t input_length = data.size();
+
+    // Ed25519 signs the SHA-256 digest of the data, RSA the data itself (RFC 8463)
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    const EVP_MD* md = EVP_sha256();
+    if (algorithm_ == DKIMAlgorithm::ED25519_SHA256) {
+        if (EVP_Digest(input, input_length, digest, &digest_length, EVP_sha256(), nullptr) != 1) {
+            error = "DKIM digest failed: " + openSSLError();
+            return false;
+        }
+        input = digest;
+        input_length = digest_length;
+        md = nullptr;
+    }
+
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    size_t length = 0;
+    bool signed_ok = context &&
+        EVP_DigestSignInit(context, nullptr, md, nullptr, key_) == 1 &&
+        EVP_DigestSign(context, nullptr, &length, input, input_length) == 1;
+    if (signed_ok) {
+        signature.resize(length);
+        signed_ok = EVP_DigestSign(context, reinterpret_cast<unsigned char*>(&signature[0]), &length,
+                                   input, input_length) == 1;
+        signature.resize(length);
+    }
+    EVP_MD_CTX_free(context);
+
+    if (!signed_ok) {
+        error = "DKIM signing failed: " + openSSLError();
+    }
+    return signed_ok;
+}
+
+DKIMSignerCache& DKIMSignerCache::getInstance() {
+    static DKIMSignerCache instance;
+    return instance;
+}
+
+bool DKIMSignerCache::get(const DomainConfig& domain_config, std::shared_ptr<const DKIMSigner>& signer,
+                          std::string& error) {
+    signer.reset();
+    if (domain_config.dkim_selector.empty() || domain_config.dkim_private_key_file.empty()) {
+        return true;
+    }
+
+    std::string domain = domain_config.dkim_domain.empty() ? domain_config.name : domain_config.dkim_domain;
+    std::string key = domain + "\n" + domain_config.dkim_selector + "\n" + domain_config.dkim_private_key_file;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = signers_.find(key);
+    if (it != signers_.end()) {
+        signer = it->second;
+        return true;
+    }
+
+    // Failures are not cached, so a key installed later is picked up
+    signer = DKIMSigner::create(domain, domain_config.dkim_selector, domain_config.dkim_private_key_file, error);
+    if (!signer) {
+        return false;
+    }
+    signers_.emplace(key, signer);
+
+    Logger::getInstance().info("Loaded DKIM key for " + domain + " (selector " +
+                               domain_config.dkim_selector + ")");
+    return true;
+}
+
+SignedMessageStream::SignedMessageStream(const std::string& signature, MessageStream& message)
+    : signature_(signature), offset_(0), message_(message) {
+}
+
+size_t SignedMessageStream::read(char* buffer, size_t size) {
+    size_t count = std::min(size, signature_.size() - offset_);
+    std::memcpy(buffer, signature_.data() + offset_, count);
+    offset_ += count;
+    return count + (count < size ? message_.read(buffer + count, size - count) : 0);
+}
+
+bool SignedMessageStream::next(ConstBuffer& piece, bool& transient) {
+    if (offset_ < signature_.size()) {
+        piece = ConstBuffer(signature_.data() + offset_, signature_.size() - offset_);
+        offset_ = signature_.size();
+        transient = false;
+        return true;
+    }
+    return message_.next(piece, transient);
+}
+
+bool SignedMessageStream::good() const {
+    return message_.good();
+}
+
+std::string SignedMessageStream::getLastError() const {
+    return message_.getLastError();
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstddef>
+#include <openssl/evp.h>
+#include "core/config/config_manager.hpp"
+#include "core/mime/message_stream.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief DKIM signing algorithms (RFC 6376, RFC 8463)
+ */
+enum class DKIMAlgorithm {
+    RSA_SHA256,
+    ED25519_SHA256
+};
+
+/**
+ * @brief Streaming relaxed body canonicalisation and SHA-256 body hash
+ *
+ * Implements the "relaxed" body algorithm of RFC 6376 section 3.4.4 in a
+ * single pass: whitespace runs become one space, whitespace at line ends
+ * and empty lines at the end of the body are dropped. Bare CR and bare LF
+ * count as line breaks, as they become CRLF on the wire. Input may be
+ * split at any byte.
+ */
+class DKIMBodyHasher {
+public:
+    DKIMBodyHasher();
+    ~DKIMBodyHasher();
+
+    DKIMBodyHasher(const DKIMBodyHasher&) = delete;
+    DKIMBodyHasher& operator=(const DKIMBodyHasher&) = delete;
+
+    /**
+     * @brief Hash the next piece of the body
+     * @param data Body bytes
+     * @param length Length in bytes
+     */
+    void update(const char* data, size_t length);
+
+    /**
+     * @brief End the body
+     * @return Base64 body hash, the value of the bh= tag
+     */
+    std::string finish();
+
+private:
+    void flush();
+
+    EVP_MD_CTX* context_;
+    std::string staging_;           // Canonical bytes not yet hashed
+    size_t pending_line_breaks_;    // Held back until content shows they are not trailing
+    bool pending_space_;
+    bool pending_cr_;
+    bool has_content_;
+};
+
+/**
+ * @brief Splits a message into its header block and DKIM body hash
+ *
+ * Feed the message in order; the header block is kept as text (it is
+ * small) and the body goes through a DKIMBodyHasher as it arrives.
+ */
+class DKIMMessageHasher {
+public:
+    DKIMMessageHasher();
+
+    /**
+     * @brief Process the next piece of the message
+     * @param data Message bytes
+     * @param length Length in bytes
+     */
+    void update(const char* data, size_t length);
+
+    /**
+     * @brief End the message
+     * @param headers Header block, without the empty line that ends it
+     * @return Base64 body hash
+     */
+    std::string finish(std::string& headers);
+
+private:
+    std::string headers_;
+    bool in_body_;
+    DKIMBodyHasher body_;
+};
+
+/**
+ * @brief DKIM signer for one signing domain, selector and private key
+ *
+ * The key is parsed once when the signer is created; signing a message
+ * then costs one header canonicalisation and one private-key operation.
+ * Instances are immutable and safe to share between threads.
+ */
+class DKIMSigner {
+public:
+    /**
+     * @brief Headers signed when present, in the order they are listed in h=
+     */
+    static const std::vector<std::string>& signedHeaders();
+
+    /**
+     * @brief Load a signer
+     * @param domain Signing domain (d=)
+     * @param selector Selector (s=)
+     * @param key_file PEM private key, RSA or Ed25519
+     * @param error Error message on failure
+     * @return Signer, or nullptr if the key could not be loaded
+     */
+    static std::shared_ptr<const DKIMSigner> create(const std::string& domain, const std::string& selector,
+                                                    const std::string& key_file, std::string& error);
+
+    ~DKIMSigner();
+
+    DKIMSigner(const DKIMSigner&) = delete;
+    DKIMSigner& operator=(const DKIMSigner&) = delete;
+
+    /**
+     * @brief Create the DKIM-Signature header for a message
+     * @param headers Header block of the message, CRLF separated
+     * @param body_hash Relaxed body hash from DKIMBodyHasher
+     * @param signature DKIM-Signature header line(s), ending with CRLF
+     * @param error Error message on failure
+     * @return true if signed, false otherwise
+     */
+    bool sign(const std::string& headers, const std::string& body_hash,
+              std::string& signature, std::string& error) const;
+
+    DKIMAlgorithm getAlgorithm() const { return algorithm_; }
+    const std::string& getDomain() const { return domain_; }
+    const std::string& getSelector() const { return selector_; }
+
+private:
+    DKIMSigner();
+
+    bool signData(const std::string& data, std::string& signature, std::string& error) const;
+
+    EVP_PKEY* key_;
+    DKIMAlgorithm algorithm_;
+    std::string domain_;
+    std::string selector_;
+};
+
+/**
+ * @brief Process-wide cache of DKIM signers, keyed by domain configuration
+ *
+ * Keys are read and parsed on first use of a domain and kept for the
+ * lifetime of the process.
+ */
+class DKIMSignerCache {
+public:
+    /**
+     * @brief Get the process-wide instance
+     * @return Cache instance
+     */
+    static DKIMSignerCache& getInstance();
+
+    /**
+     * @brief Get the signer configured for a domain
+     * @param domain_config Domain configuration with the dkim_* settings
+     * @param signer Signer, or nullptr when the domain does not sign
+     * @param error Error message on failure
+     * @return false if the domain signs but its key could not be loaded
+     */
+    bool get(const DomainConfig& domain_config, std::shared_ptr<const DKIMSigner>& signer,
+             std::string& error);
+
+private:
+    DKIMSignerCache() = default;
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::shared_ptr<const DKIMSigner>> signers_;
+};
+
+/**
+ * @brief Message stream with a DKIM-Signature header in front of another stream
+ *
+ * The inner stream must outlive this one.
+ */
+class SignedMessageStream : public MessageStream {
+public:
+    /**
+     * @brief Constructor
+     * @param signature DKIM-Signature header, ending with CRLF
+     * @param message Message to prefix
+     */
+    SignedMessageStream(const std::string& signature, MessageStream& message);
+
+    size_t read(char* buffer, size_t size) override;
+    bool next(ConstBuffer& piece, bool& transient) override;
+    bool good() const override;
+    std::string getLastError() const override;
+
+private:
+    std::string signature_;
+    size_t offset_;
+    MessageStream& message_;
+};
+
+} // namespace ssmtp_mailer
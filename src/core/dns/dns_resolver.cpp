@@ -0,0 +1,1012 @@
+#include "core/dns/dns_resolver.hpp"
+#include "core/logging/logger.hpp"
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <sstream>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const uint16_t TYPE_A = 1;
+const uint16_t TYPE_CNAME = 5;
+const uint16_t TYPE_SOA = 6;
+const uint16_t TYPE_MX = 15;
+const uint16_t TYPE_AAAA = 28;
+const uint16_t TYPE_OPT = 41;
+const uint16_t CLASS_IN = 1;
+
+const uint16_t EDNS_PAYLOAD_SIZE = 1232;
+const size_t MAX_NAMESERVERS = 3;
+const int MAX_CNAME_CHAIN = 8;
+const int MAX_COMPRESSION_JUMPS = 32;
+
+struct ResourceRecord {
+    std::string owner;
+    uint16_t type;
+    uint32_t ttl;
+    size_t rdata;
+    size_t rdata_length;
+};
+
+uint16_t read16(const unsigned char* data) {
+    return static_cast<uint16_t>((data[0] << 8) | data[1]);
+}
+
+uint32_t read32(const unsigned char* data) {
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+void append16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value & 0xFF));
+}
+
+std::string toLower(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return value;
+}
+
+// Reads a possibly compressed name and advances offset past it
+bool readName(const unsigned char* data, size_t length, size_t& offset, std::string& name) {
+    name.clear();
+    size_t pos = offset;
+    bool jumped = false;
+    int jumps = 0;
+
+    while (true) {
+        if (pos >= length) {
+            return false;
+        }
+        unsigned char label = data[pos];
+        if (label == 0) {
+            if (!jumped) {
+                offset = pos + 1;
+            }
+            break;
+        }
+        if ((label & 0xC0) == 0xC0) {
+            if (pos + 1 >= length || ++jumps > MAX_COMPRESSION_JUMPS) {
+                return false;
+            }
+            size_t target = (static_cast<size_t>(label & 0x3F) << 8) | data[pos + 1];
+            if (!jumped) {
+                offset = pos + 2;
+            }
+            jumped = true;
+            pos = target;
+            continue;
+        }
+        if ((label & 0xC0) != 0 || pos + 1 + label > length) {
+            return false;
+        }
+        if (!name.empty()) {
+            name.push_back('.');
+        }
+        name.append(reinterpret_cast<const char*>(data + pos + 1), label);
+        if (name.size() > 255) {
+            return false;
+        }
+        pos += 1 + label;
+    }
+
+    name = toLower(name);
+    return true;
+}
+
+bool readRecord(const unsigned char* data, size_t length, size_t& offset, ResourceRecord& record) {
+    if (!readName(data, length, offset, record.owner) || offset + 10 > length) {
+        return false;
+    }
+    record.type = read16(data + offset);
+    record.ttl = read32(data + offset + 4);
+    record.rdata_length = read16(data + offset + 8);
+    record.rdata = offset + 10;
+    offset = record.rdata + record.rdata_length;
+    return offset <= length;
+}
+
+bool isValidName(const std::string& name) {
+    if (name.empty() || name.size() > 253) {
+        return false;
+    }
+    size_t start = 0;
+    while (start <= name.size()) {
+        size_t dot = name.find('.', start);
+        size_t end = dot == std::string::npos ? name.size() : dot;
+        if (end == start || end - start > 63) {
+            return false;
+        }
+        if (dot == std::string::npos) {
+            break;
+        }
+        start = dot + 1;
+    }
+    return true;
+}
+
+bool parseNameserver(const std::string& text, struct sockaddr_storage& storage, socklen_t& length) {
+    std::string host = text;
+    int port = 53;
+
+    if (!host.empty() && host[0] == '[') {
+        size_t close = host.find(']');
+        if (close == std::string::npos) {
+            return false;
+        }
+        if (close + 1 < host.size() && host[close + 1] == ':') {
+            port = std::atoi(host.c_str() + close + 2);
+        }
+        host = host.substr(1, close - 1);
+    } else if (std::count(host.begin(), host.end(), ':') == 1) {
+        size_t colon = host.find(':');
+        port = std::atoi(host.c_str() + colon + 1);
+        host = host.substr(0, colon);
+    }
+
+    IPAddress address;
+    if (port <= 0 || port > 65535 || !IPAddress::parse(host, address)) {
+        return false;
+    }
+    length = address.toSockaddr(port, storage);
+    return true;
+}
+
+} // anonymous namespace
+
+IPAddress::IPAddress() : family(AF_INET) {
+    memset(bytes, 0, sizeof(bytes));
+}
+
+bool IPAddress::parse(const std::string& text, IPAddress& address) {
+    IPAddress parsed;
+    if (inet_pton(AF_INET, text.c_str(), parsed.bytes) == 1) {
+        parsed.family = AF_INET;
+    } else if (inet_pton(AF_INET6, text.c_str(), parsed.bytes) == 1) {
+        parsed.family = AF_INET6;
+    } else {
+        return false;
+    }
+    address = parsed;
+    return true;
+}
+
+std::string IPAddress::toString() const {
+    char buffer[INET6_ADDRSTRLEN];
+    if (!inet_ntop(family, bytes, buffer, sizeof(buffer))) {
+        return "";
+    }
+    return buffer;
+}
+
+socklen_t IPAddress::toSockaddr(int port, struct sockaddr_storage& storage) const {
+    memset(&storage, 0, sizeof(storage));
+    if (family == AF_INET6) {
+        struct sockaddr_in6* address = reinterpret_cast<struct sockaddr_in6*>(&storage);
+        address->sin6_family = AF_INET6;
+        address->sin6_port = htons(static_cast<uint16_t>(port));
+        memcpy(&address->sin6_addr, bytes, 16);
+        return sizeof(struct sockaddr_in6);
+    }
+    struct sockaddr_in* address = reinterpret_cast<struct sockaddr_in*>(&storage);
+    address->sin_family = AF_INET;
+    address->sin_port = htons(static_cast<uint16_t>(port));
+    memcpy(&address->sin_addr, bytes, 4);
+    return sizeof(struct sockaddr_in);
+}
+
+bool IPAddress::operator==(const IPAddress& other) const {
+    return family == other.family &&
+           memcmp(bytes, other.bytes, family == AF_INET6 ? 16 : 4) == 0;
+}
+
+DNSResolver& DNSResolver::getInstance() {
+    static DNSResolver instance;
+    return instance;
+}
+
+DNSResolver::DNSResolver(const DNSResolverConfig& config)
+    : config_(config), random_(std::random_device()()), running_(false),
+      queries_sent_(0), retransmits_(0), timeouts_(0), cache_hits_(0), cache_misses_(0) {
+    if (config_.attempts < 1) {
+        config_.attempts = 1;
+    }
+    loadSystemConfig();
+    loadHostsFile();
+}
+
+DNSResolver::~DNSResolver() {
+    if (running_) {
+        running_ = false;
+        wake();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    for (auto& server : nameservers_) {
+        if (server.fd >= 0) {
+            close(server.fd);
+        }
+    }
+    wake_pipe_.close();
+
+    // Every lookup gets its callback, even during shutdown
+    std::vector<std::string> keys;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& pair : waiters_) {
+            keys.push_back(pair.first);
+        }
+    }
+    Answer answer;
+    answer.status = DNSStatus::ERROR;
+    answer.error = "DNS resolver shut down";
+    for (const auto& key : keys) {
+        complete(key, answer);
+    }
+}
+
+void DNSResolver::resolveAddress(const std::string& host, AddressCallback callback) {
+    DNSAddressResult result;
+
+    // Address literals, optionally bracketed as in [::1]
+    std::string literal = host;
+    if (literal.size() > 2 && literal.front() == '[' && literal.back() == ']') {
+        literal = literal.substr(1, literal.size() - 2);
+    }
+    IPAddress address;
+    if (IPAddress::parse(literal, address)) {
+        result.status = DNSStatus::SUCCESS;
+        result.addresses.push_back(address);
+        callback(result);
+        return;
+    }
+
+    std::string name = normalizeName(host);
+    auto host_entry = hosts_.find(name);
+    if (host_entry != hosts_.end()) {
+        result.status = DNSStatus::SUCCESS;
+        result.addresses = host_entry->second;
+        callback(result);
+        return;
+    }
+
+    if (!isValidName(name)) {
+        result.status = DNSStatus::ERROR;
+        result.error = "Invalid host name: " + host;
+        callback(result);
+        return;
+    }
+
+    struct Pending {
+        std::mutex mutex;
+        int remaining;
+        Answer ipv4;
+        Answer ipv6;
+    };
+    std::shared_ptr<Pending> pending = std::make_shared<Pending>();
+    pending->remaining = config_.enable_ipv6 ? 2 : 1;
+    pending->ipv6.status = DNSStatus::NO_DATA;
+
+    auto finish = [pending, host, callback]() {
+        DNSAddressResult combined;
+        // IPv4 first: many hosts publish AAAA records without having an IPv6 route
+        for (const Answer* answer : {&pending->ipv4, &pending->ipv6}) {
+            for (const auto& record : answer->records) {
+                combined.addresses.push_back(record.address);
+            }
+        }
+
+        if (!combined.addresses.empty()) {
+            combined.status = DNSStatus::SUCCESS;
+        } else {
+            const Answer& ipv4 = pending->ipv4;
+            const Answer& ipv6 = pending->ipv6;
+            if (ipv4.status == DNSStatus::NOT_FOUND || ipv6.status == DNSStatus::NOT_FOUND) {
+                combined.status = DNSStatus::NOT_FOUND;
+            } else if (ipv4.status != DNSStatus::SUCCESS && ipv4.status != DNSStatus::NO_DATA) {
+                combined.status = ipv4.status;
+            } else if (ipv6.status != DNSStatus::SUCCESS && ipv6.status != DNSStatus::NO_DATA) {
+                combined.status = ipv6.status;
+            } else {
+                combined.status = DNSStatus::NO_DATA;
+            }
+            combined.error = "Failed to resolve hostname: " + host + " (" +
+                             statusToString(combined.status) + ")";
+        }
+        callback(combined);
+    };
+
+    auto collect = [pending, finish](bool ipv6, const Answer& answer) {
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            (ipv6 ? pending->ipv6 : pending->ipv4) = answer;
+            done = --pending->remaining == 0;
+        }
+        if (done) {
+            finish();
+        }
+    };
+
+    query(name, TYPE_A, [collect](const Answer& answer) { collect(false, answer); });
+    if (config_.enable_ipv6) {
+        query(name, TYPE_AAAA, [collect](const Answer& answer) { collect(true, answer); });
+    }
+}
+
+void DNSResolver::resolveMX(const std::string& domain, MXCallback callback) {
+    std::string name = normalizeName(domain);
+    if (!isValidName(name)) {
+        DNSMXResult result;
+        result.status = DNSStatus::ERROR;
+        result.error = "Invalid domain name: " + domain;
+        callback(result);
+        return;
+    }
+
+    query(name, TYPE_MX, [this, name, callback](const Answer& answer) {
+        DNSMXResult result;
+        result.status = answer.status;
+
+        if (answer.status == DNSStatus::NO_DATA) {
+            // Implicit MX: the domain itself is the exchanger
+            result.status = DNSStatus::SUCCESS;
+            result.records.push_back(MXRecord(0, name));
+        } else if (answer.status == DNSStatus::SUCCESS) {
+            for (const auto& record : answer.records) {
+                if (!record.name.empty()) {
+                    result.records.push_back(MXRecord(record.preference, record.name));
+                }
+            }
+            if (result.records.empty()) {
+                result.status = DNSStatus::NO_MAIL;
+            } else {
+                // Randomize among equal preferences, then order by preference
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    std::shuffle(result.records.begin(), result.records.end(), random_);
+                }
+                std::stable_sort(result.records.begin(), result.records.end(),
+                                 [](const MXRecord& a, const MXRecord& b) {
+                                     return a.preference < b.preference;
+                                 });
+            }
+        }
+
+        if (result.status != DNSStatus::SUCCESS) {
+            result.error = result.status == DNSStatus::NO_MAIL
+                ? "Domain does not accept mail: " + name
+                : "Failed to resolve MX for " + name + " (" + statusToString(result.status) + ")";
+        }
+        callback(result);
+    });
+}
+
+DNSAddressResult DNSResolver::lookupAddress(const std::string& host) {
+    std::promise<DNSAddressResult> promise;
+    std::future<DNSAddressResult> future = promise.get_future();
+    resolveAddress(host, [&promise](const DNSAddressResult& result) { promise.set_value(result); });
+    return future.get();
+}
+
+DNSMXResult DNSResolver::lookupMX(const std::string& domain) {
+    std::promise<DNSMXResult> promise;
+    std::future<DNSMXResult> future = promise.get_future();
+    resolveMX(domain, [&promise](const DNSMXResult& result) { promise.set_value(result); });
+    return future.get();
+}
+
+DNSResolverStats DNSResolver::getStats() const {
+    DNSResolverStats stats;
+    stats.queries_sent = queries_sent_;
+    stats.retransmits = retransmits_;
+    stats.timeouts = timeouts_;
+    stats.cache_hits = cache_hits_;
+    stats.cache_misses = cache_misses_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.cache_entries = cache_.size();
+    return stats;
+}
+
+void DNSResolver::clearCache() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+}
+
+std::string DNSResolver::statusToString(DNSStatus status) {
+    switch (status) {
+        case DNSStatus::SUCCESS: return "success";
+        case DNSStatus::NOT_FOUND: return "no such domain";
+        case DNSStatus::NO_DATA: return "no records";
+        case DNSStatus::NO_MAIL: return "null MX";
+        case DNSStatus::SERVER_FAILURE: return "server failure";
+        case DNSStatus::TIMEOUT: return "timed out";
+        case DNSStatus::ERROR: return "error";
+        default: return "unknown";
+    }
+}
+
+void DNSResolver::query(const std::string& name, uint16_t type, AnswerCallback callback) {
+    std::string key = cacheKey(name, type);
+
+    Answer cached;
+    bool hit = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            if (it->second.expires > std::chrono::steady_clock::now()) {
+                cached = it->second.answer;
+                hit = true;
+            } else {
+                cache_.erase(it);
+            }
+        }
+    }
+    if (hit) {
+        cache_hits_++;
+        callback(cached);
+        return;
+    }
+    cache_misses_++;
+
+    std::string error;
+    if (!ensureThread(error)) {
+        Answer answer;
+        answer.status = DNSStatus::ERROR;
+        answer.error = error;
+        callback(answer);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<AnswerCallback>& waiting = waiters_[key];
+        waiting.push_back(std::move(callback));
+        if (waiting.size() > 1) {
+            // Same question already in flight
+            return;
+        }
+
+        Query pending;
+        pending.key = key;
+        pending.name = name;
+        pending.type = type;
+        pending.id = 0;
+        pending.server = 0;
+        pending.tries = 0;
+        pending.edns = true;
+        submitted_.push_back(pending);
+    }
+    wake();
+}
+
+bool DNSResolver::ensureThread(std::string& error) {
+    if (running_) {
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(start_mutex_);
+    if (running_) {
+        return true;
+    }
+
+    size_t usable = 0;
+    for (auto& server : nameservers_) {
+        if (server.fd >= 0) {
+            usable++;
+            continue;
+        }
+        server.fd = openSocket(server.address.ss_family, SOCK_DGRAM, true);
+        // A connected socket only accepts datagrams from that nameserver
+        if (server.fd >= 0 &&
+            ::connect(server.fd, reinterpret_cast<struct sockaddr*>(&server.address),
+                      server.address_length) < 0) {
+            close(server.fd);
+            server.fd = -1;
+        }
+        if (server.fd >= 0) {
+            usable++;
+        }
+    }
+    if (usable == 0) {
+        error = "No usable DNS nameservers";
+        return false;
+    }
+
+    std::string pipe_error;
+    if (!wake_pipe_.open(pipe_error)) {
+        error = "Failed to create DNS resolver: " + pipe_error;
+        return false;
+    }
+
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+    return true;
+}
+
+void DNSResolver::run() {
+    std::vector<struct pollfd> fds(nameservers_.size() + 1);
+    fds[0].fd = wake_pipe_.fd();
+    fds[0].events = POLLIN;
+    for (size_t i = 0; i < nameservers_.size(); ++i) {
+        fds[i + 1].fd = nameservers_[i].fd;     // Negative descriptors are ignored by poll
+        fds[i + 1].events = POLLIN;
+    }
+
+    unsigned char buffer[65536];
+    std::vector<uint16_t> expired;
+
+    while (running_) {
+        std::vector<Query> fresh;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            fresh.swap(submitted_);
+            for (auto& pending : fresh) {
+                do {
+                    pending.id = static_cast<uint16_t>(random_());
+                } while (outstanding_.count(pending.id));
+                while (nameservers_[pending.server].fd < 0) {
+                    pending.server++;
+                }
+                outstanding_[pending.id] = pending;
+            }
+        }
+        for (const auto& pending : fresh) {
+            sendQuery(outstanding_[pending.id]);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        int timeout = -1;
+        for (const auto& pair : outstanding_) {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+                pair.second.deadline - now).count() + 1;
+            int wait = remaining < 0 ? 0 : static_cast<int>(remaining);
+            if (timeout < 0 || wait < timeout) {
+                timeout = wait;
+            }
+        }
+
+        for (auto& fd : fds) {
+            fd.revents = 0;
+        }
+        int ready = poll(fds.data(), fds.size(), timeout);
+        if (ready < 0 && errno != EINTR) {
+            Logger::getInstance().error("DNS resolver poll failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        if (ready > 0) {
+            if (fds[0].revents & POLLIN) {
+                wake_pipe_.drain();
+            }
+            for (size_t i = 1; i < fds.size(); ++i) {
+                if (!(fds[i].revents & POLLIN)) {
+                    continue;
+                }
+                ssize_t received;
+                while ((received = recv(fds[i].fd, buffer, sizeof(buffer), 0)) > 0) {
+                    handleDatagram(buffer, static_cast<size_t>(received));
+                }
+            }
+        }
+
+        now = std::chrono::steady_clock::now();
+        expired.clear();
+        for (const auto& pair : outstanding_) {
+            if (pair.second.deadline <= now) {
+                expired.push_back(pair.first);
+            }
+        }
+        for (uint16_t id : expired) {
+            retryOrFail(id, DNSStatus::TIMEOUT, "DNS query timed out");
+        }
+    }
+
+    // Whatever is still outstanding is failed by the destructor through waiters_
+    outstanding_.clear();
+}
+
+void DNSResolver::sendQuery(Query& query) {
+    std::string packet;
+    append16(packet, query.id);
+    append16(packet, 0x0100);                   // Standard query, recursion desired
+    append16(packet, 1);                        // QDCOUNT
+    append16(packet, 0);                        // ANCOUNT
+    append16(packet, 0);                        // NSCOUNT
+    append16(packet, query.edns ? 1 : 0);       // ARCOUNT
+
+    size_t start = 0;
+    while (start < query.name.size()) {
+        size_t dot = query.name.find('.', start);
+        size_t end = dot == std::string::npos ? query.name.size() : dot;
+        packet.push_back(static_cast<char>(end - start));
+        packet.append(query.name, start, end - start);
+        start = end + 1;
+    }
+    packet.push_back('\0');
+    append16(packet, query.type);
+    append16(packet, CLASS_IN);
+
+    if (query.edns) {
+        // OPT pseudo-record advertising a larger UDP payload (RFC 6891)
+        packet.push_back('\0');
+        append16(packet, TYPE_OPT);
+        append16(packet, EDNS_PAYLOAD_SIZE);
+        append16(packet, 0);
+        append16(packet, 0);
+        append16(packet, 0);
+    }
+
+    query.tries++;
+    queries_sent_++;
+    if (query.tries > 1) {
+        retransmits_++;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (send(nameservers_[query.server].fd, packet.data(), packet.size(), 0) < 0) {
+        // Move on to the next nameserver straight away
+        query.deadline = now;
+        return;
+    }
+    query.deadline = now + config_.timeout;
+}
+
+void DNSResolver::handleDatagram(const unsigned char* data, size_t length) {
+    if (length < 12) {
+        return;
+    }
+    auto it = outstanding_.find(read16(data));
+    if (it == outstanding_.end()) {
+        return;
+    }
+    Query& pending = it->second;
+
+    Answer answer;
+    bool retry = false;
+    if (!parseResponse(pending, data, length, answer, retry)) {
+        // Not an answer to this question; keep waiting for the real one
+        return;
+    }
+
+    if (retry) {
+        if (pending.edns && answer.error == "format error") {
+            // Server does not understand EDNS; ask again without it
+            pending.edns = false;
+            sendQuery(pending);
+            return;
+        }
+        retryOrFail(pending.id, answer.status, answer.error);
+        return;
+    }
+
+    std::string key = pending.key;
+    outstanding_.erase(it);
+    complete(key, answer);
+}
+
+void DNSResolver::retryOrFail(uint16_t id, DNSStatus status, const std::string& error) {
+    auto it = outstanding_.find(id);
+    if (it == outstanding_.end()) {
+        return;
+    }
+    Query& pending = it->second;
+
+    size_t usable = 0;
+    for (const auto& server : nameservers_) {
+        if (server.fd >= 0) {
+            usable++;
+        }
+    }
+
+    if (pending.tries < config_.attempts * static_cast<int>(usable)) {
+        // Rotate to the next nameserver
+        do {
+            pending.server = (pending.server + 1) % nameservers_.size();
+        } while (nameservers_[pending.server].fd < 0);
+        sendQuery(pending);
+        return;
+    }
+
+    if (status == DNSStatus::TIMEOUT) {
+        timeouts_++;
+    }
+    Answer answer;
+    answer.status = status;
+    answer.error = error + " for " + pending.name;
+    std::string key = pending.key;
+    outstanding_.erase(it);
+    complete(key, answer);
+}
+
+void DNSResolver::complete(const std::string& key, const Answer& answer) {
+    std::vector<AnswerCallback> callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        bool cacheable = answer.status == DNSStatus::SUCCESS ||
+                         answer.status == DNSStatus::NOT_FOUND ||
+                         answer.status == DNSStatus::NO_DATA;
+        if (cacheable && answer.ttl > 0 && config_.max_cache_entries > 0) {
+            auto now = std::chrono::steady_clock::now();
+            if (cache_.size() >= config_.max_cache_entries) {
+                for (auto it = cache_.begin(); it != cache_.end();) {
+                    it = it->second.expires <= now ? cache_.erase(it) : std::next(it);
+                }
+                if (cache_.size() >= config_.max_cache_entries) {
+                    cache_.erase(cache_.begin());
+                }
+            }
+            CacheEntry& entry = cache_[key];
+            entry.answer = answer;
+            entry.expires = now + std::chrono::seconds(answer.ttl);
+        }
+
+        auto it = waiters_.find(key);
+        if (it != waiters_.end()) {
+            callbacks.swap(it->second);
+            waiters_.erase(it);
+        }
+    }
+
+    for (const auto& callback : callbacks) {
+        callback(answer);
+    }
+}
+
+void DNSResolver::wake() {
+    if (wake_pipe_.fd() < 0) {
+        return;
+    }
+    if (!wake_pipe_.wake()) {
+        Logger::getInstance().error("Failed to wake DNS resolver: " + std::string(strerror(errno)));
+    }
+}
+
+bool DNSResolver::parseResponse(const Query& query, const unsigned char* data, size_t length,
+                                Answer& answer, bool& retry) const {
+    uint16_t flags = read16(data + 2);
+    if (!(flags & 0x8000) || read16(data + 4) != 1) {
+        return false;
+    }
+    size_t answer_count = read16(data + 6);
+    size_t authority_count = read16(data + 8);
+    bool truncated = (flags & 0x0200) != 0;
+    int rcode = flags & 0x000F;
+
+    // The question must echo ours, otherwise this is a stray or spoofed reply
+    size_t offset = 12;
+    std::string question;
+    if (!readName(data, length, offset, question) || offset + 4 > length ||
+        question != query.name || read16(data + offset) != query.type) {
+        return false;
+    }
+    offset += 4;
+
+    if (rcode == 1) {
+        answer.status = DNSStatus::ERROR;
+        answer.error = "format error";
+        retry = true;
+        return true;
+    }
+    if (rcode != 0 && rcode != 3) {
+        answer.status = DNSStatus::SERVER_FAILURE;
+        answer.error = rcode == 5 ? "query refused" : "server failure";
+        retry = true;
+        return true;
+    }
+
+    std::vector<ResourceRecord> answers;
+    for (size_t i = 0; i < answer_count; ++i) {
+        ResourceRecord record;
+        if (!readRecord(data, length, offset, record)) {
+            if (truncated) {
+                break;
+            }
+            answer.status = DNSStatus::ERROR;
+            answer.error = "malformed response";
+            retry = true;
+            return true;
+        }
+        answers.push_back(record);
+    }
+
+    // Negative answers are cached for min(SOA TTL, SOA MINIMUM) (RFC 2308)
+    uint32_t negative_ttl = static_cast<uint32_t>(config_.negative_ttl.count());
+    bool have_soa = false;
+    for (size_t i = 0; i < authority_count && !truncated; ++i) {
+        ResourceRecord record;
+        if (!readRecord(data, length, offset, record)) {
+            break;
+        }
+        if (record.type != TYPE_SOA || have_soa) {
+            continue;
+        }
+        size_t rdata = record.rdata;
+        std::string ignored;
+        if (readName(data, length, rdata, ignored) && readName(data, length, rdata, ignored) &&
+            rdata + 20 <= record.rdata + record.rdata_length) {
+            uint32_t minimum = read32(data + rdata + 16);
+            negative_ttl = std::min(negative_ttl, std::min(record.ttl, minimum));
+            have_soa = true;
+        }
+    }
+
+    if (rcode == 3) {
+        answer.status = DNSStatus::NOT_FOUND;
+        answer.ttl = negative_ttl;
+        return true;
+    }
+
+    // Follow the CNAME chain from the question to the records we asked for
+    std::string owner = query.name;
+    uint32_t ttl = static_cast<uint32_t>(config_.max_ttl.count());
+    for (int depth = 0; depth <= MAX_CNAME_CHAIN; ++depth) {
+        bool aliased = false;
+        for (const auto& record : answers) {
+            if (record.owner != owner) {
+                continue;
+            }
+            if (record.type == query.type) {
+                Record parsed;
+                parsed.type = record.type;
+                parsed.preference = 0;
+                if (record.type == TYPE_A && record.rdata_length == 4) {
+                    parsed.address.family = AF_INET;
+                    memcpy(parsed.address.bytes, data + record.rdata, 4);
+                } else if (record.type == TYPE_AAAA && record.rdata_length == 16) {
+                    parsed.address.family = AF_INET6;
+                    memcpy(parsed.address.bytes, data + record.rdata, 16);
+                } else if (record.type == TYPE_MX && record.rdata_length >= 3) {
+                    size_t rdata = record.rdata + 2;
+                    parsed.preference = read16(data + record.rdata);
+                    if (!readName(data, length, rdata, parsed.name)) {
+                        continue;
+                    }
+                } else {
+                    continue;
+                }
+                answer.records.push_back(parsed);
+                ttl = std::min(ttl, record.ttl);
+            } else if (record.type == TYPE_CNAME && !aliased) {
+                size_t rdata = record.rdata;
+                std::string target;
+                if (readName(data, length, rdata, target)) {
+                    ttl = std::min(ttl, record.ttl);
+                    owner = target;
+                    aliased = true;
+                }
+            }
+        }
+        if (!answer.records.empty() || !aliased) {
+            break;
+        }
+    }
+
+    if (!answer.records.empty()) {
+        answer.status = DNSStatus::SUCCESS;
+        answer.ttl = ttl;
+        return true;
+    }
+    if (truncated) {
+        // No TCP fallback; the EDNS payload size makes this rare for A/AAAA/MX
+        answer.status = DNSStatus::ERROR;
+        answer.error = "truncated response";
+        return true;
+    }
+    answer.status = DNSStatus::NO_DATA;
+    answer.ttl = negative_ttl;
+    return true;
+}
+
+void DNSResolver::loadSystemConfig() {
+    std::vector<std::string> servers = config_.nameservers;
+
+    if (servers.empty()) {
+        std::ifstream file("/etc/resolv.conf");
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream tokens(line);
+            std::string keyword;
+            tokens >> keyword;
+            if (keyword == "nameserver") {
+                std::string server;
+                if (tokens >> server && servers.size() < MAX_NAMESERVERS) {
+                    servers.push_back(server);
+                }
+            } else if (keyword == "options") {
+                std::string option;
+                while (tokens >> option) {
+                    if (option.compare(0, 8, "timeout:") == 0) {
+                        int seconds = std::atoi(option.c_str() + 8);
+                        if (seconds > 0) {
+                            config_.timeout = std::chrono::seconds(seconds);
+                        }
+                    } else if (option.compare(0, 9, "attempts:") == 0) {
+                        int attempts = std::atoi(option.c_str() + 9);
+                        if (attempts > 0) {
+                            config_.attempts = attempts;
+                        }
+                    }
+                }
+            }
+        }
+        if (servers.empty()) {
+            servers.push_back("127.0.0.1");
+        }
+    }
+
+    for (const auto& text : servers) {
+        Nameserver server;
+        server.fd = -1;
+        if (!parseNameserver(text, server.address, server.address_length)) {
+            Logger::getInstance().warning("Ignoring invalid DNS nameserver: " + text);
+            continue;
+        }
+        nameservers_.push_back(server);
+    }
+}
+
+void DNSResolver::loadHostsFile() {
+    if (config_.hosts_file.empty()) {
+        return;
+    }
+
+    std::ifstream file(config_.hosts_file);
+    std::string line;
+    while (std::getline(file, line)) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) {
+            line.erase(comment);
+        }
+        std::istringstream tokens(line);
+        std::string text;
+        IPAddress address;
+        if (!(tokens >> text) || !IPAddress::parse(text, address)) {
+            continue;
+        }
+        if (address.family == AF_INET6 && !config_.enable_ipv6) {
+            continue;
+        }
+        std::string name;
+        while (tokens >> name) {
+            std::vector<IPAddress>& addresses = hosts_[normalizeName(name)];
+            if (std::find(addresses.begin(), addresses.end(), address) == addresses.end()) {
+                addresses.push_back(address);
+            }
+        }
+    }
+
+    for (auto& pair : hosts_) {
+        std::stable_partition(pair.second.begin(), pair.second.end(),
+                              [](const IPAddress& address) { return address.family == AF_INET; });
+    }
+}
+
+std::string DNSResolver::normalizeName(const std::string& name) {
+    std::string normalized = toLower(name);
+    if (!normalized.empty() && normalized.back() == '.') {
+        normalized.pop_back();
+    }
+    return normalized;
+}
+
+std::string DNSResolver::cacheKey(const std::string& name, uint16_t type) {
+    return std::to_string(type) + ":" + name;
+}
+
+} // namespace ssmtp_mailer
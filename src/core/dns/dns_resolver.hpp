@@ -0,0 +1,303 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <sys/socket.h>
+#include "utils/socket_util.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Outcome of a DNS lookup
+ */
+enum class DNSStatus {
+    SUCCESS,
+    NOT_FOUND,          // NXDOMAIN
+    NO_DATA,            // Name exists but has no records of the requested type
+    NO_MAIL,            // Null MX (RFC 7505): the domain accepts no mail
+    SERVER_FAILURE,     // SERVFAIL/REFUSED from every nameserver
+    TIMEOUT,
+    ERROR
+};
+
+/**
+ * @brief IPv4 or IPv6 address
+ */
+struct IPAddress {
+    int family;                 // AF_INET or AF_INET6
+    unsigned char bytes[16];
+
+    IPAddress();
+
+    /**
+     * @brief Parse a textual IPv4 or IPv6 address
+     * @param text Address text
+     * @param address Parsed address
+     * @return true if text is an address literal, false otherwise
+     */
+    static bool parse(const std::string& text, IPAddress& address);
+
+    /**
+     * @brief Format the address as text
+     * @return Address text
+     */
+    std::string toString() const;
+
+    /**
+     * @brief Build a socket address for connect()
+     * @param port Port number
+     * @param storage Filled socket address
+     * @return Socket address length
+     */
+    socklen_t toSockaddr(int port, struct sockaddr_storage& storage) const;
+
+    bool operator==(const IPAddress& other) const;
+};
+
+/**
+ * @brief Mail exchanger record
+ */
+struct MXRecord {
+    uint16_t preference;
+    std::string exchange;
+
+    MXRecord() : preference(0) {}
+    MXRecord(uint16_t pref, const std::string& host) : preference(pref), exchange(host) {}
+};
+
+/**
+ * @brief Result of an address (A/AAAA) lookup
+ */
+struct DNSAddressResult {
+    DNSStatus status;
+    std::string error;
+    std::vector<IPAddress> addresses;   // IPv4 first, then IPv6
+
+    DNSAddressResult() : status(DNSStatus::ERROR) {}
+    bool success() const { return status == DNSStatus::SUCCESS; }
+};
+
+/**
+ * @brief Result of an MX lookup
+ */
+struct DNSMXResult {
+    DNSStatus status;
+    std::string error;
+    std::vector<MXRecord> records;      // Most preferred first
+
+    DNSMXResult() : status(DNSStatus::ERROR) {}
+    bool success() const { return status == DNSStatus::SUCCESS; }
+};
+
+/**
+ * @brief DNS resolver configuration
+ */
+struct DNSResolverConfig {
+    std::vector<std::string> nameservers;   // "ip" or "ip:port"; empty = /etc/resolv.conf
+    std::chrono::milliseconds timeout;      // Per attempt
+    int attempts;                           // Rounds over all nameservers
+    std::chrono::seconds negative_ttl;      // Cap (and default) for NXDOMAIN/NODATA caching
+    std::chrono::seconds max_ttl;           // Cap for positive answers
+    size_t max_cache_entries;
+    bool enable_ipv6;                       // Query AAAA as well as A
+    std::string hosts_file;                 // Empty = do not consult a hosts file
+
+    DNSResolverConfig()
+        : timeout(std::chrono::milliseconds(2000)), attempts(2),
+          negative_ttl(std::chrono::seconds(300)), max_ttl(std::chrono::hours(24)),
+          max_cache_entries(10000), enable_ipv6(true), hosts_file("/etc/hosts") {}
+};
+
+/**
+ * @brief DNS resolver statistics
+ */
+struct DNSResolverStats {
+    uint64_t queries_sent;
+    uint64_t retransmits;
+    uint64_t timeouts;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    size_t cache_entries;
+
+    DNSResolverStats()
+        : queries_sent(0), retransmits(0), timeouts(0), cache_hits(0), cache_misses(0),
+          cache_entries(0) {}
+};
+
+/**
+ * @brief Asynchronous stub resolver for A, AAAA and MX records
+ *
+ * Queries go over UDP to the configured recursive nameservers from a
+ * background thread, which is started on the first query that misses the
+ * cache. Answers are cached for their TTL; NXDOMAIN and NODATA are cached
+ * for the SOA minimum (RFC 2308). Concurrent lookups of the same name share
+ * one query. Callbacks run on the resolver thread, or on the caller's
+ * thread when the answer is already known, and must not block.
+ */
+class DNSResolver {
+public:
+    using AddressCallback = std::function<void(const DNSAddressResult&)>;
+    using MXCallback = std::function<void(const DNSMXResult&)>;
+
+    /**
+     * @brief Get the process-wide resolver using the system configuration
+     * @return Resolver instance
+     */
+    static DNSResolver& getInstance();
+
+    /**
+     * @brief Constructor
+     * @param config Resolver configuration
+     */
+    explicit DNSResolver(const DNSResolverConfig& config = DNSResolverConfig());
+
+    /**
+     * @brief Destructor, stops the resolver thread and fails outstanding lookups
+     */
+    ~DNSResolver();
+
+    DNSResolver(const DNSResolver&) = delete;
+    DNSResolver& operator=(const DNSResolver&) = delete;
+
+    /**
+     * @brief Resolve a host name (or address literal) to addresses
+     * @param host Host name
+     * @param callback Invoked once with the result
+     */
+    void resolveAddress(const std::string& host, AddressCallback callback);
+
+    /**
+     * @brief Resolve the mail exchangers of a domain
+     *
+     * A domain without MX records yields its own name as the only exchanger
+     * (RFC 5321 section 5.1). Exchangers of equal preference are shuffled.
+     *
+     * @param domain Mail domain
+     * @param callback Invoked once with the result
+     */
+    void resolveMX(const std::string& domain, MXCallback callback);
+
+    /**
+     * @brief Blocking form of resolveAddress(); must not be called from a callback
+     * @param host Host name
+     * @return Lookup result
+     */
+    DNSAddressResult lookupAddress(const std::string& host);
+
+    /**
+     * @brief Blocking form of resolveMX(); must not be called from a callback
+     * @param domain Mail domain
+     * @return Lookup result
+     */
+    DNSMXResult lookupMX(const std::string& domain);
+
+    /**
+     * @brief Get resolver statistics
+     * @return Statistics snapshot
+     */
+    DNSResolverStats getStats() const;
+
+    /**
+     * @brief Drop all cached answers
+     */
+    void clearCache();
+
+    /**
+     * @brief Get a human-readable name for a status
+     * @param status Lookup status
+     * @return Status name
+     */
+    static std::string statusToString(DNSStatus status);
+
+private:
+    struct Record {
+        uint16_t type;
+        IPAddress address;
+        uint16_t preference;
+        std::string name;
+    };
+
+    struct Answer {
+        DNSStatus status;
+        std::string error;
+        std::vector<Record> records;
+        uint32_t ttl;
+
+        Answer() : status(DNSStatus::ERROR), ttl(0) {}
+    };
+
+    using AnswerCallback = std::function<void(const Answer&)>;
+
+    struct CacheEntry {
+        Answer answer;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    struct Nameserver {
+        struct sockaddr_storage address;
+        socklen_t address_length;
+        int fd;
+    };
+
+    struct Query {
+        std::string key;
+        std::string name;
+        uint16_t type;
+        uint16_t id;
+        size_t server;
+        int tries;
+        bool edns;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    void query(const std::string& name, uint16_t type, AnswerCallback callback);
+    bool ensureThread(std::string& error);
+    void run();
+    void sendQuery(Query& query);
+    void handleDatagram(const unsigned char* data, size_t length);
+    void retryOrFail(uint16_t id, DNSStatus status, const std::string& error);
+    void complete(const std::string& key, const Answer& answer);
+    void wake();
+
+    bool parseResponse(const Query& query, const unsigned char* data, size_t length,
+                       Answer& answer, bool& retry) const;
+
+    void loadSystemConfig();
+    void loadHostsFile();
+
+    static std::string normalizeName(const std::string& name);
+    static std::string cacheKey(const std::string& name, uint16_t type);
+
+    DNSResolverConfig config_;
+    std::vector<Nameserver> nameservers_;
+    std::unordered_map<std::string, std::vector<IPAddress>> hosts_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, CacheEntry> cache_;
+    std::unordered_map<std::string, std::vector<AnswerCallback>> waiters_;
+    std::vector<Query> submitted_;
+    std::unordered_map<uint16_t, Query> outstanding_;   // Owned by the resolver thread
+    std::mt19937 random_;
+
+    std::mutex start_mutex_;
+    std::thread thread_;
+    std::atomic<bool> running_;
+    WakePipe wake_pipe_;
+
+    std::atomic<uint64_t> queries_sent_;
+    std::atomic<uint64_t> retransmits_;
+    std::atomic<uint64_t> timeouts_;
+    std::atomic<uint64_t> cache_hits_;
+    std::atomic<uint64_t> cache_misses_;
+};
+
+} // namespace ssmtp_mailer
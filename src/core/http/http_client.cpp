@@ -89,6 +89,11 @@ static size_t HeaderCallback(char* buffer, size_t size, size_t nitems, std::map<
     return size * nitems;
 }
 
+static size_t ReadCallback(char* buffer, size_t size, size_t nitems, HTTPRequest::BodyReader* reader) {
+    size_t written = (*reader)(buffer, size * nitems);
+    return written == HTTPRequest::BODY_READ_ABORT ? CURL_READFUNC_ABORT : written;
+}
+
 static int ProgressCallback(void* clientp, double dltotal, double dlnow, double ultotal, double ulnow) {
     (void)dltotal; // Suppress unused parameter warning
     (void)dlnow;   // Suppress unused parameter warning
@@ -161,12 +166,31 @@ HTTPResponse CURLHTTPClient::sendRequest(const HTTPRequest& request,
             break;
     }
     
+    // A streamed body is pulled by curl as it sends, in chunked encoding
+    HTTPRequest::BodyReader body_reader = request.body_reader;
+    if (body_reader && request.method != HTTPMethod::GET && request.method != HTTPMethod::DELETE) {
+        if (request.method == HTTPMethod::POST) {
+            curl_easy_setopt(pimpl_->curl_handle, CURLOPT_POST, 1L);
+        } else {
+            curl_easy_setopt(pimpl_->curl_handle, CURLOPT_UPLOAD, 1L);
+        }
+        curl_easy_setopt(pimpl_->curl_handle, CURLOPT_POSTFIELDS, static_cast<char*>(nullptr));
+        curl_easy_setopt(pimpl_->curl_handle, CURLOPT_READFUNCTION, ReadCallback);
+        curl_easy_setopt(pimpl_->curl_handle, CURLOPT_READDATA, &body_reader);
+    } else {
+        body_reader = nullptr;
+    }
+    
     // Set headers
     struct curl_slist* headers = nullptr;
     for (const auto& header : request.headers) {
         std::string header_line = header.first + ": " + header.second;
         headers = curl_slist_append(headers, header_line.c_str());
     }
+    if (body_reader) {
+        headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+        headers = curl_slist_append(headers, "Expect:");
+    }
     if (headers) {
         curl_easy_setopt(pimpl_->curl_handle, CURLOPT_HTTPHEADER, headers);
     }
@@ -0,0 +1,254 @@
+#include "core/mime/attachment_cache.hpp"
+#include "utils/base64.hpp"
+#include "utils/mapped_file.hpp"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// Base64 line length used for attachments (RFC 2045)
+const size_t BASE64_LINE_LENGTH = 76;
+
+// Input bytes encoded per call, so the encoder works on cache-sized blocks
+const size_t ENCODE_BLOCK_BYTES = 57 * 1024;
+
+// Approximate bookkeeping cost of an entry (list node, index node, key copies)
+const size_t ENTRY_OVERHEAD = 256;
+
+const size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+const size_t DEFAULT_MAX_ENTRY_BYTES = 8 * 1024 * 1024;
+
+size_t encodedMimeLength(size_t size) {
+    size_t chars = base64EncodedLength(size);
+    size_t lines = (chars + BASE64_LINE_LENGTH - 1) / BASE64_LINE_LENGTH;
+    return chars + 2 * lines;
+}
+
+} // anonymous namespace
+
+AttachmentCache& AttachmentCache::getInstance() {
+    static AttachmentCache instance;
+    return instance;
+}
+
+AttachmentCache::AttachmentCache()
+    : max_bytes_(DEFAULT_MAX_BYTES), max_entry_bytes_(DEFAULT_MAX_ENTRY_BYTES), bytes_(0),
+      hits_(0), misses_(0), evictions_(0) {
+}
+
+bool AttachmentCache::makeKey(const std::string& path, std::string& key, size_t& size,
+                              std::string& error) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(path.c_str(), &info) != 0) {
+        error = "Cannot open " + path;
+        return false;
+    }
+    long long mtime = static_cast<long long>(info.st_mtime);
+#else
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        error = "Cannot open " + path;
+        return false;
+    }
+#ifdef __APPLE__
+    long long mtime = static_cast<long long>(info.st_mtimespec.tv_sec) * 1000000000LL +
+                      info.st_mtimespec.tv_nsec;
+#else
+    long long mtime = static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL +
+                      info.st_mtim.tv_nsec;
+#endif
+#endif
+
+    size = static_cast<size_t>(info.st_size);
+    key = std::to_string(static_cast<unsigned long long>(info.st_dev)) + ":" +
+          std::to_string(static_cast<unsigned long long>(info.st_ino)) + ":" +
+          std::to_string(size) + ":" + std::to_string(mtime);
+    // Inode numbers are not meaningful on every platform; the path disambiguates
+    key += ":" + path;
+    return true;
+}
+
+bool AttachmentCache::getEncoded(const std::string& path, std::shared_ptr<const std::string>& encoded,
+                                 std::string& error) {
+    encoded.reset();
+
+    std::string key;
+    size_t size = 0;
+    if (!makeKey(path, key, size, error)) {
+        return false;
+    }
+
+    size_t limit = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Entry* entry = findLocked(key);
+        if (entry && entry->encoded) {
+            hits_++;
+            encoded = entry->encoded;
+            return true;
+        }
+        misses_++;
+        limit = std::min(max_entry_bytes_, max_bytes_);
+    }
+
+    if (encodedMimeLength(size) > limit) {
+        // Too large to keep; the caller streams it from disk
+        return true;
+    }
+
+    // Encode outside the lock; concurrent misses on one file just race to insert
+    MappedFile file;
+    if (!file.open(path, error)) {
+        return false;
+    }
+    file.adviseSequential();
+
+    std::shared_ptr<std::string> text = std::make_shared<std::string>();
+    text->reserve(encodedMimeLength(file.size()));
+    if (file.size() > 0) {
+        Base64Encoder encoder(Base64Variant::STANDARD, BASE64_LINE_LENGTH);
+        for (size_t offset = 0; offset < file.size(); offset += ENCODE_BLOCK_BYTES) {
+            encoder.encode(file.data() + offset, std::min(ENCODE_BLOCK_BYTES, file.size() - offset), *text);
+        }
+        encoder.finish(*text);
+    }
+
+    // A file rewritten while it was being read must not be cached under its old identity
+    std::string check;
+    size_t check_size = 0;
+    std::string check_error;
+    if (!makeKey(path, check, check_size, check_error) || check != key || file.size() != size) {
+        encoded = text;
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry& entry = insertLocked(key);
+    if (!entry.encoded) {
+        entry.encoded = text;
+    }
+    encoded = entry.encoded;
+    resizeLocked(entry);
+    return true;
+}
+
+bool AttachmentCache::getBlobId(const std::string& path, const std::string& provider,
+                                std::string& blob_id) {
+    std::string key;
+    size_t size = 0;
+    std::string error;
+    if (!makeKey(path, key, size, error)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry* entry = findLocked(key);
+    if (entry) {
+        auto it = entry->blob_ids.find(provider);
+        if (it != entry->blob_ids.end()) {
+            hits_++;
+            blob_id = it->second;
+            return true;
+        }
+    }
+    misses_++;
+    return false;
+}
+
+void AttachmentCache::setBlobId(const std::string& path, const std::string& provider,
+                                const std::string& blob_id) {
+    std::string key;
+    size_t size = 0;
+    std::string error;
+    if (!makeKey(path, key, size, error)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (max_bytes_ == 0) {
+        return;
+    }
+    Entry& entry = insertLocked(key);
+    entry.blob_ids[provider] = blob_id;
+    resizeLocked(entry);
+}
+
+void AttachmentCache::setMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_bytes_ = max_bytes;
+    evictLocked();
+}
+
+void AttachmentCache::setMaxEntryBytes(size_t max_entry_bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_entry_bytes_ = max_entry_bytes;
+}
+
+void AttachmentCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+AttachmentCacheStats AttachmentCache::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AttachmentCacheStats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+AttachmentCache::Entry* AttachmentCache::findLocked(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return nullptr;
+    }
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return &*it->second;
+}
+
+AttachmentCache::Entry& AttachmentCache::insertLocked(const std::string& key) {
+    Entry* existing = findLocked(key);
+    if (existing) {
+        return *existing;
+    }
+
+    entries_.emplace_front();
+    entries_.front().key = key;
+    index_[key] = entries_.begin();
+    return entries_.front();
+}
+
+void AttachmentCache::resizeLocked(Entry& entry) {
+    size_t bytes = ENTRY_OVERHEAD + 2 * entry.key.size();
+    if (entry.encoded) {
+        bytes += entry.encoded->size();
+    }
+    for (const auto& blob : entry.blob_ids) {
+        bytes += blob.first.size() + blob.second.size();
+    }
+    bytes_ = bytes_ - entry.bytes + bytes;
+    entry.bytes = bytes;
+    evictLocked();
+}
+
+void AttachmentCache::evictLocked() {
+    // Entries in use are at the front; evict from the cold end. Holders of
+    // an evicted entry's data keep it alive through their shared_ptr.
+    while (bytes_ > max_bytes_ && !entries_.empty()) {
+        bytes_ -= entries_.back().bytes;
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+        evictions_++;
+    }
+}
+
+} // namespace ssmtp_mailer
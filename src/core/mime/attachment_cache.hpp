@@ -0,0 +1,157 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstddef>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Attachment cache statistics
+ */
+struct AttachmentCacheStats {
+    size_t hits;
+    size_t misses;
+    size_t evictions;
+    size_t entries;
+    size_t bytes;
+
+    AttachmentCacheStats() : hits(0), misses(0), evictions(0), entries(0), bytes(0) {}
+};
+
+/**
+ * @brief Process-wide cache of encoded attachments and provider blob IDs
+ *
+ * Entries are keyed by file identity (device, inode, size and
+ * modification time), so a file that is replaced or rewritten gets a new
+ * entry and the stale one ages out. Each entry holds the base64 MIME
+ * form of the file (76-character lines, CRLF), exactly as
+ * MimeMessageStream would produce it, and the blob IDs providers returned
+ * when the file was uploaded to them. Entries are evicted least recently
+ * used first to keep the total under a byte budget; files larger than the
+ * per-entry limit are never cached and are streamed from disk instead.
+ */
+class AttachmentCache {
+public:
+    /**
+     * @brief Get the process-wide instance
+     * @return Cache instance
+     */
+    static AttachmentCache& getInstance();
+
+    AttachmentCache(const AttachmentCache&) = delete;
+    AttachmentCache& operator=(const AttachmentCache&) = delete;
+
+    /**
+     * @brief Get the base64 MIME form of a file, encoding it on a miss
+     * @param path File path
+     * @param encoded Encoded file, or nullptr if it is too large to cache
+     * @param error Error message on failure
+     * @return false if the file could not be read
+     */
+    bool getEncoded(const std::string& path, std::shared_ptr<const std::string>& encoded,
+                    std::string& error);
+
+    /**
+     * @brief Look up the blob ID a provider assigned to a file
+     * @param path File path
+     * @param provider Provider and account the blob belongs to
+     * @param blob_id Blob ID if found
+     * @return true if the current version of the file was uploaded before
+     */
+    bool getBlobId(const std::string& path, const std::string& provider, std::string& blob_id);
+
+    /**
+     * @brief Remember the blob ID a provider assigned to a file
+     * @param path File path
+     * @param provider Provider and account the blob belongs to
+     * @param blob_id Blob ID returned by the upload
+     */
+    void setBlobId(const std::string& path, const std::string& provider, const std::string& blob_id);
+
+    /**
+     * @brief Set the total size of cached data
+     * @param max_bytes Byte budget; 0 disables caching
+     */
+    void setMaxBytes(size_t max_bytes);
+
+    /**
+     * @brief Set the largest encoded size a single entry may have
+     * @param max_entry_bytes Per-entry limit
+     */
+    void setMaxEntryBytes(size_t max_entry_bytes);
+
+    /**
+     * @brief Drop every entry
+     */
+    void clear();
+
+    /**
+     * @brief Get cache statistics
+     * @return Snapshot of cache counters
+     */
+    AttachmentCacheStats getStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<const std::string> encoded;
+        std::map<std::string, std::string> blob_ids;
+        size_t bytes;
+
+        Entry() : bytes(0) {}
+    };
+
+    using EntryList = std::list<Entry>;
+
+    AttachmentCache();
+
+    /**
+     * @brief Build the identity key of a file
+     * @param path File path
+     * @param key Key output
+     * @param size File size output
+     * @param error Error message on failure
+     * @return true if the file exists, false otherwise
+     */
+    static bool makeKey(const std::string& path, std::string& key, size_t& size, std::string& error);
+
+    /**
+     * @brief Find an entry and mark it most recently used (caller holds mutex_)
+     */
+    Entry* findLocked(const std::string& key);
+
+    /**
+     * @brief Find or create an entry, most recently used (caller holds mutex_)
+     */
+    Entry& insertLocked(const std::string& key);
+
+    /**
+     * @brief Recompute an entry's size and evict until within budget (caller holds mutex_)
+     *
+     * The entry itself may be evicted; do not use it afterwards.
+     */
+    void resizeLocked(Entry& entry);
+
+    /**
+     * @brief Evict least recently used entries until within budget (caller holds mutex_)
+     */
+    void evictLocked();
+
+    mutable std::mutex mutex_;
+    EntryList entries_;                 // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    size_t max_bytes_;
+    size_t max_entry_bytes_;
+    size_t bytes_;
+
+    size_t hits_;
+    size_t misses_;
+    size_t evictions_;
+};
+
+} // namespace ssmtp_mailer
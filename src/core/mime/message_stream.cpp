@@ -0,0 +1,460 @@
+#include "core/mime/message_stream.hpp"
+#include "core/mime/mime_encoding.hpp"
+#include "core/mime/attachment_cache.hpp"
+#include "utils/email.hpp"
+#include "utils/byte_scan.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// Base64 line length (RFC 2045) and input bytes encoded per block
+const size_t BASE64_LINE_LENGTH = 76;
+const size_t BASE64_BLOCK_BYTES = 57 * 1024;
+
+// Input bytes quoted-printable encodes per block
+const size_t QP_BLOCK_BYTES = 64 * 1024;
+
+std::string joinAddresses(const std::vector<std::string>& addresses, size_t column) {
+    std::string joined;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (i > 0) joined += ", ";
+        size_t line_start = joined.rfind("\r\n");
+        size_t used = line_start == std::string::npos ? column + joined.size() : joined.size() - line_start - 2;
+        joined += encodeAddress(addresses[i], used);
+    }
+    return joined;
+}
+
+std::string makeBoundary() {
+    // "=_" cannot occur in base64 or quoted-printable content
+    return "=_" + generateUniqueId();
+}
+
+std::string fileName(const std::string& path) {
+    size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    std::string quoted;
+    for (char c : name) {
+        if (c == '"' || c == '\\') {
+            quoted.push_back('\\');
+        }
+        if (c != '\r' && c != '\n') {
+            quoted.push_back(c);
+        }
+    }
+    return quoted;
+}
+
+std::string guessContentType(const std::string& path) {
+    static const struct {
+        const char* extension;
+        const char* type;
+    } types[] = {
+        {"txt", "text/plain"},
+        {"htm", "text/html"},
+        {"html", "text/html"},
+        {"csv", "text/csv"},
+        {"pdf", "application/pdf"},
+        {"zip", "application/zip"},
+        {"gz", "application/gzip"},
+        {"json", "application/json"},
+        {"xml", "application/xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+    };
+
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || path.find('/', dot) != std::string::npos) {
+        return "application/octet-stream";
+    }
+
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (const auto& entry : types) {
+        if (extension == entry.extension) {
+            return entry.type;
+        }
+    }
+    return "application/octet-stream";
+}
+
+} // anonymous namespace
+
+MimeMessageStream::MimeMessageStream(const Email& email, const std::string& message_id)
+    : MimeMessageStream(email, &message_id) {
+}
+
+MimeMessageStream::MimeMessageStream(const Email& email, const std::string* message_id)
+    : current_segment_(0), offset_(0), encoded_offset_(0),
+      base64_(Base64Variant::STANDARD, BASE64_LINE_LENGTH) {
+
+    std::string headers;
+    headers += "From: " + encodeAddress(email.from, 6) + "\r\n";
+    if (message_id) {
+        headers += "To: " + joinAddresses(email.to, 4) + "\r\n";
+    }
+    if (!email.cc.empty()) {
+        headers += "Cc: " + joinAddresses(email.cc, 4) + "\r\n";
+    }
+    headers += "Subject: " + encodeHeaderText(email.subject, 9) + "\r\n";
+    if (message_id) {
+        headers += "Date: " + getCurrentTimestamp() + "\r\n";
+        headers += "Message-ID: " + *message_id + "\r\n";
+    }
+    headers += "MIME-Version: 1.0\r\n";
+
+    // Open every file first, so an unreadable one fails before anything is transmitted
+    auto openFiles = [this](const std::vector<std::string>& paths, std::vector<FileSource>& files) {
+        AttachmentCache& cache = AttachmentCache::getInstance();
+        for (const auto& path : paths) {
+            FileSource source;
+            std::string error;
+            if (!cache.getEncoded(path, source.encoded, error)) {
+                last_error_ = error;
+                return false;
+            }
+            if (!source.encoded) {
+                source.file.reset(new MappedFile());
+                if (!source.file->open(path, error)) {
+                    last_error_ = error;
+                    return false;
+                }
+            }
+            files.push_back(std::move(source));
+        }
+        return true;
+    };
+
+    std::vector<FileSource> files;
+    std::vector<FileSource> inline_files;
+    if (!openFiles(email.attachments, files) || !openFiles(email.inline_attachments, inline_files)) {
+        return;
+    }
+
+    addText(headers);
+
+    // Inline attachments are only related to the body when HTML can reference them
+    bool related = !email.html_body.empty() && !inline_files.empty();
+    if (files.empty() && (related || inline_files.empty())) {
+        if (related) {
+            addRelated(email, inline_files);
+        } else {
+            addAlternative(email);
+        }
+        return;
+    }
+
+    std::string boundary = makeBoundary();
+    addText("Content-Type: multipart/mixed; boundary=\"" + boundary + "\"\r\n\r\n"
+            "--" + boundary + "\r\n");
+    if (related) {
+        addRelated(email, inline_files);
+    } else {
+        addAlternative(email);
+        for (size_t i = 0; i < inline_files.size(); ++i) {
+            addText("--" + boundary + "\r\n");
+            addFilePart(std::move(inline_files[i]), email.inline_attachments[i], "inline");
+        }
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        addText("--" + boundary + "\r\n");
+        addFilePart(std::move(files[i]), email.attachments[i], "attachment");
+    }
+    addText("--" + boundary + "--\r\n");
+}
+
+bool MimeMessageStream::render(const Email& email, const std::string& message_id,
+                               std::string& output, std::string& error) {
+    MimeMessageStream stream(email, message_id);
+    return drain(stream, output, error);
+}
+
+bool MimeMessageStream::drain(MimeMessageStream& stream, std::string& output, std::string& error) {
+    std::string message;
+
+    ConstBuffer piece;
+    bool transient = false;
+    while (stream.next(piece, transient)) {
+        message.append(piece.data, piece.size);
+    }
+    if (!stream.good()) {
+        error = stream.getLastError();
+        return false;
+    }
+
+    // 7-bit bodies are passed through as given; bring them to CRLF here
+    output.clear();
+    output.reserve(message.size());
+    for (size_t pos = 0; pos < message.size(); ) {
+        size_t run = findLineBreak(message.data() + pos, message.size() - pos);
+        output.append(message, pos, run);
+        pos += run;
+        if (pos == message.size()) {
+            break;
+        }
+        output.append("\r\n", 2);
+        pos += (message[pos] == '\r' && pos + 1 < message.size() && message[pos + 1] == '\n') ? 2 : 1;
+    }
+    return true;
+}
+
+// Every part ends with CRLF, which doubles as the CRLF that must precede the
+// next boundary delimiter (RFC 2046 section 5.1.1)
+
+void MimeMessageStream::addAlternative(const Email& email) {
+    if (email.html_body.empty()) {
+        addTextPart(email.body, "plain");
+        return;
+    }
+
+    std::string boundary = makeBoundary();
+    addText("Content-Type: multipart/alternative; boundary=\"" + boundary + "\"\r\n\r\n"
+            "--" + boundary + "\r\n");
+    addTextPart(email.body, "plain");
+    addText("--" + boundary + "\r\n");
+    addTextPart(email.html_body, "html");
+    addText("--" + boundary + "--\r\n");
+}
+
+void MimeMessageStream::addRelated(const Email& email, std::vector<FileSource>& inline_files) {
+    std::string boundary = makeBoundary();
+    addText("Content-Type: multipart/related; boundary=\"" + boundary + "\"; "
+            "type=\"multipart/alternative\"\r\n\r\n"
+            "--" + boundary + "\r\n");
+    addAlternative(email);
+    for (size_t i = 0; i < inline_files.size(); ++i) {
+        addText("--" + boundary + "\r\n");
+        addFilePart(std::move(inline_files[i]), email.inline_attachments[i], "inline");
+    }
+    addText("--" + boundary + "--\r\n");
+}
+
+void MimeMessageStream::addTextPart(const std::string& text, const std::string& subtype) {
+    std::string headers = "Content-Type: text/" + subtype + "; charset=UTF-8\r\n";
+
+    TransferEncoding encoding = chooseTransferEncoding(text.data(), text.size());
+    headers += "Content-Transfer-Encoding: " + std::string(transferEncodingName(encoding)) + "\r\n\r\n";
+
+    if (encoding == TransferEncoding::SEVEN_BIT) {
+        addText(headers);
+        addTextRef(text);
+        addText("\r\n");
+        return;
+    }
+
+    addText(headers);
+    Segment segment;
+    segment.type = encoding == TransferEncoding::QUOTED_PRINTABLE
+        ? SegmentType::QUOTED_PRINTABLE : SegmentType::BASE64;
+    segment.data = text.data();
+    segment.size = text.size();
+    segment.canonical_text = true;
+    segments_.push_back(std::move(segment));
+}
+
+void MimeMessageStream::addFilePart(FileSource source, const std::string& path,
+                                    const std::string& disposition) {
+    std::string name = fileName(path);
+    std::string headers = "Content-Type: " + guessContentType(path) + "; name=\"" + name + "\"\r\n"
+                          "Content-Disposition: " + disposition + "; filename=\"" + name + "\"\r\n";
+    if (disposition == "inline") {
+        // Referenced from the HTML body as cid:<file name>
+        headers += "Content-ID: <" + name + ">\r\n";
+    }
+    addText(headers + "Content-Transfer-Encoding: base64\r\n\r\n");
+
+    // An empty file encodes to no lines at all, so the part still needs the
+    // CRLF every part ends with
+    if (source.encoded ? source.encoded->empty() : source.file->size() == 0) {
+        addText("\r\n");
+        return;
+    }
+
+    Segment segment;
+    if (source.encoded) {
+        segment.type = SegmentType::SHARED_TEXT;
+        segment.shared = std::move(source.encoded);
+        segments_.push_back(std::move(segment));
+        return;
+    }
+
+    source.file->adviseSequential();
+    segment.type = SegmentType::BASE64;
+    segment.data = source.file->data();
+    segment.size = source.file->size();
+    segment.file = std::move(source.file);
+    segments_.push_back(std::move(segment));
+}
+
+void MimeMessageStream::addText(const std::string& text) {
+    // Merge adjacent owned text so reads cross fewer segment boundaries
+    if (!segments_.empty() && segments_.back().type == SegmentType::TEXT) {
+        segments_.back().text += text;
+        return;
+    }
+    Segment segment;
+    segment.type = SegmentType::TEXT;
+    segment.text = text;
+    segments_.push_back(std::move(segment));
+}
+
+void MimeMessageStream::addTextRef(const std::string& text) {
+    Segment segment;
+    segment.type = SegmentType::TEXT_REF;
+    segment.ref = &text;
+    segments_.push_back(std::move(segment));
+}
+
+const std::string& MimeMessageStream::segmentText(const Segment& segment) {
+    switch (segment.type) {
+        case SegmentType::TEXT_REF:
+            return *segment.ref;
+        case SegmentType::SHARED_TEXT:
+            return *segment.shared;
+        default:
+            return segment.text;
+    }
+}
+
+size_t MimeMessageStream::read(char* buffer, size_t size) {
+    size_t written = 0;
+
+    while (written < size && current_segment_ < segments_.size() && last_error_.empty()) {
+        Segment& segment = segments_[current_segment_];
+
+        if (segment.type == SegmentType::BASE64 || segment.type == SegmentType::QUOTED_PRINTABLE) {
+            if (encoded_offset_ == encoded_.size() && !encodeNextBlock(segment)) {
+                current_segment_++;
+                offset_ = 0;
+                continue;
+            }
+            size_t count = std::min(size - written, encoded_.size() - encoded_offset_);
+            std::memcpy(buffer + written, encoded_.data() + encoded_offset_, count);
+            encoded_offset_ += count;
+            written += count;
+            continue;
+        }
+
+        const std::string& text = segmentText(segment);
+        size_t count = std::min(size - written, text.size() - offset_);
+        std::memcpy(buffer + written, text.data() + offset_, count);
+        offset_ += count;
+        written += count;
+
+        if (offset_ == text.size()) {
+            current_segment_++;
+            offset_ = 0;
+        }
+    }
+
+    return written;
+}
+
+bool MimeMessageStream::next(ConstBuffer& piece, bool& transient) {
+    while (current_segment_ < segments_.size() && last_error_.empty()) {
+        Segment& segment = segments_[current_segment_];
+
+        if (segment.type == SegmentType::BASE64 || segment.type == SegmentType::QUOTED_PRINTABLE) {
+            if (encoded_offset_ == encoded_.size() && !encodeNextBlock(segment)) {
+                current_segment_++;
+                offset_ = 0;
+                continue;
+            }
+            // The block is replaced when the next one is encoded
+            piece = ConstBuffer(encoded_.data() + encoded_offset_, encoded_.size() - encoded_offset_);
+            encoded_offset_ = encoded_.size();
+            transient = true;
+            return true;
+        }
+
+        const std::string& text = segmentText(segment);
+        size_t offset = offset_;
+        current_segment_++;
+        offset_ = 0;
+
+        if (offset < text.size()) {
+            piece = ConstBuffer(text.data() + offset, text.size() - offset);
+            transient = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool MimeMessageStream::encodeNextBlock(Segment& segment) {
+    encoded_.clear();
+    encoded_offset_ = 0;
+
+    if (offset_ == segment.size) {
+        return false;
+    }
+
+    if (segment.type == SegmentType::QUOTED_PRINTABLE) {
+        // The encoder converts line breaks itself
+        size_t length = std::min(QP_BLOCK_BYTES, segment.size - offset_);
+        qp_.encode(segment.data + offset_, length, encoded_);
+        offset_ += length;
+        if (offset_ == segment.size) {
+            qp_.finish(encoded_);
+        }
+        return true;
+    }
+
+    if (segment.canonical_text) {
+        // text/* must be in canonical CRLF form before it is encoded (RFC 2045)
+        canonical_.clear();
+        while (offset_ < segment.size && canonical_.size() < BASE64_BLOCK_BYTES) {
+            size_t room = BASE64_BLOCK_BYTES - canonical_.size();
+            size_t run = findLineBreak(segment.data + offset_, std::min(room, segment.size - offset_));
+            canonical_.append(segment.data + offset_, run);
+            offset_ += run;
+            if (run == room || offset_ == segment.size) {
+                continue;
+            }
+            char c = segment.data[offset_++];
+            canonical_.append("\r\n", 2);
+            if (c == '\r' && offset_ < segment.size && segment.data[offset_] == '\n') {
+                offset_++;
+            }
+        }
+        base64_.encode(canonical_.data(), canonical_.size(), encoded_);
+    } else {
+        size_t length = std::min(BASE64_BLOCK_BYTES, segment.size - offset_);
+        base64_.encode(segment.data + offset_, length, encoded_);
+        offset_ += length;
+    }
+
+    // The encoder carries partial groups across blocks; flush at the end
+    if (offset_ == segment.size) {
+        base64_.finish(encoded_);
+    }
+    return true;
+}
+
+void MimeMessageStream::rewind() {
+    current_segment_ = 0;
+    offset_ = 0;
+    encoded_.clear();
+    encoded_offset_ = 0;
+    base64_.reset();
+    qp_.reset();
+}
+
+bool MimeMessageStream::good() const {
+    return last_error_.empty();
+}
+
+std::string MimeMessageStream::getLastError() const {
+    return last_error_;
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include "simple-smtp-mailer/mailer.hpp"
+#include "utils/const_buffer.hpp"
+#include "core/mime/mime_encoding.hpp"
+#include "utils/base64.hpp"
+#include "utils/mapped_file.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Pull interface over an RFC 5322 message
+ *
+ * Transports read the message in bounded pieces instead of asking for the
+ * whole message as one string, so memory per in-flight message stays
+ * proportional to the transfer buffer rather than to the message size.
+ */
+class MessageStream {
+public:
+    virtual ~MessageStream() = default;
+
+    /**
+     * @brief Read the next part of the message
+     * @param buffer Destination buffer
+     * @param size Buffer capacity
+     * @return Bytes written; fewer than size only at the end of the message
+     */
+    virtual size_t read(char* buffer, size_t size) = 0;
+
+    /**
+     * @brief Get the next part of the message without copying it
+     *
+     * Shares the position with read(). A transient piece stays valid only
+     * until the stream is used again; any other piece stays valid for the
+     * lifetime of the stream, so consecutive pieces may be written together.
+     *
+     * @param piece Next non-empty part of the message
+     * @param transient Set if the piece is invalidated by the next call
+     * @return true if a piece was produced, false at the end of the message or on error
+     */
+    virtual bool next(ConstBuffer& piece, bool& transient) = 0;
+
+    /**
+     * @brief Check whether the stream failed (e.g. an attachment became unreadable)
+     * @return true if no error occurred, false otherwise
+     */
+    virtual bool good() const = 0;
+
+    /**
+     * @brief Get last error message
+     * @return Last error message
+     */
+    virtual std::string getLastError() const = 0;
+};
+
+/**
+ * @brief MIME message produced on demand from an Email
+ *
+ * Headers and MIME boundaries are generated up front (they are small). The
+ * text and HTML bodies are read in place from the Email. Attachments small
+ * enough for the AttachmentCache are taken from it already encoded, so a
+ * file sent again costs a lookup; larger ones are memory-mapped. Anything
+ * else that needs base64 is encoded block by block as the stream is
+ * consumed. The structure follows the content:
+ *
+ *   multipart/mixed            when there are attachments
+ *     multipart/related        when the HTML body has inline attachments
+ *       multipart/alternative  when there is an HTML body
+ *         text/plain, text/html
+ *       inline attachments
+ *     attachments
+ *
+ * Each text part gets the encoding chooseTransferEncoding() picks: 7bit
+ * text is sent as it is, mostly-ASCII text as quoted-printable and the
+ * rest as base64. Subject and display names are RFC 2047 encoded when
+ * they are not ASCII. The Email must outlive the stream. Line endings in
+ * 7bit bodies are passed through unchanged; transports canonicalise them
+ * to CRLF.
+ */
+class MimeMessageStream : public MessageStream {
+public:
+    /**
+     * @brief Constructor
+     * @param email Email to render
+     * @param message_id Value for the Message-ID header
+     */
+    MimeMessageStream(const Email& email, const std::string& message_id);
+
+    size_t read(char* buffer, size_t size) override;
+    bool next(ConstBuffer& piece, bool& transient) override;
+    bool good() const override;
+    std::string getLastError() const override;
+
+    /**
+     * @brief Return to the start of the message
+     *
+     * The second pass produces the same bytes, boundaries included, so a
+     * message can be read once to compute a digest and again to send it.
+     */
+    void rewind();
+
+    /**
+     * @brief Render a whole message into a string
+     * @param email Email to render
+     * @param message_id Value for the Message-ID header
+     * @param output Rendered message, with CRLF line endings
+     * @param error Error message on failure
+     * @return true if rendered, false if an attachment could not be read
+     */
+    static bool render(const Email& email, const std::string& message_id,
+                       std::string& output, std::string& error);
+
+private:
+    friend class PreparedMessage;
+
+    /**
+     * @brief Constructor for content shared between recipients
+     * @param email Email to render
+     * @param message_id Value for the Message-ID header; nullptr leaves out
+     *        the To, Date and Message-ID headers
+     */
+    MimeMessageStream(const Email& email, const std::string* message_id);
+
+    /**
+     * @brief Read a stream to the end, bringing 7bit bodies to CRLF
+     * @param stream Stream to read
+     * @param output Rendered message
+     * @param error Error message on failure
+     * @return true if rendered, false if the stream failed
+     */
+    static bool drain(MimeMessageStream& stream, std::string& output, std::string& error);
+
+    enum class SegmentType {
+        TEXT,           // Owned text (headers, boundaries)
+        TEXT_REF,       // Text borrowed from the Email
+        SHARED_TEXT,    // Encoded attachment held by the AttachmentCache
+        BASE64,         // Bytes in memory (a body or mapped file), encoded while reading
+        QUOTED_PRINTABLE    // Body text, encoded while reading
+    };
+
+    struct Segment {
+        SegmentType type;
+        std::string text;
+        const std::string* ref;
+        std::shared_ptr<const std::string> shared;
+        const char* data;
+        size_t size;
+        bool canonical_text;                // Convert line endings to CRLF before encoding
+        std::unique_ptr<MappedFile> file;   // Keeps an attachment's mapping alive
+
+        Segment() : type(SegmentType::TEXT), ref(nullptr), data(nullptr), size(0),
+                    canonical_text(false) {}
+    };
+
+    /**
+     * @brief An attachment's content: encoded by the cache, or mapped for streaming
+     */
+    struct FileSource {
+        std::shared_ptr<const std::string> encoded;
+        std::unique_ptr<MappedFile> file;
+    };
+
+    std::vector<Segment> segments_;
+    size_t current_segment_;
+    size_t offset_;                 // Position in the current segment's input
+
+    // Base64 lines of the current segment not yet consumed
+    std::string encoded_;
+    size_t encoded_offset_;
+    std::string canonical_;         // Staging for text converted to CRLF
+    Base64Encoder base64_;
+    QuotedPrintableEncoder qp_;
+
+    std::string last_error_;
+
+    void addText(const std::string& text);
+    void addTextRef(const std::string& text);
+    void addTextPart(const std::string& text, const std::string& subtype);
+    void addFilePart(FileSource source, const std::string& path, const std::string& disposition);
+    void addAlternative(const Email& email);
+    void addRelated(const Email& email, std::vector<FileSource>& inline_files);
+
+    /**
+     * @brief Get the text of a TEXT, TEXT_REF or SHARED_TEXT segment
+     */
+    static const std::string& segmentText(const Segment& segment);
+
+    /**
+     * @brief Refill encoded_ with the next encoded lines of the current segment
+     * @param segment BASE64 or QUOTED_PRINTABLE segment being read
+     * @return true if data was produced, false at the end of the segment
+     */
+    bool encodeNextBlock(Segment& segment);
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,301 @@
+#include "core/mime/mime_encoding.hpp"
+#include "utils/base64.hpp"
+#include "utils/byte_scan.hpp"
+#include <algorithm>
+#include <cctype>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// RFC 5322 line length limit, excluding CRLF
+const size_t MAX_LINE_LENGTH = 998;
+
+// Characters a quoted-printable line may hold before the '=' of a soft
+// line break, which keeps every line within 76 (RFC 2045)
+const size_t QP_LINE_CONTENT = 75;
+
+const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+// Encoded-words are at most 75 characters including "=?UTF-8?X?" and "?=",
+// and lines holding them at most 76 (RFC 2047 section 2)
+const size_t ENCODED_WORD_OVERHEAD = 12;
+const size_t ENCODED_WORD_PAYLOAD = 75 - ENCODED_WORD_OVERHEAD;
+const size_t MAX_ENCODED_LINE = 76;
+
+/**
+ * Whether a header value can be sent as it is: printable ASCII that
+ * cannot be mistaken for an encoded-word
+ */
+bool isPlainHeaderText(const std::string& text) {
+    for (unsigned char c : text) {
+        if (c < 0x20 || c >= 0x7F) {
+            return false;
+        }
+    }
+    return text.find("=?") == std::string::npos;
+}
+
+/**
+ * Length of the UTF-8 sequence starting at pos; malformed bytes count as
+ * single characters
+ */
+size_t utf8SequenceLength(const std::string& text, size_t pos) {
+    unsigned char lead = static_cast<unsigned char>(text[pos]);
+    size_t length = lead >= 0xF0 && lead < 0xF8 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+    if (pos + length > text.size()) {
+        return 1;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((static_cast<unsigned char>(text[pos + i]) & 0xC0) != 0x80) {
+            return 1;
+        }
+    }
+    return length;
+}
+
+/**
+ * Characters the Q encoding may leave as they are in any header context,
+ * including phrases (RFC 2047 section 5)
+ */
+bool isQLiteral(unsigned char c) {
+    return std::isalnum(c) || c == '!' || c == '*' || c == '+' || c == '-' || c == '/';
+}
+
+/**
+ * Encode text as a sequence of UTF-8 encoded-words separated by folding
+ * whitespace, which decoders drop between adjacent words. column is the
+ * position on the line where the text starts; on return it is the
+ * position after the last word.
+ */
+std::string encodeWords(const std::string& text, size_t& column) {
+    size_t q_length = 0;
+    for (unsigned char c : text) {
+        q_length += isQLiteral(c) || c == ' ' ? 1 : 3;
+    }
+    bool q = q_length <= base64EncodedLength(text.size());
+
+    std::string result;
+    std::string word;
+    auto flush = [&result, &word, &column, q]() {
+        size_t start = result.size();
+        result += q ? "=?UTF-8?Q?" : "=?UTF-8?B?";
+        result += q ? word : base64Encode(word);
+        result += "?=";
+        column += result.size() - start;
+        word.clear();
+    };
+
+    for (size_t pos = 0; pos < text.size(); ) {
+        size_t length = utf8SequenceLength(text, pos);
+        std::string piece;
+        if (q) {
+            for (size_t i = pos; i < pos + length; ++i) {
+                unsigned char c = static_cast<unsigned char>(text[i]);
+                if (isQLiteral(c)) {
+                    piece.push_back(static_cast<char>(c));
+                } else if (c == ' ') {
+                    piece.push_back('_');
+                } else {
+                    piece.push_back('=');
+                    piece.push_back(HEX_DIGITS[c >> 4]);
+                    piece.push_back(HEX_DIGITS[c & 0x0F]);
+                }
+            }
+        } else {
+            piece.assign(text, pos, length);
+        }
+
+        // Payload that fits in a word starting at the word's column
+        size_t room = column + ENCODED_WORD_OVERHEAD < MAX_ENCODED_LINE
+                          ? std::min(ENCODED_WORD_PAYLOAD, MAX_ENCODED_LINE - ENCODED_WORD_OVERHEAD - column) : 0;
+        if (!q) {
+            room = room / 4 * 3;
+        }
+        if (word.size() + piece.size() > room) {
+            // Finish the word and start the next on a continuation line; this
+            // also moves a first word that has no room after the header name
+            if (!word.empty()) {
+                flush();
+            }
+            result += "\r\n ";
+            column = 1;
+        }
+        word += piece;
+        pos += length;
+    }
+    if (!word.empty()) {
+        flush();
+    }
+    return result;
+}
+
+std::string trim(const std::string& text) {
+    size_t start = text.find_first_not_of(" \t");
+    if (start == std::string::npos) {
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t");
+    return text.substr(start, end - start + 1);
+}
+
+} // anonymous namespace
+
+const char* transferEncodingName(TransferEncoding encoding) {
+    switch (encoding) {
+        case TransferEncoding::SEVEN_BIT: return "7bit";
+        case TransferEncoding::QUOTED_PRINTABLE: return "quoted-printable";
+        case TransferEncoding::BASE64: return "base64";
+    }
+    return "base64";
+}
+
+TransferEncoding chooseTransferEncoding(const char* data, size_t length) {
+    ByteClassCounts counts = countByteClasses(data, length);
+
+    if (counts.eight_bit == 0 && counts.nul == 0) {
+        for (size_t pos = 0; pos < length; ) {
+            size_t run = findLineBreak(data + pos, length - pos);
+            if (run > MAX_LINE_LENGTH) {
+                // Soft line breaks fold long lines without escaping anything else
+                return TransferEncoding::QUOTED_PRINTABLE;
+            }
+            pos += run + 1;
+        }
+        return TransferEncoding::SEVEN_BIT;
+    }
+
+    // Quoted-printable spends three characters per escaped byte, base64 a
+    // third extra on every byte
+    size_t escaped = counts.eight_bit + counts.nul;
+    return escaped * 6 < length ? TransferEncoding::QUOTED_PRINTABLE : TransferEncoding::BASE64;
+}
+
+QuotedPrintableEncoder::QuotedPrintableEncoder()
+    : column_(0), pending_(0), skip_lf_(false) {
+}
+
+void QuotedPrintableEncoder::encode(const char* data, size_t length, std::string& output) {
+    const char* end = data + length;
+
+    while (data < end) {
+        if (skip_lf_) {
+            skip_lf_ = false;
+            if (*data == '\n') {
+                ++data;
+                continue;
+            }
+        }
+
+        size_t run = findQuotedPrintableSpecial(data, static_cast<size_t>(end - data));
+        if (run > 0) {
+            flushPending(false, output);
+            // A trailing space stays literal only if no line break follows
+            bool hold = data[run - 1] == ' ';
+            appendLiteral(data, hold ? run - 1 : run, output);
+            if (hold) {
+                pending_ = ' ';
+            }
+            data += run;
+            continue;
+        }
+
+        unsigned char c = static_cast<unsigned char>(*data++);
+        if (c == '\r' || c == '\n') {
+            flushPending(true, output);
+            output.append("\r\n", 2);
+            column_ = 0;
+            skip_lf_ = c == '\r';
+        } else if (c == '\t') {
+            flushPending(false, output);
+            pending_ = '\t';
+        } else {
+            flushPending(false, output);
+            appendEscaped(c, output);
+        }
+    }
+}
+
+void QuotedPrintableEncoder::finish(std::string& output) {
+    flushPending(true, output);
+    // Like a 7bit body, the text is followed by a CRLF of its own, so a
+    // final line break in the text survives the boundary that follows
+    output.append("\r\n", 2);
+    reset();
+}
+
+void QuotedPrintableEncoder::reset() {
+    column_ = 0;
+    pending_ = 0;
+    skip_lf_ = false;
+}
+
+void QuotedPrintableEncoder::appendLiteral(const char* data, size_t length, std::string& output) {
+    while (length > 0) {
+        if (column_ == QP_LINE_CONTENT) {
+            output.append("=\r\n", 3);
+            column_ = 0;
+        }
+        size_t take = std::min(length, QP_LINE_CONTENT - column_);
+        output.append(data, take);
+        column_ += take;
+        data += take;
+        length -= take;
+    }
+}
+
+void QuotedPrintableEncoder::appendEscaped(unsigned char c, std::string& output) {
+    if (column_ + 3 > QP_LINE_CONTENT) {
+        output.append("=\r\n", 3);
+        column_ = 0;
+    }
+    char escaped[3] = {'=', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0x0F]};
+    output.append(escaped, 3);
+    column_ += 3;
+}
+
+void QuotedPrintableEncoder::flushPending(bool escape, std::string& output) {
+    if (pending_ == 0) {
+        return;
+    }
+    char c = pending_;
+    pending_ = 0;
+    if (escape) {
+        appendEscaped(static_cast<unsigned char>(c), output);
+    } else {
+        appendLiteral(&c, 1, output);
+    }
+}
+
+std::string encodeHeaderText(const std::string& text, size_t column) {
+    return isPlainHeaderText(text) ? text : encodeWords(text, column);
+}
+
+std::string encodeAddress(const std::string& address, size_t column) {
+    size_t open = address.rfind('<');
+    if (open == std::string::npos || address.find('>', open) == std::string::npos) {
+        return address;
+    }
+
+    std::string name = trim(address.substr(0, open));
+    if (name.empty() || isPlainHeaderText(name)) {
+        return address;
+    }
+
+    if (name.size() >= 2 && name.front() == '"' && name.back() == '"') {
+        std::string unquoted;
+        for (size_t i = 1; i + 1 < name.size(); ++i) {
+            if (name[i] == '\\' && i + 2 < name.size()) {
+                ++i;
+            }
+            unquoted.push_back(name[i]);
+        }
+        name = unquoted;
+    }
+    std::string encoded = encodeWords(name, column);
+    std::string angle_addr = address.substr(open);
+    // Keep the line with the last encoded-word within the limit too
+    return encoded + (column + 1 + angle_addr.size() > MAX_ENCODED_LINE ? "\r\n " : " ") + angle_addr;
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Content-Transfer-Encoding of a MIME part (RFC 2045)
+ */
+enum class TransferEncoding {
+    SEVEN_BIT,
+    QUOTED_PRINTABLE,
+    BASE64
+};
+
+/**
+ * @brief Header value for a transfer encoding
+ * @param encoding Transfer encoding
+ * @return "7bit", "quoted-printable" or "base64"
+ */
+const char* transferEncodingName(TransferEncoding encoding);
+
+/**
+ * @brief Choose the cheapest safe transfer encoding for a text body
+ *
+ * 7bit when the text is ASCII without NUL and no line exceeds 998
+ * characters. Otherwise quoted-printable while it is smaller than base64,
+ * i.e. when few bytes need escaping, and base64 when most of the text is
+ * 8-bit (non-Latin scripts).
+ *
+ * @param data Text
+ * @param length Text length
+ * @return Transfer encoding to use
+ */
+TransferEncoding chooseTransferEncoding(const char* data, size_t length);
+
+/**
+ * @brief Incremental quoted-printable encoder for text (RFC 2045 section 6.7)
+ *
+ * Line breaks in any convention (CRLF, LF or CR) become CRLF; lines are
+ * kept to 76 characters with soft line breaks; whitespace before a line
+ * break is escaped. Runs of printable ASCII are copied as they are, so
+ * mostly-ASCII text encodes at close to copy speed. Input may arrive in
+ * pieces of any size.
+ */
+class QuotedPrintableEncoder {
+public:
+    QuotedPrintableEncoder();
+
+    /**
+     * @brief Encode the next piece of text
+     * @param data Input bytes
+     * @param length Input length
+     * @param output Encoded text is appended here
+     */
+    void encode(const char* data, size_t length, std::string& output);
+
+    /**
+     * @brief End the text; escapes held-back whitespace and ends the last line with CRLF
+     * @param output Encoded text is appended here
+     */
+    void finish(std::string& output);
+
+    /**
+     * @brief Discard state and start a new text
+     */
+    void reset();
+
+private:
+    void appendLiteral(const char* data, size_t length, std::string& output);
+    void appendEscaped(unsigned char c, std::string& output);
+    void flushPending(bool escape, std::string& output);
+
+    size_t column_;
+    char pending_;          // Space or TAB that must be escaped if a line break follows
+    bool skip_lf_;          // Last piece ended with CR; a leading LF completes it
+};
+
+/**
+ * @brief Encode an unstructured header value such as Subject (RFC 2047)
+ *
+ * Values of printable ASCII are returned unchanged. Others become UTF-8
+ * encoded-words, Q or B encoding whichever is shorter, folded onto
+ * continuation lines so that no line holding one exceeds 76 characters.
+ * Multi-byte characters are never split between words.
+ *
+ * @param text Header value (UTF-8)
+ * @param column Characters before the value on its line, e.g. 9 after "Subject: "
+ * @return Header value safe to send
+ */
+std::string encodeHeaderText(const std::string& text, size_t column);
+
+/**
+ * @brief Encode the display name of an address such as "Zoë <zoe@example.com>"
+ * @param address Address, optionally with a (possibly quoted) display name
+ * @param column Characters before the address on its line
+ * @return Address whose display name is an encoded-word if it is not ASCII
+ */
+std::string encodeAddress(const std::string& address, size_t column);
+
+} // namespace ssmtp_mailer
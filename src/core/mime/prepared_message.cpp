@@ -0,0 +1,115 @@
+#include "core/mime/prepared_message.hpp"
+#include "core/mime/mime_encoding.hpp"
+#include "core/dkim/dkim_signer.hpp"
+#include "utils/email.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace ssmtp_mailer {
+
+std::shared_ptr<const PreparedMessage> PreparedMessage::create(const Email& email, std::string& error) {
+    std::shared_ptr<PreparedMessage> prepared(new PreparedMessage());
+
+    MimeMessageStream stream(email, nullptr);
+    if (!MimeMessageStream::drain(stream, prepared->content_, error)) {
+        return nullptr;
+    }
+    // Bulk senders keep the message for the whole run; drop the rendering slack
+    prepared->content_.shrink_to_fit();
+    prepared->from_ = email.from;
+    prepared->finish();
+    return prepared;
+}
+
+std::shared_ptr<const PreparedMessage> PreparedMessage::restore(const std::string& sender, std::string content) {
+    std::shared_ptr<PreparedMessage> prepared(new PreparedMessage());
+    prepared->content_ = std::move(content);
+    prepared->from_ = sender;
+    prepared->finish();
+    return prepared;
+}
+
+void PreparedMessage::finish() {
+    // Headers are generated with CRLF and always followed by a body
+    size_t blank = content_.find("\r\n\r\n");
+    header_length_ = blank == std::string::npos ? content_.size() : blank + 2;
+
+    domain_ = extractDomain(from_);
+    if (domain_.empty()) {
+        domain_ = "localhost";
+    }
+}
+
+const std::string& PreparedMessage::getBodyHash() const {
+    std::call_once(body_hash_once_, [this]() {
+        DKIMBodyHasher hasher;
+        size_t body_start = std::min(header_length_ + 2, content_.size());
+        hasher.update(content_.data() + body_start, content_.size() - body_start);
+        body_hash_ = hasher.finish();
+    });
+    return body_hash_;
+}
+
+std::string PreparedMessage::generateMessageId() const {
+    return "<" + generateUniqueId() + "@" + domain_ + ">";
+}
+
+std::string PreparedMessage::formatRecipientHeaders(const std::string& to, const std::string& message_id) {
+    return "To: " + encodeAddress(to, 4) + "\r\n"
+           "Date: " + getCurrentTimestamp() + "\r\n"
+           "Message-ID: " + message_id + "\r\n";
+}
+
+PreparedMessageStream::PreparedMessageStream(const PreparedMessage& message, const std::string& to,
+                                             const std::string& message_id)
+    : headers_(PreparedMessage::formatRecipientHeaders(to, message_id)),
+      current_piece_(0), offset_(0) {
+    pieces_[0] = ConstBuffer(headers_);
+    pieces_[1] = ConstBuffer(message.getContent());
+}
+
+size_t PreparedMessageStream::read(char* buffer, size_t size) {
+    size_t written = 0;
+
+    while (written < size && current_piece_ < 2) {
+        const ConstBuffer& piece = pieces_[current_piece_];
+        size_t count = std::min(size - written, piece.size - offset_);
+        std::memcpy(buffer + written, piece.data + offset_, count);
+        offset_ += count;
+        written += count;
+
+        if (offset_ == piece.size) {
+            current_piece_++;
+            offset_ = 0;
+        }
+    }
+
+    return written;
+}
+
+bool PreparedMessageStream::next(ConstBuffer& piece, bool& transient) {
+    while (current_piece_ < 2) {
+        const ConstBuffer& current = pieces_[current_piece_];
+        size_t offset = offset_;
+        current_piece_++;
+        offset_ = 0;
+
+        if (offset < current.size) {
+            piece = ConstBuffer(current.data + offset, current.size - offset);
+            transient = false;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool PreparedMessageStream::good() const {
+    return true;
+}
+
+std::string PreparedMessageStream::getLastError() const {
+    return "";
+}
+
+} // namespace ssmtp_mailer
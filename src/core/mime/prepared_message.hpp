@@ -0,0 +1,137 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include "simple-smtp-mailer/mailer.hpp"
+#include "core/mime/message_stream.hpp"
+#include "utils/const_buffer.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief A message rendered once and sent to many recipients
+ *
+ * Holds the complete MIME content of an Email (From, Cc, Subject, the
+ * MIME headers and every encoded part, with CRLF line endings) except the
+ * headers that differ per recipient: To, Date and Message-ID. Each send
+ * pairs the shared content with a few hundred bytes of its own headers
+ * (see PreparedMessageStream), so a bulk send costs O(1) memory per extra
+ * recipient instead of a rendered copy of the body. Instances are
+ * immutable and may be shared between threads.
+ */
+class PreparedMessage {
+public:
+    /**
+     * @brief Render an email for repeated sending
+     * @param email Email to render; its To list is ignored
+     * @param error Error message on failure
+     * @return Prepared message, or nullptr if an attachment could not be read
+     */
+    static std::shared_ptr<const PreparedMessage> create(const Email& email, std::string& error);
+
+    /**
+     * @brief Rebuild a prepared message from content rendered earlier
+     * @param sender Envelope sender, as returned by getSender()
+     * @param content Shared content, as returned by getContent()
+     * @return Prepared message
+     */
+    static std::shared_ptr<const PreparedMessage> restore(const std::string& sender, std::string content);
+
+    /**
+     * @brief Get the envelope sender
+     * @return Sender address as given in the email
+     */
+    const std::string& getSender() const { return from_; }
+
+    /**
+     * @brief Get the shared part of the message
+     * @return Headers and body without To, Date and Message-ID
+     */
+    const std::string& getContent() const { return content_; }
+
+    /**
+     * @brief Get the shared headers
+     * @return Header lines at the start of the content, without the empty line
+     */
+    std::string getHeaders() const { return content_.substr(0, header_length_); }
+
+    /**
+     * @brief Get the DKIM body hash (relaxed canonicalisation, SHA-256)
+     *
+     * Computed on first use and kept, so signing further copies costs only
+     * the header signature.
+     *
+     * @return Base64 body hash
+     */
+    const std::string& getBodyHash() const;
+
+    /**
+     * @brief Generate a Message-ID in the sender's domain
+     * @return New Message-ID, including angle brackets
+     */
+    std::string generateMessageId() const;
+
+    /**
+     * @brief Format the headers that differ per recipient
+     * @param to Value for the To header
+     * @param message_id Value for the Message-ID header
+     * @return To, Date and Message-ID header lines
+     */
+    static std::string formatRecipientHeaders(const std::string& to, const std::string& message_id);
+
+private:
+    PreparedMessage() : header_length_(0) {}
+
+    /**
+     * @brief Derive the header length and sender domain once content and sender are set
+     */
+    void finish();
+
+    std::string from_;
+    std::string domain_;
+    std::string content_;
+    size_t header_length_;
+
+    mutable std::once_flag body_hash_once_;
+    mutable std::string body_hash_;
+};
+
+/**
+ * @brief Stream of one recipient's copy of a PreparedMessage
+ *
+ * Yields the recipient's own headers followed by the shared content, both
+ * as non-transient pieces, so transports write them as one gathered write
+ * without copying the content. The PreparedMessage must outlive the stream.
+ */
+class PreparedMessageStream : public MessageStream {
+public:
+    /**
+     * @brief Constructor
+     * @param message Prepared message
+     * @param to Value for the To header
+     * @param message_id Value for the Message-ID header
+     */
+    PreparedMessageStream(const PreparedMessage& message, const std::string& to,
+                          const std::string& message_id);
+
+    size_t read(char* buffer, size_t size) override;
+    bool next(ConstBuffer& piece, bool& transient) override;
+    bool good() const override;
+    std::string getLastError() const override;
+
+    /**
+     * @brief Get this recipient's To, Date and Message-ID header lines
+     * @return Header lines sent in front of the shared content
+     */
+    const std::string& getRecipientHeaders() const { return headers_; }
+
+private:
+    std::string headers_;
+    ConstBuffer pieces_[2];
+    size_t current_piece_;
+    size_t offset_;
+};
+
+} // namespace ssmtp_mailer
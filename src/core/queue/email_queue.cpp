@@ -1,16 +1,35 @@
 #include "core/queue/email_queue.hpp"
+#include "core/mime/prepared_message.hpp"
 #include "core/logging/logger.hpp"
+#include "utils/email.hpp"
 #include "ssmtp-mailer/mailer.hpp"
 #include <algorithm>
 #include <chrono>
+#include <cctype>
 #include <cmath>
+#include <unordered_set>
 
 namespace ssmtp_mailer {
 
 EmailQueue::EmailQueue()
-    : email_queue_(comparePriority), running_(false), max_retries_(3),
-      retry_delay_(std::chrono::seconds(300)), batch_size_(10), max_queue_size_(1000),
-      total_processed_(0), total_failed_(0), total_retries_(0) {
+    : EmailQueue(QueueConfig()) {
+    // Defaults of the queue before it took a QueueConfig
+    retry_delay_ = std::chrono::seconds(300);
+    max_queue_size_ = 1000;
+}
+
+EmailQueue::EmailQueue(const QueueConfig& config)
+    : ingress_(config.ingress_capacity), queued_count_(0), idle_workers_(0), closed_(false),
+      running_(false),
+      delayed_(std::chrono::milliseconds(250), 1024), next_delayed_token_(1), timer_waiter_(false),
+      max_retries_(3), retry_delay_(config.retry_delay), batch_size_(10), max_queue_size_(config.max_queue_size),
+      worker_count_(config.max_workers),
+      max_workers_per_destination_(std::max<size_t>(1, config.max_workers_per_destination)),
+      destination_failure_threshold_(config.destination_failure_threshold),
+      destination_backoff_(config.destination_backoff),
+      max_destination_backoff_(config.max_destination_backoff),
+      priority_aging_(config.priority_aging),
+      total_queued_(0), total_processed_(0), total_failed_(0), total_retries_(0) {
     
     Logger& logger = Logger::getInstance();
     logger.debug("EmailQueue initialized");
@@ -20,84 +39,469 @@ EmailQueue::~EmailQueue() {
     stop();
 }
 
-void EmailQueue::enqueue(const Email* email, EmailPriority priority) {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    
-    if (email_queue_.size() >= max_queue_size_) {
-        Logger& logger = Logger::getInstance();
-        logger.warning("Queue is full, rejecting email from: " + email->from);
-        return;
-    }
-    
+EnqueueStatus EmailQueue::enqueue(const Email* email, EmailPriority priority) {
+    return enqueue(email, priority, std::chrono::system_clock::time_point());
+}
+
+EnqueueStatus EmailQueue::enqueue(const Email* email, EmailPriority priority,
+                                  std::chrono::system_clock::time_point send_at) {
     QueueItem queued_email(email->from, email->to, email->subject, email->body);
+    queued_email.id = generateUniqueId();
     queued_email.priority = priority;
+    queued_email.scheduled_for = send_at;
+    queued_email.retry_delay = retry_delay_;
+    queued_email.max_retries = max_retries_;
     queued_email.html_body = email->html_body;
     queued_email.attachments = email->attachments;
-    email_queue_.push(queued_email);
+    queued_email.inline_attachments = email->inline_attachments;
+    return admit(std::move(queued_email));
+}
+
+EnqueueStatus EmailQueue::enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                                  EmailPriority priority) {
+    return enqueue(std::move(message), recipient, priority, std::chrono::system_clock::time_point());
+}
+
+EnqueueStatus EmailQueue::enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                                  EmailPriority priority, std::chrono::system_clock::time_point send_at) {
+    // Every recipient's item shares the rendered content instead of copying the body
+    QueueItem queued_email(message->getSender(), std::vector<std::string>(1, recipient), "", "");
+    queued_email.id = generateUniqueId();
+    queued_email.priority = priority;
+    queued_email.scheduled_for = send_at;
+    queued_email.retry_delay = retry_delay_;
+    queued_email.max_retries = max_retries_;
+    queued_email.prepared = std::move(message);
+    return admit(std::move(queued_email));
+}
+
+EnqueueStatus EmailQueue::admit(QueueItem item) {
+    Logger& logger = Logger::getInstance();
+    
+    if (closed_) {
+        return EnqueueStatus::CLOSED;
+    }
+    // Reserve a place, so concurrent producers cannot overfill the queue
+    if (queued_count_.fetch_add(1) >= max_queue_size_) {
+        queued_count_--;
+        logger.warning("Queue is full, rejecting email from: " + item.from_address + " to: " +
+                       (item.to_addresses.empty() ? "none" : item.to_addresses[0]));
+        return EnqueueStatus::FULL;
+    }
+    
+    if (journal_) {
+        if (!journal_->isOwner()) {
+            // Another process serves the spool and sends the mail
+            queued_count_--;
+            std::string error;
+            if (!journal_->submit(item, error)) {
+                logger.error("Cannot hand email " + item.id + " to the queue process: " + error);
+                return EnqueueStatus::CLOSED;
+            }
+            logger.debug("Email " + item.id + " handed to the queue process");
+            return EnqueueStatus::ACCEPTED;
+        }
+        // Stored before any worker can see it, so its completion is never logged first
+        if (!persist(item)) {
+            queued_count_--;
+            return EnqueueStatus::CLOSED;
+        }
+    }
+    
+    // Formatted before the hand-over, and only when it will be written
+    std::string message;
+    if (logger.getLogLevel() <= LogLevel::DEBUG) {
+        message = "Email " + item.id + " queued to: " +
+                  (item.to_addresses.empty() ? "none" : item.to_addresses[0]) +
+                  " with priority: " + std::to_string(static_cast<int>(item.priority));
+    }
+    
+    // The ring only fills up while no worker drains it; then the producer does
+    while (!ingress_.tryPush(item)) {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        drainIngress();
+    }
+    total_queued_++;
+    
+    // Pairs with the fence in workerLoop: either a worker going idle sees the item, or we see the worker
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_workers_.load(std::memory_order_relaxed) > 0) {
+        // Taking the lock waits out a worker between its last look at the ring and its wait
+        { std::lock_guard<std::mutex> lock(queue_mutex_); }
+        queue_cv_.notify_one();
+    }
     
+    if (!message.empty()) {
+        logger.debug(message + " (queue size: " + std::to_string(queued_count_.load()) + ")");
+    }
+    return EnqueueStatus::ACCEPTED;
+}
+
+void EmailQueue::drainIngress() {
+    QueueItem item;
+    while (ingress_.tryPop(item)) {
+        schedule(std::move(item));
+    }
+}
+
+bool EmailQueue::persist(QueueItem& item) {
     Logger& logger = Logger::getInstance();
-    logger.debug("Email queued from: " + email->from + " with priority: " + 
-                std::to_string(static_cast<int>(priority)) + 
-                " (queue size: " + std::to_string(email_queue_.size()) + ")");
+    std::string error;
+    
+    // Shared prepared content is already stored once per message by the journal
+    if (spool_ && !item.prepared && !item.spooled) {
+        if (!spool_->store(item, error)) {
+            logger.error("Cannot spool email " + item.id + ", rejected: " + error);
+            return false;
+        }
+        MessageSpool::compact(item);
+    }
+    
+    if (!journal_->recordEnqueue(item)) {
+        logger.error("Cannot journal email " + item.id + ", rejected: " + journal_->getLastError());
+        if (item.spooled) {
+            spool_->remove(item.id);
+        }
+        return false;
+    }
+    return true;
+}
+
+void EmailQueue::retire(const QueueItem& item) {
+    // Payload first: an index record without a payload is known to be finished
+    if (spool_ && item.spooled) {
+        spool_->remove(item.id);
+    }
+    if (journal_) {
+        journal_->recordDone(item);
+    }
+}
+
+void EmailQueue::schedule(QueueItem item) {
+    auto now = std::chrono::system_clock::now();
+    auto due = item.status == EmailStatus::RETRY ? item.last_attempt + item.retry_delay : item.scheduled_for;
+    
+    if (due <= now) {
+        makeReady(std::move(item));
+        return;
+    }
+    
+    uint64_t token = next_delayed_token_++;
+    delayed_items_.emplace(token, std::move(item));
+    auto deadline = TimerWheel::Clock::now() + std::chrono::duration_cast<TimerWheel::Clock::duration>(due - now);
+    delayed_.schedule(deadline, token);
+    watchWheel(deadline);
+}
+
+void EmailQueue::watchWheel(TimerWheel::Clock::time_point deadline) {
+    if (!timer_waiter_) {
+        queue_cv_.notify_one();
+    } else if (deadline < timer_wake_at_) {
+        // The waiter sleeps past the new deadline; it cannot be told apart from the other sleepers
+        queue_cv_.notify_all();
+    }
+}
+
+void EmailQueue::makeReady(QueueItem item) {
+    std::string key = destinationKey(item);
+    auto& destination = destinations_[key];
+    if (!destination) {
+        destination.reset(new Destination(key, priority_aging_));
+    }
+    destination->ready.push(std::move(item));
+    activate(*destination);
+}
+
+void EmailQueue::releaseDue() {
+    if (delayed_.empty()) {
+        return;
+    }
     
+    std::vector<uint64_t> expired;
+    delayed_.advance(TimerWheel::Clock::now(), expired);
+    for (uint64_t token : expired) {
+        auto it = delayed_items_.find(token);
+        if (it != delayed_items_.end()) {
+            makeReady(std::move(it->second));
+            delayed_items_.erase(it);
+            continue;
+        }
+        
+        auto paused = paused_.find(token);
+        if (paused != paused_.end()) {
+            Destination& destination = *paused->second;
+            paused_.erase(paused);
+            destination.pause_token = 0;
+            Logger::getInstance().info("Destination " + destination.key + " resumed after backoff");
+            activate(destination);
+            dropIfIdle(destination);
+        }
+    }
+}
+
+std::string EmailQueue::destinationKey(const QueueItem& item) const {
+    if (destination_function_) {
+        return destination_function_(item);
+    }
+    std::string domain = item.to_addresses.empty() ? std::string() : extractDomain(item.to_addresses[0]);
+    std::transform(domain.begin(), domain.end(), domain.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return domain;
+}
+
+void EmailQueue::activate(Destination& destination) {
+    if (destination.active || destination.pause_token != 0 || destination.ready.empty() ||
+        destination.in_flight >= max_workers_per_destination_) {
+        return;
+    }
+    destination.active = true;
+    active_.push_back(&destination);
     queue_cv_.notify_one();
 }
 
+void EmailQueue::dropIfIdle(Destination& destination) {
+    // Failure counts are kept, so backoff survives a lull between retries
+    if (destination.active || destination.in_flight != 0 || destination.pause_token != 0 ||
+        destination.consecutive_failures != 0 || !destination.ready.empty()) {
+        return;
+    }
+    destinations_.erase(destination.key);
+}
+
+void EmailQueue::recordOutcome(Destination& destination, bool success) {
+    if (success) {
+        destination.consecutive_failures = 0;
+        return;
+    }
+    
+    destination.consecutive_failures++;
+    if (destination_failure_threshold_ == 0 || destination.pause_token != 0 ||
+        destination.consecutive_failures < destination_failure_threshold_) {
+        return;
+    }
+    
+    // Double the pause for each failure beyond the threshold
+    size_t doublings = std::min<size_t>(destination.consecutive_failures - destination_failure_threshold_, 30);
+    std::chrono::seconds pause = std::min<std::chrono::seconds>(max_destination_backoff_,
+                                                             destination_backoff_ * (1LL << doublings));
+    
+    uint64_t token = next_delayed_token_++;
+    destination.pause_token = token;
+    destination.paused_until = std::chrono::system_clock::now() + pause;
+    paused_.emplace(token, &destination);
+    auto deadline = TimerWheel::Clock::now() + pause;
+    delayed_.schedule(deadline, token);
+    watchWheel(deadline);
+    
+    Logger::getInstance().warning("Destination " + destination.key + " paused for " +
+                                  std::to_string(pause.count()) + "s after " +
+                                  std::to_string(destination.consecutive_failures) + " failures in a row");
+}
+
+void EmailQueue::releaseDestination(Destination& destination) {
+    destination.in_flight--;
+    activate(destination);
+    dropIfIdle(destination);
+}
+
 bool EmailQueue::dequeue(QueueItem& email) {
     std::lock_guard<std::mutex> lock(queue_mutex_);
+    drainIngress();
     
-    if (email_queue_.empty()) {
+    // The most urgent item of any destination, paused or not
+    Destination* best = nullptr;
+    for (const auto& entry : destinations_) {
+        Destination* destination = entry.second.get();
+        if (!destination->ready.empty() &&
+            (!best || comparePriority(best->ready.front(), destination->ready.front()))) {
+            best = destination;
+        }
+    }
+    if (!best) {
         return false;
     }
     
-    email = email_queue_.top();
-    email_queue_.pop();
+    email = best->ready.pop();
+    queued_count_--;
+    dropIfIdle(*best);
     
     return true;
 }
 
 size_t EmailQueue::size() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    return email_queue_.size();
+    return queued_count_;
 }
 
 bool EmailQueue::empty() const {
-    std::lock_guard<std::mutex> lock(queue_mutex_);
-    return email_queue_.empty();
+    return queued_count_ == 0;
 }
 
 void EmailQueue::start() {
-    if (running_) {
-        return;
+    std::lock_guard<std::mutex> workers_lock(workers_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (running_) {
+            return;
+        }
+        running_ = true;
     }
     
-    running_ = true;
-    worker_thread_ = std::thread(&EmailQueue::workerLoop, this);
+    size_t count = std::max<size_t>(1, worker_count_);
+    worker_states_.clear();
+    for (size_t i = 0; i < count; ++i) {
+        worker_states_.emplace_back(new WorkerState());
+        workers_.emplace_back(&EmailQueue::workerLoop, this, std::ref(*worker_states_.back()));
+    }
+    if (journal_ && journal_->isOwner()) {
+        intake_thread_ = std::thread(&EmailQueue::intakeLoop, this);
+    }
     
     Logger& logger = Logger::getInstance();
-    logger.info("EmailQueue worker thread started");
+    logger.info("EmailQueue started " + std::to_string(count) + " worker thread(s)");
 }
 
 void EmailQueue::stop() {
-    if (!running_) {
-        return;
+    std::lock_guard<std::mutex> workers_lock(workers_mutex_);
+    {
+        // Under the queue lock, so no worker can miss the wakeup between its check and its wait
+        std::lock_guard<std::mutex> lock(queue_mutex_);
+        if (!running_) {
+            return;
+        }
+        running_ = false;
     }
-    
-    running_ = false;
     queue_cv_.notify_all();
+    intake_cv_.notify_all();
     
-    if (worker_thread_.joinable()) {
-        worker_thread_.join();
+    for (auto& worker : workers_) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    workers_.clear();
+    if (intake_thread_.joinable()) {
+        intake_thread_.join();
     }
     
     Logger& logger = Logger::getInstance();
-    logger.info("EmailQueue worker thread stopped");
+    logger.info("EmailQueue worker threads stopped");
 }
 
 bool EmailQueue::isRunning() const {
     return running_;
 }
 
+void EmailQueue::close() {
+    closed_ = true;
+}
+
+bool EmailQueue::enablePersistence(const QueueJournalConfig& config, std::string& error) {
+    if (running_ || journal_) {
+        error = "Persistence must be enabled once, before the queue is started";
+        return false;
+    }
+    
+    auto journal = std::make_unique<QueueJournal>(config);
+    std::vector<QueueItem> recovered;
+    if (!journal->open(recovered, error)) {
+        return false;
+    }
+    
+    journal_ = std::move(journal);
+    if (journal_->isOwner() && !restore(recovered, error)) {
+        journal_.reset();
+        return false;
+    }
+    return true;
+}
+
+bool EmailQueue::takeOverSpool(std::string& error) {
+    if (running_) {
+        error = "The spool must be taken over before the queue is started";
+        return false;
+    }
+    if (!journal_) {
+        error = "The queue is not persistent";
+        return false;
+    }
+    if (journal_->isOwner()) {
+        return true;
+    }
+    
+    std::vector<QueueItem> recovered;
+    if (!journal_->acquire(recovered, error)) {
+        return false;
+    }
+    return restore(recovered, error);
+}
+
+bool EmailQueue::restore(std::vector<QueueItem>& recovered, std::string& error) {
+    Logger& logger = Logger::getInstance();
+    const QueueJournalConfig& config = journal_->getConfig();
+    
+    auto spool = std::make_unique<MessageSpool>(config.directory + "/msg", config.sync == JournalSync::SYNC);
+    if (!spool->open(error)) {
+        return false;
+    }
+    
+    // Reconcile the journal's index with the payload files
+    std::unordered_set<std::string> known;
+    for (const auto& item : recovered) {
+        if (item.spooled) {
+            known.insert(item.id);
+        }
+    }
+    std::unordered_set<std::string> present;
+    std::vector<QueueItem> unknown;
+    auto scan_start = std::chrono::steady_clock::now();
+    size_t files = spool->scan(known, std::max(1u, std::thread::hardware_concurrency()), present, unknown);
+    long long scan_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - scan_start).count();
+    logger.debug("EmailQueue scanned " + std::to_string(files) + " spool file(s) in " +
+                 std::to_string(scan_ms) + " ms");
+    
+    // Payloads are deleted before the completion is logged; a missing one was finished
+    size_t finished = 0;
+    auto gone = std::remove_if(recovered.begin(), recovered.end(), [&](const QueueItem& item) {
+        if (item.spooled && present.count(item.id) == 0) {
+            journal_->recordDone(item);
+            finished++;
+            return true;
+        }
+        return false;
+    });
+    recovered.erase(gone, recovered.end());
+    
+    // A payload without an index record was being queued when the process stopped
+    for (auto& item : unknown) {
+        if (journal_->recordEnqueue(item)) {
+            recovered.push_back(std::move(item));
+        }
+    }
+    if (finished > 0 || !unknown.empty()) {
+        logger.info("EmailQueue spool check: " + std::to_string(finished) + " finished, " +
+                    std::to_string(unknown.size()) + " re-indexed");
+    }
+    
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    spool_ = std::move(spool);
+    for (auto& item : recovered) {
+        schedule(std::move(item));
+        queued_count_++;
+        total_queued_++;
+    }
+    
+    if (!recovered.empty()) {
+        logger.info("EmailQueue recovered " + std::to_string(recovered.size()) + " queued email(s) from " +
+                    config.directory);
+    }
+    return true;
+}
+
+QueueJournalStats EmailQueue::getJournalStats() const {
+    return journal_ ? journal_->getStats() : QueueJournalStats();
+}
+
 void EmailQueue::setMaxRetries(int max_retries) {
     max_retries_ = max_retries;
 }
@@ -114,6 +518,48 @@ void EmailQueue::setMaxQueueSize(size_t max_size) {
     max_queue_size_ = max_size;
 }
 
+void EmailQueue::setWorkerCount(size_t worker_count) {
+    worker_count_ = worker_count;
+}
+
+size_t EmailQueue::getWorkerCount() const {
+    return worker_count_;
+}
+
+void EmailQueue::setDestinationConcurrency(size_t max_workers) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    max_workers_per_destination_ = std::max<size_t>(1, max_workers);
+    for (auto& entry : destinations_) {
+        activate(*entry.second);
+    }
+}
+
+void EmailQueue::setDestinationWeight(const std::string& destination, size_t weight) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    destination_weights_[destination] = std::max<size_t>(1, weight);
+}
+
+void EmailQueue::setDestinationBackoff(size_t failure_threshold, std::chrono::seconds backoff,
+                                       std::chrono::seconds max_backoff) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    destination_failure_threshold_ = failure_threshold;
+    destination_backoff_ = backoff;
+    max_destination_backoff_ = max_backoff;
+}
+
+void EmailQueue::setPriorityAging(size_t aging_limit) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    priority_aging_ = aging_limit;
+    for (auto& entry : destinations_) {
+        entry.second->ready.setAgingLimit(aging_limit);
+    }
+}
+
+void EmailQueue::setDestinationFunction(DestinationFunction function) {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    destination_function_ = function;
+}
+
 size_t EmailQueue::getTotalProcessed() const {
     return total_processed_;
 }
@@ -126,23 +572,113 @@ size_t EmailQueue::getTotalRetries() const {
     return total_retries_;
 }
 
+QueueStats EmailQueue::getStats() const {
+    QueueStats stats;
+    stats.total_queued = total_queued_;
+    stats.total_sent = total_processed_;
+    stats.total_failed = total_failed_;
+    stats.total_retried = total_retries_;
+    stats.current_queue_size = size();
+    
+    std::vector<QueueWorkerStats> workers = getWorkerStats();
+    stats.last_activity = std::chrono::system_clock::time_point();
+    for (const auto& worker : workers) {
+        stats.active_workers += worker.busy ? 1 : 0;
+        stats.last_activity = std::max(stats.last_activity, worker.last_activity);
+    }
+    return stats;
+}
+
+std::vector<QueueWorkerStats> EmailQueue::getWorkerStats() const {
+    std::lock_guard<std::mutex> lock(workers_mutex_);
+    
+    std::vector<QueueWorkerStats> workers;
+    workers.reserve(worker_states_.size());
+    for (const auto& state : worker_states_) {
+        QueueWorkerStats worker;
+        worker.processed = state->processed;
+        worker.failed = state->failed;
+        worker.retried = state->retried;
+        worker.busy = state->busy;
+        worker.last_activity = std::chrono::system_clock::time_point(
+            std::chrono::milliseconds(state->last_activity_ms.load()));
+        workers.push_back(worker);
+    }
+    return workers;
+}
+
+std::vector<QueueDestinationStats> EmailQueue::getDestinationStats() const {
+    std::lock_guard<std::mutex> lock(queue_mutex_);
+    
+    std::vector<QueueDestinationStats> destinations;
+    std::unordered_map<std::string, size_t> index;
+    destinations.reserve(destinations_.size());
+    for (const auto& entry : destinations_) {
+        index[entry.first] = destinations.size();
+        const Destination& destination = *entry.second;
+        QueueDestinationStats stats;
+        stats.destination = destination.key;
+        stats.ready = destination.ready.size();
+        stats.in_flight = destination.in_flight;
+        stats.consecutive_failures = destination.consecutive_failures;
+        stats.paused = destination.pause_token != 0;
+        if (stats.paused) {
+            stats.paused_until = destination.paused_until;
+        }
+        destinations.push_back(stats);
+    }
+    
+    // Mail no worker has taken in yet; read in place, as consumers only run under queue_mutex_
+    auto now = std::chrono::system_clock::now();
+    ingress_.peek([&](const QueueItem& item) {
+        if (item.scheduled_for > now) {
+            return;
+        }
+        std::string key = destinationKey(item);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            it = index.emplace(key, destinations.size()).first;
+            destinations.emplace_back();
+            destinations.back().destination = key;
+        }
+        destinations[it->second].ready++;
+    });
+    return destinations;
+}
+
 void EmailQueue::setSendCallback(SendCallback callback) {
     send_callback_ = callback;
 }
 
+void EmailQueue::setPreparedSendCallback(PreparedSendCallback callback) {
+    prepared_send_callback_ = callback;
+}
+
 std::vector<QueueItem> EmailQueue::getPendingEmails() const {
     std::lock_guard<std::mutex> lock(queue_mutex_);
     
+    // Read the priority levels in place, most urgent first; mail still in the
+    // ring is newer than any of its level's, as consumers only run under queue_mutex_
     std::vector<QueueItem> pending_emails;
-    std::priority_queue<QueueItem, std::vector<QueueItem>, 
-                       std::function<bool(const QueueItem&, const QueueItem&)>> temp_queue = email_queue_;
-    
-    while (!temp_queue.empty()) {
-        QueueItem email = temp_queue.top();
-        if (email.status == EmailStatus::PENDING || email.status == EmailStatus::RETRY) {
-            pending_emails.push_back(email);
+    pending_emails.reserve(queued_count_);
+    for (size_t level = PriorityBuckets::LEVELS; level-- > 0;) {
+        EmailPriority priority = static_cast<EmailPriority>(level);
+        for (const auto& entry : destinations_) {
+            for (const auto& email : entry.second->ready.level(priority)) {
+                if (email.status == EmailStatus::PENDING || email.status == EmailStatus::RETRY) {
+                    pending_emails.push_back(email);
+                }
+            }
         }
-        temp_queue.pop();
+        ingress_.peek([&](const QueueItem& email) {
+            if (email.priority == priority) {
+                pending_emails.push_back(email);
+            }
+        });
+    }
+    
+    for (const auto& delayed : delayed_items_) {
+        pending_emails.push_back(delayed.second);
     }
     
     return pending_emails;
@@ -151,127 +687,261 @@ std::vector<QueueItem> EmailQueue::getPendingEmails() const {
 std::vector<QueueItem> EmailQueue::getFailedEmails() const {
     std::lock_guard<std::mutex> lock(queue_mutex_);
     
+    // New mail in the ring has not failed yet
     std::vector<QueueItem> failed_emails;
-    std::priority_queue<QueueItem, std::vector<QueueItem>, 
-                       std::function<bool(const QueueItem&, const QueueItem&)>> temp_queue = email_queue_;
-    
-    while (!temp_queue.empty()) {
-        QueueItem email = temp_queue.top();
-        if (email.status == EmailStatus::FAILED) {
-            failed_emails.push_back(email);
+    for (size_t level = PriorityBuckets::LEVELS; level-- > 0;) {
+        for (const auto& entry : destinations_) {
+            for (const auto& email : entry.second->ready.level(static_cast<EmailPriority>(level))) {
+                if (email.status == EmailStatus::FAILED) {
+                    failed_emails.push_back(email);
+                }
+            }
         }
-        temp_queue.pop();
     }
     
     return failed_emails;
 }
 
-void EmailQueue::workerLoop() {
+void EmailQueue::workerLoop(WorkerState& state) {
     Logger& logger = Logger::getInstance();
     logger.debug("EmailQueue worker loop started");
     
+    std::vector<QueueItem> batch;
+    std::unique_lock<std::mutex> lock(queue_mutex_);
     while (running_) {
-        std::unique_lock<std::mutex> lock(queue_mutex_);
-        
-        // Wait for emails or stop signal
-        queue_cv_.wait(lock, [this] { return !running_ || !email_queue_.empty(); });
-        
-        if (!running_) {
-            break;
-        }
+        batch.clear();
+        drainIngress();
+        releaseDue();
+        Destination* destination = claimBatch(batch);
         
-        // Process emails in batches
-        std::vector<QueueItem> batch;
-        for (size_t i = 0; i < batch_size_ && !email_queue_.empty(); ++i) {
-            QueueItem email = email_queue_.top();
-            email_queue_.pop();
-            
-            // Check if email is ready for processing
-            if (email.status == EmailStatus::RETRY) {
-                auto now = std::chrono::system_clock::now();
-                auto time_since_last_attempt = std::chrono::duration_cast<std::chrono::seconds>(
-                    now - email.last_attempt);
-                
-                if (time_since_last_attempt < email.retry_delay) {
-                    // Not ready for retry, put back in queue
-                    email_queue_.push(email);
-                    continue;
-                }
+        if (!destination) {
+            // Announce the wait before the last look at the ring; pairs with the fence in admit()
+            idle_workers_++;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ingress_.empty()) {
+                idle_workers_--;
+                continue;
             }
             
-            batch.push_back(email);
+            // One worker sleeps until the earliest delayed item falls due; the rest until mail arrives
+            auto now = TimerWheel::Clock::now();
+            int wait_ms = delayed_.millisecondsUntilNextExpiry(now);
+            if (wait_ms >= 0 && !timer_waiter_) {
+                timer_waiter_ = true;
+                timer_wake_at_ = now + std::chrono::milliseconds(wait_ms);
+                queue_cv_.wait_for(lock, std::chrono::milliseconds(wait_ms));
+                timer_waiter_ = false;
+            } else {
+                queue_cv_.wait(lock);
+            }
+            idle_workers_--;
+            continue;
         }
         
+        // Let another worker start on what is left, or take over watching the wheel
+        if (!active_.empty() || !ingress_.empty() || (!delayed_.empty() && !timer_waiter_)) {
+            queue_cv_.notify_one();
+        }
         lock.unlock();
         
-        // Process batch
-        for (auto& queued_email : batch) {
-            if (!running_) {
-                break;
-            }
-            
+        state.busy = true;
+        size_t processed = 0;
+        bool paused = false;
+        while (processed < batch.size() && running_ && !paused) {
+            QueueItem& queued_email = batch[processed++];
             processEmail(queued_email);
+            
+            // Stop sending to a destination as soon as it is paused
+            lock.lock();
+            recordOutcome(*destination, queued_email.status == EmailStatus::SENT);
+            paused = destination->pause_token != 0;
+            lock.unlock();
+            
+            switch (queued_email.status) {
+                case EmailStatus::SENT:
+                    state.processed++;
+                    break;
+                case EmailStatus::RETRY:
+                    state.retried++;
+                    break;
+                default:
+                    state.failed++;
+                    break;
+            }
+            state.last_activity_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
         }
+        state.busy = false;
         
-        // Small delay to prevent busy waiting
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        lock.lock();
+        // Stopping or paused: hand back claimed mail that was not started, in its old place
+        for (size_t i = batch.size(); i > processed; --i) {
+            destination->ready.pushFront(std::move(batch[i - 1]));
+            queued_count_++;
+        }
+        releaseDestination(*destination);
     }
     
     logger.debug("EmailQueue worker loop ended");
 }
 
+void EmailQueue::intakeLoop() {
+    // Submissions are rare (command-line use); polling keeps it portable
+    const auto poll_interval = std::chrono::seconds(1);
+    
+    std::vector<QueueItem> items;
+    std::unique_lock<std::mutex> lock(queue_mutex_);
+    while (running_) {
+        intake_cv_.wait_for(lock, poll_interval);
+        if (!running_) {
+            break;
+        }
+        
+        lock.unlock();
+        items.clear();
+        journal_->collectIncoming(items);
+        auto stored = std::partition(items.begin(), items.end(), [this](QueueItem& item) {
+            return persist(item);
+        });
+        for (auto it = items.begin(); it != stored; ++it) {
+            journal_->acceptIncoming(it->id);
+        }
+        lock.lock();
+        
+        for (auto it = items.begin(); it != stored; ++it) {
+            schedule(std::move(*it));
+            queued_count_++;
+            total_queued_++;
+        }
+    }
+}
+
+EmailQueue::Destination* EmailQueue::claimBatch(std::vector<QueueItem>& batch) {
+    while (!active_.empty()) {
+        Destination* destination = active_.front();
+        
+        // Listed destinations are checked lazily: one may have been paused, emptied or saturated since
+        if (destination->pause_token != 0 || destination->ready.empty() ||
+            destination->in_flight >= max_workers_per_destination_) {
+            active_.pop_front();
+            destination->active = false;
+            destination->deficit = 0;
+            dropIfIdle(*destination);
+            continue;
+        }
+        
+        // Deficit round robin: a destination's turn lasts as many batches as its weight
+        if (destination->deficit == 0) {
+            auto weight = destination_weights_.find(destination->key);
+            destination->deficit = weight != destination_weights_.end() ? weight->second : 1;
+        }
+        
+        // Share a backlog between the workers allowed on it instead of letting the first one claim it all
+        size_t workers = std::max<size_t>(1, std::min<size_t>(worker_count_, max_workers_per_destination_));
+        size_t limit = std::max<size_t>(1, std::min(batch_size_, destination->ready.size() / workers));
+        while (batch.size() < limit && !destination->ready.empty()) {
+            batch.push_back(destination->ready.pop());
+        }
+        queued_count_ -= batch.size();
+        destination->in_flight++;
+        
+        // End of its turn: to the back of the line, while it still has work others can take
+        if (--destination->deficit == 0) {
+            active_.pop_front();
+            if (!destination->ready.empty() && destination->in_flight < max_workers_per_destination_) {
+                active_.push_back(destination);
+            } else {
+                destination->active = false;
+            }
+        }
+        return destination;
+    }
+    return nullptr;
+}
+
 void EmailQueue::processEmail(QueueItem& queued_email) {
     Logger& logger = Logger::getInstance();
     
-    if (!send_callback_) {
+    if (queued_email.prepared ? !prepared_send_callback_ : !send_callback_) {
         logger.error("No send callback set, cannot process email");
         queued_email.status = EmailStatus::FAILED;
         queued_email.error_message = "No send callback configured";
         total_failed_++;
+        retire(queued_email);
         return;
     }
     
     queued_email.status = EmailStatus::PROCESSING;
     queued_email.last_attempt = std::chrono::system_clock::now();
     
-    logger.debug("Processing email from: " + queued_email.from_address + 
+    logger.debug("Processing email " + queued_email.id + " from: " + queued_email.from_address + 
                 " to: " + (queued_email.to_addresses.empty() ? "none" : queued_email.to_addresses[0]));
     
     try {
-        // Create Email object from QueueItem for the callback
-        Email email;
-        email.from = queued_email.from_address;
-        email.to = queued_email.to_addresses;
-        email.subject = queued_email.subject;
-        email.body = queued_email.body;
-        email.html_body = queued_email.html_body;
-        email.attachments = queued_email.attachments;
-        
-        SMTPResult result = send_callback_(&email);
+        SMTPResult result;
+        if (queued_email.prepared) {
+            result = prepared_send_callback_(*queued_email.prepared, queued_email.to_addresses[0]);
+        } else {
+            // A spooled item's payload is read back only now, for the send
+            QueueItem spooled_item;
+            const QueueItem* content = &queued_email;
+            if (queued_email.spooled) {
+                std::string error;
+                if (!spool_->load(queued_email.id, spooled_item, error)) {
+                    queued_email.status = EmailStatus::FAILED;
+                    queued_email.error_message = error;
+                    total_failed_++;
+                    retire(queued_email);
+                    logger.error("Email " + queued_email.id + " cannot be sent: " + error);
+                    return;
+                }
+                content = &spooled_item;
+            }
+            
+            // Create Email object from QueueItem for the callback
+            Email email;
+            email.from = queued_email.from_address;
+            email.to = queued_email.to_addresses;
+            email.subject = content->subject;
+            email.body = content->body;
+            email.html_body = content->html_body;
+            email.attachments = content->attachments;
+            email.inline_attachments = content->inline_attachments;
+            
+            result = send_callback_(&email);
+        }
         
         if (result.success) {
             queued_email.status = EmailStatus::SENT;
             total_processed_++;
-            logger.info("Email sent successfully from: " + queued_email.from_address);
+            retire(queued_email);
+            logger.info("Email " + queued_email.id + " sent successfully from: " + queued_email.from_address);
         } else {
             if (shouldRetry(queued_email)) {
                 queued_email.status = EmailStatus::RETRY;
                 updateRetryInfo(queued_email);
                 total_retries_++;
+                if (journal_) {
+                    journal_->recordRetry(queued_email);
+                }
                 
-                // Re-queue for retry
-                std::lock_guard<std::mutex> lock(queue_mutex_);
-                email_queue_.push(queued_email);
+                // Re-queue for retry once the delay has passed
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex_);
+                    schedule(queued_email);
+                    queued_count_++;
+                }
                 
-                logger.warning("Email queued for retry from: " + queued_email.from_address + 
+                logger.warning("Email " + queued_email.id + " queued for retry from: " + queued_email.from_address + 
                               " (attempt " + std::to_string(queued_email.retry_count) + "/" + 
                               std::to_string(queued_email.max_retries) + ")");
             } else {
                 queued_email.status = EmailStatus::FAILED;
                 queued_email.error_message = result.error_message;
                 total_failed_++;
+                retire(queued_email);
                 
-                logger.error("Email failed permanently from: " + queued_email.from_address + 
+                logger.error("Email " + queued_email.id + " failed permanently from: " + queued_email.from_address + 
                             ": " + result.error_message);
             }
         }
@@ -279,6 +949,7 @@ void EmailQueue::processEmail(QueueItem& queued_email) {
         queued_email.status = EmailStatus::FAILED;
         queued_email.error_message = "Exception: " + std::string(e.what());
         total_failed_++;
+        retire(queued_email);
         
         logger.error("Exception while processing email from: " + queued_email.from_address + 
                     ": " + e.what());
@@ -1,26 +1,78 @@
 #pragma once
 
-#include <queue>
 #include <mutex>
 #include <condition_variable>
 #include <thread>
 #include <atomic>
 #include <chrono>
 #include <functional>
+#include <memory>
+#include <vector>
 #include "ssmtp-mailer/queue_types.hpp"
 #include "ssmtp-mailer/mailer.hpp"
+#include "core/queue/message_spool.hpp"
+#include "core/queue/priority_buckets.hpp"
+#include "core/queue/queue_journal.hpp"
+#include "utils/mpmc_ring.hpp"
+#include "utils/timer_wheel.hpp"
+#include <unordered_map>
+#include <deque>
 
 namespace ssmtp_mailer {
 
 // Queue types are now defined in queue_types.hpp
 
+/**
+ * @brief Priority queue of outgoing mail served by a pool of worker threads
+ *
+ * Workers sleep on a condition variable until mail is queued or a retry
+ * falls due, so an idle queue costs nothing and a busy one is drained by
+ * all workers at once. Mail that is not due yet (a scheduled send or a
+ * retry waiting out its delay) is held on a timing wheel apart from the
+ * ready queue and moved across when due, so it never blocks ready mail.
+ * stop() lets workers finish the message they are sending and puts any
+ * mail they had claimed but not started back in the queue, so nothing is
+ * lost across a stop and restart. With persistence enabled, the queue is
+ * also kept in a QueueJournal and survives a restart of the process; the
+ * payload of each message then lives in a MessageSpool file and the queue
+ * itself holds compact index records.
+ *
+ * Ready mail is kept in one sub-queue per destination (the recipient's
+ * domain by default), each a PriorityBuckets FIFO per priority level, so
+ * queueing and claiming mail is O(1) and lower priorities still get
+ * through under a steady load of urgent mail.
+ *
+ * Producers do not take the queue lock: enqueue() stores the mail, then
+ * hands it over through a lock-free MpmcRing that workers drain into the
+ * sub-queues when they next look for work. Only when a worker is asleep
+ * does a producer briefly take the lock to wake it. Workers take turns between
+ * destinations by deficit round robin, so a large or slow destination
+ * cannot starve the others; setDestinationWeight() gives a destination a
+ * larger share. Each destination also has its own limit on concurrent
+ * workers and its own backoff: after repeated failures in a row it is
+ * paused, for longer each time, while mail to other destinations flows.
+ */
 class EmailQueue {
 public:
     EmailQueue();
+    explicit EmailQueue(const QueueConfig& config);
     ~EmailQueue();
 
     // Queue management
-    void enqueue(const Email* email, EmailPriority priority = EmailPriority::NORMAL);
+    EnqueueStatus enqueue(const Email* email, EmailPriority priority = EmailPriority::NORMAL);
+    EnqueueStatus enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                          EmailPriority priority = EmailPriority::NORMAL);
+    
+    /**
+     * @brief Queue mail to be sent no earlier than the given time
+     * @param email Email to send
+     * @param priority Priority once due
+     * @param send_at Send time; a past time queues the mail as ready
+     * @return Whether the mail was queued
+     */
+    EnqueueStatus enqueue(const Email* email, EmailPriority priority, std::chrono::system_clock::time_point send_at);
+    EnqueueStatus enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                          EmailPriority priority, std::chrono::system_clock::time_point send_at);
     bool dequeue(QueueItem& email);
     size_t size() const;
     bool empty() const;
@@ -30,52 +82,278 @@ public:
     void stop();
     bool isRunning() const;
     
+    /**
+     * @brief Stop taking mail; enqueue() returns CLOSED from now on
+     *
+     * Mail already queued is still sent while the queue runs.
+     */
+    void close();
+    
+    /**
+     * @brief Keep the queue in a journal, so it survives restarts
+     *
+     * Call before start() and before queueing mail. Recovers the mail still
+     * queued in the spool. If another process serves the spool, or the
+     * config is submit_only, mail enqueued here is handed to that process
+     * instead.
+     *
+     * @param config Journal configuration
+     * @param error Error message on failure
+     * @return true if the spool could be opened
+     */
+    bool enablePersistence(const QueueJournalConfig& config, std::string& error);
+    
+    /**
+     * @brief Serve the spool this queue has been handing mail to
+     *
+     * Call before start(), while no mail is being queued. Recovers the mail
+     * queued in the spool; the intake thread then takes in what other
+     * processes submit.
+     *
+     * @param error Error message on failure, e.g. another process serves the spool
+     * @return true if this queue owns the spool
+     */
+    bool takeOverSpool(std::string& error);
+    QueueJournalStats getJournalStats() const;
+    
     // Configuration
     void setMaxRetries(int max_retries);
     void setRetryDelay(std::chrono::seconds delay);
     void setBatchSize(size_t batch_size);
     void setMaxQueueSize(size_t max_size);
     
+    /**
+     * @brief Set the number of worker threads, applied on the next start()
+     * @param worker_count Number of workers; at least one is started
+     */
+    void setWorkerCount(size_t worker_count);
+    size_t getWorkerCount() const;
+    
+    /**
+     * @brief Limit the workers sending to any one destination at a time
+     * @param max_workers Workers per destination; at least one
+     */
+    void setDestinationConcurrency(size_t max_workers);
+    
+    /**
+     * @brief Set a destination's share of the workers relative to the others
+     * @param destination Destination key, e.g. "example.com"
+     * @param weight Batches served per turn; 1 is an equal share
+     */
+    void setDestinationWeight(const std::string& destination, size_t weight);
+    
+    /**
+     * @brief Configure how a failing destination is paused
+     * @param failure_threshold Failures in a row before the first pause; 0 never pauses
+     * @param backoff First pause, doubled for each further failure
+     * @param max_backoff Longest pause
+     */
+    void setDestinationBackoff(size_t failure_threshold, std::chrono::seconds backoff,
+                               std::chrono::seconds max_backoff);
+    
+    /**
+     * @brief Let waiting mail of a lower priority through after a number of more urgent sends
+     * @param aging_limit Sends a waiting priority level may be passed over; 0 serves strictly by priority
+     */
+    void setPriorityAging(size_t aging_limit);
+    
+    /**
+     * @brief Group mail by something other than the recipient's domain, e.g. the provider
+     * @param function Returns the destination key of an item
+     */
+    using DestinationFunction = std::function<std::string(const QueueItem&)>;
+    void setDestinationFunction(DestinationFunction function);
+    
     // Statistics
     size_t getTotalProcessed() const;
     size_t getTotalFailed() const;
     size_t getTotalRetries() const;
+    QueueStats getStats() const;
+    std::vector<QueueWorkerStats> getWorkerStats() const;
+    std::vector<QueueDestinationStats> getDestinationStats() const;
     
     // Callbacks
     using SendCallback = std::function<SMTPResult(const Email*)>;
     void setSendCallback(SendCallback callback);
+    using PreparedSendCallback = std::function<SMTPResult(const PreparedMessage&, const std::string&)>;
+    void setPreparedSendCallback(PreparedSendCallback callback);
     
     // Queue inspection
     std::vector<QueueItem> getPendingEmails() const;
     std::vector<QueueItem> getFailedEmails() const;
 
 private:
+    // Ready mail of one destination, with its scheduling state (guarded by queue_mutex_)
+    struct Destination {
+        std::string key;
+        PriorityBuckets ready;
+        size_t in_flight;                   // Workers holding a batch of its mail
+        size_t deficit;                     // Batches it may still take this turn
+        bool active;                        // Listed in active_
+        size_t consecutive_failures;
+        uint64_t pause_token;               // Wheel token while paused, else 0
+        std::chrono::system_clock::time_point paused_until;
+        
+        Destination(const std::string& destination_key, size_t priority_aging)
+            : key(destination_key), ready(priority_aging), in_flight(0), deficit(0), active(false),
+              consecutive_failures(0), pause_token(0) {}
+    };
+    
     // Queue storage
     mutable std::mutex queue_mutex_;
-    std::priority_queue<QueueItem, std::vector<QueueItem>, 
-                       std::function<bool(const QueueItem&, const QueueItem&)>> email_queue_;
+    std::unordered_map<std::string, std::unique_ptr<Destination>> destinations_;
+    std::deque<Destination*> active_;       // Round-robin order of destinations that may have work
+    std::unordered_map<uint64_t, Destination*> paused_;    // Keyed by wheel token
+    std::unordered_map<std::string, size_t> destination_weights_;
+    
+    // Mail enqueued but not yet taken in by a worker (lock-free)
+    MpmcRing<QueueItem> ingress_;
+    std::atomic<size_t> queued_count_;      // Ingress, ready and delayed mail; not what workers hold
+    std::atomic<size_t> idle_workers_;      // Workers waiting, whom a producer has to wake
+    std::atomic<bool> closed_;
     
     // Processing state
+    struct WorkerState {
+        std::atomic<size_t> processed;
+        std::atomic<size_t> failed;
+        std::atomic<size_t> retried;
+        std::atomic<bool> busy;
+        std::atomic<long long> last_activity_ms;    // system_clock milliseconds
+        
+        WorkerState() : processed(0), failed(0), retried(0), busy(false), last_activity_ms(0) {}
+    };
+    
     std::atomic<bool> running_;
-    std::thread worker_thread_;
+    std::vector<std::thread> workers_;
+    std::vector<std::unique_ptr<WorkerState>> worker_states_;
     std::condition_variable queue_cv_;
+    mutable std::mutex workers_mutex_;     // Guards workers_ and worker_states_
+    
+    // Mail not yet due, keyed by wheel token (guarded by queue_mutex_)
+    TimerWheel delayed_;
+    std::unordered_map<uint64_t, QueueItem> delayed_items_;
+    uint64_t next_delayed_token_;
+    bool timer_waiter_;                     // A worker sleeps until the earliest delayed item is due
+    TimerWheel::Clock::time_point timer_wake_at_;
+    
+    // Persistence; mail submitted by other processes is picked up by the intake thread
+    std::unique_ptr<QueueJournal> journal_;
+    std::unique_ptr<MessageSpool> spool_;
+    std::thread intake_thread_;
+    std::condition_variable intake_cv_;
     
     // Configuration
     int max_retries_;
     std::chrono::seconds retry_delay_;
     size_t batch_size_;
     size_t max_queue_size_;
+    std::atomic<size_t> worker_count_;
+    size_t max_workers_per_destination_;
+    size_t destination_failure_threshold_;
+    std::chrono::seconds destination_backoff_;
+    std::chrono::seconds max_destination_backoff_;
+    size_t priority_aging_;
+    DestinationFunction destination_function_;
     
     // Statistics
+    std::atomic<size_t> total_queued_;
     std::atomic<size_t> total_processed_;
     std::atomic<size_t> total_failed_;
     std::atomic<size_t> total_retries_;
     
     // Callbacks
     SendCallback send_callback_;
+    PreparedSendCallback prepared_send_callback_;
     
     // Worker thread function
-    void workerLoop();
+    void workerLoop(WorkerState& state);
+    void intakeLoop();
+    
+    /**
+     * @brief Journal a new item and queue it, unless the queue is full
+     * @param item New item
+     * @return Whether it was queued
+     */
+    EnqueueStatus admit(QueueItem item);
+    
+    /**
+     * @brief Move mail from the ingress ring into the sub-queues (caller holds queue_mutex_)
+     */
+    void drainIngress();
+    
+    /**
+     * @brief Spool an item's payload and log its index record (persistent queues)
+     * @param item Item; reduced to its index record once spooled
+     * @return false if it could not be stored
+     */
+    bool persist(QueueItem& item);
+    
+    /**
+     * @brief Open the payload spool of an owned journal and queue the recovered mail
+     * @param recovered Items the journal recovered
+     * @param error Error message on failure
+     * @return false if the payload spool could not be opened
+     */
+    bool restore(std::vector<QueueItem>& recovered, std::string& error);
+    
+    /**
+     * @brief Drop a sent or permanently failed item from the spool and journal
+     * @param item Finished item
+     */
+    void retire(const QueueItem& item);
+    
+    /**
+     * @brief Take up to batch_size_ ready items of the next destination in turn (caller holds queue_mutex_)
+     * @param batch Claimed items
+     * @return Their destination, to be given back with releaseDestination(); nullptr if nothing is ready
+     */
+    Destination* claimBatch(std::vector<QueueItem>& batch);
+    
+    /**
+     * @brief Record a send attempt, pausing the destination after repeated failures (caller holds queue_mutex_)
+     * @param destination Destination of the item
+     * @param success Whether it was sent
+     */
+    void recordOutcome(Destination& destination, bool success);
+    
+    /**
+     * @brief Give back a destination claimed by a worker (caller holds queue_mutex_)
+     * @param destination Destination returned by claimBatch()
+     */
+    void releaseDestination(Destination& destination);
+    
+    /**
+     * @brief Put a destination in the round robin if it can be served (caller holds queue_mutex_)
+     */
+    void activate(Destination& destination);
+    
+    std::string destinationKey(const QueueItem& item) const;
+    
+    /**
+     * @brief Forget an idle, healthy destination (caller holds queue_mutex_)
+     */
+    void dropIfIdle(Destination& destination);
+    
+    /**
+     * @brief Add an item to the ready queue, or to the wheel if not due (caller holds queue_mutex_)
+     * @param item Item; due at scheduled_for, or for retries after retry_delay
+     */
+    void schedule(QueueItem item);
+    
+    /**
+     * @brief Make sure a worker will wake for a new deadline on the wheel (caller holds queue_mutex_)
+     */
+    void watchWheel(TimerWheel::Clock::time_point deadline);
+    
+    /**
+     * @brief Add a due item to its destination's sub-queue (caller holds queue_mutex_)
+     */
+    void makeReady(QueueItem item);
+    
+    /**
+     * @brief Move items that have fallen due onto the ready queue and end expired pauses (caller holds queue_mutex_)
+     */
+    void releaseDue();
     
     // Helper methods
     void processEmail(QueueItem& queued_email);
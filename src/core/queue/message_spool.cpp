@@ -0,0 +1,171 @@
+#include "core/queue/message_spool.hpp"
+#include "core/queue/queue_records.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/crc32c.hpp"
+#include "utils/durable_file.hpp"
+#include "utils/mapped_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+namespace ssmtp_mailer {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const unsigned SHARD_COUNT = 256;
+
+std::string shardName(unsigned shard) {
+    char name[3];
+    std::snprintf(name, sizeof(name), "%02x", shard);
+    return name;
+}
+
+/**
+ * Read a payload file
+ */
+bool readPayload(const std::string& path, QueueItem& item, std::string& error) {
+    MappedFile file;
+    if (!file.open(path, error)) {
+        return false;
+    }
+    file.adviseSequential();
+
+    QueueReplayState state;
+    if (file.size() >= QUEUE_MAGIC_LENGTH &&
+        std::memcmp(file.data(), QUEUE_PAYLOAD_MAGIC, QUEUE_MAGIC_LENGTH) == 0) {
+        replayQueueRecords(file.data(), file.size(), state);
+    }
+    if (!state.complete() || state.items.size() != 1) {
+        error = "Damaged spool file " + path;
+        return false;
+    }
+    item = std::move(state.items.begin()->second);
+    return true;
+}
+
+} // anonymous namespace
+
+MessageSpool::MessageSpool(const std::string& directory, bool sync)
+    : directory_(directory), sync_(sync) {
+}
+
+std::string MessageSpool::shardPath(const std::string& id) const {
+    return directory_ + "/" + shardName(crc32c(id.data(), id.size()) % SHARD_COUNT);
+}
+
+bool MessageSpool::open(std::string& error) {
+    std::error_code ec;
+    for (unsigned shard = 0; shard < SHARD_COUNT; ++shard) {
+        fs::create_directories(directory_ + "/" + shardName(shard), ec);
+        if (ec) {
+            error = "Cannot create spool directory " + directory_ + ": " + ec.message();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MessageSpool::store(const QueueItem& item, std::string& error) {
+    std::string content(QUEUE_PAYLOAD_MAGIC, QUEUE_MAGIC_LENGTH);
+    QueueItem stored = item;
+    stored.prepared.reset();
+    stored.spooled = false;
+    encodeQueueItem(content, stored, 0);
+    encodeQueueEnd(content, 1);
+    return writeFileDurably(shardPath(item.id), item.id, content, sync_, error);
+}
+
+bool MessageSpool::load(const std::string& id, QueueItem& item, std::string& error) const {
+    if (!readPayload(shardPath(id) + "/" + id, item, error)) {
+        return false;
+    }
+    if (item.id != id) {
+        error = "Spool file " + id + " holds item " + item.id;
+        return false;
+    }
+    return true;
+}
+
+void MessageSpool::remove(const std::string& id) {
+    std::remove((shardPath(id) + "/" + id).c_str());
+}
+
+void MessageSpool::compact(QueueItem& item) {
+    // Swap rather than clear(), so the memory is given back
+    std::string().swap(item.subject);
+    std::string().swap(item.body);
+    std::string().swap(item.html_body);
+    std::vector<std::string>().swap(item.attachments);
+    std::vector<std::string>().swap(item.inline_attachments);
+    item.spooled = true;
+}
+
+size_t MessageSpool::scan(const std::unordered_set<std::string>& known, size_t threads,
+                          std::unordered_set<std::string>& present, std::vector<QueueItem>& unknown) const {
+    Logger& logger = Logger::getInstance();
+    std::atomic<unsigned> next_shard(0);
+    std::mutex results_mutex;
+    size_t found = 0;
+
+    auto scanShards = [&]() {
+        std::vector<std::string> local_present;
+        std::vector<QueueItem> local_unknown;
+        for (unsigned shard = next_shard++; shard < SHARD_COUNT; shard = next_shard++) {
+            std::string shard_path = directory_ + "/" + shardName(shard);
+            std::error_code ec;
+            for (fs::directory_iterator it(shard_path, ec), end; !ec && it != end; it.increment(ec)) {
+                std::string name = it->path().filename().string();
+                if (name.empty() || name[0] == '.') {
+                    // Left by a write that fell back to a rename and was interrupted
+                    if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+                        fs::remove(it->path(), ec);
+                    }
+                    continue;
+                }
+                if (known.count(name) != 0) {
+                    local_present.push_back(name);
+                    continue;
+                }
+
+                QueueItem item;
+                std::string error;
+                if (!readPayload(it->path().string(), item, error) || item.id != name) {
+                    logger.warning("Message spool: skipping " + it->path().string() + ": " + error);
+                    continue;
+                }
+                compact(item);
+                local_present.push_back(name);
+                local_unknown.push_back(std::move(item));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(results_mutex);
+        found += local_present.size();
+        present.insert(local_present.begin(), local_present.end());
+        for (auto& item : local_unknown) {
+            unknown.push_back(std::move(item));
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < std::max<size_t>(1, threads); ++i) {
+        workers.emplace_back(scanShards);
+    }
+    scanShards();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::sort(unknown.begin(), unknown.end(), [](const QueueItem& a, const QueueItem& b) {
+        return a.id < b.id;
+    });
+    return found;
+}
+
+} // namespace ssmtp_mailer
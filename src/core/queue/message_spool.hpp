@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "ssmtp-mailer/queue_types.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Payload files of a persistent queue, one per message (Maildir-style)
+ *
+ * A queued message is split in two: the payload (subject, bodies,
+ * attachment lists) is written once to its own file here, and the queue
+ * keeps only a compact index record (QueueItem::spooled, with those
+ * fields empty) in memory and in its journal. Heap operations, retries
+ * and checkpoints then move a few hundred bytes per item instead of the
+ * message, and the payload is read back through a memory mapping when
+ * the message is sent.
+ *
+ * Files are named after the item ID and spread over 256 subdirectories,
+ * so no directory grows huge and scan() can list them in parallel. Each
+ * file is written with writeFileDurably() and holds the complete item, so
+ * the index can be rebuilt from the spool alone.
+ */
+class MessageSpool {
+public:
+    /**
+     * @brief Constructor
+     * @param directory Spool directory, created by open() if missing
+     * @param sync Whether store() returns only once the file is on disk
+     */
+    MessageSpool(const std::string& directory, bool sync);
+
+    /**
+     * @brief Create the spool directories
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool open(std::string& error);
+
+    /**
+     * @brief Write an item's payload file
+     * @param item Complete item; shared PreparedMessage content is not spooled
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool store(const QueueItem& item, std::string& error);
+
+    /**
+     * @brief Read a spooled item back in full
+     * @param id Item ID
+     * @param item Complete item
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool load(const std::string& id, QueueItem& item, std::string& error) const;
+
+    /**
+     * @brief Delete an item's payload file
+     * @param id Item ID
+     */
+    void remove(const std::string& id);
+
+    /**
+     * @brief Reduce a stored item to its index record
+     * @param item Item to strip of its payload; marked spooled
+     */
+    static void compact(QueueItem& item);
+
+    /**
+     * @brief List the spool with several threads, rebuilding unknown index records
+     *
+     * Files of known items are only listed; the others (an item whose
+     * index record was lost, e.g. in a crash between writing its payload
+     * and logging it) are read and returned as index records.
+     *
+     * @param known IDs the caller has index records for
+     * @param threads Number of scanning threads
+     * @param present IDs of all payload files found
+     * @param unknown Index records rebuilt from files not in known
+     * @return Number of payload files found
+     */
+    size_t scan(const std::unordered_set<std::string>& known, size_t threads,
+                std::unordered_set<std::string>& present, std::vector<QueueItem>& unknown) const;
+
+private:
+    std::string directory_;
+    bool sync_;
+
+    std::string shardPath(const std::string& id) const;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,65 @@
+#include "core/queue/priority_buckets.hpp"
+#include <algorithm>
+#include <utility>
+
+namespace ssmtp_mailer {
+
+PriorityBuckets::PriorityBuckets(size_t aging_limit)
+    : size_(0), aging_limit_(aging_limit) {
+    passed_over_.fill(0);
+}
+
+size_t PriorityBuckets::levelOf(const QueueItem& item) {
+    int level = static_cast<int>(item.priority);
+    return static_cast<size_t>(std::max(0, std::min(level, static_cast<int>(LEVELS) - 1)));
+}
+
+void PriorityBuckets::push(QueueItem item) {
+    size_t level = levelOf(item);
+    levels_[level].push_back(std::move(item));
+    size_++;
+}
+
+void PriorityBuckets::pushFront(QueueItem item) {
+    size_t level = levelOf(item);
+    levels_[level].push_front(std::move(item));
+    size_++;
+}
+
+size_t PriorityBuckets::nextLevel() const {
+    size_t next = LEVELS;
+    for (size_t level = LEVELS; level-- > 0;) {
+        if (levels_[level].empty()) {
+            continue;
+        }
+        if (next == LEVELS) {
+            next = level;
+        } else if (aging_limit_ > 0 && passed_over_[level] >= aging_limit_ &&
+                   (passed_over_[next] < aging_limit_ || passed_over_[level] > passed_over_[next])) {
+            // Waited long enough: the most overdue level goes first
+            next = level;
+        }
+    }
+    return next;
+}
+
+const QueueItem& PriorityBuckets::front() const {
+    return levels_[nextLevel()].front();
+}
+
+QueueItem PriorityBuckets::pop() {
+    size_t next = nextLevel();
+    for (size_t level = 0; level < next; ++level) {
+        if (!levels_[level].empty()) {
+            passed_over_[level]++;
+        }
+    }
+    passed_over_[next] = 0;
+
+    QueueItem item = std::move(levels_[next].front());
+    levels_[next].pop_front();
+    size_--;
+    return item;
+}
+
+} // namespace ssmtp_mailer
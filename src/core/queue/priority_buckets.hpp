@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include "ssmtp-mailer/queue_types.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Queue items ordered by priority, one FIFO per EmailPriority level
+ *
+ * Push and pop are O(1) and need no comparisons: an item goes to the back
+ * of its level and the most urgent non-empty level is served first. To
+ * keep a steady stream of urgent mail from starving the rest, a waiting
+ * level is served anyway once more urgent levels have been chosen over it
+ * aging_limit times. The levels can be read in place, most urgent first.
+ *
+ * Not thread-safe; EmailQueue guards it with its queue lock.
+ */
+class PriorityBuckets {
+public:
+    static const size_t LEVELS = static_cast<size_t>(EmailPriority::URGENT) + 1;
+
+    /**
+     * @brief Constructor
+     * @param aging_limit Times a level may be passed over before it is served; 0 serves strictly by priority
+     */
+    explicit PriorityBuckets(size_t aging_limit = 0);
+
+    /**
+     * @brief Add an item at the back of its priority level
+     * @param item Item to queue
+     */
+    void push(QueueItem item);
+
+    /**
+     * @brief Put an item back at the front of its level, ahead of everything queued since
+     * @param item Item that was popped and not processed
+     */
+    void pushFront(QueueItem item);
+
+    /**
+     * @brief Get the item pop() would return
+     * @return Next item; the queue must not be empty
+     */
+    const QueueItem& front() const;
+
+    /**
+     * @brief Remove and return the next item
+     * @return Next item; the queue must not be empty
+     */
+    QueueItem pop();
+
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+    /**
+     * @brief Get the items of one level, oldest first
+     * @param priority Level
+     * @return Items queued at that level
+     */
+    const std::deque<QueueItem>& level(EmailPriority priority) const {
+        return levels_[static_cast<size_t>(priority)];
+    }
+
+    void setAgingLimit(size_t aging_limit) { aging_limit_ = aging_limit; }
+
+private:
+    std::array<std::deque<QueueItem>, LEVELS> levels_;
+    std::array<size_t, LEVELS> passed_over_;    // Pops served from a more urgent level while this one waited
+    size_t size_;
+    size_t aging_limit_;
+
+    /**
+     * @brief Level the next pop() is served from
+     */
+    size_t nextLevel() const;
+
+    static size_t levelOf(const QueueItem& item);
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,645 @@
+#include "core/queue/queue_journal.hpp"
+#include "core/mime/prepared_message.hpp"
+#include "core/logging/logger.hpp"
+#include "core/queue/queue_records.hpp"
+#include "utils/durable_file.hpp"
+#include "utils/mapped_file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <share.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Sequence number from a name like "segment-000000000000002a.wal"
+ */
+bool parseSequence(const std::string& name, const std::string& prefix, const std::string& suffix,
+                   uint64_t& seq) {
+    if (name.size() != prefix.size() + 16 + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+        return false;
+    }
+    seq = 0;
+    for (size_t i = prefix.size(); i < prefix.size() + 16; ++i) {
+        char c = name[i];
+        int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        seq = (seq << 4) | static_cast<uint64_t>(digit);
+    }
+    return true;
+}
+
+std::string sequenceName(const std::string& prefix, uint64_t seq, const std::string& suffix) {
+    char digits[17];
+    std::snprintf(digits, sizeof(digits), "%016llx", static_cast<unsigned long long>(seq));
+    return prefix + digits + suffix;
+}
+
+std::string systemError(const std::string& what, const std::string& path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+/**
+ * Take the spool lock without waiting
+ * @return Descriptor holding the lock, -1 if another process holds it, -2 on error
+ */
+int lockSpool(const std::string& path) {
+#ifdef _WIN32
+    int fd = -1;
+    if (_sopen_s(&fd, path.c_str(), _O_CREAT | _O_RDWR, _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0) {
+        return errno == EACCES ? -1 : -2;
+    }
+    return fd;
+#else
+    int fd = ::open(path.c_str(), O_CREAT | O_RDWR | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return -2;
+    }
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return saved == EWOULDBLOCK ? -1 : -2;
+    }
+    return fd;
+#endif
+}
+
+} // anonymous namespace
+
+QueueJournal::QueueJournal(const QueueJournalConfig& config)
+    : config_(config), open_(false), owner_(false), stopping_(false), failed_(false),
+      lock_fd_(-1), segment_fd_(-1), segment_seq_(0), segment_size_(0), bytes_since_checkpoint_(0),
+      checkpoint_requested_(false), appended_lsn_(0), durable_lsn_(0), next_message_id_(1) {
+}
+
+QueueJournal::~QueueJournal() {
+    close();
+}
+
+std::string QueueJournal::path(const std::string& name) const {
+    return config_.directory + "/" + name;
+}
+
+bool QueueJournal::open(std::vector<QueueItem>& recovered, std::string& error) {
+    Logger& logger = Logger::getInstance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_) {
+        error = "Queue journal is already open";
+        return false;
+    }
+
+    std::error_code ec;
+    fs::create_directories(path("incoming"), ec);
+    if (ec) {
+        error = "Cannot create spool directory " + path("incoming") + ": " + ec.message();
+        return false;
+    }
+
+    if (config_.submit_only) {
+        open_ = true;
+        owner_ = false;
+        return true;
+    }
+    lock_fd_ = lockSpool(path("LOCK"));
+    if (lock_fd_ == -2) {
+        error = systemError("Cannot lock", path("LOCK"));
+        return false;
+    }
+    if (lock_fd_ == -1) {
+        logger.info("Queue spool " + config_.directory + " is served by another process; mail is handed to it");
+        open_ = true;
+        owner_ = false;
+        return true;
+    }
+    return recoverLocked(recovered, error);
+}
+
+bool QueueJournal::acquire(std::vector<QueueItem>& recovered, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_) {
+        error = "Queue journal is not open";
+        return false;
+    }
+    if (owner_) {
+        recovered.clear();
+        return true;
+    }
+
+    lock_fd_ = lockSpool(path("LOCK"));
+    if (lock_fd_ == -2) {
+        error = systemError("Cannot lock", path("LOCK"));
+        return false;
+    }
+    if (lock_fd_ == -1) {
+        error = "Queue spool " + config_.directory + " is served by another process";
+        return false;
+    }
+    return recoverLocked(recovered, error);
+}
+
+bool QueueJournal::recoverLocked(std::vector<QueueItem>& recovered, std::string& error) {
+    Logger& logger = Logger::getInstance();
+    auto start = std::chrono::steady_clock::now();
+    if (!replay(error)) {
+        closeFile(lock_fd_);
+        lock_fd_ = -1;
+        return false;
+    }
+
+    // Start from a fresh checkpoint, so the next recovery does not replay this one's log again
+    if (!writeCheckpoint(snapshotLocked(), error)) {
+        closeFile(lock_fd_);
+        lock_fd_ = -1;
+        return false;
+    }
+    stats_.segment = segment_seq_;
+
+    recovered.clear();
+    recovered.reserve(live_.size());
+    for (const auto& item : live_) {
+        recovered.push_back(item.second);
+    }
+    std::sort(recovered.begin(), recovered.end(), [](const QueueItem& a, const QueueItem& b) {
+        return a.id < b.id;
+    });
+
+    open_ = true;
+    owner_ = true;
+    stopping_ = false;
+    failed_ = false;
+    flusher_ = std::thread(&QueueJournal::flusherLoop, this);
+
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    logger.info("Queue journal " + config_.directory + " recovered " + std::to_string(recovered.size()) +
+                " item(s) in " + std::to_string(elapsed) + " ms");
+    return true;
+}
+
+bool QueueJournal::replay(std::string& error) {
+    Logger& logger = Logger::getInstance();
+
+    std::vector<uint64_t> checkpoints;
+    std::vector<uint64_t> segments;
+    std::error_code ec;
+    for (fs::directory_iterator it(config_.directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        uint64_t seq = 0;
+        if (parseSequence(name, "checkpoint-", ".chk", seq)) {
+            checkpoints.push_back(seq);
+        } else if (parseSequence(name, "segment-", ".wal", seq)) {
+            segments.push_back(seq);
+        } else if (name.size() > 5 && name[0] == '.' && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            // A checkpoint interrupted before its rename
+            fs::remove(it->path(), ec);
+        }
+    }
+    if (ec) {
+        error = "Cannot read spool directory " + config_.directory + ": " + ec.message();
+        return false;
+    }
+    std::sort(checkpoints.rbegin(), checkpoints.rend());
+    std::sort(segments.begin(), segments.end());
+
+    // The newest checkpoint that is complete; replay continues with the segment it names
+    QueueReplayState state;
+    uint64_t first_segment = 0;
+    for (uint64_t seq : checkpoints) {
+        std::string file_path = path(sequenceName("checkpoint-", seq, ".chk"));
+        MappedFile file;
+        std::string open_error;
+        QueueReplayState candidate;
+        if (file.open(file_path, open_error) && file.size() >= QUEUE_MAGIC_LENGTH &&
+            std::memcmp(file.data(), QUEUE_CHECKPOINT_MAGIC, QUEUE_MAGIC_LENGTH) == 0) {
+            replayQueueRecords(file.data(), file.size(), candidate);
+        }
+        if (candidate.complete()) {
+            state = std::move(candidate);
+            first_segment = seq;
+            break;
+        }
+        logger.warning("Queue journal: ignoring incomplete checkpoint " + file_path);
+    }
+
+    segment_seq_ = first_segment;
+    for (uint64_t seq : segments) {
+        if (seq < first_segment) {
+            continue;
+        }
+        segment_seq_ = std::max(segment_seq_, seq);
+        std::string file_path = path(sequenceName("segment-", seq, ".wal"));
+        MappedFile file;
+        std::string open_error;
+        if (!file.open(file_path, open_error)) {
+            logger.error("Queue journal: cannot read " + file_path + ": " + open_error);
+            continue;
+        }
+        if (file.size() < QUEUE_MAGIC_LENGTH || std::memcmp(file.data(), QUEUE_SEGMENT_MAGIC, QUEUE_MAGIC_LENGTH) != 0) {
+            continue;   // Created but never written
+        }
+        size_t intact = replayQueueRecords(file.data(), file.size(), state);
+        if (QUEUE_MAGIC_LENGTH + intact < file.size()) {
+            // Normal after a crash in the last segment: the commit in flight was torn
+            logger.warning("Queue journal: " + file_path + " ends in " +
+                           std::to_string(file.size() - QUEUE_MAGIC_LENGTH - intact) +
+                           " byte(s) of incomplete records, ignored");
+        }
+    }
+
+    live_.clear();
+    messages_.clear();
+    next_message_id_ = 1;
+    for (auto& item : state.items) {
+        if (item.second.prepared) {
+            MessageRef& ref = messages_[item.second.prepared.get()];
+            if (ref.refs++ == 0) {
+                ref.id = next_message_id_++;
+            }
+        }
+        live_.emplace(item.first, std::move(item.second));
+    }
+    return true;
+}
+
+void QueueJournal::close() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!open_) {
+            return;
+        }
+        open_ = false;
+        if (owner_) {
+            // A final checkpoint makes the next start-up read no log at all
+            checkpoint_requested_ = true;
+            stopping_ = true;
+            flush_cv_.notify_one();
+        }
+    }
+
+    if (flusher_.joinable()) {
+        flusher_.join();
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (segment_fd_ >= 0) {
+        closeFile(segment_fd_);
+        segment_fd_ = -1;
+    }
+    if (lock_fd_ >= 0) {
+        closeFile(lock_fd_);
+        lock_fd_ = -1;
+    }
+    owner_ = false;
+    live_.clear();
+    messages_.clear();
+}
+
+bool QueueJournal::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_;
+}
+
+bool QueueJournal::isOwner() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return open_ && owner_;
+}
+
+void QueueJournal::appendEnqueueLocked(std::string& out, const QueueItem& item) {
+    uint64_t message_id = 0;
+    if (item.prepared) {
+        MessageRef& ref = messages_[item.prepared.get()];
+        if (ref.refs++ == 0) {
+            // First item of this content: log the content itself once
+            ref.id = next_message_id_++;
+            encodeQueueMessage(out, ref.id, *item.prepared);
+        }
+        message_id = ref.id;
+    }
+    encodeQueueItem(out, item, message_id);
+}
+
+void QueueJournal::releaseMessageLocked(const QueueItem& item) {
+    if (!item.prepared) {
+        return;
+    }
+    auto it = messages_.find(item.prepared.get());
+    if (it != messages_.end() && --it->second.refs == 0) {
+        messages_.erase(it);
+    }
+}
+
+uint64_t QueueJournal::appendLocked(const std::string& records, size_t count) {
+    pending_.append(records);
+    appended_lsn_ += records.size();
+    stats_.records += count;
+    stats_.bytes += records.size();
+    flush_cv_.notify_one();
+    return appended_lsn_;
+}
+
+bool QueueJournal::waitDurable(uint64_t lsn) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    durable_cv_.wait(lock, [this, lsn]() { return durable_lsn_ >= lsn || failed_; });
+    return durable_lsn_ >= lsn;
+}
+
+bool QueueJournal::recordEnqueue(const QueueItem& item) {
+    uint64_t lsn = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_ || !owner_ || failed_) {
+            return false;
+        }
+        std::string records;
+        appendEnqueueLocked(records, item);
+        auto it = live_.find(item.id);
+        if (it != live_.end()) {
+            releaseMessageLocked(it->second);
+            it->second = item;
+        } else {
+            live_.emplace(item.id, item);
+        }
+        lsn = appendLocked(records, 1);
+    }
+
+    if (config_.sync == JournalSync::ASYNC) {
+        return true;
+    }
+    return waitDurable(lsn);
+}
+
+void QueueJournal::recordRetry(const QueueItem& item) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_ || !owner_ || failed_) {
+        return;
+    }
+    auto it = live_.find(item.id);
+    if (it == live_.end()) {
+        return;
+    }
+    it->second.status = item.status;
+    it->second.last_attempt = item.last_attempt;
+    it->second.retry_delay = item.retry_delay;
+    it->second.retry_count = item.retry_count;
+    it->second.error_message = item.error_message;
+
+    std::string records;
+    encodeQueueRetry(records, item);
+    appendLocked(records, 1);
+}
+
+void QueueJournal::recordDone(const QueueItem& item) {
+    // Not waited for: if it is lost, the item is sent again after a crash (at-least-once)
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_ || !owner_ || failed_) {
+        return;
+    }
+    auto it = live_.find(item.id);
+    if (it == live_.end()) {
+        return;
+    }
+    releaseMessageLocked(it->second);
+    live_.erase(it);
+
+    std::string records;
+    encodeQueueDone(records, item);
+    appendLocked(records, 1);
+}
+
+bool QueueJournal::checkpoint(std::string& error) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!open_ || !owner_) {
+        error = "Queue journal is not open";
+        return false;
+    }
+    size_t before = stats_.checkpoints;
+    checkpoint_requested_ = true;
+    flush_cv_.notify_one();
+    durable_cv_.wait(lock, [this, before]() { return stats_.checkpoints != before || failed_; });
+    if (stats_.checkpoints == before) {
+        error = last_error_;
+        return false;
+    }
+    return true;
+}
+
+void QueueJournal::flusherLoop() {
+    Logger& logger = Logger::getInstance();
+    std::string batch;
+    std::string snapshot;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        flush_cv_.wait(lock, [this]() { return stopping_ || !pending_.empty() || checkpoint_requested_; });
+        if (config_.commit_delay.count() > 0 && !stopping_ && !checkpoint_requested_) {
+            // Let more records join this commit and share its fsync
+            flush_cv_.wait_for(lock, config_.commit_delay,
+                               [this]() { return stopping_ || checkpoint_requested_; });
+        }
+
+        batch.clear();
+        batch.swap(pending_);
+        uint64_t lsn = appended_lsn_;
+        bytes_since_checkpoint_ += batch.size();
+
+        // The snapshot matches the log up to this batch: later records go to the next segment
+        bool checkpoint_due = checkpoint_requested_ || bytes_since_checkpoint_ >= config_.checkpoint_bytes;
+        if (checkpoint_due) {
+            snapshot = snapshotLocked();
+            checkpoint_requested_ = false;
+            bytes_since_checkpoint_ = 0;
+        }
+        bool stop = stopping_ && pending_.empty();
+        lock.unlock();
+
+        std::string error;
+        bool ok = batch.empty() || commit(batch, error);
+        if (ok && checkpoint_due) {
+            ok = writeCheckpoint(snapshot, error);
+        } else if (ok && segment_size_ >= config_.segment_bytes) {
+            ok = openSegment(segment_seq_ + 1, error);
+        }
+
+        lock.lock();
+        if (ok) {
+            durable_lsn_ = lsn;
+            if (!batch.empty()) {
+                stats_.commits++;
+            }
+            if (checkpoint_due) {
+                stats_.checkpoints++;
+            }
+            stats_.segment = segment_seq_;
+        } else {
+            // Later records cannot follow a hole in the log; refuse further mail instead
+            failed_ = true;
+            last_error_ = error;
+            logger.error("Queue journal failed, mail is no longer persisted: " + error);
+        }
+        durable_cv_.notify_all();
+        if (stop || failed_) {
+            break;
+        }
+    }
+}
+
+bool QueueJournal::commit(const std::string& batch, std::string& error) {
+    std::string file_path = path(sequenceName("segment-", segment_seq_, ".wal"));
+    if (!writeFully(segment_fd_, batch.data(), batch.size())) {
+        error = systemError("Cannot write", file_path);
+        return false;
+    }
+    if (config_.sync != JournalSync::NONE && !syncFileData(segment_fd_)) {
+        error = systemError("Cannot sync", file_path);
+        return false;
+    }
+    segment_size_ += batch.size();
+    return true;
+}
+
+std::string QueueJournal::snapshotLocked() {
+    std::string snapshot(QUEUE_CHECKPOINT_MAGIC, QUEUE_MAGIC_LENGTH);
+    for (const auto& message : messages_) {
+        encodeQueueMessage(snapshot, message.second.id, *message.first);
+    }
+    for (const auto& item : live_) {
+        uint64_t message_id = item.second.prepared ? messages_[item.second.prepared.get()].id : 0;
+        encodeQueueItem(snapshot, item.second, message_id);
+    }
+    encodeQueueEnd(snapshot, live_.size());
+    return snapshot;
+}
+
+bool QueueJournal::writeCheckpoint(const std::string& snapshot, std::string& error) {
+    // Named after the segment replay resumes with; records after the snapshot go there
+    if (!openSegment(segment_seq_ + 1, error) ||
+        !writeFileDurably(config_.directory, sequenceName("checkpoint-", segment_seq_, ".chk"),
+                          snapshot, true, error)) {
+        return false;
+    }
+
+    // Everything before the new segment is covered by the checkpoint
+    std::error_code ec;
+    for (fs::directory_iterator it(config_.directory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        uint64_t seq = 0;
+        if ((parseSequence(name, "segment-", ".wal", seq) || parseSequence(name, "checkpoint-", ".chk", seq)) &&
+            seq < segment_seq_) {
+            fs::remove(it->path(), ec);
+        }
+    }
+    return true;
+}
+
+bool QueueJournal::openSegment(uint64_t seq, std::string& error) {
+    if (segment_fd_ >= 0) {
+        if (config_.sync != JournalSync::NONE) {
+            syncFileData(segment_fd_);
+        }
+        closeFile(segment_fd_);
+        segment_fd_ = -1;
+    }
+
+    std::string file_path = path(sequenceName("segment-", seq, ".wal"));
+    segment_fd_ = createFile(file_path);
+    if (segment_fd_ < 0) {
+        error = systemError("Cannot create", file_path);
+        return false;
+    }
+    if (!writeFully(segment_fd_, QUEUE_SEGMENT_MAGIC, QUEUE_MAGIC_LENGTH) ||
+        (config_.sync != JournalSync::NONE && (!syncFileData(segment_fd_) || !syncDirectory(config_.directory)))) {
+        error = systemError("Cannot initialise", file_path);
+        return false;
+    }
+    segment_seq_ = seq;
+    segment_size_ = QUEUE_MAGIC_LENGTH;
+    return true;
+}
+
+bool QueueJournal::submit(const QueueItem& item, std::string& error) {
+    std::string content(QUEUE_CHECKPOINT_MAGIC, QUEUE_MAGIC_LENGTH);
+    if (item.prepared) {
+        encodeQueueMessage(content, 1, *item.prepared);
+    }
+    encodeQueueItem(content, item, item.prepared ? 1 : 0);
+    encodeQueueEnd(content, 1);
+    return writeFileDurably(path("incoming"), item.id + ".msg", content, true, error);
+}
+
+size_t QueueJournal::collectIncoming(std::vector<QueueItem>& items) {
+    if (!isOwner()) {
+        return 0;
+    }
+    Logger& logger = Logger::getInstance();
+
+    std::vector<fs::path> files;
+    std::error_code ec;
+    for (fs::directory_iterator it(path("incoming"), ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() > 4 && name[0] != '.' && name.compare(name.size() - 4, 4, ".msg") == 0) {
+            files.push_back(it->path());
+        }
+    }
+    // Names are item IDs, so this is submission order
+    std::sort(files.begin(), files.end());
+
+    size_t taken = 0;
+    for (const auto& file_path : files) {
+        MappedFile file;
+        std::string open_error;
+        QueueReplayState state;
+        if (file.open(file_path.string(), open_error) && file.size() >= QUEUE_MAGIC_LENGTH &&
+            std::memcmp(file.data(), QUEUE_CHECKPOINT_MAGIC, QUEUE_MAGIC_LENGTH) == 0) {
+            replayQueueRecords(file.data(), file.size(), state);
+        }
+        file.close();
+        if (!state.complete()) {
+            logger.warning("Queue journal: ignoring unreadable submission " + file_path.string());
+            fs::rename(file_path, file_path.string() + ".bad", ec);
+            continue;
+        }
+        for (auto& item : state.items) {
+            items.push_back(std::move(item.second));
+            taken++;
+        }
+    }
+    return taken;
+}
+
+void QueueJournal::acceptIncoming(const std::string& id) {
+    std::error_code ec;
+    fs::remove(path("incoming/" + id + ".msg"), ec);
+}
+
+QueueJournalStats QueueJournal::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    QueueJournalStats stats = stats_;
+    stats.live_items = live_.size();
+    return stats;
+}
+
+std::string QueueJournal::getLastError() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_error_;
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "ssmtp-mailer/queue_types.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief When journal records reach the disk
+ */
+enum class JournalSync {
+    NONE,       // Enqueue waits for write() but not fsync: survives a process crash, not a power failure
+    ASYNC,      // Enqueue does not wait; a crash loses mail queued in the last commit
+    SYNC        // Enqueue returns once its record is on disk
+};
+
+/**
+ * @brief Queue journal configuration
+ */
+struct QueueJournalConfig {
+    std::string directory;                  // Spool directory, created if missing
+    JournalSync sync;
+    std::chrono::microseconds commit_delay; // Time a commit waits for more records to share its fsync
+    size_t segment_bytes;                   // Start a new segment file beyond this size
+    size_t checkpoint_bytes;                // Log volume between checkpoints
+    bool submit_only;                       // Never take the spool on open(); only hand mail to its owner
+
+    QueueJournalConfig()
+        : sync(JournalSync::SYNC), commit_delay(0),
+          segment_bytes(16 * 1024 * 1024), checkpoint_bytes(64 * 1024 * 1024), submit_only(false) {}
+};
+
+/**
+ * @brief Queue journal statistics
+ */
+struct QueueJournalStats {
+    size_t records;         // Records appended since open()
+    size_t commits;         // Batches written (one fsync each unless sync is NONE)
+    size_t bytes;           // Bytes appended since open()
+    size_t checkpoints;     // Checkpoints written since open()
+    size_t live_items;      // Items a recovery would restore now
+    uint64_t segment;       // Sequence number of the segment being written
+
+    QueueJournalStats()
+        : records(0), commits(0), bytes(0), checkpoints(0), live_items(0), segment(0) {}
+};
+
+/**
+ * @brief Write-ahead log that makes an EmailQueue survive restarts
+ *
+ * The spool directory holds append-only segment files of CRC-checked
+ * records: an item entering the queue, a failed attempt scheduled for
+ * retry, and an item leaving the queue (sent or failed for good). Shared
+ * PreparedMessage content is logged once, not once per recipient.
+ *
+ * Records are appended to a memory buffer and written by a flusher
+ * thread, one write() and one fsync for everything that arrived since the
+ * previous commit (group commit), so the fsync cost is shared between
+ * concurrent senders. JournalSync and commit_delay trade latency against
+ * durability.
+ *
+ * Every checkpoint_bytes of log, and on open and close, the live items are
+ * written to a checkpoint file and the segments it covers are deleted, so
+ * recovery reads one checkpoint plus a bounded tail of log. A record torn
+ * by a crash fails its CRC and ends the replay of its segment.
+ *
+ * One process owns a spool at a time (a lock on the LOCK file). Other
+ * processes hand mail to the owner through the incoming/ directory.
+ *
+ * Items whose payload was moved to a MessageSpool (QueueItem::spooled)
+ * are logged as compact index records, so commits and checkpoints do not
+ * copy message bodies.
+ */
+class QueueJournal {
+public:
+    explicit QueueJournal(const QueueJournalConfig& config);
+    ~QueueJournal();
+
+    /**
+     * @brief Open the spool and recover the items it holds
+     *
+     * If another process owns the spool, or the config is submit_only,
+     * opens it for submission only: isOwner() is false and mail goes
+     * through submit().
+     *
+     * @param recovered Items still queued when the spool was last used
+     * @param error Error message on failure
+     * @return true if the spool could be opened
+     */
+    bool open(std::vector<QueueItem>& recovered, std::string& error);
+
+    /**
+     * @brief Take over a spool that open() left to its owner
+     *
+     * Fails while another process still holds the spool.
+     *
+     * @param recovered Items still queued when the spool was last used
+     * @param error Error message on failure
+     * @return true once this journal owns the spool
+     */
+    bool acquire(std::vector<QueueItem>& recovered, std::string& error);
+
+    /**
+     * @brief Checkpoint, stop the flusher and release the spool
+     */
+    void close();
+
+    bool isOpen() const;
+    bool isOwner() const;
+    const QueueJournalConfig& getConfig() const { return config_; }
+
+    /**
+     * @brief Log an item entering the queue
+     *
+     * Waits for the commit that writes the record unless sync is ASYNC.
+     *
+     * @param item New item
+     * @return false if the journal could not be written
+     */
+    bool recordEnqueue(const QueueItem& item);
+
+    /**
+     * @brief Log a failed attempt that will be retried
+     * @param item Item with updated retry count, delay and error
+     */
+    void recordRetry(const QueueItem& item);
+
+    /**
+     * @brief Log an item leaving the queue, sent or failed permanently
+     * @param item Finished item
+     */
+    void recordDone(const QueueItem& item);
+
+    /**
+     * @brief Write a checkpoint now and delete the segments it covers
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool checkpoint(std::string& error);
+
+    /**
+     * @brief Hand an item to the process that owns the spool
+     * @param item Item to queue
+     * @param error Error message on failure
+     * @return true once the item is safely in incoming/
+     */
+    bool submit(const QueueItem& item, std::string& error);
+
+    /**
+     * @brief Read the items other processes have submitted
+     *
+     * Submissions stay in incoming/ until acceptIncoming(), so an item is
+     * never lost between reading it and logging it.
+     *
+     * @param items Submitted items, appended
+     * @return Number of items read
+     */
+    size_t collectIncoming(std::vector<QueueItem>& items);
+
+    /**
+     * @brief Delete a submission once its item is in the queue
+     * @param id Item ID
+     */
+    void acceptIncoming(const std::string& id);
+
+    QueueJournalStats getStats() const;
+    std::string getLastError() const;
+
+private:
+    struct MessageRef {
+        uint64_t id;
+        size_t refs;
+    };
+
+    QueueJournalConfig config_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flush_cv_;      // Wakes the flusher
+    std::condition_variable durable_cv_;    // Wakes writers waiting for their commit
+    std::thread flusher_;
+    bool open_;
+    bool owner_;
+    bool stopping_;
+    bool failed_;
+    std::string last_error_;
+
+    int lock_fd_;
+    int segment_fd_;
+    uint64_t segment_seq_;
+    size_t segment_size_;
+    size_t bytes_since_checkpoint_;
+    bool checkpoint_requested_;
+
+    // Appended but not yet written; LSNs count bytes appended since open()
+    std::string pending_;
+    uint64_t appended_lsn_;
+    uint64_t durable_lsn_;
+
+    // What a checkpoint would hold (guarded by mutex_)
+    std::unordered_map<std::string, QueueItem> live_;
+    std::unordered_map<const PreparedMessage*, MessageRef> messages_;
+    uint64_t next_message_id_;
+
+    QueueJournalStats stats_;
+
+    void flusherLoop();
+
+    /**
+     * @brief Replay the spool once its lock is held (caller holds mutex_)
+     */
+    bool recoverLocked(std::vector<QueueItem>& recovered, std::string& error);
+
+    /**
+     * @brief Write a batch to the current segment and sync it (flusher thread)
+     */
+    bool commit(const std::string& batch, std::string& error);
+
+    /**
+     * @brief Serialise the live items and their content (caller holds mutex_)
+     */
+    std::string snapshotLocked();
+
+    /**
+     * @brief Start a new segment, write the snapshot as the checkpoint replay starts from, drop older files
+     */
+    bool writeCheckpoint(const std::string& snapshot, std::string& error);
+
+    bool openSegment(uint64_t seq, std::string& error);
+    bool replay(std::string& error);
+
+    /**
+     * @brief Append an item's records to a buffer, logging its content if new (caller holds mutex_)
+     */
+    void appendEnqueueLocked(std::string& out, const QueueItem& item);
+    void releaseMessageLocked(const QueueItem& item);
+    uint64_t appendLocked(const std::string& records, size_t count);
+    bool waitDurable(uint64_t lsn);
+
+    std::string path(const std::string& name) const;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,306 @@
+#include "core/queue/queue_records.hpp"
+#include "core/mime/prepared_message.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/crc32c.hpp"
+#include <chrono>
+#include <vector>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// Record: u32 payload length, u32 CRC-32C of type and payload, u8 type, payload
+const size_t RECORD_HEADER = 9;
+
+enum RecordType : uint8_t {
+    RECORD_MESSAGE = 1,     // Shared PreparedMessage content
+    RECORD_ENQUEUE = 2,     // Item entered the queue
+    RECORD_RETRY = 3,       // Attempt failed, item waits for a retry
+    RECORD_DONE = 4,        // Item left the queue
+    RECORD_END = 5          // End of a checkpoint, submission or payload file, with its item count
+};
+
+// Item record flags
+const uint8_t ITEM_SPOOLED = 0x01;     // Payload is in the spool, not in the record
+
+// ---- Encoding ----
+
+void putU8(std::string& out, uint8_t value) {
+    out.push_back(static_cast<char>(value));
+}
+
+void putU32(std::string& out, uint32_t value) {
+    char bytes[4];
+    for (int i = 0; i < 4; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 4);
+}
+
+void putU64(std::string& out, uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 8);
+}
+
+void putString(std::string& out, const std::string& value) {
+    putU32(out, static_cast<uint32_t>(value.size()));
+    out.append(value);
+}
+
+void putStrings(std::string& out, const std::vector<std::string>& values) {
+    putU32(out, static_cast<uint32_t>(values.size()));
+    for (const auto& value : values) {
+        putString(out, value);
+    }
+}
+
+void putTime(std::string& out, std::chrono::system_clock::time_point time) {
+    putU64(out, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        time.time_since_epoch()).count()));
+}
+
+size_t beginRecord(std::string& out, RecordType type) {
+    size_t start = out.size();
+    out.append(RECORD_HEADER - 1, '\0');
+    putU8(out, type);
+    return start;
+}
+
+void endRecord(std::string& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - RECORD_HEADER);
+    uint32_t crc = crc32c(out.data() + start + 8, out.size() - start - 8);
+    for (int i = 0; i < 4; ++i) {
+        out[start + i] = static_cast<char>(length >> (8 * i));
+        out[start + 4 + i] = static_cast<char>(crc >> (8 * i));
+    }
+}
+
+// ---- Decoding ----
+
+/**
+ * Bounds-checked reader over one record's payload
+ */
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p_(data), end_(data + size), ok_(true) {}
+
+    bool ok() const { return ok_; }
+
+    uint64_t getU(size_t bytes) {
+        if (!have(bytes)) {
+            return 0;
+        }
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; ++i) {
+            value |= static_cast<uint64_t>(static_cast<unsigned char>(p_[i])) << (8 * i);
+        }
+        p_ += bytes;
+        return value;
+    }
+
+    std::string getString() {
+        size_t length = static_cast<size_t>(getU(4));
+        if (!have(length)) {
+            return std::string();
+        }
+        std::string value(p_, length);
+        p_ += length;
+        return value;
+    }
+
+    std::vector<std::string> getStrings() {
+        size_t count = static_cast<size_t>(getU(4));
+        std::vector<std::string> values;
+        for (size_t i = 0; i < count && ok_; ++i) {
+            values.push_back(getString());
+        }
+        return values;
+    }
+
+    std::chrono::system_clock::time_point getTime() {
+        return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(
+            std::chrono::microseconds(static_cast<int64_t>(getU(8)))));
+    }
+
+private:
+    bool have(size_t bytes) {
+        if (!ok_ || static_cast<size_t>(end_ - p_) < bytes) {
+            ok_ = false;
+            return false;
+        }
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+    bool ok_;
+};
+
+bool applyRecord(uint8_t type, Reader& in, QueueReplayState& state) {
+    switch (type) {
+        case RECORD_MESSAGE: {
+            uint64_t id = in.getU(8);
+            std::string sender = in.getString();
+            std::string content = in.getString();
+            if (in.ok()) {
+                state.messages[id] = PreparedMessage::restore(sender, std::move(content));
+            }
+            break;
+        }
+        case RECORD_ENQUEUE: {
+            QueueItem item;
+            item.id = in.getString();
+            item.domain = in.getString();
+            item.user = in.getString();
+            item.from_address = in.getString();
+            item.to_addresses = in.getStrings();
+            item.subject = in.getString();
+            item.body = in.getString();
+            item.html_body = in.getString();
+            item.attachments = in.getStrings();
+            item.inline_attachments = in.getStrings();
+            uint64_t message_id = in.getU(8);
+            item.priority = static_cast<EmailPriority>(in.getU(1));
+            item.status = static_cast<EmailStatus>(in.getU(1));
+            item.created_at = in.getTime();
+            item.scheduled_for = in.getTime();
+            item.last_attempt = in.getTime();
+            item.retry_delay = std::chrono::seconds(static_cast<long long>(in.getU(8)));
+            item.retry_count = static_cast<int>(in.getU(4));
+            item.max_retries = static_cast<int>(in.getU(4));
+            item.error_message = in.getString();
+            item.spooled = (in.getU(1) & ITEM_SPOOLED) != 0;
+            if (!in.ok()) {
+                break;
+            }
+            if (message_id != 0) {
+                auto message = state.messages.find(message_id);
+                if (message == state.messages.end()) {
+                    Logger::getInstance().warning("Queue journal: item " + item.id +
+                                                  " refers to missing content, dropped");
+                    break;
+                }
+                item.prepared = message->second;
+            }
+            state.items[item.id] = std::move(item);
+            break;
+        }
+        case RECORD_RETRY: {
+            std::string id = in.getString();
+            EmailStatus status = static_cast<EmailStatus>(in.getU(1));
+            auto last_attempt = in.getTime();
+            auto retry_delay = std::chrono::seconds(static_cast<long long>(in.getU(8)));
+            int retry_count = static_cast<int>(in.getU(4));
+            std::string error = in.getString();
+            auto it = state.items.find(id);
+            if (in.ok() && it != state.items.end()) {
+                it->second.status = status;
+                it->second.last_attempt = last_attempt;
+                it->second.retry_delay = retry_delay;
+                it->second.retry_count = retry_count;
+                it->second.error_message = error;
+            }
+            break;
+        }
+        case RECORD_DONE: {
+            std::string id = in.getString();
+            if (in.ok()) {
+                state.items.erase(id);
+            }
+            break;
+        }
+        case RECORD_END:
+            state.end_count = static_cast<size_t>(in.getU(8));
+            state.ended = in.ok();
+            break;
+        default:
+            // A newer record type this version does not know; skipping it is safe
+            break;
+    }
+    return in.ok();
+}
+
+} // anonymous namespace
+
+void encodeQueueMessage(std::string& out, uint64_t id, const PreparedMessage& message) {
+    size_t start = beginRecord(out, RECORD_MESSAGE);
+    putU64(out, id);
+    putString(out, message.getSender());
+    putString(out, message.getContent());
+    endRecord(out, start);
+}
+
+void encodeQueueItem(std::string& out, const QueueItem& item, uint64_t message_id) {
+    size_t start = beginRecord(out, RECORD_ENQUEUE);
+    putString(out, item.id);
+    putString(out, item.domain);
+    putString(out, item.user);
+    putString(out, item.from_address);
+    putStrings(out, item.to_addresses);
+    putString(out, item.subject);
+    putString(out, item.body);
+    putString(out, item.html_body);
+    putStrings(out, item.attachments);
+    putStrings(out, item.inline_attachments);
+    putU64(out, message_id);
+    putU8(out, static_cast<uint8_t>(item.priority));
+    putU8(out, static_cast<uint8_t>(item.status));
+    putTime(out, item.created_at);
+    putTime(out, item.scheduled_for);
+    putTime(out, item.last_attempt);
+    putU64(out, static_cast<uint64_t>(item.retry_delay.count()));
+    putU32(out, static_cast<uint32_t>(item.retry_count));
+    putU32(out, static_cast<uint32_t>(item.max_retries));
+    putString(out, item.error_message);
+    putU8(out, item.spooled ? ITEM_SPOOLED : 0);
+    endRecord(out, start);
+}
+
+void encodeQueueRetry(std::string& out, const QueueItem& item) {
+    size_t start = beginRecord(out, RECORD_RETRY);
+    putString(out, item.id);
+    putU8(out, static_cast<uint8_t>(item.status));
+    putTime(out, item.last_attempt);
+    putU64(out, static_cast<uint64_t>(item.retry_delay.count()));
+    putU32(out, static_cast<uint32_t>(item.retry_count));
+    putString(out, item.error_message);
+    endRecord(out, start);
+}
+
+void encodeQueueDone(std::string& out, const QueueItem& item) {
+    size_t start = beginRecord(out, RECORD_DONE);
+    putString(out, item.id);
+    putU8(out, static_cast<uint8_t>(item.status));
+    endRecord(out, start);
+}
+
+void encodeQueueEnd(std::string& out, size_t count) {
+    size_t start = beginRecord(out, RECORD_END);
+    putU64(out, count);
+    endRecord(out, start);
+}
+
+size_t replayQueueRecords(const char* data, size_t size, QueueReplayState& state) {
+    size_t offset = QUEUE_MAGIC_LENGTH;
+    while (size - offset >= RECORD_HEADER) {
+        Reader header(data + offset, RECORD_HEADER);
+        size_t length = static_cast<size_t>(header.getU(4));
+        uint32_t crc = static_cast<uint32_t>(header.getU(4));
+        if (length > size - offset - RECORD_HEADER ||
+            crc32c(data + offset + 8, length + 1) != crc) {
+            break;
+        }
+        uint8_t type = static_cast<uint8_t>(data[offset + 8]);
+        Reader payload(data + offset + RECORD_HEADER, length);
+        if (!applyRecord(type, payload, state)) {
+            break;
+        }
+        offset += RECORD_HEADER + length;
+    }
+    return offset - QUEUE_MAGIC_LENGTH;
+}
+
+} // namespace ssmtp_mailer
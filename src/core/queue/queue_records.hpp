@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include "ssmtp-mailer/queue_types.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * Queue record files: an 8-byte magic followed by records of
+ *
+ *   u32 payload length, u32 CRC-32C of type and payload, u8 type, payload
+ *
+ * all little-endian. The same records make up journal segments,
+ * checkpoints, submissions from other processes and spooled payloads;
+ * only the magic tells them apart.
+ */
+const size_t QUEUE_MAGIC_LENGTH = 8;
+const char QUEUE_SEGMENT_MAGIC[] = "SSMQWAL1";       // Journal segment
+const char QUEUE_CHECKPOINT_MAGIC[] = "SSMQCHK1";    // Checkpoint or submission, closed by an end record
+const char QUEUE_PAYLOAD_MAGIC[] = "SSMQMSG1";       // Spooled item with its payload, closed by an end record
+
+/**
+ * @brief Append a record holding shared PreparedMessage content
+ * @param out Buffer to append to
+ * @param id Number the item records refer to the content by
+ * @param message Content
+ */
+void encodeQueueMessage(std::string& out, uint64_t id, const PreparedMessage& message);
+
+/**
+ * @brief Append a record of an item entering the queue
+ * @param out Buffer to append to
+ * @param item Item, with whatever payload it carries
+ * @param message_id Number of its PreparedMessage record, 0 if it has none
+ */
+void encodeQueueItem(std::string& out, const QueueItem& item, uint64_t message_id);
+
+/**
+ * @brief Append a record of a failed attempt (status, last attempt, retry count and delay, error)
+ */
+void encodeQueueRetry(std::string& out, const QueueItem& item);
+
+/**
+ * @brief Append a record of an item leaving the queue
+ */
+void encodeQueueDone(std::string& out, const QueueItem& item);
+
+/**
+ * @brief Append the record closing a checkpoint, submission or payload file
+ * @param out Buffer to append to
+ * @param count Number of items in the file
+ */
+void encodeQueueEnd(std::string& out, size_t count);
+
+/**
+ * @brief Queue contents rebuilt from records
+ */
+struct QueueReplayState {
+    std::map<std::string, QueueItem> items;     // By ID, which sorts by creation time
+    std::unordered_map<uint64_t, std::shared_ptr<const PreparedMessage>> messages;
+    bool ended;                                 // An end record was seen
+    size_t end_count;                           // Item count it gave
+
+    QueueReplayState() : ended(false), end_count(0) {}
+
+    /**
+     * @brief Whether a file closed by an end record was read in full
+     */
+    bool complete() const { return ended && end_count == items.size(); }
+};
+
+/**
+ * @brief Apply the records of a file
+ *
+ * Stops at the first record that is cut short or fails its CRC.
+ *
+ * @param data File contents, starting with the magic
+ * @param size File size
+ * @param state State to update
+ * @return Bytes of intact records after the magic; less than the file if the tail is torn
+ */
+size_t replayQueueRecords(const char* data, size_t size, QueueReplayState& state);
+
+} // namespace ssmtp_mailer
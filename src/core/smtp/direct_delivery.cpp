@@ -0,0 +1,394 @@
+#include "core/smtp/direct_delivery.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/mime/prepared_message.hpp"
+#include "core/dkim/dkim_signer.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/email.hpp"
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+SMTPEventLoopConfig makeLoopConfig(const DirectDeliveryConfig& delivery_config) {
+    SMTPEventLoopConfig loop_config;
+    loop_config.worker_threads = std::max<size_t>(1, delivery_config.event_loop_threads);
+    loop_config.resolver = delivery_config.resolver;
+    return loop_config;
+}
+
+/**
+ * @brief Get the DKIM signer of the sender's domain, like SMTPClient does for relayed mail
+ */
+bool getSigner(const ConfigManager& config, const std::string& from,
+               std::shared_ptr<const DKIMSigner>& signer, std::string& error) {
+    signer.reset();
+    const DomainConfig* domain_config = config.getDomainConfig(extractDomain(from));
+    if (!domain_config) {
+        return true;
+    }
+    return DKIMSignerCache::getInstance().get(*domain_config, signer, error);
+}
+
+} // anonymous namespace
+
+/**
+ * @brief One send() call: its transactions and the caller waiting for them
+ */
+struct DirectDelivery::Delivery {
+    std::vector<DomainGroup> groups;
+    Composer compose;
+    std::vector<SMTPResult> results;
+    size_t finished;
+
+    std::mutex mutex;
+    std::condition_variable finished_cv;
+
+    Delivery() : finished(0) {}
+};
+
+/**
+ * @brief One SMTP transaction of a delivery, tried against the domain's exchangers in turn
+ */
+struct DirectDelivery::Transaction {
+    std::shared_ptr<Delivery> delivery;
+    size_t index;
+    std::vector<MXRecord> exchangers;
+    size_t next_exchanger;
+    SMTPResult last_result;
+
+    const DomainGroup& group() const { return delivery->groups[index]; }
+};
+
+DirectDelivery::DirectDelivery(const ConfigManager& config, const DirectDeliveryConfig& delivery_config)
+    : config_(config), delivery_config_(delivery_config),
+      resolver_(delivery_config.resolver ? *delivery_config.resolver : DNSResolver::getInstance()),
+      loop_(config, makeLoopConfig(delivery_config)) {
+    if (delivery_config_.max_parallel_transactions == 0) {
+        delivery_config_.max_parallel_transactions = 1;
+    }
+    if (delivery_config_.max_connections_per_domain == 0) {
+        delivery_config_.max_connections_per_domain = 1;
+    }
+    if (delivery_config_.max_recipients_per_transaction == 0) {
+        delivery_config_.max_recipients_per_transaction = 100;
+    }
+    if (delivery_config_.max_mx_attempts == 0) {
+        delivery_config_.max_mx_attempts = 1;
+    }
+    if (!loop_.start()) {
+        Logger::getInstance().error("Direct delivery unavailable: " + loop_.getLastError());
+    }
+}
+
+DirectDelivery::~DirectDelivery() {
+    loop_.stop();
+}
+
+SMTPResult DirectDelivery::send(const Email& email) {
+    Logger& logger = Logger::getInstance();
+
+    std::vector<std::string> invalid;
+    std::vector<DomainGroup> groups = groupByDomain(email.getAllRecipients(), invalid);
+
+    // Large groups are split so no transaction exceeds the recipient limit
+    std::vector<DomainGroup> transactions;
+    for (const auto& group : groups) {
+        size_t limit = delivery_config_.max_recipients_per_transaction;
+        for (size_t start = 0; start < group.recipients.size(); start += limit) {
+            DomainGroup part;
+            part.domain = group.domain;
+            size_t end = std::min(group.recipients.size(), start + limit);
+            part.recipients.assign(group.recipients.begin() + start, group.recipients.begin() + end);
+            transactions.push_back(std::move(part));
+        }
+    }
+
+    std::vector<RecipientStatus> statuses;
+    for (const auto& address : invalid) {
+        statuses.emplace_back(address, false, 0, "No destination domain");
+    }
+    if (transactions.empty()) {
+        SMTPResult result = SMTPResult::createError("No deliverable recipients");
+        result.recipients = std::move(statuses);
+        return result;
+    }
+
+    std::string message_id = email.generateMessageId();
+
+    // Every transaction sends the same bytes, so the message is signed once
+    std::string signature;
+    std::shared_ptr<const DKIMSigner> signer;
+    std::string error;
+    if (!getSigner(config_, email.from, signer, error)) {
+        return SMTPResult::createError(error);
+    }
+    if (signer) {
+        MimeMessageStream message(email, message_id);
+        DKIMMessageHasher hasher;
+        ConstBuffer piece;
+        bool transient = false;
+        while (message.next(piece, transient)) {
+            hasher.update(piece.data, piece.size);
+        }
+        if (!message.good()) {
+            return SMTPResult::createError(message.getLastError());
+        }
+        std::string headers;
+        std::string body_hash = hasher.finish(headers);
+        if (!signer->sign(headers, body_hash, signature, error)) {
+            return SMTPResult::createError(error);
+        }
+    }
+
+    std::vector<SMTPResult> results = deliver(transactions,
+        [&email, &message_id, &signature](const DomainGroup& group, SMTPOutgoingMessage& message,
+                                          std::string&) {
+            message.sender = email.from;
+            message.recipients = group.recipients;
+            message.message_id = message_id;
+            message.signature = signature;
+            message.content.reset(new MimeMessageStream(email, message_id));
+            return true;
+        });
+
+    // Merge per-transaction outcomes into one result for the message
+    size_t accepted = 0;
+    std::string first_error;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const SMTPResult& result = results[i];
+        if (!result.success && first_error.empty()) {
+            first_error = transactions[i].domain + ": " + result.error_message;
+        }
+
+        for (const auto& address : transactions[i].recipients) {
+            auto status = std::find_if(result.recipients.begin(), result.recipients.end(),
+                                       [&address](const RecipientStatus& s) { return s.address == address; });
+            if (status != result.recipients.end() && (result.success || !status->accepted)) {
+                statuses.push_back(*status);
+            } else {
+                // Never reached RCPT, or accepted in a transaction that then failed
+                statuses.emplace_back(address, false, result.error_code, result.error_message);
+            }
+            if (statuses.back().accepted) {
+                accepted++;
+            }
+        }
+    }
+
+    SMTPResult result = accepted > 0 ? SMTPResult::createSuccess(message_id)
+                                     : SMTPResult::createError(first_error);
+    result.recipients = std::move(statuses);
+
+    logger.info("Direct delivery of " + message_id + ": " + std::to_string(accepted) + " of " +
+                std::to_string(result.recipients.size()) + " recipients accepted across " +
+                std::to_string(groups.size()) + " domain(s)");
+    return result;
+}
+
+SMTPResult DirectDelivery::send(const PreparedMessage& message, const std::string& recipient) {
+    DomainGroup group;
+    group.domain = extractDomain(recipient);
+    if (group.domain.empty()) {
+        SMTPResult result = SMTPResult::createError("No deliverable recipients");
+        result.recipients.emplace_back(recipient, false, 0, "No destination domain");
+        return result;
+    }
+    std::transform(group.domain.begin(), group.domain.end(), group.domain.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    group.recipients.push_back(recipient);
+
+    std::shared_ptr<const DKIMSigner> signer;
+    std::string error;
+    if (!getSigner(config_, message.getSender(), signer, error)) {
+        return SMTPResult::createError(error);
+    }
+
+    std::vector<SMTPResult> results = deliver(std::vector<DomainGroup>(1, group),
+        [this, &message, &recipient, &signer](const DomainGroup&, SMTPOutgoingMessage& outgoing,
+                                              std::string& compose_error) {
+            std::string id = message.generateMessageId();
+            std::unique_ptr<PreparedMessageStream> stream(new PreparedMessageStream(message, recipient, id));
+            if (signer && !signer->sign(stream->getRecipientHeaders() + message.getHeaders(),
+                                        message.getBodyHash(), outgoing.signature, compose_error)) {
+                return false;
+            }
+            outgoing.sender = message.getSender();
+            outgoing.recipients.assign(1, recipient);
+            outgoing.message_id = id;
+            outgoing.content = std::move(stream);
+            return true;
+        });
+    return results.front();
+}
+
+std::vector<DomainGroup> DirectDelivery::groupByDomain(const std::vector<std::string>& recipients,
+                                                       std::vector<std::string>& invalid) {
+    std::vector<DomainGroup> groups;
+    std::unordered_map<std::string, size_t> index;
+
+    std::vector<EmailAddressParts> parts;
+    parseEmailAddresses(recipients, parts);
+
+    for (size_t i = 0; i < recipients.size(); ++i) {
+        const std::string& address = recipients[i];
+        if (parts[i].domain.empty()) {
+            invalid.push_back(address);
+            continue;
+        }
+        std::string domain(parts[i].domain);
+        std::transform(domain.begin(), domain.end(), domain.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        auto it = index.find(domain);
+        if (it == index.end()) {
+            it = index.emplace(domain, groups.size()).first;
+            DomainGroup group;
+            group.domain = domain;
+            groups.push_back(std::move(group));
+        }
+        groups[it->second].recipients.push_back(address);
+    }
+
+    return groups;
+}
+
+std::vector<SMTPResult> DirectDelivery::deliver(const std::vector<DomainGroup>& groups, const Composer& compose) {
+    auto delivery = std::make_shared<Delivery>();
+    delivery->groups = groups;
+    delivery->compose = compose;
+    delivery->results.resize(groups.size());
+
+    // The caller releases transactions as earlier ones finish; completions never block
+    std::unique_lock<std::mutex> lock(delivery->mutex);
+    size_t released = 0;
+    while (delivery->finished < groups.size()) {
+        while (released < groups.size() &&
+               released - delivery->finished < delivery_config_.max_parallel_transactions) {
+            auto transaction = std::make_shared<Transaction>();
+            transaction->delivery = delivery;
+            transaction->index = released++;
+            transaction->next_exchanger = 0;
+            lock.unlock();
+            enqueue(transaction);
+            lock.lock();
+        }
+        // Transactions can finish inline (cached DNS failures), so wait on the state, not for a change
+        size_t limit = delivery_config_.max_parallel_transactions;
+        delivery->finished_cv.wait(lock, [&delivery, &groups, released, limit]() {
+            return delivery->finished == groups.size() ||
+                   (released < groups.size() && released - delivery->finished < limit);
+        });
+    }
+    return delivery->results;
+}
+
+void DirectDelivery::enqueue(const std::shared_ptr<Transaction>& transaction) {
+    std::vector<std::shared_ptr<Transaction>> startable;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        DomainQueue& queue = domains_[transaction->group().domain];
+        queue.waiting.push_back(transaction);
+        takeStartable(queue, startable);
+    }
+    for (const auto& next : startable) {
+        start(next);
+    }
+}
+
+void DirectDelivery::takeStartable(DomainQueue& queue, std::vector<std::shared_ptr<Transaction>>& startable) {
+    while (queue.active < delivery_config_.max_connections_per_domain && !queue.waiting.empty()) {
+        queue.active++;
+        startable.push_back(std::move(queue.waiting.front()));
+        queue.waiting.pop_front();
+    }
+}
+
+void DirectDelivery::start(const std::shared_ptr<Transaction>& transaction) {
+    resolver_.resolveMX(transaction->group().domain, [this, transaction](const DNSMXResult& mx) {
+        if (!mx.success()) {
+            finish(transaction, SMTPResult::createError(mx.error));
+            return;
+        }
+        size_t attempts = std::min(mx.records.size(), delivery_config_.max_mx_attempts);
+        transaction->exchangers.assign(mx.records.begin(), mx.records.begin() + attempts);
+        transaction->last_result =
+            SMTPResult::createError("No mail exchanger reachable for " + transaction->group().domain);
+        attempt(transaction);
+    });
+}
+
+void DirectDelivery::attempt(const std::shared_ptr<Transaction>& transaction) {
+    if (transaction->next_exchanger >= transaction->exchangers.size()) {
+        finish(transaction, transaction->last_result);
+        return;
+    }
+
+    const DomainGroup& group = transaction->group();
+    DomainConfig relay;
+    relay.name = group.domain;
+    relay.smtp_server = transaction->exchangers[transaction->next_exchanger++].exchange;
+    relay.smtp_port = delivery_config_.port;
+    relay.auth_method = "NONE";
+    relay.use_ssl = false;
+    relay.use_starttls = true;
+    relay.require_starttls = delivery_config_.require_tls;
+    relay.ssl_verify_peer = delivery_config_.require_tls;
+
+    SMTPOutgoingMessage message;
+    std::string error;
+    if (!transaction->delivery->compose(group, message, error)) {
+        finish(transaction, SMTPResult::createError(error));
+        return;
+    }
+    if (!loop_.submit(relay, message, [this, transaction](const SMTPResult& result) {
+            onAttempt(transaction, result);
+        })) {
+        finish(transaction, SMTPResult::createError(loop_.getLastError()));
+    }
+}
+
+void DirectDelivery::onAttempt(const std::shared_ptr<Transaction>& transaction, const SMTPResult& result) {
+    // Once the server has answered for recipients its verdict stands;
+    // only failures before that fall through to the next exchanger
+    if (result.success || !result.recipients.empty()) {
+        finish(transaction, result);
+        return;
+    }
+    const MXRecord& exchanger = transaction->exchangers[transaction->next_exchanger - 1];
+    Logger::getInstance().warning("MX " + exchanger.exchange + " for " + transaction->group().domain +
+                                  " failed: " + result.error_message);
+    transaction->last_result = result;
+    attempt(transaction);
+}
+
+void DirectDelivery::finish(const std::shared_ptr<Transaction>& transaction, const SMTPResult& result) {
+    std::vector<std::shared_ptr<Transaction>> startable;
+    {
+        std::lock_guard<std::mutex> lock(slots_mutex_);
+        auto it = domains_.find(transaction->group().domain);
+        if (it != domains_.end()) {
+            it->second.active--;
+            takeStartable(it->second, startable);
+            if (it->second.active == 0 && it->second.waiting.empty()) {
+                domains_.erase(it);
+            }
+        }
+    }
+
+    Delivery& delivery = *transaction->delivery;
+    {
+        std::lock_guard<std::mutex> lock(delivery.mutex);
+        delivery.results[transaction->index] = result;
+        delivery.finished++;
+    }
+    delivery.finished_cv.notify_all();
+
+    for (const auto& next : startable) {
+        start(next);
+    }
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include "core/config/config_manager.hpp"
+#include "core/dns/dns_resolver.hpp"
+#include "core/smtp/smtp_event_loop.hpp"
+#include "simple-smtp-mailer/mailer.hpp"
+
+namespace ssmtp_mailer {
+
+class PreparedMessage;
+
+/**
+ * @brief Direct delivery configuration
+ */
+struct DirectDeliveryConfig {
+    size_t max_parallel_transactions;       // Transactions in flight per send() call
+    size_t max_connections_per_domain;      // Across all concurrent send() calls
+    size_t max_recipients_per_transaction;  // RFC 5321 requires servers to accept 100
+    size_t max_mx_attempts;                 // Exchangers tried per transaction
+    size_t event_loop_threads;              // Threads multiplexing the SMTP sessions of all callers
+    int port;
+    bool require_tls;                       // false = opportunistic, unverified STARTTLS
+    DNSResolver* resolver;                  // nullptr = DNSResolver::getInstance()
+
+    DirectDeliveryConfig()
+        : max_parallel_transactions(8), max_connections_per_domain(2),
+          max_recipients_per_transaction(100), max_mx_attempts(3), event_loop_threads(1), port(25),
+          require_tls(false), resolver(nullptr) {}
+};
+
+/**
+ * @brief Recipients of one message that share a destination domain
+ */
+struct DomainGroup {
+    std::string domain;
+    std::vector<std::string> recipients;
+};
+
+/**
+ * @brief Delivers mail straight to each recipient domain's MX hosts
+ *
+ * Recipients are grouped by destination domain, and each group (split at
+ * max_recipients_per_transaction) becomes one SMTP transaction against
+ * the domain's exchangers in preference order. Transactions run as
+ * non-blocking sessions on an SMTPEventLoop shared by all callers, so
+ * fanning out to many domains costs no threads; the MX lookup, the move
+ * to the next exchanger and the start of a transaction waiting for its
+ * domain all happen in completion callbacks. A per-domain limit keeps
+ * the number of connections to any one destination bounded across all
+ * callers. All transactions of a message share its Message-ID and DKIM
+ * signature.
+ */
+class DirectDelivery {
+public:
+    /**
+     * @brief Constructor
+     * @param config Configuration manager instance
+     * @param delivery_config Parallelism, limits and TLS policy
+     */
+    explicit DirectDelivery(const ConfigManager& config,
+                            const DirectDeliveryConfig& delivery_config = DirectDeliveryConfig());
+
+    /**
+     * @brief Destructor, stops the event loop
+     */
+    ~DirectDelivery();
+
+    DirectDelivery(const DirectDelivery&) = delete;
+    DirectDelivery& operator=(const DirectDelivery&) = delete;
+
+    /**
+     * @brief Deliver an email to all of its recipients
+     *
+     * Succeeds if at least one recipient was accepted; per-recipient
+     * outcomes, including whole domains that failed, are in
+     * SMTPResult::recipients.
+     *
+     * @param email Email object to send
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const Email& email);
+
+    /**
+     * @brief Deliver one recipient's copy of a prepared message
+     * @param message Prepared message
+     * @param recipient Recipient address
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const PreparedMessage& message, const std::string& recipient);
+
+    /**
+     * @brief Group recipient addresses by destination domain
+     *
+     * Domains are compared case-insensitively; groups keep the order in
+     * which their domain first appears. Addresses without a valid domain
+     * are returned in invalid.
+     *
+     * @param recipients Recipient addresses
+     * @param invalid Addresses that have no destination domain
+     * @return Domain groups
+     */
+    static std::vector<DomainGroup> groupByDomain(const std::vector<std::string>& recipients,
+                                                  std::vector<std::string>& invalid);
+
+private:
+    /**
+     * @brief Builds the envelope and content of one transaction
+     */
+    using Composer = std::function<bool(const DomainGroup& group, SMTPOutgoingMessage& message,
+                                        std::string& error)>;
+
+    struct Delivery;
+    struct Transaction;
+
+    struct DomainQueue {
+        size_t active;
+        std::deque<std::shared_ptr<Transaction>> waiting;
+
+        DomainQueue() : active(0) {}
+    };
+
+    /**
+     * @brief Run the transactions of one send() call and wait for all of them
+     */
+    std::vector<SMTPResult> deliver(const std::vector<DomainGroup>& groups, const Composer& compose);
+
+    /**
+     * @brief Start a transaction, or queue it behind its domain's limit
+     */
+    void enqueue(const std::shared_ptr<Transaction>& transaction);
+
+    /**
+     * @brief Look up the exchangers of a transaction's domain
+     */
+    void start(const std::shared_ptr<Transaction>& transaction);
+
+    /**
+     * @brief Hand a transaction to the event loop for its next exchanger
+     */
+    void attempt(const std::shared_ptr<Transaction>& transaction);
+
+    void onAttempt(const std::shared_ptr<Transaction>& transaction, const SMTPResult& result);
+
+    /**
+     * @brief Record a transaction's result and give its domain slot to the next in line
+     */
+    void finish(const std::shared_ptr<Transaction>& transaction, const SMTPResult& result);
+
+    /**
+     * @brief Take the waiting transactions the domain limit lets start (caller holds slots_mutex_)
+     */
+    void takeStartable(DomainQueue& queue, std::vector<std::shared_ptr<Transaction>>& startable);
+
+    const ConfigManager& config_;
+    DirectDeliveryConfig delivery_config_;
+    DNSResolver& resolver_;
+    SMTPEventLoop loop_;
+
+    std::mutex slots_mutex_;
+    std::unordered_map<std::string, DomainQueue> domains_;
+};
+
+} // namespace ssmtp_mailer
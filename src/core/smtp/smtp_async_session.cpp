@@ -0,0 +1,859 @@
+#include "core/smtp/smtp_async_session.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/dkim/dkim_signer.hpp"
+#include "core/smtp/tls_context_cache.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/base64.hpp"
+#include "utils/socket_util.hpp"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const size_t MAX_REPLY_LINE_LENGTH = 64 * 1024;
+const size_t READ_BUFFER_SIZE = 16 * 1024;
+const size_t MESSAGE_CHUNK_SIZE = 64 * 1024;
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+std::string toUpper(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return value;
+}
+
+std::string opensslError() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown error";
+    }
+    char buffer[256];
+    ERR_error_string_n(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+} // anonymous namespace
+
+SMTPAsyncSession::SMTPAsyncSession(const DomainConfig& domain_config, const Email& email,
+                                   const std::string& ehlo_hostname,
+                                   const SMTPSessionTimeouts& timeouts,
+                                   CompletionCallback callback)
+    : config_(domain_config), email_(email), ehlo_hostname_(ehlo_hostname), timeouts_(timeouts),
+      callback_(std::move(callback)), phase_(Phase::CONNECTING), after_handshake_(Phase::GREETING),
+      fd_(-1), ssl_(nullptr), want_write_(false), peer_closed_(false),
+      in_offset_(0), out_offset_(0), reply_code_(-1), next_address_(0), message_(nullptr),
+      encoder_(true), pipelined_(false), envelope_replies_(0), mail_accepted_(false), accepted_(0) {
+    sender_ = email_.from;
+    recipients_ = email_.getAllRecipients();
+    message_id_ = email_.generateMessageId();
+}
+
+SMTPAsyncSession::SMTPAsyncSession(const DomainConfig& domain_config, SMTPOutgoingMessage message,
+                                   const std::string& ehlo_hostname,
+                                   const SMTPSessionTimeouts& timeouts,
+                                   CompletionCallback callback)
+    : config_(domain_config), ehlo_hostname_(ehlo_hostname), timeouts_(timeouts),
+      callback_(std::move(callback)), phase_(Phase::CONNECTING), after_handshake_(Phase::GREETING),
+      fd_(-1), ssl_(nullptr), want_write_(false), peer_closed_(false),
+      in_offset_(0), out_offset_(0), reply_code_(-1), next_address_(0),
+      sender_(std::move(message.sender)), signature_(std::move(message.signature)),
+      content_(std::move(message.content)), message_(nullptr), encoder_(true),
+      message_id_(std::move(message.message_id)), recipients_(std::move(message.recipients)),
+      pipelined_(false), envelope_replies_(0), mail_accepted_(false), accepted_(0) {
+}
+
+SMTPAsyncSession::~SMTPAsyncSession() {
+    closeConnection();
+}
+
+bool SMTPAsyncSession::start(const std::vector<IPAddress>& addresses) {
+    addresses_ = addresses;
+    next_address_ = 0;
+    if (addresses_.empty()) {
+        fail("No addresses for SMTP server " + config_.smtp_server);
+        return false;
+    }
+    return connectNext();
+}
+
+bool SMTPAsyncSession::connectNext() {
+    while (next_address_ < addresses_.size()) {
+        const IPAddress& address = addresses_[next_address_++];
+
+        // Open the new socket before closing the old one so the descriptor
+        // number changes and the owner notices it must re-register
+        int fd = openSocket(address.family, SOCK_STREAM, true);
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        fd_ = fd;
+        if (fd_ < 0) {
+            connect_error_ = "Failed to create socket: " + std::string(strerror(errno));
+            continue;
+        }
+
+        struct sockaddr_storage storage;
+        socklen_t length = address.toSockaddr(config_.smtp_port, storage);
+        if (::connect(fd_, reinterpret_cast<const struct sockaddr*>(&storage), length) < 0 &&
+            errno != EINPROGRESS) {
+            connect_error_ = address.toString() + ": " + strerror(errno);
+            continue;
+        }
+
+        // Completion (or failure) of the connect is reported as writability
+        phase_ = Phase::CONNECTING;
+        setDeadline(timeouts_.connect);
+        return true;
+    }
+
+    fail("Failed to connect to SMTP server: " + config_.smtp_server + ":" +
+         std::to_string(config_.smtp_port) + ": " + connect_error_);
+    return false;
+}
+
+uint32_t SMTPAsyncSession::getWantedEvents() const {
+    if (phase_ == Phase::CONNECTING) {
+        return POLLOUT;
+    }
+    uint32_t events = POLLIN;
+    if (want_write_ || out_offset_ < out_.size() || phase_ == Phase::BODY) {
+        events |= POLLOUT;
+    }
+    return events;
+}
+
+void SMTPAsyncSession::onEvent(uint32_t events) {
+    if (phase_ == Phase::FINISHED) {
+        return;
+    }
+
+    if (phase_ == Phase::CONNECTING) {
+        if (!(events & (POLLOUT | POLLERR | POLLHUP))) {
+            return;
+        }
+        int socket_error = 0;
+        socklen_t length = sizeof(socket_error);
+        if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &socket_error, &length) < 0) {
+            socket_error = errno;
+        }
+        if (socket_error != 0) {
+            // Fall back to the next address of the relay, if any
+            connect_error_ = addresses_[next_address_ - 1].toString() + ": " + strerror(socket_error);
+            connectNext();
+            return;
+        }
+
+        // Implicit TLS (port 465) wraps the whole session, including the greeting
+        if (config_.use_ssl) {
+            if (!beginTLS(Phase::GREETING)) {
+                return;
+            }
+        } else {
+            phase_ = Phase::GREETING;
+            setDeadline(timeouts_.command);
+        }
+    }
+
+    pump();
+}
+
+void SMTPAsyncSession::onTimeout() {
+    if (phase_ == Phase::FINISHED) {
+        return;
+    }
+    if (phase_ == Phase::CONNECTING && next_address_ < addresses_.size()) {
+        connect_error_ = addresses_[next_address_ - 1].toString() + ": connect timed out";
+        connectNext();
+        return;
+    }
+    // In the QUIT phase this keeps the successful result
+    fail("Timed out waiting for SMTP server " + config_.smtp_server);
+}
+
+void SMTPAsyncSession::abort(const std::string& reason) {
+    if (phase_ != Phase::FINISHED) {
+        fail(reason);
+    }
+}
+
+void SMTPAsyncSession::complete() {
+    if (callback_) {
+        callback_(result_);
+    }
+}
+
+void SMTPAsyncSession::pump() {
+    while (phase_ != Phase::FINISHED) {
+        if (phase_ == Phase::TLS_HANDSHAKE) {
+            if (continueHandshake() != IOStatus::PROGRESS) {
+                return;
+            }
+            continue;
+        }
+
+        if (phase_ == Phase::BODY && out_offset_ == out_.size()) {
+            produceBody();
+            if (phase_ == Phase::FINISHED) {
+                return;
+            }
+        }
+
+        bool progressed = false;
+
+        if (out_offset_ < out_.size() || want_write_) {
+            IOStatus status = flushOutput();
+            if (status == IOStatus::FAILED || status == IOStatus::CLOSED) {
+                fail("Failed to write to SMTP server " + config_.smtp_server);
+                return;
+            }
+            progressed = status == IOStatus::PROGRESS;
+        }
+
+        IOStatus status = readInput();
+        if (status == IOStatus::FAILED) {
+            return;
+        }
+        if (status == IOStatus::PROGRESS) {
+            progressed = true;
+            if (!processInput()) {
+                return;
+            }
+        }
+
+        if (peer_closed_ || status == IOStatus::CLOSED) {
+            if (phase_ == Phase::QUIT) {
+                finish();
+            } else if (phase_ != Phase::FINISHED) {
+                fail("Connection closed by SMTP server " + config_.smtp_server);
+            }
+            return;
+        }
+
+        if (!progressed) {
+            return;
+        }
+    }
+}
+
+SMTPAsyncSession::IOStatus SMTPAsyncSession::flushOutput() {
+    bool wrote = false;
+    want_write_ = false;
+
+    while (out_offset_ < out_.size()) {
+        size_t remaining = out_.size() - out_offset_;
+        ssize_t written;
+
+        if (ssl_) {
+            int result = SSL_write(ssl_, out_.data() + out_offset_,
+                                   static_cast<int>(std::min(remaining, static_cast<size_t>(INT_MAX))));
+            if (result <= 0) {
+                int error = SSL_get_error(ssl_, result);
+                if (error == SSL_ERROR_WANT_WRITE) {
+                    want_write_ = true;
+                    break;
+                }
+                if (error == SSL_ERROR_WANT_READ) {
+                    break;
+                }
+                return IOStatus::FAILED;
+            }
+            written = result;
+        } else {
+            written = ::send(fd_, out_.data() + out_offset_, remaining, SEND_FLAGS);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    want_write_ = true;
+                    break;
+                }
+                return IOStatus::FAILED;
+            }
+        }
+
+        out_offset_ += static_cast<size_t>(written);
+        wrote = true;
+    }
+
+    if (out_offset_ == out_.size()) {
+        out_.clear();
+        out_offset_ = 0;
+    }
+    if (wrote && phase_ == Phase::BODY) {
+        setDeadline(timeouts_.write);
+    }
+    return wrote ? IOStatus::PROGRESS : IOStatus::WOULD_BLOCK;
+}
+
+SMTPAsyncSession::IOStatus SMTPAsyncSession::readInput() {
+    char buffer[READ_BUFFER_SIZE];
+    bool received = false;
+
+    while (!peer_closed_) {
+        ssize_t length;
+
+        if (ssl_) {
+            int result = SSL_read(ssl_, buffer, sizeof(buffer));
+            if (result <= 0) {
+                int error = SSL_get_error(ssl_, result);
+                if (error == SSL_ERROR_WANT_READ) {
+                    break;
+                }
+                if (error == SSL_ERROR_WANT_WRITE) {
+                    want_write_ = true;
+                    break;
+                }
+                if (error == SSL_ERROR_ZERO_RETURN || (error == SSL_ERROR_SYSCALL && result == 0)) {
+                    peer_closed_ = true;
+                    break;
+                }
+                fail("TLS read from " + config_.smtp_server + " failed: " + opensslError());
+                return IOStatus::FAILED;
+            }
+            length = result;
+        } else {
+            length = recv(fd_, buffer, sizeof(buffer), 0);
+            if (length == 0) {
+                peer_closed_ = true;
+                break;
+            }
+            if (length < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
+                fail("Read from " + config_.smtp_server + " failed: " + strerror(errno));
+                return IOStatus::FAILED;
+            }
+        }
+
+        in_.append(buffer, static_cast<size_t>(length));
+        received = true;
+
+        if (in_.size() - in_offset_ > MAX_REPLY_LINE_LENGTH &&
+            in_.find('\n', in_offset_) == std::string::npos) {
+            fail("SMTP reply line too long");
+            return IOStatus::FAILED;
+        }
+    }
+
+    if (received) {
+        return IOStatus::PROGRESS;
+    }
+    return peer_closed_ ? IOStatus::CLOSED : IOStatus::WOULD_BLOCK;
+}
+
+bool SMTPAsyncSession::beginTLS(Phase after_handshake) {
+    std::string error;
+    ssl_ = TLSContextCache::getInstance().createConnection(
+        TLSProfile(config_.ssl_ca_file, config_.ssl_cert_file, config_.ssl_key_file,
+                   config_.ssl_verify_peer),
+        config_.smtp_server, config_.smtp_port, error);
+    if (!ssl_) {
+        fail(error);
+        return false;
+    }
+    if (SSL_set_fd(ssl_, fd_) != 1) {
+        fail("Failed to set SSL socket");
+        return false;
+    }
+
+    // Partial writes let SSL_write behave like send() on a non-blocking socket
+    SSL_set_mode(ssl_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    phase_ = Phase::TLS_HANDSHAKE;
+    after_handshake_ = after_handshake;
+    setDeadline(timeouts_.command);
+    return true;
+}
+
+SMTPAsyncSession::IOStatus SMTPAsyncSession::continueHandshake() {
+    int result = SSL_connect(ssl_);
+    if (result == 1) {
+        want_write_ = false;
+        TLSContextCache::getInstance().recordHandshake(ssl_);
+        Logger::getInstance().debug("TLS established with " + config_.smtp_server);
+
+        if (after_handshake_ == Phase::EHLO) {
+            // Capabilities must be re-read after the TLS upgrade (RFC 3207)
+            capabilities_.clear();
+            send("EHLO " + ehlo_hostname_);
+            phase_ = Phase::EHLO;
+        } else {
+            phase_ = after_handshake_;
+            setDeadline(timeouts_.command);
+        }
+        return IOStatus::PROGRESS;
+    }
+
+    int error = SSL_get_error(ssl_, result);
+    if (error == SSL_ERROR_WANT_READ) {
+        want_write_ = false;
+        return IOStatus::WOULD_BLOCK;
+    }
+    if (error == SSL_ERROR_WANT_WRITE) {
+        want_write_ = true;
+        return IOStatus::WOULD_BLOCK;
+    }
+
+    fail("SSL handshake with " + config_.smtp_server + " failed: " + opensslError());
+    return IOStatus::FAILED;
+}
+
+void SMTPAsyncSession::send(const std::string& command) {
+    out_ += command;
+    out_ += "\r\n";
+    setDeadline(timeouts_.command);
+}
+
+void SMTPAsyncSession::setDeadline(std::chrono::milliseconds timeout) {
+    deadline_ = std::chrono::steady_clock::now() + timeout;
+}
+
+bool SMTPAsyncSession::processInput() {
+    while (phase_ != Phase::FINISHED && phase_ != Phase::TLS_HANDSHAKE) {
+        size_t newline = in_.find('\n', in_offset_);
+        if (newline == std::string::npos) {
+            break;
+        }
+
+        size_t line_end = (newline > in_offset_ && in_[newline - 1] == '\r') ? newline - 1 : newline;
+        std::string line = in_.substr(in_offset_, line_end - in_offset_);
+        in_offset_ = newline + 1;
+
+        if (line.size() < 3 || !std::isdigit(static_cast<unsigned char>(line[0])) ||
+            !std::isdigit(static_cast<unsigned char>(line[1])) ||
+            !std::isdigit(static_cast<unsigned char>(line[2])) ||
+            (line.size() > 3 && line[3] != ' ' && line[3] != '-')) {
+            fail("Malformed SMTP reply: " + line);
+            return false;
+        }
+
+        int line_code = (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0');
+        if (reply_code_ == -1) {
+            reply_code_ = line_code;
+        } else if (line_code != reply_code_) {
+            fail("Inconsistent codes in multi-line SMTP reply: " + line);
+            return false;
+        }
+
+        if (!reply_.empty()) {
+            reply_ += "\n";
+        }
+        reply_ += line;
+
+        if (line.size() == 3 || line[3] == ' ') {
+            int code = reply_code_;
+            std::string text;
+            text.swap(reply_);
+            reply_code_ = -1;
+            handleReply(code, text);
+        }
+    }
+
+    // Drop consumed input; anything left is a partial line
+    if (in_offset_ > 0) {
+        in_.erase(0, in_offset_);
+        in_offset_ = 0;
+    }
+    return phase_ != Phase::FINISHED;
+}
+
+void SMTPAsyncSession::handleReply(int code, const std::string& text) {
+    switch (phase_) {
+        case Phase::GREETING:
+            if (code != 220) {
+                fail("SMTP server rejected connection: " + text);
+                return;
+            }
+            send("EHLO " + ehlo_hostname_);
+            phase_ = Phase::EHLO;
+            break;
+
+        case Phase::EHLO:
+            handleEhlo(code, text);
+            break;
+
+        case Phase::HELO:
+            if (code != 250) {
+                fail("EHLO rejected: " + text);
+                return;
+            }
+            capabilities_.clear();
+            afterEhlo();
+            break;
+
+        case Phase::STARTTLS:
+            if (code != 220) {
+                fail("STARTTLS rejected: " + text);
+                return;
+            }
+            // Anything buffered before the handshake would be a plaintext injection
+            if (in_offset_ < in_.size()) {
+                fail("Unexpected data received before TLS handshake");
+                return;
+            }
+            beginTLS(Phase::EHLO);
+            break;
+
+        case Phase::AUTH:
+            if (code != 235) {
+                fail("Authentication failed: " + text);
+                return;
+            }
+            startEnvelope();
+            break;
+
+        case Phase::AUTH_LOGIN_USER:
+            if (code != 334) {
+                fail("AUTH LOGIN not supported: " + text);
+                return;
+            }
+            send(base64Encode(config_.username));
+            phase_ = Phase::AUTH_LOGIN_PASSWORD;
+            break;
+
+        case Phase::AUTH_LOGIN_PASSWORD:
+            if (code != 334) {
+                fail("Username rejected: " + text);
+                return;
+            }
+            send(base64Encode(config_.password));
+            phase_ = Phase::AUTH;
+            break;
+
+        case Phase::AUTH_CRAM_MD5: {
+            if (code != 334 || text.size() < 4) {
+                fail("AUTH CRAM-MD5 not supported: " + text);
+                return;
+            }
+            std::string challenge;
+            base64Decode(text.substr(4), challenge);
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int digest_length = 0;
+            HMAC(EVP_md5(), config_.password.data(), static_cast<int>(config_.password.size()),
+                 reinterpret_cast<const unsigned char*>(challenge.data()), challenge.size(),
+                 digest, &digest_length);
+
+            static const char hex_digits[] = "0123456789abcdef";
+            std::string response = config_.username + " ";
+            for (unsigned int i = 0; i < digest_length; ++i) {
+                response.push_back(hex_digits[digest[i] >> 4]);
+                response.push_back(hex_digits[digest[i] & 0x0F]);
+            }
+            send(base64Encode(response));
+            phase_ = Phase::AUTH;
+            break;
+        }
+
+        case Phase::AUTH_XOAUTH2:
+            if (code == 334) {
+                // Server sent a JSON error challenge; an empty reply completes the exchange
+                send("");
+                phase_ = Phase::AUTH;
+                return;
+            }
+            if (code != 235) {
+                fail("XOAUTH2 authentication failed: " + text);
+                return;
+            }
+            startEnvelope();
+            break;
+
+        case Phase::ENVELOPE:
+            handleEnvelopeReply(code, text);
+            break;
+
+        case Phase::BODY:
+            fail("Unexpected reply during message transfer: " + text);
+            break;
+
+        case Phase::BODY_REPLY:
+            if (code != 250) {
+                fail("Email data rejected: " + text);
+                return;
+            }
+            succeed();
+            break;
+
+        case Phase::DATA_ABORT:
+            fail(envelope_error_);
+            break;
+
+        case Phase::QUIT:
+            finish();
+            break;
+
+        default:
+            fail("Unexpected SMTP reply: " + text);
+            break;
+    }
+}
+
+void SMTPAsyncSession::handleEhlo(int code, const std::string& text) {
+    capabilities_.clear();
+
+    if (code != 250) {
+        // Pre-ESMTP servers only understand HELO and advertise no extensions
+        if (code < 500) {
+            fail("EHLO rejected: " + text);
+            return;
+        }
+        send("HELO " + ehlo_hostname_);
+        phase_ = Phase::HELO;
+        return;
+    }
+
+    // First line is the server greeting, the rest are "KEYWORD [params]"
+    size_t start = text.find('\n');
+    while (start != std::string::npos) {
+        size_t end = text.find('\n', start + 1);
+        std::string line = text.substr(start + 1, end == std::string::npos ? std::string::npos : end - start - 1);
+        if (line.size() > 4) {
+            std::string capability = line.substr(4);
+            size_t space = capability.find(' ');
+            std::string keyword = toUpper(capability.substr(0, space));
+            capabilities_.push_back(space == std::string::npos ? keyword : keyword + capability.substr(space));
+        }
+        start = end;
+    }
+
+    afterEhlo();
+}
+
+void SMTPAsyncSession::afterEhlo() {
+    if (!config_.use_ssl && config_.use_starttls && !ssl_ &&
+        (config_.require_starttls || hasCapability("STARTTLS"))) {
+        if (!hasCapability("STARTTLS")) {
+            fail("Server " + config_.smtp_server + " does not offer STARTTLS");
+            return;
+        }
+        send("STARTTLS");
+        phase_ = Phase::STARTTLS;
+        return;
+    }
+    startAuth();
+}
+
+void SMTPAsyncSession::startAuth() {
+    std::string method = toUpper(config_.auth_method);
+    if (config_.username.empty() || method.empty() || method == "NONE") {
+        startEnvelope();
+        return;
+    }
+
+    if (method == "PLAIN") {
+        // authzid NUL authcid NUL passwd
+        std::string auth_string;
+        auth_string.push_back('\0');
+        auth_string += config_.username;
+        auth_string.push_back('\0');
+        auth_string += config_.password;
+        send("AUTH PLAIN " + base64Encode(auth_string));
+        phase_ = Phase::AUTH;
+    } else if (method == "LOGIN") {
+        send("AUTH LOGIN");
+        phase_ = Phase::AUTH_LOGIN_USER;
+    } else if (method == "CRAM-MD5" || method == "CRAM_MD5") {
+        send("AUTH CRAM-MD5");
+        phase_ = Phase::AUTH_CRAM_MD5;
+    } else if (method == "OAUTH2" || method == "XOAUTH2") {
+        std::string auth_string = "user=" + config_.username + "\x01" +
+                                  "auth=Bearer " + config_.oauth2_token + "\x01\x01";
+        send("AUTH XOAUTH2 " + base64Encode(auth_string));
+        phase_ = Phase::AUTH_XOAUTH2;
+    } else {
+        startEnvelope();
+    }
+}
+
+void SMTPAsyncSession::startEnvelope() {
+    if (!content_) {
+        content_.reset(new MimeMessageStream(email_, message_id_));
+    }
+    if (!content_->good()) {
+        fail(content_->getLastError());
+        return;
+    }
+    message_ = content_.get();
+    if (!signature_.empty()) {
+        signed_.reset(new SignedMessageStream(signature_, *content_));
+        message_ = signed_.get();
+    }
+
+    if (recipients_.empty()) {
+        fail("No recipient addresses specified");
+        return;
+    }
+    statuses_.reserve(recipients_.size());
+
+    send("MAIL FROM:<" + sender_ + ">");
+
+    // With PIPELINING the whole envelope goes out at once (RFC 2920); the
+    // write buffer drains as the socket allows, so there is no window limit
+    pipelined_ = hasCapability("PIPELINING");
+    if (pipelined_) {
+        for (const auto& recipient : recipients_) {
+            send("RCPT TO:<" + recipient + ">");
+        }
+        send("DATA");
+    }
+    phase_ = Phase::ENVELOPE;
+}
+
+void SMTPAsyncSession::handleEnvelopeReply(int code, const std::string& text) {
+    size_t index = envelope_replies_++;
+    size_t recipient_count = recipients_.size();
+
+    if (index == 0) {
+        mail_accepted_ = code == 250;
+        if (!mail_accepted_) {
+            envelope_error_ = "MAIL FROM rejected: " + text;
+            if (!pipelined_) {
+                fail(envelope_error_);
+                return;
+            }
+        }
+    } else if (index <= recipient_count) {
+        const std::string& recipient = recipients_[index - 1];
+        bool accepted = code == 250 || code == 251;
+        statuses_.emplace_back(recipient, accepted, code, text);
+        if (accepted) {
+            accepted_++;
+        } else {
+            Logger::getInstance().warning("RCPT TO <" + recipient + "> rejected: " + text);
+            if (envelope_error_.empty()) {
+                envelope_error_ = "All recipients rejected: " + text;
+            }
+        }
+    } else {
+        bool deliverable = mail_accepted_ && accepted_ > 0;
+        if (code == 354 && deliverable) {
+            chunk_.resize(MESSAGE_CHUNK_SIZE);
+            phase_ = Phase::BODY;
+            setDeadline(timeouts_.write);
+            return;
+        }
+        if (deliverable) {
+            envelope_error_ = "DATA command rejected: " + text;
+        }
+        if (code == 354) {
+            // The server is waiting for content that has nowhere to go; end it empty
+            send(".");
+            phase_ = Phase::DATA_ABORT;
+            return;
+        }
+        fail(envelope_error_);
+        return;
+    }
+
+    if (pipelined_) {
+        return;
+    }
+
+    if (index < recipient_count) {
+        send("RCPT TO:<" + recipients_[index] + ">");
+    } else if (accepted_ == 0) {
+        fail(envelope_error_);
+    } else {
+        send("DATA");
+    }
+}
+
+void SMTPAsyncSession::produceBody() {
+    size_t length = message_->read(chunk_.data(), chunk_.size());
+    if (!message_->good()) {
+        // Closing without the terminating dot makes the server discard the message
+        fail("Failed to produce message content: " + message_->getLastError());
+        return;
+    }
+
+    out_.clear();
+    out_offset_ = 0;
+    encoder_.encode(chunk_.data(), length, out_);
+
+    if (length < chunk_.size()) {
+        encoder_.finish(out_);
+        out_ += ".\r\n";
+        releaseMessage();
+        phase_ = Phase::BODY_REPLY;
+        setDeadline(timeouts_.data);
+    }
+}
+
+bool SMTPAsyncSession::hasCapability(const std::string& keyword) const {
+    std::string wanted = toUpper(keyword);
+    for (const auto& capability : capabilities_) {
+        if (capability.compare(0, wanted.size(), wanted) == 0 &&
+            (capability.size() == wanted.size() || capability[wanted.size()] == ' ')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SMTPAsyncSession::succeed() {
+    result_ = SMTPResult::createSuccess(message_id_);
+    result_.recipients = std::move(statuses_);
+    Logger::getInstance().info("Email sent successfully via " + config_.smtp_server);
+
+    send("QUIT");
+    phase_ = Phase::QUIT;
+}
+
+void SMTPAsyncSession::fail(const std::string& error) {
+    if (phase_ == Phase::QUIT) {
+        // The message was already accepted; errors while saying goodbye do not matter
+        finish();
+        return;
+    }
+    
+    result_ = SMTPResult::createError(error);
+    result_.recipients = std::move(statuses_);
+    Logger::getInstance().error(error);
+    finish();
+}
+
+void SMTPAsyncSession::finish() {
+    closeConnection();
+    phase_ = Phase::FINISHED;
+}
+
+void SMTPAsyncSession::closeConnection() {
+    if (ssl_) {
+        TLSContextCache::getInstance().releaseConnection(ssl_);
+        ssl_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    releaseMessage();
+}
+
+void SMTPAsyncSession::releaseMessage() {
+    message_ = nullptr;
+    signed_.reset();
+    content_.reset();
+}
+
+} // namespace ssmtp_mailer
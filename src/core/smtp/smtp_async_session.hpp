@@ -0,0 +1,258 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include "core/config/config_manager.hpp"
+#include "core/dns/dns_resolver.hpp"
+#include "core/smtp/smtp_data_encoder.hpp"
+#include "core/mime/message_stream.hpp"
+#include "simple-smtp-mailer/mailer.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Envelope and content of one mail transaction
+ *
+ * The content is read once, while the session sends it; whatever it
+ * refers to (an Email, a PreparedMessage) must outlive the session.
+ */
+struct SMTPOutgoingMessage {
+    std::string sender;
+    std::vector<std::string> recipients;
+    std::string message_id;
+    std::string signature;                  // DKIM-Signature header sent ahead of the content, or empty
+    std::unique_ptr<MessageStream> content;
+};
+
+/**
+ * @brief Deadlines applied to each phase of an asynchronous SMTP session
+ */
+struct SMTPSessionTimeouts {
+    std::chrono::milliseconds connect;   // TCP connect
+    std::chrono::milliseconds command;   // Each reply, including greeting and TLS handshake
+    std::chrono::milliseconds write;     // Progress while sending message content
+    std::chrono::milliseconds data;      // Final reply after the terminating dot
+
+    SMTPSessionTimeouts()
+        : connect(std::chrono::seconds(30)), command(std::chrono::seconds(60)),
+          write(std::chrono::seconds(60)), data(std::chrono::minutes(10)) {}
+};
+
+/**
+ * @brief Non-blocking SMTP session delivering one message
+ *
+ * A state machine driven by readiness events from an event loop: connect,
+ * greeting, EHLO, STARTTLS, AUTH, envelope (pipelined when offered),
+ * DATA and QUIT. The socket and the TLS connection are non-blocking, so
+ * SSL_ERROR_WANT_READ/WANT_WRITE simply change the events the session
+ * waits for. The session never blocks and never sleeps; the owner calls
+ * onEvent() when the socket is ready and onTimeout() when getDeadline()
+ * has passed.
+ */
+class SMTPAsyncSession {
+public:
+    using CompletionCallback = std::function<void(const SMTPResult&)>;
+
+    /**
+     * @brief Constructor
+     * @param domain_config Relay and credentials to use
+     * @param email Email to deliver (copied)
+     * @param ehlo_hostname Name announced in EHLO
+     * @param timeouts Per-phase deadlines
+     * @param callback Invoked by the owner once the session has finished
+     */
+    SMTPAsyncSession(const DomainConfig& domain_config, const Email& email,
+                     const std::string& ehlo_hostname, const SMTPSessionTimeouts& timeouts,
+                     CompletionCallback callback);
+
+    /**
+     * @brief Constructor for a transaction with its own envelope
+     * @param domain_config Relay and credentials to use
+     * @param message Envelope and content
+     * @param ehlo_hostname Name announced in EHLO
+     * @param timeouts Per-phase deadlines
+     * @param callback Invoked by the owner once the session has finished
+     */
+    SMTPAsyncSession(const DomainConfig& domain_config, SMTPOutgoingMessage message,
+                     const std::string& ehlo_hostname, const SMTPSessionTimeouts& timeouts,
+                     CompletionCallback callback);
+
+    /**
+     * @brief Destructor
+     */
+    ~SMTPAsyncSession();
+
+    SMTPAsyncSession(const SMTPAsyncSession&) = delete;
+    SMTPAsyncSession& operator=(const SMTPAsyncSession&) = delete;
+
+    /**
+     * @brief Start a non-blocking connect to the relay
+     *
+     * Addresses are tried in order; a refused or timed-out connect moves on
+     * to the next one, which may change getFd().
+     *
+     * @param addresses Resolved relay addresses
+     * @return true if a connect is under way, false if the session already finished
+     */
+    bool start(const std::vector<IPAddress>& addresses);
+
+    /**
+     * @brief Handle readiness reported by the event loop
+     * @param events POLLIN/POLLOUT/POLLERR/POLLHUP bits
+     */
+    void onEvent(uint32_t events);
+
+    /**
+     * @brief Handle expiry of the current phase deadline
+     */
+    void onTimeout();
+
+    /**
+     * @brief Fail the session from outside (e.g. when the loop shuts down)
+     * @param reason Error message
+     */
+    void abort(const std::string& reason);
+
+    /**
+     * @brief Get the socket descriptor
+     * @return Socket descriptor or -1 once closed
+     */
+    int getFd() const { return fd_; }
+
+    /**
+     * @brief Get the poll events the session currently waits for
+     * @return Event mask
+     */
+    uint32_t getWantedEvents() const;
+
+    /**
+     * @brief Get the deadline of the current phase
+     * @return Deadline
+     */
+    std::chrono::steady_clock::time_point getDeadline() const { return deadline_; }
+
+    /**
+     * @brief Check whether the session has finished
+     * @return true if finished, false otherwise
+     */
+    bool isFinished() const { return phase_ == Phase::FINISHED; }
+
+    /**
+     * @brief Get the delivery result (valid once finished)
+     * @return SMTP result
+     */
+    const SMTPResult& getResult() const { return result_; }
+
+    /**
+     * @brief Invoke the completion callback with the result
+     */
+    void complete();
+
+private:
+    enum class Phase {
+        CONNECTING,
+        TLS_HANDSHAKE,
+        GREETING,
+        EHLO,
+        HELO,
+        STARTTLS,
+        AUTH,
+        AUTH_LOGIN_USER,
+        AUTH_LOGIN_PASSWORD,
+        AUTH_CRAM_MD5,
+        AUTH_XOAUTH2,
+        ENVELOPE,
+        BODY,
+        BODY_REPLY,
+        DATA_ABORT,
+        QUIT,
+        FINISHED
+    };
+
+    enum class IOStatus {
+        PROGRESS,
+        WOULD_BLOCK,
+        CLOSED,
+        FAILED
+    };
+
+    DomainConfig config_;
+    Email email_;                   // Source of the content unless it was given as a stream
+    std::string ehlo_hostname_;
+    SMTPSessionTimeouts timeouts_;
+    CompletionCallback callback_;
+
+    Phase phase_;
+    Phase after_handshake_;
+    int fd_;
+    SSL* ssl_;
+    bool want_write_;
+    bool peer_closed_;
+
+    std::string in_;
+    size_t in_offset_;
+    std::string out_;
+    size_t out_offset_;
+    std::string reply_;
+    int reply_code_;
+
+    std::vector<std::string> capabilities_;
+    std::chrono::steady_clock::time_point deadline_;
+
+    std::vector<IPAddress> addresses_;
+    size_t next_address_;
+    std::string connect_error_;
+
+    // Transaction state
+    std::string sender_;
+    std::string signature_;
+    std::unique_ptr<MessageStream> content_;
+    std::unique_ptr<MessageStream> signed_;
+    MessageStream* message_;
+    SMTPDataEncoder encoder_;
+    std::vector<char> chunk_;
+    std::string message_id_;
+    std::vector<std::string> recipients_;
+    std::vector<RecipientStatus> statuses_;
+    bool pipelined_;
+    size_t envelope_replies_;
+    bool mail_accepted_;
+    size_t accepted_;
+    std::string envelope_error_;
+
+    SMTPResult result_;
+
+    // I/O
+    bool connectNext();
+    void pump();
+    IOStatus flushOutput();
+    IOStatus readInput();
+    IOStatus continueHandshake();
+    bool beginTLS(Phase after_handshake);
+    void send(const std::string& command);
+    void setDeadline(std::chrono::milliseconds timeout);
+
+    // Protocol
+    bool processInput();
+    void handleReply(int code, const std::string& text);
+    void handleEhlo(int code, const std::string& text);
+    void afterEhlo();
+    void startAuth();
+    void startEnvelope();
+    void handleEnvelopeReply(int code, const std::string& text);
+    void produceBody();
+    bool hasCapability(const std::string& capability) const;
+
+    void succeed();
+    void fail(const std::string& error);
+    void closeConnection();
+    void releaseMessage();
+    void finish();
+};
+
+} // namespace ssmtp_mailer
@@ -1,30 +1,130 @@
 #include "core/smtp/smtp_client.hpp"
+#include "core/smtp/smtp_data_encoder.hpp"
+#include "core/smtp/tls_context_cache.hpp"
+#include "core/dns/dns_resolver.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/mime/prepared_message.hpp"
+#include "core/dkim/dkim_signer.hpp"
 #include "simple-smtp-mailer/mailer.hpp"
 #include "core/logging/logger.hpp"
+#include "utils/base64.hpp"
+#include "utils/email.hpp"
+#include "utils/socket_util.hpp"
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
-#include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/time.h>
+#include <cerrno>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <mutex>
 #include <sstream>
 #include <regex>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
 
 namespace ssmtp_mailer {
 
-SMTPClient::SMTPClient(const ConfigManager& config) : config_(config), socket_fd_(-1), ssl_context_(nullptr), ssl_connection_(nullptr) {
-    // Initialize OpenSSL
-    SSL_library_init();
-    SSL_load_error_strings();
-    OpenSSL_add_all_algorithms();
+namespace {
+
+// Upper bound for a single reply line; RFC 5321 allows 512 octets, be generous
+const size_t MAX_REPLY_LINE_LENGTH = 64 * 1024;
+
+// Commands written per pipelined batch before reading their replies
+const size_t PIPELINE_WINDOW = 100;
+
+// Message content is read, encoded and written in pieces of this size, which
+// bounds the memory held per in-flight message; also the BDAT chunk size
+const size_t MESSAGE_CHUNK_SIZE = 256 * 1024;
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+#ifdef IOV_MAX
+const size_t MAX_IOVECS = IOV_MAX;
+#else
+const size_t MAX_IOVECS = 1024;
+#endif
+
+// Largest TLS record payload; smaller buffers are gathered up to this size
+const size_t TLS_RECORD_SIZE = 16384;
+
+// Buffers at least this large are encrypted in place rather than gathered
+const size_t TLS_COALESCE_LIMIT = 4096;
+
+std::string toUpper(std::string value) {
+    std::transform(value.begin(), value.end(), value.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+    return value;
+}
+
+bool sslWriteAll(SSL* ssl, const char* data, size_t length) {
+    size_t total_written = 0;
+    while (total_written < length) {
+        size_t written = 0;
+        if (SSL_write_ex(ssl, data + total_written, length - total_written, &written) != 1) {
+            return false;
+        }
+        total_written += written;
+    }
+    return true;
+}
+
+std::string opensslError() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown error";
+    }
+    char buffer[256];
+    ERR_error_string_n(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+} // anonymous namespace
+
+SMTPClient::SMTPClient(const ConfigManager& config)
+    : config_(config), socket_fd_(-1), ssl_connection_(nullptr),
+      state_(SMTPState::DISCONNECTED), port_(0), use_ssl_(false), ssl_verify_peer_(true),
+      authenticated_(false) {
+    // Initialize OpenSSL once per process
+    static std::once_flag openssl_init_flag;
+    std::call_once(openssl_init_flag, [] {
+        SSL_library_init();
+        SSL_load_error_strings();
+        OpenSSL_add_all_algorithms();
+    });
+    
+    const GlobalConfig& global_config = config_.getGlobalConfig();
+    connection_timeout_ = global_config.connection_timeout;
+    read_timeout_ = global_config.read_timeout;
+    write_timeout_ = global_config.write_timeout;
+    
+    ehlo_hostname_ = global_config.default_hostname;
+    if (ehlo_hostname_.empty()) {
+        char hostname[256];
+        if (gethostname(hostname, sizeof(hostname)) == 0) {
+            hostname[sizeof(hostname) - 1] = '\0';
+            ehlo_hostname_ = hostname;
+        } else {
+            ehlo_hostname_ = "localhost";
+        }
+    }
 }
 
 SMTPClient::~SMTPClient() {
     disconnect();
-    if (ssl_context_) {
-        SSL_CTX_free(ssl_context_);
-    }
 }
 
 SMTPResult SMTPClient::send(const Email& email) {
@@ -39,59 +139,247 @@ SMTPResult SMTPClient::send(const Email& email) {
             return SMTPResult::createError("No configuration found for domain: " + domain);
         }
         
-        // Use curl to send email via SMTP
-        return sendViaCurl(email, domain_config);
+        if (!openSession(*domain_config)) {
+            // The curl subprocess is only used when explicitly enabled for the domain
+            if (domain_config->use_curl_fallback) {
+                logger.warning("Native SMTP session failed (" + last_error_ + "), falling back to curl");
+                return sendViaCurl(email, domain_config);
+            }
+            return SMTPResult::createError(last_error_);
+        }
+        
+        SMTPResult result = sendEmail(email);
+        closeSession();
+        return result;
         
     } catch (const std::exception& e) {
         logger.error("SMTP send error: " + std::string(e.what()));
+        disconnect();
         return SMTPResult::createError("SMTP error: " + std::string(e.what()));
     }
 }
 
-bool SMTPClient::connect(const std::string& server, int port, bool use_ssl) {
+bool SMTPClient::openSession(const DomainConfig& domain_config) {
     Logger& logger = Logger::getInstance();
     
-    // Create socket
-    socket_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_fd_ < 0) {
-        logger.error("Failed to create socket");
+    disconnect();
+    ssl_cert_file_ = domain_config.ssl_cert_file;
+    ssl_key_file_ = domain_config.ssl_key_file;
+    ssl_ca_file_ = domain_config.ssl_ca_file;
+    ssl_verify_peer_ = domain_config.ssl_verify_peer;
+    
+    if (!connect(domain_config.smtp_server, domain_config.smtp_port, domain_config.use_ssl)) {
+        if (last_error_.empty()) {
+            last_error_ = "Failed to connect to " + domain_config.smtp_server;
+        }
         return false;
     }
     
-    // Get server address
-    struct hostent* server_info = gethostbyname(server.c_str());
-    if (!server_info) {
-        logger.error("Failed to resolve hostname: " + server);
-        close(socket_fd_);
-        socket_fd_ = -1;
+    if (!sendEHLO(ehlo_hostname_)) {
+        disconnect();
         return false;
     }
     
-    // Set up server address
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
-    memcpy(&server_addr.sin_addr, server_info->h_addr, server_info->h_length);
+    if (!domain_config.use_ssl && domain_config.use_starttls &&
+        (domain_config.require_starttls || hasCapability("STARTTLS"))) {
+        if (!hasCapability("STARTTLS")) {
+            setError("Server " + domain_config.smtp_server + " does not offer STARTTLS");
+            disconnect();
+            return false;
+        }
+        // Capabilities must be re-read after the TLS upgrade (RFC 3207)
+        if (!sendSTARTTLS() || !sendEHLO(ehlo_hostname_)) {
+            disconnect();
+            return false;
+        }
+    }
+    
+    SMTPAuthMethod auth_method = stringToAuthMethod(domain_config.auth_method);
+    if (auth_method != SMTPAuthMethod::NONE && !domain_config.username.empty()) {
+        bool authenticated;
+        if (auth_method == SMTPAuthMethod::OAUTH2 || auth_method == SMTPAuthMethod::XOAUTH2) {
+            authenticated = authenticateOAuth2(domain_config.username, domain_config.oauth2_token);
+        } else {
+            authenticated = authenticate(domain_config.username, domain_config.password, auth_method);
+        }
+        
+        if (!authenticated) {
+            if (last_error_.empty()) {
+                last_error_ = "SMTP authentication failed for " + domain_config.username;
+            }
+            closeSession();
+            return false;
+        }
+    }
     
-    // Connect to server
-    if (::connect(socket_fd_, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        logger.error("Failed to connect to SMTP server: " + server + ":" + std::to_string(port));
-        close(socket_fd_);
-        socket_fd_ = -1;
+    logger.debug("SMTP session ready on " + server_ + ":" + std::to_string(port_));
+    return true;
+}
+
+SMTPResult SMTPClient::sendEmail(const Email& email) {
+    return sendEmail(email, email.getAllRecipients(), "");
+}
+
+SMTPResult SMTPClient::sendEmail(const Email& email, const std::vector<std::string>& recipients,
+                                 const std::string& message_id) {
+    if (!isConnected()) {
+        return SMTPResult::createError("SMTP session is not open");
+    }
+    
+    // Render the message lazily; attachments are checked before the envelope is sent
+    std::string id = message_id.empty() ? email.generateMessageId() : message_id;
+    MimeMessageStream message(email, id);
+    if (!message.good()) {
+        setError(message.getLastError());
+        return SMTPResult::createError(last_error_);
+    }
+    
+    std::shared_ptr<const DKIMSigner> signer;
+    if (!getSigner(email.from, signer)) {
+        return SMTPResult::createError(last_error_);
+    }
+    
+    // On failure the state is left where the transaction stopped; reset() clears it
+    SMTPResult result;
+    if (signer) {
+        // The signature precedes the body it covers, so hash in a first pass
+        DKIMMessageHasher hasher;
+        ConstBuffer piece;
+        bool transient = false;
+        while (message.next(piece, transient)) {
+            hasher.update(piece.data, piece.size);
+        }
+        if (!message.good()) {
+            setError(message.getLastError());
+            return SMTPResult::createError(last_error_);
+        }
+        message.rewind();
+        
+        std::string headers;
+        std::string body_hash = hasher.finish(headers);
+        std::string signature;
+        std::string error;
+        if (!signer->sign(headers, body_hash, signature, error)) {
+            setError(error);
+            return SMTPResult::createError(last_error_);
+        }
+        SignedMessageStream signed_message(signature, message);
+        result = sendEmailData(email.from, recipients, signed_message, id);
+    } else {
+        result = sendEmailData(email.from, recipients, message, id);
+    }
+    if (result.success) {
+        state_ = authenticated_ ? SMTPState::AUTHENTICATED : SMTPState::CONNECTED;
+    }
+    return result;
+}
+
+SMTPResult SMTPClient::sendEmail(const PreparedMessage& message, const std::string& recipient,
+                                 const std::string& message_id) {
+    if (!isConnected()) {
+        return SMTPResult::createError("SMTP session is not open");
+    }
+    
+    std::string id = message_id.empty() ? message.generateMessageId() : message_id;
+    PreparedMessageStream stream(message, recipient, id);
+    std::vector<std::string> recipients(1, recipient);
+    
+    std::shared_ptr<const DKIMSigner> signer;
+    if (!getSigner(message.getSender(), signer)) {
+        return SMTPResult::createError(last_error_);
+    }
+    
+    SMTPResult result;
+    if (signer) {
+        // The body hash is computed once per prepared message
+        std::string signature;
+        std::string error;
+        if (!signer->sign(stream.getRecipientHeaders() + message.getHeaders(), message.getBodyHash(),
+                          signature, error)) {
+            setError(error);
+            return SMTPResult::createError(last_error_);
+        }
+        SignedMessageStream signed_message(signature, stream);
+        result = sendEmailData(message.getSender(), recipients, signed_message, id);
+    } else {
+        result = sendEmailData(message.getSender(), recipients, stream, id);
+    }
+    if (result.success) {
+        state_ = authenticated_ ? SMTPState::AUTHENTICATED : SMTPState::CONNECTED;
+    }
+    return result;
+}
+
+bool SMTPClient::reset() {
+    if (!isConnected()) {
         return false;
     }
     
-    // Read initial response
-    std::string response = readResponse();
-    if (response.empty() || response[0] != '2') {
-        logger.error("SMTP server rejected connection: " + response);
+    std::string response;
+    if (executeCommand("RSET", response) != 250) {
+        setError("RSET rejected: " + response);
+        return false;
+    }
+    
+    state_ = authenticated_ ? SMTPState::AUTHENTICATED : SMTPState::CONNECTED;
+    return true;
+}
+
+void SMTPClient::closeSession() {
+    if (isConnected()) {
+        sendQUIT();
+    }
+    disconnect();
+}
+
+bool SMTPClient::connect(const std::string& server, int port, bool use_ssl) {
+    Logger& logger = Logger::getInstance();
+    
+    last_error_.clear();
+    
+    // Resolve through the shared caching resolver (hosts file, A and AAAA)
+    DNSAddressResult resolved = DNSResolver::getInstance().lookupAddress(server);
+    if (!resolved.success()) {
+        setError("Failed to resolve hostname: " + server + " (" +
+                 DNSResolver::statusToString(resolved.status) + ")");
+        return false;
+    }
+    
+    // Try each address in turn, each connect bounded by the connection timeout
+    bool connected = false;
+    bool timed_out = false;
+    for (const auto& address : resolved.addresses) {
+        socket_fd_ = openSocket(address.family, SOCK_STREAM, false);
+        if (socket_fd_ < 0) {
+            continue;
+        }
+        
+        struct sockaddr_storage server_addr;
+        socklen_t server_addr_length = address.toSockaddr(port, server_addr);
+        if (connectWithTimeout(reinterpret_cast<struct sockaddr*>(&server_addr), server_addr_length)) {
+            connected = true;
+            break;
+        }
+        
+        timed_out = timed_out || errno == ETIMEDOUT;
+        logger.debug("Connect to " + address.toString() + ":" + std::to_string(port) + " failed");
         close(socket_fd_);
         socket_fd_ = -1;
+    }
+    
+    if (!connected) {
+        setError("Failed to connect to SMTP server: " + server + ":" + std::to_string(port) +
+                 (timed_out ? " (timed out)" : ""));
         return false;
     }
+    applySocketTimeouts();
+    
+    server_ = server;
+    port_ = port;
+    use_ssl_ = use_ssl;
+    read_buffer_.clear();
     
-    // Set up SSL if required
+    // Implicit TLS (port 465) wraps the whole session, including the greeting
     if (use_ssl) {
         if (!setupSSL()) {
             disconnect();
@@ -99,156 +387,763 @@ bool SMTPClient::connect(const std::string& server, int port, bool use_ssl) {
         }
     }
     
+    // Read initial response
+    std::string response;
+    int code = readResponse(response);
+    if (code != 220) {
+        setError("SMTP server rejected connection: " + response);
+        disconnect();
+        return false;
+    }
+    
+    state_ = SMTPState::CONNECTED;
     logger.info("Connected to SMTP server: " + server + ":" + std::to_string(port));
     return true;
 }
 
 void SMTPClient::disconnect() {
+    if (ssl_connection_) {
+        TLSContextCache::getInstance().releaseConnection(ssl_connection_);
+        ssl_connection_ = nullptr;
+    }
     if (socket_fd_ >= 0) {
-        if (ssl_connection_) {
-            SSL_free(ssl_connection_);
-            ssl_connection_ = nullptr;
-        }
         close(socket_fd_);
         socket_fd_ = -1;
     }
+    state_ = SMTPState::DISCONNECTED;
+    authenticated_ = false;
+    read_buffer_.clear();
+    capabilities_.clear();
 }
 
 bool SMTPClient::authenticate(const std::string& username, const std::string& password, SMTPAuthMethod auth_method) {
     Logger& logger = Logger::getInstance();
     
+    bool result;
     switch (auth_method) {
         case SMTPAuthMethod::LOGIN:
-            return authenticateLogin(username, password);
+            result = authenticateLogin(username, password);
+            break;
         case SMTPAuthMethod::PLAIN:
-            return authenticatePlain(username, password);
+            result = authenticatePlain(username, password);
+            break;
+        case SMTPAuthMethod::CRAM_MD5:
+            result = authenticateCramMD5(username, password);
+            break;
+        case SMTPAuthMethod::OAUTH2:
+        case SMTPAuthMethod::XOAUTH2:
+            return authenticateOAuth2(username, password);
         default:
             logger.warning("Unsupported authentication method");
             return false;
     }
+    
+    if (result) {
+        authenticated_ = true;
+        state_ = SMTPState::AUTHENTICATED;
+    }
+    return result;
+}
+
+bool SMTPClient::authenticateOAuth2(const std::string& username, const std::string& oauth2_token) {
+    Logger& logger = Logger::getInstance();
+    
+    // SASL XOAUTH2 initial client response
+    std::string auth_string = "user=" + username + "\x01" + "auth=Bearer " + oauth2_token + "\x01\x01";
+    
+    std::string response;
+    int code = executeCommand("AUTH XOAUTH2 " + base64Encode(auth_string), response);
+    if (code == 334) {
+        // Server sent a JSON error challenge; an empty reply completes the exchange
+        code = executeCommand("", response);
+    }
+    
+    if (code != 235) {
+        setError("XOAUTH2 authentication failed: " + response);
+        return false;
+    }
+    
+    authenticated_ = true;
+    state_ = SMTPState::AUTHENTICATED;
+    logger.info("SMTP XOAUTH2 authentication successful");
+    return true;
+}
+
+bool SMTPClient::isConnected() const {
+    return socket_fd_ >= 0 && state_ != SMTPState::DISCONNECTED;
+}
+
+bool SMTPClient::isAuthenticated() const {
+    return isConnected() && authenticated_;
+}
+
+SMTPState SMTPClient::getState() const {
+    return state_;
+}
+
+std::string SMTPClient::getLastError() const {
+    return last_error_;
+}
+
+bool SMTPClient::hasCapability(const std::string& keyword) const {
+    std::string wanted = toUpper(keyword);
+    for (const auto& capability : capabilities_) {
+        if (capability.compare(0, wanted.size(), wanted) == 0 &&
+            (capability.size() == wanted.size() || capability[wanted.size()] == ' ')) {
+            return true;
+        }
+    }
+    return false;
 }
 
 bool SMTPClient::testConnection() {
-    // This is a simple test - just try to connect and disconnect
-    const DomainConfig* domain_config = nullptr;
+    if (!isConnected()) {
+        return false;
+    }
     
-    // Try to find any configured domain
-    // For now, we'll just return true if we have a socket
-    return socket_fd_ >= 0;
+    std::string response;
+    return executeCommand("NOOP", response) == 250;
 }
 
 // Private helper methods
 bool SMTPClient::setupSSL() {
     Logger& logger = Logger::getInstance();
+    TLSContextCache& tls_cache = TLSContextCache::getInstance();
     
-    // Create SSL context
-    ssl_context_ = SSL_CTX_new(TLS_client_method());
-    if (!ssl_context_) {
-        logger.error("Failed to create SSL context");
-        return false;
-    }
-    
-    // Create SSL connection
-    ssl_connection_ = SSL_new(ssl_context_);
+    // Shared per-profile context; offers a cached session for this server
+    std::string error;
+    ssl_connection_ = tls_cache.createConnection(
+        TLSProfile(ssl_ca_file_, ssl_cert_file_, ssl_key_file_, ssl_verify_peer_), server_, port_, error);
     if (!ssl_connection_) {
-        logger.error("Failed to create SSL connection");
+        setError(error);
         return false;
     }
     
     // Set socket for SSL
     if (SSL_set_fd(ssl_connection_, socket_fd_) != 1) {
-        logger.error("Failed to set SSL socket");
+        setError("Failed to set SSL socket");
         return false;
     }
     
     // Perform SSL handshake
     if (SSL_connect(ssl_connection_) != 1) {
-        logger.error("SSL handshake failed");
+        setError("SSL handshake with " + server_ + " failed: " + opensslError());
         return false;
     }
     
-    logger.info("SSL connection established");
+    tls_cache.recordHandshake(ssl_connection_);
+    logger.info(SSL_session_reused(ssl_connection_) ? "SSL connection established (resumed)"
+                                                    : "SSL connection established");
     return true;
 }
 
-std::string SMTPClient::readResponse() {
-    std::string response;
-    char buffer[1024];
+bool SMTPClient::connectWithTimeout(const struct sockaddr* address, socklen_t address_length) {
+    int flags = fcntl(socket_fd_, F_GETFL, 0);
+    if (flags < 0 || fcntl(socket_fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
     
-    while (true) {
-        int bytes_read;
-        if (ssl_connection_) {
-            bytes_read = SSL_read(ssl_connection_, buffer, sizeof(buffer) - 1);
-        } else {
-            bytes_read = recv(socket_fd_, buffer, sizeof(buffer) - 1, 0);
+    if (::connect(socket_fd_, address, address_length) < 0) {
+        if (errno != EINPROGRESS) {
+            return false;
         }
         
-        if (bytes_read <= 0) {
-            break;
+        struct pollfd pfd;
+        pfd.fd = socket_fd_;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        int timeout_ms = connection_timeout_ > 0 ? connection_timeout_ * 1000 : -1;
+        
+        int ready;
+        do {
+            ready = poll(&pfd, 1, timeout_ms);
+        } while (ready < 0 && errno == EINTR);
+        if (ready == 0) {
+            errno = ETIMEDOUT;
+            return false;
         }
         
-        buffer[bytes_read] = '\0';
-        response += buffer;
+        int socket_error = 0;
+        socklen_t length = sizeof(socket_error);
+        if (ready < 0 || getsockopt(socket_fd_, SOL_SOCKET, SO_ERROR, &socket_error, &length) < 0) {
+            return false;
+        }
+        if (socket_error != 0) {
+            errno = socket_error;
+            return false;
+        }
+    }
+    
+    // The rest of the session uses blocking I/O with kernel-enforced timeouts
+    return fcntl(socket_fd_, F_SETFL, flags) == 0;
+}
+
+void SMTPClient::applySocketTimeouts() {
+    // SO_RCVTIMEO/SO_SNDTIMEO also bound the blocking TLS handshake
+    struct timeval timeout;
+    if (read_timeout_ > 0) {
+        timeout.tv_sec = read_timeout_;
+        timeout.tv_usec = 0;
+        setsockopt(socket_fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    }
+    if (write_timeout_ > 0) {
+        timeout.tv_sec = write_timeout_;
+        timeout.tv_usec = 0;
+        setsockopt(socket_fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    }
+}
+
+int SMTPClient::readData(char* buffer, size_t max_length) {
+    if (ssl_connection_) {
+        return SSL_read(ssl_connection_, buffer, static_cast<int>(max_length));
+    }
+    return static_cast<int>(recv(socket_fd_, buffer, max_length, 0));
+}
+
+int SMTPClient::writeData(const char* data, size_t length) {
+    ConstBuffer buffer(data, length);
+    return writeBuffers(&buffer, 1) ? static_cast<int>(length) : -1;
+}
+
+bool SMTPClient::writeBuffers(const ConstBuffer* buffers, size_t count) {
+    if (ssl_connection_) {
+        // A record per small buffer would cost a header, a MAC and often a packet each
+        tls_write_buffer_.resize(TLS_RECORD_SIZE);
+        size_t staged = 0;
+        
+        for (size_t i = 0; i < count; ++i) {
+            const ConstBuffer& buffer = buffers[i];
+            if (buffer.size >= TLS_COALESCE_LIMIT) {
+                if ((staged > 0 && !sslWriteAll(ssl_connection_, tls_write_buffer_.data(), staged)) ||
+                    !sslWriteAll(ssl_connection_, buffer.data, buffer.size)) {
+                    return false;
+                }
+                staged = 0;
+                continue;
+            }
+            
+            for (size_t copied = 0; copied < buffer.size; ) {
+                size_t length = std::min(buffer.size - copied, TLS_RECORD_SIZE - staged);
+                std::memcpy(tls_write_buffer_.data() + staged, buffer.data + copied, length);
+                staged += length;
+                copied += length;
+                if (staged == TLS_RECORD_SIZE) {
+                    if (!sslWriteAll(ssl_connection_, tls_write_buffer_.data(), staged)) {
+                        return false;
+                    }
+                    staged = 0;
+                }
+            }
+        }
         
-        // Check if response is complete (ends with \r\n)
-        if (response.length() >= 2 && 
-            response[response.length() - 2] == '\r' && 
-            response[response.length() - 1] == '\n') {
+        return staged == 0 || sslWriteAll(ssl_connection_, tls_write_buffer_.data(), staged);
+    }
+    
+    // sendmsg() rather than writev() so SEND_FLAGS still apply
+    struct iovec iov[MAX_IOVECS];
+    size_t index = 0;       // First buffer not yet completely written
+    size_t offset = 0;      // Bytes of buffers[index] already written
+    
+    while (index < count) {
+        size_t iov_count = 0;
+        for (size_t i = index; i < count && iov_count < MAX_IOVECS; ++i) {
+            size_t skip = i == index ? offset : 0;
+            if (buffers[i].size > skip) {
+                iov[iov_count].iov_base = const_cast<char*>(buffers[i].data + skip);
+                iov[iov_count].iov_len = buffers[i].size - skip;
+                iov_count++;
+            }
+        }
+        if (iov_count == 0) {
             break;
         }
+        
+        struct msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = iov_count;
+        
+        ssize_t written = sendmsg(socket_fd_, &message, SEND_FLAGS);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        
+        // A short write may end anywhere, including inside a buffer
+        size_t remaining = static_cast<size_t>(written);
+        while (index < count && remaining >= buffers[index].size - offset) {
+            remaining -= buffers[index].size - offset;
+            index++;
+            offset = 0;
+        }
+        offset += remaining;
     }
     
-    return response;
+    return true;
+}
+
+bool SMTPClient::readLine(std::string& line) {
+    while (true) {
+        size_t newline = read_buffer_.find('\n');
+        if (newline != std::string::npos) {
+            size_t line_end = (newline > 0 && read_buffer_[newline - 1] == '\r') ? newline - 1 : newline;
+            line.assign(read_buffer_, 0, line_end);
+            read_buffer_.erase(0, newline + 1);
+            return true;
+        }
+        
+        if (read_buffer_.size() > MAX_REPLY_LINE_LENGTH) {
+            setError("SMTP reply line too long");
+            return false;
+        }
+        
+        char buffer[4096];
+        errno = 0;
+        int bytes_read = readData(buffer, sizeof(buffer));
+        if (bytes_read <= 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                setError("Timed out waiting for reply from " + server_);
+            }
+            return false;
+        }
+        read_buffer_.append(buffer, static_cast<size_t>(bytes_read));
+    }
+}
+
+int SMTPClient::readResponse(std::string& response) {
+    response.clear();
+    int code = -1;
+    
+    // Multi-line replies use "NNN-text" for all but the last line ("NNN text")
+    while (true) {
+        std::string line;
+        if (!readLine(line)) {
+            if (last_error_.empty()) {
+                last_error_ = "Connection closed while reading SMTP reply";
+            }
+            return -1;
+        }
+        
+        if (line.size() < 3 || !std::isdigit(static_cast<unsigned char>(line[0])) ||
+            !std::isdigit(static_cast<unsigned char>(line[1])) ||
+            !std::isdigit(static_cast<unsigned char>(line[2])) ||
+            (line.size() > 3 && line[3] != ' ' && line[3] != '-')) {
+            setError("Malformed SMTP reply: " + line);
+            return -1;
+        }
+        
+        int line_code = (line[0] - '0') * 100 + (line[1] - '0') * 10 + (line[2] - '0');
+        if (code == -1) {
+            code = line_code;
+        } else if (line_code != code) {
+            setError("Inconsistent codes in multi-line SMTP reply: " + line);
+            return -1;
+        }
+        
+        if (!response.empty()) {
+            response += "\n";
+        }
+        response += line;
+        
+        if (line.size() == 3 || line[3] == ' ') {
+            return code;
+        }
+    }
+}
+
+bool SMTPClient::isResponseSuccess(int code) const {
+    return code >= 200 && code < 400;
 }
 
 bool SMTPClient::sendCommand(const std::string& command) {
-    std::string full_command = command + "\r\n";
+    ConstBuffer buffers[] = {ConstBuffer(command), ConstBuffer("\r\n", 2)};
+    return writeBuffers(buffers, 2);
+}
+
+int SMTPClient::executeCommand(const std::string& command, std::string& response) {
+    if (!sendCommand(command)) {
+        setError("Failed to send SMTP command to " + server_);
+        return -1;
+    }
+    return readResponse(response);
+}
+
+bool SMTPClient::sendEHLO(const std::string& hostname) {
+    std::string response;
+    int code = executeCommand("EHLO " + hostname, response);
     
-    int bytes_sent;
-    if (ssl_connection_) {
-        bytes_sent = SSL_write(ssl_connection_, full_command.c_str(), full_command.length());
-    } else {
-        bytes_sent = ::send(socket_fd_, full_command.c_str(), full_command.length(), 0);
+    capabilities_.clear();
+    if (code != 250) {
+        // Pre-ESMTP servers only understand HELO and advertise no extensions
+        if (code < 500 || executeCommand("HELO " + hostname, response) != 250) {
+            setError("EHLO rejected: " + response);
+            return false;
+        }
+        return true;
+    }
+    
+    // First line is the server greeting, the rest are "KEYWORD [params]"
+    std::istringstream lines(response);
+    std::string line;
+    bool first_line = true;
+    while (std::getline(lines, line)) {
+        if (first_line) {
+            first_line = false;
+            continue;
+        }
+        if (line.size() > 4) {
+            std::string capability = line.substr(4);
+            size_t space = capability.find(' ');
+            std::string keyword = toUpper(capability.substr(0, space));
+            capabilities_.push_back(space == std::string::npos ? keyword : keyword + capability.substr(space));
+        }
     }
     
-    return bytes_sent == static_cast<int>(full_command.length());
+    return true;
 }
 
-bool SMTPClient::authenticateLogin(const std::string& username, const std::string& password) {
-    Logger& logger = Logger::getInstance();
+bool SMTPClient::sendSTARTTLS() {
+    std::string response;
+    if (executeCommand("STARTTLS", response) != 220) {
+        setError("STARTTLS rejected: " + response);
+        return false;
+    }
     
-    // Send AUTH LOGIN command
-    if (!sendCommand("AUTH LOGIN")) {
+    // Anything buffered before the handshake would be a plaintext injection
+    if (!read_buffer_.empty()) {
+        setError("Unexpected data received before TLS handshake");
         return false;
     }
     
-    std::string response = readResponse();
-    if (response[0] != '3') {
-        logger.error("AUTH LOGIN not supported: " + response);
+    capabilities_.clear();
+    return setupSSL();
+}
+
+bool SMTPClient::sendMAILFROM(const std::string& from_address) {
+    std::string response;
+    if (executeCommand("MAIL FROM:<" + from_address + ">", response) != 250) {
+        setError("MAIL FROM rejected: " + response);
         return false;
     }
+    state_ = SMTPState::MAIL_FROM_SENT;
+    return true;
+}
+
+bool SMTPClient::sendRCPTTO(const std::string& to_address, RecipientStatus& status) {
+    std::string response;
+    int code = executeCommand("RCPT TO:<" + to_address + ">", response);
+    return recordRecipient(to_address, code, response, status);
+}
+
+bool SMTPClient::recordRecipient(const std::string& to_address, int code,
+                                 const std::string& response, RecipientStatus& status) {
+    bool accepted = code == 250 || code == 251;
+    status = RecipientStatus(to_address, accepted, code, response);
     
-    // Send username (base64 encoded)
-    std::string encoded_username = base64Encode(username);
-    if (!sendCommand(encoded_username)) {
+    if (accepted) {
+        state_ = SMTPState::RCPT_TO_SENT;
+    } else if (code > 0) {
+        Logger::getInstance().warning("RCPT TO <" + to_address + "> rejected: " + response);
+    }
+    return accepted;
+}
+
+bool SMTPClient::sendDATA() {
+    std::string response;
+    if (executeCommand("DATA", response) != 354) {
+        setError("DATA command rejected: " + response);
         return false;
     }
+    state_ = SMTPState::DATA_SENT;
+    return true;
+}
+
+bool SMTPClient::sendMessageData(MessageStream& message) {
+    SMTPDataEncoder encoder(true);
+    std::vector<ConstBuffer> buffers;
+    size_t pending = 0;
     
-    response = readResponse();
-    if (response[0] != '3') {
-        logger.error("Username rejected: " + response);
+    // Message pieces are encoded into views of themselves and written in
+    // place; they are copied only when TLS gathers small ones into a record
+    ConstBuffer piece;
+    bool transient = false;
+    while (message.next(piece, transient)) {
+        for (size_t offset = 0; offset < piece.size; ) {
+            size_t length = std::min(MESSAGE_CHUNK_SIZE, piece.size - offset);
+            pending += encoder.encode(piece.data + offset, length, buffers);
+            offset += length;
+            
+            // A transient piece must be written before the stream is used again
+            if (pending >= MESSAGE_CHUNK_SIZE || (transient && offset == piece.size)) {
+                if (!writeBuffers(buffers.data(), buffers.size())) {
+                    setError("Failed to send email data");
+                    return false;
+                }
+                buffers.clear();
+                pending = 0;
+            }
+        }
+    }
+    
+    if (!message.good()) {
+        // Without the terminating dot the server discards the partial message
+        setError("Failed to produce message content: " + message.getLastError());
+        disconnect();
         return false;
     }
     
-    // Send password (base64 encoded)
-    std::string encoded_password = base64Encode(password);
-    if (!sendCommand(encoded_password)) {
+    encoder.finish(buffers);
+    buffers.push_back(ConstBuffer(".\r\n", 3));
+    if (!writeBuffers(buffers.data(), buffers.size())) {
+        setError("Failed to send email data");
         return false;
     }
     
-    response = readResponse();
-    if (response[0] != '2') {
-        logger.error("Authentication failed: " + response);
+    std::string response;
+    if (readResponse(response) != 250) {
+        setError("Email data rejected: " + response);
+        return false;
+    }
+    return true;
+}
+
+bool SMTPClient::sendMessageChunked(MessageStream& message) {
+    SMTPDataEncoder encoder(false);
+    std::vector<ConstBuffer> buffers(1);    // [0] is the BDAT command, written with its chunk
+    size_t chunk_size = 0;
+    std::string command;
+    std::string response;
+    std::string error;
+    
+    // With PIPELINING the next chunk is sent before the previous one is acknowledged
+    const size_t max_outstanding = hasCapability("PIPELINING") ? 1 : 0;
+    size_t outstanding = 0;
+    
+    state_ = SMTPState::DATA_SENT;
+    
+    // BDAT carries an exact byte count, so the content needs no dot-stuffing
+    auto sendChunk = [&](bool last) -> bool {
+        command = "BDAT " + std::to_string(chunk_size) + (last ? " LAST" : "") + "\r\n";
+        buffers[0] = ConstBuffer(command);
+        if (!writeBuffers(buffers.data(), buffers.size())) {
+            setError("Failed to send BDAT chunk to " + server_);
+            return false;
+        }
+        buffers.resize(1);
+        chunk_size = 0;
+        outstanding++;
+        
+        while (outstanding > (last ? 0 : max_outstanding)) {
+            int code = readResponse(response);
+            outstanding--;
+            if (code < 0) {
+                setError("Connection lost during BDAT: " + last_error_);
+                return false;
+            }
+            if (code != 250 && error.empty()) {
+                error = (last && outstanding == 0 ? "Email data rejected: " : "BDAT chunk rejected: ") + response;
+            }
+        }
+        return true;
+    };
+    
+    ConstBuffer piece;
+    bool transient = false;
+    while (error.empty() && message.next(piece, transient)) {
+        for (size_t offset = 0; offset < piece.size && error.empty(); ) {
+            size_t length = std::min(MESSAGE_CHUNK_SIZE, piece.size - offset);
+            chunk_size += encoder.encode(piece.data + offset, length, buffers);
+            offset += length;
+            
+            // A transient piece must be sent before the stream is used again
+            if ((chunk_size >= MESSAGE_CHUNK_SIZE || (transient && offset == piece.size)) &&
+                !sendChunk(false)) {
+                return false;
+            }
+        }
+    }
+    
+    if (error.empty()) {
+        if (!message.good()) {
+            // Chunks already accepted are discarded by the RSET that follows a failure
+            error = "Failed to produce message content: " + message.getLastError();
+        } else {
+            chunk_size += encoder.finish(buffers);
+            if (!sendChunk(true)) {
+                return false;
+            }
+        }
+    }
+    
+    // Collect replies still in flight so the session stays in step
+    while (outstanding > 0) {
+        if (readResponse(response) < 0) {
+            setError("Connection lost during BDAT: " + last_error_);
+            return false;
+        }
+        outstanding--;
+    }
+    
+    if (!error.empty()) {
+        setError(error);
+        return false;
+    }
+    return true;
+}
+
+bool SMTPClient::sendEnvelope(const std::string& from_address,
+                              const std::vector<std::string>& recipients,
+                              bool send_data,
+                              std::vector<RecipientStatus>& statuses) {
+    if (!sendMAILFROM(from_address)) {
+        return false;
+    }
+    
+    size_t accepted = 0;
+    for (const auto& recipient : recipients) {
+        RecipientStatus status;
+        if (sendRCPTTO(recipient, status)) {
+            accepted++;
+        } else if (status.reply_code < 0) {
+            setError("Connection lost during RCPT TO: " + last_error_);
+            return false;
+        }
+        statuses.push_back(status);
+    }
+    
+    if (accepted == 0) {
+        setError("All recipients rejected" +
+                 (statuses.empty() ? std::string() : ": " + statuses.front().response));
+        return false;
+    }
+    
+    return !send_data || sendDATA();
+}
+
+bool SMTPClient::sendEnvelopePipelined(const std::string& from_address,
+                                       const std::vector<std::string>& recipients,
+                                       bool send_data,
+                                       std::vector<RecipientStatus>& statuses) {
+    // Commands in order: MAIL FROM, one RCPT TO per recipient, then DATA if requested
+    const size_t command_count = recipients.size() + (send_data ? 2 : 1);
+    auto commandAt = [&](size_t index) {
+        if (index == 0) {
+            return "MAIL FROM:<" + from_address + ">\r\n";
+        }
+        if (index <= recipients.size()) {
+            return "RCPT TO:<" + recipients[index - 1] + ">\r\n";
+        }
+        return std::string("DATA\r\n");
+    };
+    
+    bool mail_accepted = false;
+    size_t accepted = 0;
+    int data_code = -1;
+    std::string response;
+    std::string data_response;
+    
+    // Write a window of commands, then collect its replies in order. Bounding
+    // the window keeps the server's unread replies well inside the socket
+    // buffers so neither side blocks on a full send queue.
+    for (size_t first = 0; first < command_count; first += PIPELINE_WINDOW) {
+        size_t last = std::min(command_count, first + PIPELINE_WINDOW);
+        
+        std::string batch;
+        for (size_t i = first; i < last; ++i) {
+            batch += commandAt(i);
+        }
+        if (writeData(batch.data(), batch.size()) < 0) {
+            setError("Failed to send pipelined SMTP commands to " + server_);
+            return false;
+        }
+        
+        for (size_t i = first; i < last; ++i) {
+            int code = readResponse(response);
+            if (code < 0) {
+                setError("Connection lost while reading pipelined replies: " + last_error_);
+                return false;
+            }
+            
+            if (i == 0) {
+                mail_accepted = code == 250;
+                if (mail_accepted) {
+                    state_ = SMTPState::MAIL_FROM_SENT;
+                } else {
+                    setError("MAIL FROM rejected: " + response);
+                }
+            } else if (i <= recipients.size()) {
+                RecipientStatus status;
+                if (recordRecipient(recipients[i - 1], code, response, status)) {
+                    accepted++;
+                }
+                statuses.push_back(status);
+            } else {
+                data_code = code;
+                data_response = response;
+            }
+        }
+    }
+    
+    if (!send_data && mail_accepted && accepted > 0) {
+        return true;
+    }
+    
+    if (data_code == 354) {
+        state_ = SMTPState::DATA_SENT;
+        if (mail_accepted && accepted > 0) {
+            return true;
+        }
+        
+        // The server is waiting for content that has nowhere to go; end it empty
+        if (writeData(".\r\n", 3) < 0 || readResponse(response) < 0) {
+            setError("Failed to abort DATA with no accepted recipients");
+            return false;
+        }
+    }
+    
+    if (mail_accepted) {
+        if (accepted == 0) {
+            setError("All recipients rejected" +
+                     (statuses.empty() ? std::string() : ": " + statuses.front().response));
+        } else {
+            setError("DATA command rejected: " + data_response);
+        }
+    }
+    return false;
+}
+
+bool SMTPClient::sendQUIT() {
+    std::string response;
+    state_ = SMTPState::QUIT_SENT;
+    return executeCommand("QUIT", response) == 221;
+}
+
+void SMTPClient::setError(const std::string& message) {
+    last_error_ = message;
+    Logger::getInstance().error(message);
+}
+
+bool SMTPClient::authenticateLogin(const std::string& username, const std::string& password) {
+    Logger& logger = Logger::getInstance();
+    std::string response;
+    
+    // Send AUTH LOGIN command
+    if (executeCommand("AUTH LOGIN", response) != 334) {
+        setError("AUTH LOGIN not supported: " + response);
+        return false;
+    }
+    
+    // Send username (base64 encoded)
+    if (executeCommand(base64Encode(username), response) != 334) {
+        setError("Username rejected: " + response);
+        return false;
+    }
+    
+    // Send password (base64 encoded)
+    if (executeCommand(base64Encode(password), response) != 235) {
+        setError("Authentication failed: " + response);
         return false;
     }
     
@@ -259,67 +1154,94 @@ bool SMTPClient::authenticateLogin(const std::string& username, const std::strin
 bool SMTPClient::authenticatePlain(const std::string& username, const std::string& password) {
     Logger& logger = Logger::getInstance();
     
-    // Create PLAIN authentication string
-    std::string auth_string = "\0" + username + "\0" + password;
-    std::string encoded_auth = base64Encode(auth_string);
+    // Create PLAIN authentication string: authzid NUL authcid NUL passwd
+    std::string auth_string;
+    auth_string.push_back('\0');
+    auth_string += username;
+    auth_string.push_back('\0');
+    auth_string += password;
     
     // Send AUTH PLAIN command
-    if (!sendCommand("AUTH PLAIN " + encoded_auth)) {
+    std::string response;
+    if (executeCommand("AUTH PLAIN " + base64Encode(auth_string), response) != 235) {
+        setError("PLAIN authentication failed: " + response);
+        return false;
+    }
+    
+    logger.info("SMTP PLAIN authentication successful");
+    return true;
+}
+
+bool SMTPClient::authenticateCramMD5(const std::string& username, const std::string& password) {
+    Logger& logger = Logger::getInstance();
+    std::string response;
+    
+    if (executeCommand("AUTH CRAM-MD5", response) != 334 || response.size() < 4) {
+        setError("AUTH CRAM-MD5 not supported: " + response);
         return false;
     }
     
-    std::string response = readResponse();
-    if (response[0] != '2') {
-        logger.error("PLAIN authentication failed: " + response);
+    std::string challenge;
+    if (!base64Decode(response.substr(4), challenge) || challenge.empty()) {
+        std::string malformed = response;
+        // Cancel the exchange (RFC 4954 section 4) so the session stays usable
+        executeCommand("*", response);
+        setError("CRAM-MD5 authentication failed: malformed challenge: " + malformed);
         return false;
     }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    HMAC(EVP_md5(), password.data(), static_cast<int>(password.size()),
+         reinterpret_cast<const unsigned char*>(challenge.data()), challenge.size(),
+         digest, &digest_length);
     
-    logger.info("SMTP PLAIN authentication successful");
+    static const char hex_digits[] = "0123456789abcdef";
+    std::string reply = username + " ";
+    for (unsigned int i = 0; i < digest_length; ++i) {
+        reply.push_back(hex_digits[digest[i] >> 4]);
+        reply.push_back(hex_digits[digest[i] & 0x0F]);
+    }
+    
+    if (executeCommand(base64Encode(reply), response) != 235) {
+        setError("CRAM-MD5 authentication failed: " + response);
+        return false;
+    }
+    
+    logger.info("SMTP CRAM-MD5 authentication successful");
     return true;
 }
 
 SMTPResult SMTPClient::sendViaCurl(const Email& email, const DomainConfig* domain_config) {
+    // Render with the same MIME structure and encodings as the direct SMTP path
+    std::string message;
+    std::string error;
+    if (!MimeMessageStream::render(email, email.generateMessageId(), message, error)) {
+        return SMTPResult::createError(error);
+    }
+    return runCurl(email.from, email.to, message, domain_config);
+}
+
+SMTPResult SMTPClient::sendViaCurl(const PreparedMessage& message, const std::string& recipient,
+                                   const DomainConfig* domain_config) {
+    std::string content = PreparedMessage::formatRecipientHeaders(recipient, message.generateMessageId());
+    content += message.getContent();
+    return runCurl(message.getSender(), std::vector<std::string>(1, recipient), content, domain_config);
+}
+
+SMTPResult SMTPClient::runCurl(const std::string& from, const std::vector<std::string>& recipients,
+                               const std::string& message, const DomainConfig* domain_config) {
     Logger& logger = Logger::getInstance();
     
     try {
         // Create temporary file for email content
         std::string temp_file = "/tmp/ssmtp_email_" + std::to_string(time(nullptr)) + ".txt";
-        std::ofstream email_file(temp_file);
+        std::ofstream email_file(temp_file, std::ios::binary);
         
         if (!email_file.is_open()) {
             return SMTPResult::createError("Failed to create temporary email file");
         }
         
-        // Write email headers and body
-        email_file << "From: " << email.from << "\n";
-        email_file << "To: ";
-        for (size_t i = 0; i < email.to.size(); ++i) {
-            if (i > 0) email_file << ", ";
-            email_file << email.to[i];
-        }
-        email_file << "\n";
-        email_file << "Subject: " << email.subject << "\n";
-        email_file << "Date: " << getCurrentTimestamp() << "\n";
-        email_file << "MIME-Version: 1.0\n";
-        
-        if (!email.html_body.empty()) {
-            email_file << "Content-Type: multipart/alternative; boundary=\"boundary123\"\n";
-            email_file << "\n";
-            email_file << "--boundary123\n";
-            email_file << "Content-Type: text/plain; charset=UTF-8\n";
-            email_file << "\n";
-            email_file << email.body << "\n";
-            email_file << "--boundary123\n";
-            email_file << "Content-Type: text/html; charset=UTF-8\n";
-            email_file << "\n";
-            email_file << email.html_body << "\n";
-            email_file << "--boundary123--\n";
-        } else {
-            email_file << "Content-Type: text/plain; charset=UTF-8\n";
-            email_file << "\n";
-            email_file << email.body << "\n";
-        }
-        
+        email_file << message;
         email_file.close();
         
         // Build curl command for SMTP
@@ -339,10 +1261,10 @@ SMTPResult SMTPClient::sendViaCurl(const Email& email, const DomainConfig* domai
         }
         
         // Add mail options
-        cmd << " --mail-from " << email.from;
+        cmd << " --mail-from " << from;
         
         // Add recipients
-        for (const auto& recipient : email.to) {
+        for (const auto& recipient : recipients) {
             cmd << " --mail-rcpt " << recipient;
         }
         
@@ -369,100 +1291,54 @@ SMTPResult SMTPClient::sendViaCurl(const Email& email, const DomainConfig* domai
     }
 }
 
-SMTPResult SMTPClient::sendEmailData(const Email& email) {
+SMTPResult SMTPClient::sendEmailData(const std::string& from, const std::vector<std::string>& recipients,
+                                     MessageStream& message, const std::string& message_id) {
     Logger& logger = Logger::getInstance();
     
-    // Send MAIL FROM command
-    std::string mail_from = "MAIL FROM:<" + email.from + ">";
-    if (!sendCommand(mail_from)) {
-        return SMTPResult::createError("Failed to send MAIL FROM command");
-    }
+    // Envelope: MAIL FROM, RCPT TO for each recipient (To, Cc and Bcc), then
+    // DATA unless the content goes out as BDAT chunks (RFC 3030)
+    bool chunking = hasCapability("CHUNKING");
+    std::vector<RecipientStatus> statuses;
+    statuses.reserve(recipients.size());
     
-    std::string response = readResponse();
-    if (response[0] != '2') {
-        return SMTPResult::createError("MAIL FROM rejected: " + response);
-    }
+    bool ready = hasCapability("PIPELINING")
+        ? sendEnvelopePipelined(from, recipients, !chunking, statuses)
+        : sendEnvelope(from, recipients, !chunking, statuses);
     
-    // Send RCPT TO commands for each recipient
-    for (const auto& recipient : email.to) {
-        std::string rcpt_to = "RCPT TO:<" + recipient + ">";
-        if (!sendCommand(rcpt_to)) {
-            return SMTPResult::createError("Failed to send RCPT TO command");
-        }
-        
-        response = readResponse();
-        if (response[0] != '2') {
-            return SMTPResult::createError("RCPT TO rejected: " + response);
-        }
+    bool sent = ready && (chunking ? sendMessageChunked(message) : sendMessageData(message));
+    if (!sent) {
+        SMTPResult result = SMTPResult::createError(last_error_);
+        result.recipients = std::move(statuses);
+        return result;
     }
     
-    // Send DATA command
-    if (!sendCommand("DATA")) {
-        return SMTPResult::createError("Failed to send DATA command");
-    }
+    SMTPResult result = SMTPResult::createSuccess(message_id);
+    result.recipients = std::move(statuses);
     
-    response = readResponse();
-    if (response[0] != '3') {
-        return SMTPResult::createError("DATA command rejected: " + response);
-    }
-    
-    // Send email headers and body
-    std::string email_data = buildEmailData(email);
-    if (!sendCommand(email_data)) {
-        return SMTPResult::createError("Failed to send email data");
-    }
-    
-    // Send end of data marker
-    if (!sendCommand(".")) {
-        return SMTPResult::createError("Failed to send end of data marker");
-    }
-    
-    response = readResponse();
-    if (response[0] != '2') {
-        return SMTPResult::createError("Email data rejected: " + response);
+    size_t rejected = result.getRejectedRecipients().size();
+    if (rejected > 0) {
+        logger.warning("Email sent, but " + std::to_string(rejected) + " of " +
+                       std::to_string(recipients.size()) + " recipients were rejected");
+    } else {
+        logger.info("Email sent successfully");
     }
-    
-    // Send QUIT command
-    sendCommand("QUIT");
-    
-    logger.info("Email sent successfully");
-    return SMTPResult::createSuccess("Email sent successfully");
+    return result;
 }
 
-std::string SMTPClient::buildEmailData(const Email& email) {
-    std::ostringstream email_data;
-    
-    // Headers
-    email_data << "From: " << email.from << "\r\n";
-    email_data << "To: ";
-    for (size_t i = 0; i < email.to.size(); ++i) {
-        if (i > 0) email_data << ", ";
-        email_data << email.to[i];
+bool SMTPClient::getSigner(const std::string& from, std::shared_ptr<const DKIMSigner>& signer) {
+    signer.reset();
+    const DomainConfig* domain_config = config_.getDomainConfig(extractDomain(from));
+    if (!domain_config) {
+        return true;
     }
-    email_data << "\r\n";
-    email_data << "Subject: " << email.subject << "\r\n";
-    email_data << "Date: " << getCurrentTimestamp() << "\r\n";
-    email_data << "MIME-Version: 1.0\r\n";
     
-    if (!email.html_body.empty()) {
-        email_data << "Content-Type: multipart/alternative; boundary=\"boundary123\"\r\n";
-        email_data << "\r\n";
-        email_data << "--boundary123\r\n";
-        email_data << "Content-Type: text/plain; charset=UTF-8\r\n";
-        email_data << "\r\n";
-        email_data << email.body << "\r\n";
-        email_data << "--boundary123\r\n";
-        email_data << "Content-Type: text/html; charset=UTF-8\r\n";
-        email_data << "\r\n";
-        email_data << email.html_body << "\r\n";
-        email_data << "--boundary123--\r\n";
-    } else {
-        email_data << "Content-Type: text/plain; charset=UTF-8\r\n";
-        email_data << "\r\n";
-        email_data << email.body << "\r\n";
+    std::string error;
+    if (!DKIMSignerCache::getInstance().get(*domain_config, signer, error)) {
+        // Sending unsigned mail for a signing domain would only get it rejected later
+        setError(error);
+        return false;
     }
-    
-    return email_data.str();
+    return true;
 }
 
 std::string SMTPClient::getCurrentTimestamp() {
@@ -473,37 +1349,13 @@ std::string SMTPClient::getCurrentTimestamp() {
     return std::string(buffer);
 }
 
-std::string SMTPClient::base64Encode(const std::string& input) {
-    const std::string chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    std::string result;
-    int val = 0, valb = -6;
-    
-    for (unsigned char c : input) {
-        val = (val << 8) + c;
-        valb += 8;
-        while (valb >= 0) {
-            result.push_back(chars[(val >> valb) & 0x3F]);
-            valb -= 6;
-        }
-    }
-    
-    if (valb > -6) {
-        result.push_back(chars[((val << 8) >> (valb + 8)) & 0x3F]);
-    }
-    
-    while (result.size() % 4) {
-        result.push_back('=');
-    }
-    
-    return result;
-}
-
 SMTPAuthMethod SMTPClient::stringToAuthMethod(const std::string& method) {
-    if (method == "LOGIN") return SMTPAuthMethod::LOGIN;
-    if (method == "PLAIN") return SMTPAuthMethod::PLAIN;
-    if (method == "CRAM_MD5") return SMTPAuthMethod::CRAM_MD5;
-    if (method == "OAUTH2") return SMTPAuthMethod::OAUTH2;
-    if (method == "XOAUTH2") return SMTPAuthMethod::XOAUTH2;
+    std::string upper = toUpper(method);
+    if (upper == "LOGIN") return SMTPAuthMethod::LOGIN;
+    if (upper == "PLAIN") return SMTPAuthMethod::PLAIN;
+    if (upper == "CRAM_MD5" || upper == "CRAM-MD5") return SMTPAuthMethod::CRAM_MD5;
+    if (upper == "OAUTH2") return SMTPAuthMethod::OAUTH2;
+    if (upper == "XOAUTH2") return SMTPAuthMethod::XOAUTH2;
     return SMTPAuthMethod::NONE;
 }
 
@@ -3,13 +3,19 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <sys/socket.h>
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 #include "core/config/config_manager.hpp"
 #include "simple-smtp-mailer/mailer.hpp"
+#include "utils/const_buffer.hpp"
 
 namespace ssmtp_mailer {
 
+class MessageStream;
+class PreparedMessage;
+class DKIMSigner;
+
 /**
  * @brief SMTP connection state
  */
@@ -120,6 +126,85 @@ public:
      * @return true if connection successful, false otherwise
      */
     bool testConnection();
+    
+    /**
+     * @brief Open an ESMTP session for a domain (connect, EHLO, STARTTLS, AUTH)
+     * @param domain_config Domain configuration describing the relay
+     * @return true if the session is ready for mail transactions, false otherwise
+     */
+    bool openSession(const DomainConfig& domain_config);
+    
+    /**
+     * @brief Send an email over the open session (MAIL FROM, RCPT TO, DATA)
+     * @param email Email object to send
+     * @return SMTPResult with operation status
+     */
+    SMTPResult sendEmail(const Email& email);
+    
+    /**
+     * @brief Send an email to an explicit envelope recipient list
+     *
+     * Headers still show the email's own To and Cc; only RCPT TO is
+     * restricted. Used to split one message into per-domain transactions
+     * that share a Message-ID.
+     *
+     * @param email Email object to send
+     * @param recipients Envelope recipients
+     * @param message_id Message-ID to use (empty = generate one)
+     * @return SMTPResult with operation status
+     */
+    SMTPResult sendEmail(const Email& email, const std::vector<std::string>& recipients,
+                         const std::string& message_id);
+    
+    /**
+     * @brief Send one recipient's copy of a prepared message over the open session
+     *
+     * The recipient is both the only RCPT TO and the To header. The shared
+     * content is written from the PreparedMessage without being copied.
+     *
+     * @param message Prepared message
+     * @param recipient Recipient address
+     * @param message_id Message-ID to use (empty = generate one)
+     * @return SMTPResult with operation status
+     */
+    SMTPResult sendEmail(const PreparedMessage& message, const std::string& recipient,
+                         const std::string& message_id);
+    
+    /**
+     * @brief Abort any pending transaction so the session can be reused (RSET)
+     * @return true if the server acknowledged the reset, false otherwise
+     */
+    bool reset();
+    
+    /**
+     * @brief Send QUIT and close the session
+     */
+    void closeSession();
+    
+    /**
+     * @brief Send an email through the curl subprocess (opt-in fallback)
+     * @param email Email object to send
+     * @param domain_config Domain configuration describing the relay
+     * @return SMTPResult with operation status
+     */
+    SMTPResult sendViaCurl(const Email& email, const DomainConfig* domain_config);
+    
+    /**
+     * @brief Send one recipient's copy of a prepared message through the curl subprocess
+     * @param message Prepared message
+     * @param recipient Recipient address
+     * @param domain_config Domain configuration describing the relay
+     * @return SMTPResult with operation status
+     */
+    SMTPResult sendViaCurl(const PreparedMessage& message, const std::string& recipient,
+                           const DomainConfig* domain_config);
+    
+    /**
+     * @brief Check if the server advertised an EHLO capability
+     * @param keyword Capability keyword (e.g. "PIPELINING")
+     * @return true if advertised, false otherwise
+     */
+    bool hasCapability(const std::string& keyword) const;
 
 private:
     /**
@@ -134,12 +219,27 @@ private:
     void cleanupSSL();
     
     /**
-     * @brief Read SMTP response
+     * @brief Read a complete (possibly multi-line) SMTP reply
      * @param response Response string to store result
-     * @return SMTP response code
+     * @return SMTP response code, or -1 on I/O or protocol error
      */
     int readResponse(std::string& response);
     
+    /**
+     * @brief Read one CRLF-terminated line from the connection
+     * @param line Line without the trailing CRLF
+     * @return true if a line was read, false on I/O error or EOF
+     */
+    bool readLine(std::string& line);
+    
+    /**
+     * @brief Send a command and read its reply
+     * @param command Command line without CRLF
+     * @param response Response string to store the reply
+     * @return SMTP response code, or -1 on I/O error
+     */
+    int executeCommand(const std::string& command, std::string& response);
+    
     /**
      * @brief Check SMTP response code
      * @param code Response code to check
@@ -170,16 +270,67 @@ private:
     /**
      * @brief Send RCPT TO command
      * @param to_address To address
-     * @return true if successful, false otherwise
+     * @param status Server reply for this recipient
+     * @return true if the recipient was accepted, false otherwise
      */
-    bool sendRCPTTO(const std::string& to_address);
+    bool sendRCPTTO(const std::string& to_address, RecipientStatus& status);
     
     /**
-     * @brief Send DATA command and email content
-     * @param email Email object to send
-     * @return true if successful, false otherwise
+     * @brief Record the reply to a RCPT TO command
+     * @param to_address Recipient address
+     * @param code Reply code (negative on connection failure)
+     * @param response Full reply text
+     * @param status Output recipient status
+     * @return true if the recipient was accepted, false otherwise
+     */
+    bool recordRecipient(const std::string& to_address, int code,
+                         const std::string& response, RecipientStatus& status);
+    
+    /**
+     * @brief Send DATA command
+     * @return true if the server is ready for message content, false otherwise
+     */
+    bool sendDATA();
+    
+    /**
+     * @brief Send message content after DATA, dot-stuffed, with the terminating dot
+     * @param message Message content source
+     * @return true if the message was accepted, false otherwise
+     */
+    bool sendMessageData(MessageStream& message);
+    
+    /**
+     * @brief Send message content as BDAT chunks (RFC 3030)
+     * @param message Message content source
+     * @return true if the message was accepted, false otherwise
+     */
+    bool sendMessageChunked(MessageStream& message);
+    
+    /**
+     * @brief Send MAIL FROM, RCPT TO and optionally DATA one command at a time
+     * @param from_address Envelope sender
+     * @param recipients Envelope recipients
+     * @param send_data Finish with DATA (false when content goes out as BDAT)
+     * @param statuses Output per-recipient replies
+     * @return true if at least one recipient (and DATA, if sent) was accepted
+     */
+    bool sendEnvelope(const std::string& from_address,
+                      const std::vector<std::string>& recipients,
+                      bool send_data,
+                      std::vector<RecipientStatus>& statuses);
+    
+    /**
+     * @brief Send MAIL FROM, RCPT TO and optionally DATA as a pipelined batch (RFC 2920)
+     * @param from_address Envelope sender
+     * @param recipients Envelope recipients
+     * @param send_data Finish with DATA (false when content goes out as BDAT)
+     * @param statuses Output per-recipient replies
+     * @return true if at least one recipient (and DATA, if sent) was accepted
      */
-    bool sendDATA(const Email& email);
+    bool sendEnvelopePipelined(const std::string& from_address,
+                               const std::vector<std::string>& recipients,
+                               bool send_data,
+                               std::vector<RecipientStatus>& statuses);
     
     /**
      * @brief Send QUIT command
@@ -221,6 +372,19 @@ private:
      */
     int writeData(const char* data, size_t length);
     
+    /**
+     * @brief Write several buffers as one gathered write
+     *
+     * Uses sendmsg() on plain connections. Under TLS, small buffers are
+     * coalesced into full records and large ones are encrypted in place.
+     * Short writes are continued until everything is sent.
+     *
+     * @param buffers Buffers to write, in order
+     * @param count Number of buffers
+     * @return true if all bytes were written, false otherwise
+     */
+    bool writeBuffers(const ConstBuffer* buffers, size_t count);
+    
     /**
      * @brief Read data from socket
      * @param buffer Buffer to store data
@@ -230,13 +394,6 @@ private:
     int readData(char* buffer, size_t max_length);
 
 private:
-    /**
-     * @brief Send email using SMTP protocol
-     * @param email Email object to send
-     * @return SMTPResult with operation status
-     */
-    SMTPResult sendEmail(const Email& email);
-    
     /**
      * @brief Authenticate using LOGIN method
      * @param username Username for authentication
@@ -260,23 +417,34 @@ private:
      * @return true if successful, false otherwise
      */
     bool authenticateCramMD5(const std::string& username, const std::string& password);
+    
+    /**
+     * @brief Record an error and log it
+     * @param message Error message
+     */
+    void setError(const std::string& message);
 
 private:
     const ConfigManager& config_;
     int socket_fd_;
-    SSL_CTX* ssl_context_;
     SSL* ssl_connection_;
     SMTPState state_;
     std::string server_;
     int port_;
     bool use_ssl_;
     std::string last_error_;
-    std::string capabilities_;
+    std::vector<std::string> capabilities_;
+    std::string read_buffer_;
+    std::vector<char> tls_write_buffer_;    // Coalesces small buffers into TLS records
+    std::string ehlo_hostname_;
     
     // SSL configuration
     std::string ssl_cert_file_;
     std::string ssl_key_file_;
     std::string ssl_ca_file_;
+    bool ssl_verify_peer_;
+    
+    bool authenticated_;
     
     // Connection settings
     int connection_timeout_;
@@ -284,15 +452,17 @@ private:
     int write_timeout_;
     
     // Helper methods
+    bool connectWithTimeout(const struct sockaddr* address, socklen_t address_length);
+    void applySocketTimeouts();
     bool setupSSL();
-    std::string readResponse();
     bool sendCommand(const std::string& command);
-    SMTPResult sendEmailData(const Email& email);
-    std::string buildEmailData(const Email& email);
+    SMTPResult sendEmailData(const std::string& from, const std::vector<std::string>& recipients,
+                             MessageStream& message, const std::string& message_id);
+    bool getSigner(const std::string& from, std::shared_ptr<const DKIMSigner>& signer);
+    SMTPResult runCurl(const std::string& from, const std::vector<std::string>& recipients,
+                       const std::string& message, const DomainConfig* domain_config);
     std::string getCurrentTimestamp();
-    std::string base64Encode(const std::string& input);
     SMTPAuthMethod stringToAuthMethod(const std::string& method);
-    SMTPResult sendViaCurl(const Email& email, const DomainConfig* domain_config);
 };
 
 } // namespace ssmtp_mailer
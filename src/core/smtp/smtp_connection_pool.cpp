@@ -0,0 +1,359 @@
+#include "core/smtp/smtp_connection_pool.hpp"
+#include "core/mime/prepared_message.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/email.hpp"
+#include <limits>
+
+namespace ssmtp_mailer {
+
+SMTPConnectionPool::SMTPConnectionPool(const ConfigManager& config, const SMTPPoolConfig& pool_config)
+    : config_(config), pool_config_(pool_config), total_open_(0),
+      last_prune_(std::chrono::steady_clock::now()),
+      sessions_opened_(0), sessions_reused_(0), sessions_closed_(0), health_check_failures_(0) {
+
+    max_total_sessions_ = pool_config_.max_total_sessions;
+    if (max_total_sessions_ == 0) {
+        int max_connections = config_.getGlobalConfig().max_connections;
+        max_total_sessions_ = max_connections > 0 ? static_cast<size_t>(max_connections)
+                                                  : std::numeric_limits<size_t>::max();
+    }
+    if (pool_config_.max_sessions_per_domain == 0) {
+        pool_config_.max_sessions_per_domain = 1;
+    }
+}
+
+SMTPConnectionPool::~SMTPConnectionPool() {
+    closeAll();
+}
+
+SMTPResult SMTPConnectionPool::send(const Email& email) {
+    std::string domain = extractDomain(email.from);
+    const DomainConfig* domain_config = config_.getDomainConfig(domain);
+
+    if (!domain_config) {
+        return SMTPResult::createError("No configuration found for domain: " + domain);
+    }
+
+    return send(*domain_config, email);
+}
+
+SMTPResult SMTPConnectionPool::send(const DomainConfig& domain_config, const Email& email) {
+    return runTransaction(domain_config,
+        [&email](SMTPClient& client) { return client.sendEmail(email); },
+        [&email, &domain_config](SMTPClient& client) { return client.sendViaCurl(email, &domain_config); });
+}
+
+SMTPResult SMTPConnectionPool::send(const PreparedMessage& message, const std::string& recipient) {
+    std::string domain = extractDomain(message.getSender());
+    const DomainConfig* domain_config = config_.getDomainConfig(domain);
+
+    if (!domain_config) {
+        return SMTPResult::createError("No configuration found for domain: " + domain);
+    }
+
+    return send(*domain_config, message, recipient);
+}
+
+SMTPResult SMTPConnectionPool::send(const DomainConfig& domain_config, const PreparedMessage& message,
+                                    const std::string& recipient) {
+    return runTransaction(domain_config,
+        [&message, &recipient](SMTPClient& client) { return client.sendEmail(message, recipient, ""); },
+        [&message, &recipient, &domain_config](SMTPClient& client) {
+            return client.sendViaCurl(message, recipient, &domain_config);
+        });
+}
+
+SMTPResult SMTPConnectionPool::runTransaction(const DomainConfig& domain_config,
+                                              const Transaction& transaction,
+                                              const Transaction& fallback) {
+    Logger& logger = Logger::getInstance();
+
+    // A reused session may have been closed by the server while idle; allow one
+    // retry on a fresh session if the failure happened before MAIL FROM was accepted
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        std::string error;
+        std::unique_ptr<PooledSession> session = acquire(domain_config, error);
+        if (!session) {
+            if (domain_config.use_curl_fallback) {
+                logger.warning("No SMTP session available (" + error + "), falling back to curl");
+                SMTPClient client(config_);
+                return fallback(client);
+            }
+            return SMTPResult::createError(error);
+        }
+
+        bool reused = session->messages_sent > 0;
+        SMTPResult result = transaction(*session->client);
+        session->messages_sent++;
+
+        if (result.success) {
+            release(std::move(session), true);
+            return result;
+        }
+
+        SMTPState failed_state = session->client->getState();
+        bool reusable = session->client->reset();
+        release(std::move(session), reusable);
+
+        bool before_transaction = failed_state == SMTPState::CONNECTED ||
+                                  failed_state == SMTPState::AUTHENTICATED;
+        if (!(reused && !reusable && before_transaction)) {
+            return result;
+        }
+
+        logger.debug("Pooled SMTP session went stale, retrying on a new session");
+    }
+
+    return SMTPResult::createError("SMTP session failed on retry");
+}
+
+std::unique_ptr<SMTPConnectionPool::PooledSession>
+SMTPConnectionPool::acquire(const DomainConfig& domain_config, std::string& error) {
+    std::string key = makeKey(domain_config);
+    auto deadline = std::chrono::steady_clock::now() + pool_config_.acquire_timeout;
+
+    std::vector<std::unique_ptr<PooledSession>> to_close;
+    std::unique_ptr<PooledSession> session;
+    bool reserved_slot = false;
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_prune_ >= pool_config_.idle_timeout / 2) {
+            collectExpiredLocked(to_close);
+            last_prune_ = now;
+        }
+
+        while (!session && !reserved_slot) {
+            DomainSessions& domain = sessions_[key];
+            now = std::chrono::steady_clock::now();
+
+            // Most recently used first: it is the least likely to have timed out
+            while (!domain.idle.empty()) {
+                std::unique_ptr<PooledSession> candidate = std::move(domain.idle.back());
+                domain.idle.pop_back();
+
+                if (now - candidate->last_used > pool_config_.idle_timeout) {
+                    domain.open_count--;
+                    total_open_--;
+                    to_close.push_back(std::move(candidate));
+                    continue;
+                }
+
+                session = std::move(candidate);
+                break;
+            }
+            if (session) {
+                break;
+            }
+
+            if (domain.open_count < pool_config_.max_sessions_per_domain) {
+                if (total_open_ >= max_total_sessions_) {
+                    std::unique_ptr<PooledSession> victim = evictIdleLocked();
+                    if (victim) {
+                        to_close.push_back(std::move(victim));
+                    }
+                }
+                if (total_open_ < max_total_sessions_) {
+                    domain.open_count++;
+                    total_open_++;
+                    reserved_slot = true;
+                    break;
+                }
+            }
+
+            if (slot_cv_.wait_until(lock, deadline) == std::cv_status::timeout) {
+                error = "Timed out waiting for an SMTP session to " + domain_config.smtp_server;
+                break;
+            }
+        }
+    }
+
+    for (auto& expired : to_close) {
+        closeSession(std::move(expired));
+    }
+    if (!to_close.empty()) {
+        slot_cv_.notify_all();
+    }
+
+    if (session) {
+        // Probe sessions that sat idle for a while before trusting them
+        if (std::chrono::steady_clock::now() - session->last_used < pool_config_.health_check_interval ||
+            session->client->testConnection()) {
+            sessions_reused_++;
+            return session;
+        }
+
+        health_check_failures_++;
+        session->client->disconnect();
+        sessions_closed_++;
+        session.reset();
+        reserved_slot = true;  // keep the slot and reopen in place
+    }
+
+    if (!reserved_slot) {
+        return nullptr;
+    }
+
+    session = std::make_unique<PooledSession>();
+    session->key = key;
+    session->client = std::make_unique<SMTPClient>(config_);
+
+    if (!session->client->openSession(domain_config)) {
+        error = session->client->getLastError();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sessions_[key].open_count--;
+            total_open_--;
+        }
+        slot_cv_.notify_one();
+        return nullptr;
+    }
+
+    sessions_opened_++;
+    return session;
+}
+
+void SMTPConnectionPool::release(std::unique_ptr<PooledSession> session, bool reusable) {
+    if (reusable && session->messages_sent < pool_config_.max_messages_per_session) {
+        session->last_used = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sessions_[session->key].idle.push_back(std::move(session));
+        }
+        slot_cv_.notify_one();
+        return;
+    }
+
+    std::string key = session->key;
+    closeSession(std::move(session));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_[key].open_count--;
+        total_open_--;
+    }
+    slot_cv_.notify_one();
+}
+
+void SMTPConnectionPool::pruneIdleSessions() {
+    std::vector<std::unique_ptr<PooledSession>> expired;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        collectExpiredLocked(expired);
+        last_prune_ = std::chrono::steady_clock::now();
+    }
+
+    for (auto& session : expired) {
+        closeSession(std::move(session));
+    }
+    if (!expired.empty()) {
+        slot_cv_.notify_all();
+    }
+}
+
+void SMTPConnectionPool::closeAll() {
+    std::vector<std::unique_ptr<PooledSession>> idle;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& pair : sessions_) {
+            for (auto& session : pair.second.idle) {
+                idle.push_back(std::move(session));
+            }
+            pair.second.open_count -= pair.second.idle.size();
+            total_open_ -= pair.second.idle.size();
+            pair.second.idle.clear();
+        }
+    }
+
+    for (auto& session : idle) {
+        closeSession(std::move(session));
+    }
+    slot_cv_.notify_all();
+}
+
+SMTPPoolStats SMTPConnectionPool::getStats() const {
+    SMTPPoolStats stats;
+    stats.sessions_opened = sessions_opened_;
+    stats.sessions_reused = sessions_reused_;
+    stats.sessions_closed = sessions_closed_;
+    stats.health_check_failures = health_check_failures_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& pair : sessions_) {
+        stats.idle_sessions += pair.second.idle.size();
+    }
+    stats.active_sessions = total_open_ - stats.idle_sessions;
+    return stats;
+}
+
+std::string SMTPConnectionPool::makeKey(const DomainConfig& domain_config) {
+    // Sessions are only interchangeable if they were opened with identical settings
+    const char separator = '\x1f';
+    std::string key;
+    key += domain_config.smtp_server + separator;
+    key += std::to_string(domain_config.smtp_port) + separator;
+    key += domain_config.auth_method + separator;
+    key += domain_config.username + separator;
+    key += domain_config.password + separator;
+    key += domain_config.oauth2_token + separator;
+    key += (domain_config.use_ssl ? "ssl" : "") + std::string(domain_config.use_starttls ? "starttls" : "") +
+           (domain_config.require_starttls ? "required" : "") +
+           (domain_config.ssl_verify_peer ? "verify" : "") + separator;
+    key += domain_config.ssl_cert_file + separator;
+    key += domain_config.ssl_key_file + separator;
+    key += domain_config.ssl_ca_file;
+    return key;
+}
+
+std::unique_ptr<SMTPConnectionPool::PooledSession> SMTPConnectionPool::evictIdleLocked() {
+    std::unordered_map<std::string, DomainSessions>::iterator oldest_domain = sessions_.end();
+
+    for (auto it = sessions_.begin(); it != sessions_.end(); ++it) {
+        if (it->second.idle.empty()) {
+            continue;
+        }
+        if (oldest_domain == sessions_.end() ||
+            it->second.idle.front()->last_used < oldest_domain->second.idle.front()->last_used) {
+            oldest_domain = it;
+        }
+    }
+
+    if (oldest_domain == sessions_.end()) {
+        return nullptr;
+    }
+
+    auto& idle = oldest_domain->second.idle;
+    std::unique_ptr<PooledSession> victim = std::move(idle.front());
+    idle.erase(idle.begin());
+    oldest_domain->second.open_count--;
+    total_open_--;
+    return victim;
+}
+
+void SMTPConnectionPool::collectExpiredLocked(std::vector<std::unique_ptr<PooledSession>>& expired) {
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto& pair : sessions_) {
+        auto& idle = pair.second.idle;
+        // Idle lists are ordered by last use, oldest first
+        size_t expired_count = 0;
+        while (expired_count < idle.size() &&
+               now - idle[expired_count]->last_used > pool_config_.idle_timeout) {
+            expired.push_back(std::move(idle[expired_count]));
+            ++expired_count;
+        }
+        idle.erase(idle.begin(), idle.begin() + static_cast<std::ptrdiff_t>(expired_count));
+        pair.second.open_count -= expired_count;
+        total_open_ -= expired_count;
+    }
+}
+
+void SMTPConnectionPool::closeSession(std::unique_ptr<PooledSession> session) {
+    if (session && session->client) {
+        session->client->closeSession();
+        sessions_closed_++;
+    }
+}
+
+} // namespace ssmtp_mailer
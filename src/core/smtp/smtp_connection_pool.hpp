@@ -0,0 +1,212 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <unordered_map>
+#include <functional>
+#include "core/config/config_manager.hpp"
+#include "core/smtp/smtp_client.hpp"
+#include "simple-smtp-mailer/mailer.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief SMTP connection pool configuration
+ */
+struct SMTPPoolConfig {
+    size_t max_sessions_per_domain;
+    size_t max_total_sessions;          // 0 = use GlobalConfig::max_connections
+    size_t max_messages_per_session;
+    std::chrono::seconds idle_timeout;
+    std::chrono::seconds health_check_interval;
+    std::chrono::seconds acquire_timeout;
+
+    SMTPPoolConfig()
+        : max_sessions_per_domain(4), max_total_sessions(0),
+          max_messages_per_session(100),
+          idle_timeout(std::chrono::seconds(60)),
+          health_check_interval(std::chrono::seconds(15)),
+          acquire_timeout(std::chrono::seconds(30)) {}
+};
+
+/**
+ * @brief SMTP connection pool statistics
+ */
+struct SMTPPoolStats {
+    size_t sessions_opened;
+    size_t sessions_reused;
+    size_t sessions_closed;
+    size_t health_check_failures;
+    size_t idle_sessions;
+    size_t active_sessions;
+
+    SMTPPoolStats()
+        : sessions_opened(0), sessions_reused(0), sessions_closed(0),
+          health_check_failures(0), idle_sessions(0), active_sessions(0) {}
+};
+
+/**
+ * @brief Pool of authenticated SMTP sessions keyed by relay configuration
+ *
+ * Sessions are opened on demand, returned to the pool after each message
+ * and reused for later messages to the same relay (same server, port,
+ * credentials and TLS settings), so the TCP connect, TLS handshake and
+ * AUTH are paid once per session rather than once per message.
+ */
+class SMTPConnectionPool {
+public:
+    /**
+     * @brief Constructor
+     * @param config Configuration manager instance
+     * @param pool_config Pool limits and timeouts
+     */
+    explicit SMTPConnectionPool(const ConfigManager& config,
+                                const SMTPPoolConfig& pool_config = SMTPPoolConfig());
+
+    /**
+     * @brief Destructor, closes all idle sessions
+     */
+    ~SMTPConnectionPool();
+
+    /**
+     * @brief Send an email through a pooled session for the sender's domain
+     * @param email Email object to send
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const Email& email);
+
+    /**
+     * @brief Send an email through a pooled session for a specific relay
+     * @param domain_config Domain configuration describing the relay
+     * @param email Email object to send
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const DomainConfig& domain_config, const Email& email);
+
+    /**
+     * @brief Send one recipient's copy of a prepared message for the sender's domain
+     * @param message Prepared message
+     * @param recipient Recipient address
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const PreparedMessage& message, const std::string& recipient);
+
+    /**
+     * @brief Send one recipient's copy of a prepared message through a specific relay
+     * @param domain_config Domain configuration describing the relay
+     * @param message Prepared message
+     * @param recipient Recipient address
+     * @return SMTPResult with operation status
+     */
+    SMTPResult send(const DomainConfig& domain_config, const PreparedMessage& message,
+                    const std::string& recipient);
+
+    /**
+     * @brief Close sessions that have been idle longer than the idle timeout
+     */
+    void pruneIdleSessions();
+
+    /**
+     * @brief Close every idle session
+     */
+    void closeAll();
+
+    /**
+     * @brief Get pool statistics
+     * @return Snapshot of pool counters
+     */
+    SMTPPoolStats getStats() const;
+
+private:
+    struct PooledSession {
+        std::unique_ptr<SMTPClient> client;
+        std::string key;
+        size_t messages_sent;
+        std::chrono::steady_clock::time_point last_used;
+
+        PooledSession() : messages_sent(0) {}
+    };
+
+    struct DomainSessions {
+        std::vector<std::unique_ptr<PooledSession>> idle;
+        size_t open_count;
+
+        DomainSessions() : open_count(0) {}
+    };
+
+    using Transaction = std::function<SMTPResult(SMTPClient& client)>;
+
+    /**
+     * @brief Run one mail transaction on a pooled session, retrying once on a stale session
+     * @param domain_config Domain configuration describing the relay
+     * @param transaction Sends the message over an open session
+     * @param fallback Sends the message through curl when no session is available
+     * @return SMTPResult with operation status
+     */
+    SMTPResult runTransaction(const DomainConfig& domain_config, const Transaction& transaction,
+                              const Transaction& fallback);
+
+    /**
+     * @brief Get an open session for a relay, reusing an idle one when possible
+     * @param domain_config Domain configuration describing the relay
+     * @param error Error message if no session could be obtained
+     * @return Session or nullptr on failure
+     */
+    std::unique_ptr<PooledSession> acquire(const DomainConfig& domain_config, std::string& error);
+
+    /**
+     * @brief Return a session to the pool or close it
+     * @param session Session to release
+     * @param reusable Whether the session is still in a usable state
+     */
+    void release(std::unique_ptr<PooledSession> session, bool reusable);
+
+    /**
+     * @brief Build the pool key identifying a relay and its credentials
+     * @param domain_config Domain configuration
+     * @return Pool key
+     */
+    static std::string makeKey(const DomainConfig& domain_config);
+
+    /**
+     * @brief Remove one idle session of another relay to free a global slot
+     * @return Evicted session or nullptr if none was idle (caller holds mutex_)
+     */
+    std::unique_ptr<PooledSession> evictIdleLocked();
+
+    /**
+     * @brief Collect idle sessions past the idle timeout (caller holds mutex_)
+     * @param expired Output vector of sessions to close
+     */
+    void collectExpiredLocked(std::vector<std::unique_ptr<PooledSession>>& expired);
+
+    /**
+     * @brief Close a session outside of the pool lock
+     * @param session Session to close
+     */
+    void closeSession(std::unique_ptr<PooledSession> session);
+
+private:
+    const ConfigManager& config_;
+    SMTPPoolConfig pool_config_;
+    size_t max_total_sessions_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable slot_cv_;
+    std::unordered_map<std::string, DomainSessions> sessions_;
+    size_t total_open_;
+    std::chrono::steady_clock::time_point last_prune_;
+
+    // Statistics
+    std::atomic<size_t> sessions_opened_;
+    std::atomic<size_t> sessions_reused_;
+    std::atomic<size_t> sessions_closed_;
+    std::atomic<size_t> health_check_failures_;
+};
+
+} // namespace ssmtp_mailer
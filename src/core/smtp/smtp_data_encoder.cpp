@@ -0,0 +1,129 @@
+#include "core/smtp/smtp_data_encoder.hpp"
+#include "utils/byte_scan.hpp"
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const char CRLF[] = "\r\n";
+const char DOT[] = ".";
+
+const ConstBuffer CRLF_BUFFER(CRLF, 2);
+const ConstBuffer CR_BUFFER(CRLF, 1);
+const ConstBuffer LF_BUFFER(CRLF + 1, 1);
+const ConstBuffer DOT_BUFFER(DOT, 1);
+
+} // anonymous namespace
+
+SMTPDataEncoder::SMTPDataEncoder(bool dot_stuff)
+    : dot_stuff_(dot_stuff), at_line_start_(true), pending_cr_(false) {
+}
+
+void SMTPDataEncoder::encode(const char* data, size_t length, std::string& output) {
+    scratch_.clear();
+    size_t produced = encode(data, length, scratch_);
+    
+    output.reserve(output.size() + produced);
+    for (const auto& buffer : scratch_) {
+        output.append(buffer.data, buffer.size);
+    }
+}
+
+void SMTPDataEncoder::finish(std::string& output) {
+    if (pending_cr_) {
+        output.push_back('\n');
+        pending_cr_ = false;
+        at_line_start_ = true;
+    }
+    if (!at_line_start_) {
+        output.append("\r\n", 2);
+        at_line_start_ = true;
+    }
+}
+
+size_t SMTPDataEncoder::encode(const char* data, size_t length, std::vector<ConstBuffer>& output) {
+    size_t produced = 0;
+    size_t i = 0;
+    
+    auto emit = [&output, &produced](const ConstBuffer& buffer) {
+        if (buffer.size > 0) {
+            output.push_back(buffer);
+            produced += buffer.size;
+        }
+    };
+    
+    if (pending_cr_ && length > 0) {
+        pending_cr_ = false;
+        emit(LF_BUFFER);
+        at_line_start_ = true;
+        if (data[0] == '\n') {
+            i = 1;
+        }
+    }
+    
+    // Bytes from run_start up to i pass through unchanged. Only line breaks
+    // and a dot right after one need attention, so the text between breaks
+    // is skipped by the vectorised scan.
+    size_t run_start = i;
+    while (i < length) {
+        if (at_line_start_ && data[i] == '.' && dot_stuff_) {
+            emit(ConstBuffer(data + run_start, i - run_start));
+            emit(DOT_BUFFER);
+            run_start = i;
+        }
+        
+        size_t line_break = i + findLineBreak(data + i, length - i);
+        if (line_break > i) {
+            at_line_start_ = false;
+            i = line_break;
+            if (i == length) {
+                break;
+            }
+        }
+        
+        if (data[i] == '\r') {
+            if (i + 1 == length) {
+                // Whether an LF follows is only known with the next piece
+                emit(ConstBuffer(data + run_start, i - run_start));
+                emit(CR_BUFFER);
+                run_start = i + 1;
+                pending_cr_ = true;
+                i++;
+            } else if (data[i + 1] == '\n') {
+                i += 2;
+            } else {
+                emit(ConstBuffer(data + run_start, i - run_start));
+                emit(CRLF_BUFFER);
+                run_start = i + 1;
+                i++;
+            }
+        } else {
+            emit(ConstBuffer(data + run_start, i - run_start));
+            emit(CRLF_BUFFER);
+            run_start = i + 1;
+            i++;
+        }
+        at_line_start_ = true;
+    }
+    
+    emit(ConstBuffer(data + run_start, length - run_start));
+    return produced;
+}
+
+size_t SMTPDataEncoder::finish(std::vector<ConstBuffer>& output) {
+    size_t produced = 0;
+    if (pending_cr_) {
+        output.push_back(LF_BUFFER);
+        produced += LF_BUFFER.size;
+        pending_cr_ = false;
+        at_line_start_ = true;
+    }
+    if (!at_line_start_) {
+        output.push_back(CRLF_BUFFER);
+        produced += CRLF_BUFFER.size;
+        at_line_start_ = true;
+    }
+    return produced;
+}
+
+} // namespace ssmtp_mailer
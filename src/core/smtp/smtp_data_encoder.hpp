@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include "utils/const_buffer.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Streaming canonicaliser for SMTP message content
+ *
+ * Converts bare CR and bare LF to CRLF and, for the DATA command, applies
+ * RFC 5321 dot-stuffing, in one pass that uses a SIMD scan to skip over
+ * the text between line breaks. State is carried across calls so input
+ * may be split at any byte, including between CR and LF.
+ */
+class SMTPDataEncoder {
+public:
+    /**
+     * @brief Constructor
+     * @param dot_stuff Double a leading '.' on each line (DATA), or not (BDAT)
+     */
+    explicit SMTPDataEncoder(bool dot_stuff);
+    
+    /**
+     * @brief Encode the next piece of message content
+     * @param data Input bytes
+     * @param length Input length
+     * @param output String the encoded bytes are appended to
+     */
+    void encode(const char* data, size_t length, std::string& output);
+    
+    /**
+     * @brief Terminate the content so it ends with CRLF
+     * @param output String the final bytes are appended to
+     */
+    void finish(std::string& output);
+    
+    /**
+     * @brief Encode the next piece of message content without copying it
+     *
+     * Appends views of the unchanged runs of data, separated by views of
+     * static line breaks and stuffing dots, so the output is valid only as
+     * long as data is. Produces the same bytes as the copying form, and the
+     * two forms may be mixed on one encoder.
+     *
+     * @param data Input bytes
+     * @param length Input length
+     * @param output Buffers the encoded content is appended to
+     * @return Number of encoded bytes appended
+     */
+    size_t encode(const char* data, size_t length, std::vector<ConstBuffer>& output);
+    
+    /**
+     * @brief Terminate the content so it ends with CRLF
+     * @param output Buffers the final bytes are appended to
+     * @return Number of bytes appended
+     */
+    size_t finish(std::vector<ConstBuffer>& output);
+    
+private:
+    bool dot_stuff_;
+    bool at_line_start_;
+    bool pending_cr_;
+    std::vector<ConstBuffer> scratch_;     // Views collected by the copying form
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,372 @@
+#include "core/smtp/smtp_event_loop.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/email.hpp"
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+
+namespace ssmtp_mailer {
+
+SMTPEventLoop::SMTPEventLoop(const ConfigManager& config, const SMTPEventLoopConfig& loop_config)
+    : config_(config), loop_config_(loop_config), running_(false), next_worker_(0),
+      active_sessions_(0),
+      resolver_(loop_config.resolver ? *loop_config.resolver : DNSResolver::getInstance()),
+      resolving_(0) {
+
+    if (loop_config_.worker_threads == 0) {
+        loop_config_.worker_threads = 1;
+    }
+
+    const GlobalConfig& global_config = config_.getGlobalConfig();
+    if (global_config.connection_timeout > 0) {
+        timeouts_.connect = std::chrono::seconds(global_config.connection_timeout);
+    }
+    if (global_config.read_timeout > 0) {
+        timeouts_.command = std::chrono::seconds(global_config.read_timeout);
+    }
+    if (global_config.write_timeout > 0) {
+        timeouts_.write = std::chrono::seconds(global_config.write_timeout);
+    }
+    timeouts_.data = loop_config_.data_timeout;
+
+    ehlo_hostname_ = global_config.default_hostname;
+    if (ehlo_hostname_.empty()) {
+        char hostname[256];
+        if (gethostname(hostname, sizeof(hostname)) == 0) {
+            hostname[sizeof(hostname) - 1] = '\0';
+            ehlo_hostname_ = hostname;
+        } else {
+            ehlo_hostname_ = "localhost";
+        }
+    }
+}
+
+SMTPEventLoop::~SMTPEventLoop() {
+    stop();
+}
+
+bool SMTPEventLoop::start() {
+    if (running_) {
+        return true;
+    }
+
+    // SSL_write cannot pass MSG_NOSIGNAL; a peer reset must not kill the process
+    struct sigaction current;
+    if (sigaction(SIGPIPE, nullptr, &current) == 0 && current.sa_handler == SIG_DFL) {
+        signal(SIGPIPE, SIG_IGN);
+    }
+
+    for (size_t i = 0; i < loop_config_.worker_threads; ++i) {
+        std::unique_ptr<Worker> worker(new Worker(loop_config_.timer_tick));
+        std::string error;
+        if (!worker->poller.open(error)) {
+            std::lock_guard<std::mutex> lock(error_mutex_);
+            last_error_ = "Failed to create event loop: " + error;
+            workers_.clear();
+            return false;
+        }
+        workers_.push_back(std::move(worker));
+    }
+
+    running_ = true;
+    for (auto& worker : workers_) {
+        Worker* raw = worker.get();
+        worker->thread = std::thread([this, raw]() { run(*raw); });
+    }
+
+    Logger::getInstance().info("SMTP event loop started with " +
+                               std::to_string(workers_.size()) + " worker(s)");
+    return true;
+}
+
+void SMTPEventLoop::stop() {
+    if (!running_) {
+        return;
+    }
+
+    {
+        // Lookups still in flight will see running_ == false and fail their session
+        std::unique_lock<std::mutex> lock(resolve_mutex_);
+        running_ = false;
+        resolve_cv_.wait(lock, [this]() { return resolving_ == 0; });
+    }
+    for (auto& worker : workers_) {
+        wake(*worker);
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    // Fail whatever is still in flight so every submit gets its callback
+    for (auto& worker : workers_) {
+        adoptInbox(*worker);
+        std::vector<uint64_t> ids;
+        for (const auto& pair : worker->sessions) {
+            ids.push_back(pair.first);
+        }
+        for (uint64_t id : ids) {
+            worker->sessions[id].session->abort("SMTP event loop stopped");
+            completeSession(*worker, id);
+        }
+        worker->poller.close();
+    }
+    workers_.clear();
+
+    Logger::getInstance().info("SMTP event loop stopped");
+}
+
+bool SMTPEventLoop::submit(const Email& email, CompletionCallback callback) {
+    std::string domain = extractDomain(email.from);
+    const DomainConfig* domain_config = config_.getDomainConfig(domain);
+
+    if (!domain_config) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        last_error_ = "No configuration found for domain: " + domain;
+        return false;
+    }
+
+    return submit(*domain_config, email, std::move(callback));
+}
+
+bool SMTPEventLoop::submit(const DomainConfig& domain_config, const Email& email,
+                           CompletionCallback callback) {
+    if (!admit()) {
+        return false;
+    }
+    resolve(std::unique_ptr<SMTPAsyncSession>(
+                new SMTPAsyncSession(domain_config, email, ehlo_hostname_, timeouts_, std::move(callback))),
+            domain_config.smtp_server);
+    return true;
+}
+
+bool SMTPEventLoop::submit(const DomainConfig& domain_config, SMTPOutgoingMessage& message,
+                           CompletionCallback callback) {
+    if (!admit()) {
+        return false;
+    }
+    resolve(std::unique_ptr<SMTPAsyncSession>(
+                new SMTPAsyncSession(domain_config, std::move(message), ehlo_hostname_, timeouts_,
+                                     std::move(callback))),
+            domain_config.smtp_server);
+    return true;
+}
+
+bool SMTPEventLoop::admit() {
+    if (!running_ || workers_.empty()) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        last_error_ = "SMTP event loop is not running";
+        return false;
+    }
+
+    if (loop_config_.max_sessions > 0 && active_sessions_ >= loop_config_.max_sessions) {
+        std::lock_guard<std::mutex> lock(error_mutex_);
+        last_error_ = "SMTP event loop is at capacity";
+        return false;
+    }
+
+    active_sessions_++;
+    std::lock_guard<std::mutex> lock(resolve_mutex_);
+    resolving_++;
+    return true;
+}
+
+void SMTPEventLoop::resolve(std::unique_ptr<SMTPAsyncSession> session, const std::string& server) {
+    // Workers never block on DNS; the session is handed over once the relay resolves
+    auto pending = std::make_shared<std::unique_ptr<SMTPAsyncSession>>(std::move(session));
+    resolver_.resolveAddress(server, [this, pending](const DNSAddressResult& resolved) {
+        onResolved(std::move(*pending), resolved);
+    });
+}
+
+void SMTPEventLoop::onResolved(std::unique_ptr<SMTPAsyncSession> session, const DNSAddressResult& resolved) {
+    std::unique_lock<std::mutex> lock(resolve_mutex_);
+    if (running_ && resolved.success()) {
+        PendingSession pending;
+        pending.session = std::move(session);
+        pending.addresses = resolved.addresses;
+
+        Worker& worker = *workers_[next_worker_++ % workers_.size()];
+        {
+            std::lock_guard<std::mutex> inbox_lock(worker.inbox_mutex);
+            worker.inbox.push_back(std::move(pending));
+        }
+        wake(worker);
+    } else {
+        lock.unlock();
+        session->abort(running_ ? resolved.error : "SMTP event loop stopped");
+        active_sessions_--;
+        try {
+            session->complete();
+        } catch (const std::exception& e) {
+            Logger::getInstance().error("SMTP completion callback threw: " + std::string(e.what()));
+        }
+        lock.lock();
+    }
+
+    // Last access to this object; stop() may destroy it once resolving_ drops to zero
+    if (--resolving_ == 0) {
+        resolve_cv_.notify_all();
+    }
+}
+
+std::string SMTPEventLoop::getLastError() const {
+    std::lock_guard<std::mutex> lock(error_mutex_);
+    return last_error_;
+}
+
+void SMTPEventLoop::run(Worker& worker) {
+    std::vector<EventPoller::Event> events;
+    std::vector<uint64_t> expired;
+
+    while (running_) {
+        // Sleep until the earliest session deadline; submissions and I/O wake the worker anyway
+        int timeout = worker.timers.millisecondsUntilNextExpiry(std::chrono::steady_clock::now());
+        if (!worker.poller.wait(events, timeout)) {
+            Logger::getInstance().error("SMTP event loop wait failed: " + std::string(strerror(errno)));
+            break;
+        }
+
+        for (const auto& event : events) {
+            auto it = worker.sessions.find(event.token);
+            if (it == worker.sessions.end()) {
+                continue;
+            }
+            it->second.session->onEvent(event.events);
+            update(worker, event.token);
+        }
+
+        adoptInbox(worker);
+
+        auto now = std::chrono::steady_clock::now();
+        expired.clear();
+        worker.timers.advance(now, expired);
+        for (uint64_t id : expired) {
+            auto it = worker.sessions.find(id);
+            if (it == worker.sessions.end()) {
+                continue;
+            }
+            ActiveSession& active = it->second;
+            active.timer = 0;
+            if (active.session->getDeadline() > now) {
+                // The deadline moved out since the timer was set; re-arm lazily
+                active.scheduled_deadline = active.session->getDeadline();
+                active.timer = worker.timers.schedule(active.scheduled_deadline, id);
+                continue;
+            }
+            active.session->onTimeout();
+            update(worker, id);
+        }
+    }
+}
+
+void SMTPEventLoop::adoptInbox(Worker& worker) {
+    std::vector<PendingSession> inbox;
+    {
+        std::lock_guard<std::mutex> lock(worker.inbox_mutex);
+        inbox.swap(worker.inbox);
+    }
+
+    for (auto& pending : inbox) {
+        uint64_t id = worker.next_session_id++;
+        ActiveSession& active = worker.sessions[id];
+        active.session = std::move(pending.session);
+        active.timer = 0;
+        active.registered_events = 0;
+        active.registered_fd = -1;
+
+        if (!running_ || !active.session->start(pending.addresses)) {
+            if (!active.session->isFinished()) {
+                active.session->abort("SMTP event loop stopped");
+            }
+            completeSession(worker, id);
+            continue;
+        }
+
+        uint32_t wanted = active.session->getWantedEvents();
+        if (!worker.poller.add(active.session->getFd(), wanted, id)) {
+            active.session->abort("Failed to register SMTP session: " + std::string(strerror(errno)));
+            completeSession(worker, id);
+            continue;
+        }
+        active.registered_events = wanted;
+        active.registered_fd = active.session->getFd();
+
+        active.scheduled_deadline = active.session->getDeadline();
+        active.timer = worker.timers.schedule(active.scheduled_deadline, id);
+    }
+}
+
+void SMTPEventLoop::update(Worker& worker, uint64_t id) {
+    auto it = worker.sessions.find(id);
+    if (it == worker.sessions.end()) {
+        return;
+    }
+    ActiveSession& active = it->second;
+
+    if (active.session->isFinished()) {
+        completeSession(worker, id);
+        return;
+    }
+
+    uint32_t wanted = active.session->getWantedEvents();
+    if (active.session->getFd() != active.registered_fd) {
+        // The session moved on to another relay address; its old socket is closed
+        worker.poller.remove(active.registered_fd);
+        active.registered_fd = -1;
+        if (!worker.poller.add(active.session->getFd(), wanted, id)) {
+            active.session->abort("Failed to register SMTP session: " + std::string(strerror(errno)));
+            completeSession(worker, id);
+            return;
+        }
+        active.registered_fd = active.session->getFd();
+        active.registered_events = wanted;
+    } else if (wanted != active.registered_events) {
+        worker.poller.modify(active.registered_fd, wanted, id);
+        active.registered_events = wanted;
+    }
+
+    // Only an earlier deadline needs a new timer; later ones are re-armed on expiry
+    auto deadline = active.session->getDeadline();
+    if (deadline < active.scheduled_deadline || active.timer == 0) {
+        if (active.timer != 0) {
+            worker.timers.cancel(active.timer);
+        }
+        active.scheduled_deadline = deadline;
+        active.timer = worker.timers.schedule(deadline, id);
+    }
+}
+
+void SMTPEventLoop::completeSession(Worker& worker, uint64_t id) {
+    auto it = worker.sessions.find(id);
+    if (it == worker.sessions.end()) {
+        return;
+    }
+
+    std::unique_ptr<SMTPAsyncSession> session = std::move(it->second.session);
+    if (it->second.timer != 0) {
+        worker.timers.cancel(it->second.timer);
+    }
+    // A finished session has already closed its socket, but poll() would still watch it
+    if (it->second.registered_fd >= 0) {
+        worker.poller.remove(it->second.registered_fd);
+    }
+    worker.sessions.erase(it);
+    active_sessions_--;
+
+    try {
+        session->complete();
+    } catch (const std::exception& e) {
+        Logger::getInstance().error("SMTP completion callback threw: " + std::string(e.what()));
+    }
+}
+
+void SMTPEventLoop::wake(Worker& worker) {
+    if (!worker.poller.wake()) {
+        Logger::getInstance().error("Failed to wake SMTP event loop: " + std::string(strerror(errno)));
+    }
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include "core/config/config_manager.hpp"
+#include "core/dns/dns_resolver.hpp"
+#include "core/smtp/smtp_async_session.hpp"
+#include "simple-smtp-mailer/mailer.hpp"
+#include "utils/event_poller.hpp"
+#include "utils/timer_wheel.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief SMTP event loop configuration
+ */
+struct SMTPEventLoopConfig {
+    size_t worker_threads;
+    size_t max_sessions;                    // In-flight limit across workers, 0 = unlimited
+    std::chrono::milliseconds timer_tick;
+    std::chrono::seconds data_timeout;      // Final reply after the message (RFC 5321: 10 minutes)
+    DNSResolver* resolver;                  // nullptr = DNSResolver::getInstance()
+
+    SMTPEventLoopConfig()
+        : worker_threads(1), max_sessions(0),
+          timer_tick(std::chrono::milliseconds(100)),
+          data_timeout(std::chrono::minutes(10)), resolver(nullptr) {}
+};
+
+/**
+ * @brief Multiplexes many non-blocking SMTP sessions over epoll (poll() off Linux)
+ *
+ * Each worker thread owns an event poller and a timer wheel and drives
+ * its sessions entirely through readiness events, so one thread can keep
+ * thousands of deliveries in flight. Relay names are resolved through the
+ * asynchronous DNS resolver, after which messages are spread over the
+ * workers round-robin. Completion callbacks run on a worker or resolver
+ * thread and must not block.
+ */
+class SMTPEventLoop {
+public:
+    using CompletionCallback = SMTPAsyncSession::CompletionCallback;
+
+    /**
+     * @brief Constructor
+     * @param config Configuration manager instance
+     * @param loop_config Worker count, limits and timer settings
+     */
+    explicit SMTPEventLoop(const ConfigManager& config,
+                           const SMTPEventLoopConfig& loop_config = SMTPEventLoopConfig());
+
+    /**
+     * @brief Destructor, stops the loop
+     */
+    ~SMTPEventLoop();
+
+    /**
+     * @brief Start the worker threads
+     * @return true if successful, false otherwise
+     */
+    bool start();
+
+    /**
+     * @brief Stop the workers; sessions still in flight fail with an error
+     *
+     * Must not be called concurrently with submit().
+     */
+    void stop();
+
+    /**
+     * @brief Check if the loop is running
+     * @return true if running, false otherwise
+     */
+    bool isRunning() const { return running_; }
+
+    /**
+     * @brief Queue an email for delivery through the relay of its sender's domain
+     * @param email Email to send (copied)
+     * @param callback Invoked with the result on a worker thread
+     * @return true if accepted, false if the loop is stopped or full or the domain is not configured
+     */
+    bool submit(const Email& email, CompletionCallback callback);
+
+    /**
+     * @brief Queue an email for delivery through a specific relay
+     * @param domain_config Domain configuration describing the relay
+     * @param email Email to send (copied)
+     * @param callback Invoked with the result, including DNS failures
+     * @return true if accepted, false if the loop is stopped or full
+     */
+    bool submit(const DomainConfig& domain_config, const Email& email, CompletionCallback callback);
+
+    /**
+     * @brief Queue one mail transaction with its own envelope through a specific relay
+     * @param domain_config Domain configuration describing the relay
+     * @param message Envelope and content; not consumed if the submission is refused
+     * @param callback Invoked with the result, including DNS failures
+     * @return true if accepted, false if the loop is stopped or full
+     */
+    bool submit(const DomainConfig& domain_config, SMTPOutgoingMessage& message, CompletionCallback callback);
+
+    /**
+     * @brief Get number of sessions submitted and not yet completed
+     * @return Active session count
+     */
+    size_t getActiveSessions() const { return active_sessions_; }
+
+    /**
+     * @brief Get last error message
+     * @return Last error message
+     */
+    std::string getLastError() const;
+
+private:
+    struct PendingSession {
+        std::unique_ptr<SMTPAsyncSession> session;
+        std::vector<IPAddress> addresses;
+    };
+
+    struct ActiveSession {
+        std::unique_ptr<SMTPAsyncSession> session;
+        TimerWheel::TimerId timer;
+        std::chrono::steady_clock::time_point scheduled_deadline;
+        uint32_t registered_events;
+        int registered_fd;
+    };
+
+    struct Worker {
+        EventPoller poller;
+        std::thread thread;
+        std::mutex inbox_mutex;
+        std::vector<PendingSession> inbox;
+        std::unordered_map<uint64_t, ActiveSession> sessions;
+        TimerWheel timers;
+        uint64_t next_session_id;
+
+        explicit Worker(std::chrono::milliseconds tick)
+            : timers(tick), next_session_id(1) {}
+    };
+
+    /**
+     * @brief Check that a session can be taken and count it in (fails with last_error_ set)
+     */
+    bool admit();
+
+    /**
+     * @brief Resolve the relay of an admitted session, then hand it to a worker
+     */
+    void resolve(std::unique_ptr<SMTPAsyncSession> session, const std::string& server);
+
+    void onResolved(std::unique_ptr<SMTPAsyncSession> session, const DNSAddressResult& resolved);
+    void run(Worker& worker);
+    void adoptInbox(Worker& worker);
+    void update(Worker& worker, uint64_t id);
+    void completeSession(Worker& worker, uint64_t id);
+    void wake(Worker& worker);
+
+    const ConfigManager& config_;
+    SMTPEventLoopConfig loop_config_;
+    SMTPSessionTimeouts timeouts_;
+    std::string ehlo_hostname_;
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<bool> running_;
+    std::atomic<size_t> next_worker_;
+    std::atomic<size_t> active_sessions_;
+
+    DNSResolver& resolver_;
+    std::mutex resolve_mutex_;
+    std::condition_variable resolve_cv_;
+    size_t resolving_;
+
+    mutable std::mutex error_mutex_;
+    std::string last_error_;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,215 @@
+#include "core/smtp/tls_context_cache.hpp"
+#include "core/logging/logger.hpp"
+#include <ctime>
+#include <openssl/err.h>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+// Bounds memory when talking to very many distinct servers
+const size_t MAX_CACHED_SESSIONS = 4096;
+
+std::string opensslError() {
+    unsigned long code = ERR_get_error();
+    if (code == 0) {
+        return "unknown error";
+    }
+    char buffer[256];
+    ERR_error_string_n(code, buffer, sizeof(buffer));
+    return buffer;
+}
+
+void freeSessionKey(void* parent, void* ptr, CRYPTO_EX_DATA* data, int index, long argl, void* argp) {
+    delete static_cast<std::string*>(ptr);
+}
+
+bool isUsable(SSL_SESSION* session) {
+    if (!SSL_SESSION_is_resumable(session)) {
+        return false;
+    }
+    long expires = SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session);
+    return expires > static_cast<long>(time(nullptr));
+}
+
+} // anonymous namespace
+
+TLSContextCache& TLSContextCache::getInstance() {
+    static TLSContextCache instance;
+    return instance;
+}
+
+TLSContextCache::TLSContextCache()
+    : key_index_(-1), full_handshakes_(0), resumed_handshakes_(0), sessions_offered_(0) {
+    key_index_ = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, freeSessionKey);
+}
+
+TLSContextCache::~TLSContextCache() {
+    clear();
+}
+
+SSL* TLSContextCache::createConnection(const TLSProfile& profile, const std::string& server,
+                                       int port, std::string& error) {
+    std::string key = profileKey(profile) + "|" + server + ":" + std::to_string(port);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    SSL_CTX* context = getContext(profile, error);
+    if (!context) {
+        return nullptr;
+    }
+
+    SSL* ssl = SSL_new(context);
+    if (!ssl) {
+        error = "Failed to create SSL connection: " + opensslError();
+        return nullptr;
+    }
+
+    // Server name indication and hostname verification
+    SSL_set_tlsext_host_name(ssl, server.c_str());
+    SSL_set1_host(ssl, server.c_str());
+
+    // Tells onNewSession where to file tickets that arrive later
+    SSL_set_ex_data(ssl, key_index_, new std::string(key));
+
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+        if (isUsable(it->second) && SSL_set_session(ssl, it->second) == 1) {
+            sessions_offered_++;
+        } else {
+            SSL_SESSION_free(it->second);
+            sessions_.erase(it);
+        }
+    }
+
+    return ssl;
+}
+
+void TLSContextCache::releaseConnection(SSL* ssl) {
+    if (!ssl) {
+        return;
+    }
+    if (SSL_is_init_finished(ssl)) {
+        SSL_set_quiet_shutdown(ssl, 1);
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+}
+
+void TLSContextCache::recordHandshake(SSL* ssl) {
+    if (SSL_session_reused(ssl)) {
+        resumed_handshakes_++;
+    } else {
+        full_handshakes_++;
+    }
+}
+
+TLSCacheStats TLSContextCache::getStats() const {
+    TLSCacheStats stats;
+    stats.full_handshakes = full_handshakes_;
+    stats.resumed_handshakes = resumed_handshakes_;
+    stats.sessions_offered = sessions_offered_;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats.contexts = contexts_.size();
+    stats.cached_sessions = sessions_.size();
+    return stats;
+}
+
+void TLSContextCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& pair : sessions_) {
+        SSL_SESSION_free(pair.second);
+    }
+    sessions_.clear();
+    for (auto& pair : contexts_) {
+        SSL_CTX_free(pair.second);
+    }
+    contexts_.clear();
+}
+
+SSL_CTX* TLSContextCache::getContext(const TLSProfile& profile, std::string& error) {
+    std::string key = profileKey(profile);
+    auto it = contexts_.find(key);
+    if (it != contexts_.end()) {
+        return it->second;
+    }
+
+    SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+    if (!context) {
+        error = "Failed to create SSL context";
+        return nullptr;
+    }
+
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_verify(context, profile.verify_peer ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    // Many servers close after 221 without close_notify; SMTP replies are self-delimiting
+    SSL_CTX_set_options(context, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+    bool ca_loaded = profile.ca_file.empty()
+        ? SSL_CTX_set_default_verify_paths(context) == 1
+        : SSL_CTX_load_verify_locations(context, profile.ca_file.c_str(), nullptr) == 1;
+    if (!ca_loaded) {
+        error = "Failed to load CA certificates: " + opensslError();
+        SSL_CTX_free(context);
+        return nullptr;
+    }
+
+    if (!profile.cert_file.empty()) {
+        if (SSL_CTX_use_certificate_chain_file(context, profile.cert_file.c_str()) != 1 ||
+            SSL_CTX_use_PrivateKey_file(context,
+                (profile.key_file.empty() ? profile.cert_file : profile.key_file).c_str(),
+                SSL_FILETYPE_PEM) != 1) {
+            error = "Failed to load client certificate: " + opensslError();
+            SSL_CTX_free(context);
+            return nullptr;
+        }
+    }
+
+    // Sessions are stored here, keyed by server, rather than in OpenSSL's
+    // internal cache, which only serves the server side
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, &TLSContextCache::onNewSession);
+
+    contexts_[key] = context;
+    Logger::getInstance().debug("Created TLS context for profile " + key);
+    return context;
+}
+
+void TLSContextCache::storeSession(const std::string& key, SSL_SESSION* session) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = sessions_.find(key);
+    if (it != sessions_.end()) {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+        return;
+    }
+
+    if (sessions_.size() >= MAX_CACHED_SESSIONS) {
+        SSL_SESSION_free(sessions_.begin()->second);
+        sessions_.erase(sessions_.begin());
+    }
+    sessions_[key] = session;
+}
+
+int TLSContextCache::onNewSession(SSL* ssl, SSL_SESSION* session) {
+    TLSContextCache& cache = getInstance();
+    std::string* key = static_cast<std::string*>(SSL_get_ex_data(ssl, cache.key_index_));
+    if (!key) {
+        return 0;
+    }
+
+    // Returning 1 keeps the reference OpenSSL passed in
+    cache.storeSession(*key, session);
+    return 1;
+}
+
+std::string TLSContextCache::profileKey(const TLSProfile& profile) {
+    return profile.ca_file + "|" + profile.cert_file + "|" + profile.key_file +
+           (profile.verify_peer ? "|verify" : "|noverify");
+}
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <unordered_map>
+#include <openssl/ssl.h>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Certificate settings that select a shared TLS context
+ */
+struct TLSProfile {
+    std::string ca_file;        // Empty = system trust store
+    std::string cert_file;      // Optional client certificate chain
+    std::string key_file;       // Defaults to cert_file when empty
+    bool verify_peer;           // false only for opportunistic TLS (RFC 7435)
+
+    TLSProfile() : verify_peer(true) {}
+    TLSProfile(const std::string& ca, const std::string& cert, const std::string& key,
+               bool verify = true)
+        : ca_file(ca), cert_file(cert), key_file(key), verify_peer(verify) {}
+};
+
+/**
+ * @brief TLS handshake and cache statistics
+ */
+struct TLSCacheStats {
+    uint64_t full_handshakes;
+    uint64_t resumed_handshakes;
+    uint64_t sessions_offered;
+    size_t contexts;
+    size_t cached_sessions;
+
+    TLSCacheStats()
+        : full_handshakes(0), resumed_handshakes(0), sessions_offered(0),
+          contexts(0), cached_sessions(0) {}
+};
+
+/**
+ * @brief Process-wide SSL_CTX and client session cache for SMTP connections
+ *
+ * One SSL_CTX is built per TLS profile and shared by every connection using
+ * it, so the trust store and client certificate are loaded once. Sessions
+ * handed out by servers (TLS 1.2 session IDs and TLS 1.3 tickets, which may
+ * arrive after the handshake) are kept per profile and server:port and
+ * offered on the next connection, so reconnects resume instead of paying
+ * for a full handshake.
+ */
+class TLSContextCache {
+public:
+    /**
+     * @brief Get the process-wide instance
+     * @return Cache instance
+     */
+    static TLSContextCache& getInstance();
+
+    /**
+     * @brief Destructor, frees all contexts and sessions
+     */
+    ~TLSContextCache();
+
+    TLSContextCache(const TLSContextCache&) = delete;
+    TLSContextCache& operator=(const TLSContextCache&) = delete;
+
+    /**
+     * @brief Create a client connection object for a server
+     *
+     * Sets SNI and hostname verification and offers a cached session for
+     * server:port when one is still valid. The caller owns the result and
+     * frees it with releaseConnection().
+     *
+     * @param profile TLS profile selecting the shared context
+     * @param server Server hostname
+     * @param port Server port
+     * @param error Set to a description when nullptr is returned
+     * @return SSL object, or nullptr on failure
+     */
+    SSL* createConnection(const TLSProfile& profile, const std::string& server, int port,
+                          std::string& error);
+
+    /**
+     * @brief Free a connection without spoiling its session for resumption
+     *
+     * OpenSSL marks the session of a connection freed without a shutdown as
+     * non-resumable. SMTP has already ended with QUIT, so a quiet shutdown
+     * is enough and never writes to a socket the server may have closed.
+     *
+     * @param ssl Connection to free (may be nullptr)
+     */
+    void releaseConnection(SSL* ssl);
+
+    /**
+     * @brief Record a completed handshake as full or resumed
+     * @param ssl Connection whose handshake just finished
+     */
+    void recordHandshake(SSL* ssl);
+
+    /**
+     * @brief Get handshake and cache statistics
+     * @return Statistics snapshot
+     */
+    TLSCacheStats getStats() const;
+
+    /**
+     * @brief Drop all cached sessions and contexts
+     *
+     * Connections already created keep their context alive.
+     */
+    void clear();
+
+private:
+    TLSContextCache();
+
+    SSL_CTX* getContext(const TLSProfile& profile, std::string& error);
+    void storeSession(const std::string& key, SSL_SESSION* session);
+    static int onNewSession(SSL* ssl, SSL_SESSION* session);
+
+    static std::string profileKey(const TLSProfile& profile);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, SSL_CTX*> contexts_;
+    std::unordered_map<std::string, SSL_SESSION*> sessions_;
+    int key_index_;
+
+    std::atomic<uint64_t> full_handshakes_;
+    std::atomic<uint64_t> resumed_handshakes_;
+    std::atomic<uint64_t> sessions_offered_;
+};
+
+} // namespace ssmtp_mailer
@@ -1,6 +1,6 @@
 #include "ssmtp-mailer/unified_mailer.hpp"
 #include "core/config/config_manager.hpp"
-#include "ssmtp-mailer/smtp_client.hpp"
+#include "core/smtp/smtp_connection_pool.hpp"
 #include <algorithm>
 #include <iostream>
 #include <chrono>
@@ -43,14 +43,13 @@ UnifiedMailerResult UnifiedMailer::sendViaSMTP(const Email& email) {
     result.method_used = SendMethod::SMTP;
     
     try {
-        if (!smtp_config_) {
+        if (!smtp_config_ || !smtp_pool_) {
             result.error_message = "SMTP configuration not available";
             return result;
         }
         
-        // Create SMTP client and send email
-        SMTPClient smtp_client(*smtp_config_);
-        SMTPResult smtp_result = smtp_client.send(email);
+        // Send over a pooled session so connect, TLS and AUTH are amortised
+        SMTPResult smtp_result = smtp_pool_->send(email);
         
         result.success = smtp_result.success;
         if (result.success) {
@@ -229,6 +228,7 @@ void UnifiedMailer::initializeSMTP() {
         try {
             smtp_config_ = std::make_unique<ConfigManager>();
             smtp_config_->loadFromFile(config_.smtp_config_file);
+            smtp_pool_ = std::make_unique<SMTPConnectionPool>(*smtp_config_);
         } catch (const std::exception& e) {
             std::cerr << "Failed to initialize SMTP configuration: " << e.what() << std::endl;
         }
@@ -1,8 +1,7 @@
 #include "simple-smtp-mailer/mailer.hpp"
 #include "utils/email.hpp"
+#include "core/mime/message_stream.hpp"
 #include <algorithm>
-#include <sstream>
-#include <regex>
 
 namespace ssmtp_mailer {
 
@@ -33,25 +32,10 @@ bool Email::isValid() const {
         return false;
     }
     
-    for (const auto& addr : to) {
-        if (!isValidEmailAddress(addr)) {
-            return false;
-        }
-    }
-    
-    for (const auto& addr : cc) {
-        if (!isValidEmailAddress(addr)) {
-            return false;
-        }
-    }
-    
-    for (const auto& addr : bcc) {
-        if (!isValidEmailAddress(addr)) {
-            return false;
-        }
-    }
-    
-    return true;
+    std::vector<EmailAddressParts> parts;
+    return parseEmailAddresses(to, parts) == to.size() &&
+           parseEmailAddresses(cc, parts) == cc.size() &&
+           parseEmailAddresses(bcc, parts) == bcc.size();
 }
 
 void Email::clear() {
@@ -63,6 +47,7 @@ void Email::clear() {
     body.clear();
     html_body.clear();
     attachments.clear();
+    inline_attachments.clear();
 }
 
 void Email::addRecipient(const std::string& address) {
@@ -87,6 +72,10 @@ void Email::addAttachment(const std::string& file_path) {
     attachments.push_back(file_path);
 }
 
+void Email::addInlineAttachment(const std::string& file_path) {
+    inline_attachments.push_back(file_path);
+}
+
 bool Email::removeRecipient(const std::string& address) {
     auto it = std::find(to.begin(), to.end(), address);
     if (it != to.end()) {
@@ -152,7 +141,7 @@ bool Email::hasHtmlContent() const {
 }
 
 bool Email::hasAttachments() const {
-    return !attachments.empty();
+    return !attachments.empty() || !inline_attachments.empty();
 }
 
 size_t Email::getEstimatedSize() const {
@@ -171,6 +160,9 @@ size_t Email::getEstimatedSize() const {
     for (const auto& attachment : attachments) {
         size += attachment.length() + 1000; // Assume 1KB per attachment
     }
+    for (const auto& attachment : inline_attachments) {
+        size += attachment.length() + 1000;
+    }
     
     return size;
 }
@@ -189,73 +181,16 @@ std::string Email::getCurrentTimestamp() {
 }
 
 std::string Email::toRFC2822() const {
-    std::ostringstream oss;
-    
-    // Date
-    oss << "Date: " << getCurrentTimestamp() << "\r\n";
-    
-    // From
-    oss << "From: " << from << "\r\n";
-    
-    // To
-    if (!to.empty()) {
-        oss << "To: ";
-        for (size_t i = 0; i < to.size(); ++i) {
-            if (i > 0) oss << ", ";
-            oss << to[i];
-        }
-        oss << "\r\n";
-    }
-    
-    // CC
-    if (!cc.empty()) {
-        oss << "Cc: ";
-        for (size_t i = 0; i < cc.size(); ++i) {
-            if (i > 0) oss << ", ";
-            oss << cc[i];
-        }
-        oss << "\r\n";
-    }
-    
-    // Subject
-    oss << "Subject: " << subject << "\r\n";
-    
-    // Message-ID
-    oss << "Message-ID: " << generateMessageId() << "\r\n";
-    
-    // MIME-Version
-    if (hasHtmlContent() || hasAttachments()) {
-        oss << "MIME-Version: 1.0\r\n";
-    }
-    
-    // Content-Type
-    if (hasHtmlContent() && hasAttachments()) {
-        oss << "Content-Type: multipart/mixed; boundary=\"" << ssmtp_mailer::generateUniqueId() << "\"\r\n";
-    } else if (hasHtmlContent()) {
-        oss << "Content-Type: multipart/alternative; boundary=\"" << ssmtp_mailer::generateUniqueId() << "\"\r\n";
-    } else if (hasAttachments()) {
-        oss << "Content-Type: multipart/mixed; boundary=\"" << ssmtp_mailer::generateUniqueId() << "\"\r\n";
-    } else {
-        oss << "Content-Type: text/plain; charset=UTF-8\r\n";
-    }
-    
-    oss << "\r\n";
-    
-    // Body
-    if (hasHtmlContent() || hasAttachments()) {
-        // TODO: Implement MIME multipart formatting
-        oss << body;
-    } else {
-        oss << body;
-    }
-    
-    return oss.str();
+    return toMIME();
 }
 
 std::string Email::toMIME() const {
-    // For now, return RFC2822 format
-    // TODO: Implement proper MIME multipart formatting
-    return toRFC2822();
+    std::string message;
+    std::string error;
+    if (!MimeMessageStream::render(*this, generateMessageId(), message, error)) {
+        return "";
+    }
+    return message;
 }
 
 // SMTPResult static methods
@@ -274,4 +209,14 @@ SMTPResult SMTPResult::createError(const std::string& error_msg, int error_code)
     return result;
 }
 
+std::vector<RecipientStatus> SMTPResult::getRejectedRecipients() const {
+    std::vector<RecipientStatus> rejected;
+    for (const auto& recipient : recipients) {
+        if (!recipient.accepted) {
+            rejected.push_back(recipient);
+        }
+    }
+    return rejected;
+}
+
 } // namespace ssmtp_mailer
@@ -2,7 +2,10 @@
 #include "core/logging/logger.hpp"
 #include "core/config/config_manager.hpp"
 #include "core/smtp/smtp_client.hpp"
+#include "core/smtp/smtp_connection_pool.hpp"
+#include "core/smtp/direct_delivery.hpp"
 #include "core/queue/email_queue.hpp"
+#include "core/mime/prepared_message.hpp"
 // #include "core/auth/auth_manager.hpp"  // TODO: Implement AuthManager or use existing auth classes
 #include <memory>
 #include <stdexcept>
@@ -21,13 +24,17 @@ public:
     SMTPResult sendHtml(const std::string& from, const std::string& to, 
                         const std::string& subject, const std::string& body, 
                         const std::string& html_body);
+    std::shared_ptr<const PreparedMessage> prepare(const Email& email);
+    SMTPResult send(const PreparedMessage& message, const std::string& recipient);
     bool isConfigured() const;
     std::string getLastError() const;
     bool testConnection();
     
     // Queue management
-    void enqueue(const Email& email, EmailPriority priority = EmailPriority::NORMAL);
-    void startQueue();
+    EnqueueStatus enqueue(const Email& email, EmailPriority priority, std::chrono::system_clock::time_point send_at);
+    EnqueueStatus enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                          EmailPriority priority, std::chrono::system_clock::time_point send_at);
+    bool startQueue();
     void stopQueue();
     bool isQueueRunning() const;
     size_t getQueueSize() const;
@@ -37,6 +44,8 @@ public:
 private:
     std::unique_ptr<ConfigManager> config_manager_;
     std::unique_ptr<SMTPClient> smtp_client_;
+    std::unique_ptr<SMTPConnectionPool> smtp_pool_;
+    std::unique_ptr<DirectDelivery> direct_delivery_;   // Set when delivering straight to MX hosts
     std::unique_ptr<EmailQueue> email_queue_;
     // std::unique_ptr<AuthManager> auth_manager_;  // TODO: Implement AuthManager
     std::string last_error_;
@@ -45,6 +54,7 @@ private:
     bool initializeConfiguration(const std::string& config_file);
     bool validateEmailPermissions(const Email& email);
     SMTPResult sendEmailDirect(const Email& email);
+    SMTPResult sendPreparedDirect(const PreparedMessage& message, const std::string& recipient);
 };
 
 // Mailer implementation
@@ -69,6 +79,14 @@ SMTPResult Mailer::sendHtml(const std::string& from, const std::string& to,
     return pImpl->sendHtml(from, to, subject, body, html_body);
 }
 
+std::shared_ptr<const PreparedMessage> Mailer::prepare(const Email& email) {
+    return pImpl->prepare(email);
+}
+
+SMTPResult Mailer::send(const PreparedMessage& message, const std::string& recipient) {
+    return pImpl->send(message, recipient);
+}
+
 bool Mailer::isConfigured() const {
     return pImpl->isConfigured();
 }
@@ -82,12 +100,18 @@ bool Mailer::testConnection() {
 }
 
 // Queue management methods
-void Mailer::enqueue(const Email& email, EmailPriority priority) {
-    pImpl->enqueue(email, priority);
+EnqueueStatus Mailer::enqueue(const Email& email, EmailPriority priority,
+                              std::chrono::system_clock::time_point send_at) {
+    return pImpl->enqueue(email, priority, send_at);
 }
 
-void Mailer::startQueue() {
-    pImpl->startQueue();
+EnqueueStatus Mailer::enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                              EmailPriority priority, std::chrono::system_clock::time_point send_at) {
+    return pImpl->enqueue(std::move(message), recipient, priority, send_at);
+}
+
+bool Mailer::startQueue() {
+    return pImpl->startQueue();
 }
 
 void Mailer::stopQueue() {
@@ -124,13 +148,35 @@ Mailer::Impl::Impl(const std::string& config_file)
     
             try {
             smtp_client_ = std::make_unique<SMTPClient>(*config_manager_);
+            smtp_pool_ = std::make_unique<SMTPConnectionPool>(*config_manager_);
+            if (config_manager_->getGlobalConfig().direct_delivery) {
+                direct_delivery_ = std::make_unique<DirectDelivery>(*config_manager_);
+            }
             // auth_manager_ = std::make_unique<AuthManager>();  // TODO: Implement AuthManager
             email_queue_ = std::make_unique<EmailQueue>();
             
+            const GlobalConfig& global = config_manager_->getGlobalConfig();
+            if (!global.queue_dir.empty()) {
+                QueueJournalConfig journal_config;
+                journal_config.directory = global.queue_dir;
+                journal_config.sync = global.queue_sync ? JournalSync::SYNC : JournalSync::ASYNC;
+                journal_config.commit_delay = std::chrono::milliseconds(global.queue_commit_delay_ms);
+                // Hand mail to the queue process; startQueue() takes the spool over
+                journal_config.submit_only = true;
+                std::string journal_error;
+                if (!email_queue_->enablePersistence(journal_config, journal_error)) {
+                    logger.warning("Email queue is kept in memory only: " + journal_error);
+                }
+            }
+            
             // Set up the queue callback
             email_queue_->setSendCallback([this](const Email* email) -> SMTPResult {
                 return sendEmailDirect(*email);
             });
+            email_queue_->setPreparedSendCallback(
+                [this](const PreparedMessage& message, const std::string& recipient) -> SMTPResult {
+                    return sendPreparedDirect(message, recipient);
+                });
             
             is_configured_ = true;
             logger.info("Mailer initialized successfully");
@@ -189,8 +235,8 @@ SMTPResult Mailer::Impl::send(const Email& email) {
     }
     
     try {
-        // Send email using SMTP client
-        SMTPResult result = smtp_client_->send(email);
+        // Send email to the recipients' MX hosts, or over a pooled relay session
+        SMTPResult result = direct_delivery_ ? direct_delivery_->send(email) : smtp_pool_->send(email);
         
         if (result.success) {
             logger.info("Email sent successfully with message ID: " + result.message_id);
@@ -232,6 +278,45 @@ SMTPResult Mailer::Impl::sendHtml(const std::string& from, const std::string& to
     return send(email);
 }
 
+std::shared_ptr<const PreparedMessage> Mailer::Impl::prepare(const Email& email) {
+    Logger& logger = Logger::getInstance();
+    
+    std::string error;
+    std::shared_ptr<const PreparedMessage> message = PreparedMessage::create(email, error);
+    if (!message) {
+        last_error_ = "Failed to prepare email: " + error;
+        logger.error(last_error_);
+        return nullptr;
+    }
+    
+    logger.debug("Prepared email from " + email.from + " (" +
+                 std::to_string(message->getContent().size()) + " bytes)");
+    return message;
+}
+
+SMTPResult Mailer::Impl::send(const PreparedMessage& message, const std::string& recipient) {
+    Logger& logger = Logger::getInstance();
+    
+    if (!is_configured_) {
+        last_error_ = "Mailer not properly configured";
+        logger.error(last_error_);
+        return SMTPResult::createError(last_error_);
+    }
+    
+    if (!config_manager_->validateEmail(message.getSender(), std::vector<std::string>(1, recipient))) {
+        last_error_ = "Email permission validation failed";
+        logger.error(last_error_);
+        return SMTPResult::createError(last_error_);
+    }
+    
+    SMTPResult result = sendPreparedDirect(message, recipient);
+    if (!result.success) {
+        last_error_ = result.error_message;
+        logger.error("Failed to send email to " + recipient + ": " + result.error_message);
+    }
+    return result;
+}
+
 bool Mailer::Impl::isConfigured() const {
     return is_configured_ && config_manager_ && smtp_client_;
 }
@@ -271,22 +356,46 @@ bool Mailer::Impl::validateEmailPermissions(const Email& email) {
 }
 
 // Queue management implementations
-void Mailer::Impl::enqueue(const Email& email, EmailPriority priority) {
+EnqueueStatus Mailer::Impl::enqueue(const Email& email, EmailPriority priority,
+                                    std::chrono::system_clock::time_point send_at) {
     if (!email_queue_) {
         last_error_ = "Email queue not available";
-        return;
+        return EnqueueStatus::CLOSED;
     }
     
-    email_queue_->enqueue(&email, priority);
+    return email_queue_->enqueue(&email, priority, send_at);
 }
 
-void Mailer::Impl::startQueue() {
+EnqueueStatus Mailer::Impl::enqueue(std::shared_ptr<const PreparedMessage> message, const std::string& recipient,
+                                    EmailPriority priority, std::chrono::system_clock::time_point send_at) {
     if (!email_queue_) {
         last_error_ = "Email queue not available";
-        return;
+        return EnqueueStatus::CLOSED;
+    }
+    if (!message) {
+        last_error_ = "No prepared message";
+        return EnqueueStatus::CLOSED;
+    }
+    
+    return email_queue_->enqueue(std::move(message), recipient, priority, send_at);
+}
+
+bool Mailer::Impl::startQueue() {
+    if (!email_queue_) {
+        last_error_ = "Email queue not available";
+        return false;
+    }
+    if (email_queue_->isRunning()) {
+        last_error_ = "Email queue is already running";
+        return false;
     }
     
+    // Only the process that runs the queue serves the spool
+    if (!config_manager_->getGlobalConfig().queue_dir.empty() && !email_queue_->takeOverSpool(last_error_)) {
+        return false;
+    }
     email_queue_->start();
+    return true;
 }
 
 void Mailer::Impl::stopQueue() {
@@ -316,12 +425,30 @@ std::vector<QueueItem> Mailer::Impl::getFailedEmails() const {
 
 SMTPResult Mailer::Impl::sendEmailDirect(const Email& email) {
     // This method is called by the queue to send emails directly
-    if (!smtp_client_) {
+    if (!smtp_pool_) {
+        return SMTPResult::createError("SMTP client not available");
+    }
+    
+    try {
+        if (direct_delivery_) {
+            return direct_delivery_->send(email);
+        }
+        return smtp_pool_->send(email);
+    } catch (const std::exception& e) {
+        return SMTPResult::createError("Exception during email sending: " + std::string(e.what()));
+    }
+}
+
+SMTPResult Mailer::Impl::sendPreparedDirect(const PreparedMessage& message, const std::string& recipient) {
+    if (!smtp_pool_) {
         return SMTPResult::createError("SMTP client not available");
     }
     
     try {
-        return smtp_client_->send(email);
+        if (direct_delivery_) {
+            return direct_delivery_->send(message, recipient);
+        }
+        return smtp_pool_->send(message, recipient);
     } catch (const std::exception& e) {
         return SMTPResult::createError("Exception during email sending: " + std::string(e.what()));
     }
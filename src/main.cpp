@@ -1,11 +1,24 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <csignal>
+#include <thread>
 #include "simple-smtp-mailer/mailer.hpp"
 #include "simple-smtp-mailer/unified_mailer.hpp"
 #include "simple-smtp-mailer/cli_manager.hpp"
 #include "core/logging/logger.hpp"
 
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+
+void requestStop(int) {
+    stop_requested = 1;
+}
+
+} // anonymous namespace
+
 void printUsage() {
     std::cout << "\nUsage: simple-smtp-mailer [OPTIONS] [COMMAND] [ARGS...]" << std::endl;
     std::cout << "\nOptions:" << std::endl;
@@ -63,7 +76,7 @@ void printUsage() {
     std::cout << "    cli api provider list" << std::endl;
     
     std::cout << "\nQueue Subcommands:" << std::endl;
-    std::cout << "  start                Start the email processing queue" << std::endl;
+    std::cout << "  start                Process the queue until interrupted (Ctrl-C or SIGTERM)" << std::endl;
     std::cout << "  stop                 Stop the email processing queue" << std::endl;
     std::cout << "  status               Show queue status" << std::endl;
     std::cout << "  add                  Add email to queue" << std::endl;
@@ -358,9 +371,22 @@ int main(int argc, char* argv[]) {
             std::string subcommand = args[1];
             
             if (subcommand == "start") {
-                mailer.startQueue();
-                std::cout << "Email queue started" << std::endl;
+                // Serve the spool in the foreground; mail queued by other invocations is picked up
+                std::signal(SIGINT, requestStop);
+                std::signal(SIGTERM, requestStop);
+                if (!mailer.startQueue()) {
+                    std::cerr << "Error: Cannot start the email queue: " << mailer.getLastError() << std::endl;
+                    return 1;
+                }
+                std::cout << "Email queue started (" << mailer.getQueueSize() << " queued), "
+                          << "press Ctrl-C to stop" << std::endl;
                 logger.info("Email queue started");
+                while (!stop_requested) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                }
+                mailer.stopQueue();
+                std::cout << "Email queue stopped" << std::endl;
+                logger.info("Email queue stopped");
                 return 0;
                 
             } else if (subcommand == "stop") {
@@ -391,7 +417,12 @@ int main(int argc, char* argv[]) {
                 }
                 
                 ssmtp_mailer::Email email(from, to, subject, body);
-                mailer.enqueue(email);
+                ssmtp_mailer::EnqueueStatus status = mailer.enqueue(email);
+                if (status != ssmtp_mailer::EnqueueStatus::ACCEPTED) {
+                    std::cerr << "Error: " << (status == ssmtp_mailer::EnqueueStatus::FULL ?
+                                               "Queue is full" : "Queue is not accepting mail") << std::endl;
+                    return 1;
+                }
                 std::cout << "Email added to queue" << std::endl;
                 logger.info("Email queued from " + from + " to " + to);
                 return 0;
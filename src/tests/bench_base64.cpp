@@ -0,0 +1,116 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <openssl/evp.h>
+#include "utils/base64.hpp"
+#include "utils/cpu_features.hpp"
+
+using namespace ssmtp_mailer;
+
+namespace {
+
+const size_t INPUT_SIZE = 64 * 1024 * 1024;
+const size_t PIECE_SIZE = 256 * 1024;
+const int ROUNDS = 5;
+
+/**
+ * Best throughput over ROUNDS runs, in GB/s of unencoded data
+ */
+double measure(size_t bytes, const std::function<void()>& run) {
+    double best = 0;
+    for (int round = 0; round < ROUNDS; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, bytes / seconds / 1e9);
+    }
+    return best;
+}
+
+void report(const std::string& name, double gbps) {
+    std::cout << "   " << std::left << std::setw(32) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(8) << gbps << " GB/s" << std::endl;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Base64 Codec Benchmark" << std::endl;
+    std::cout << "======================" << std::endl;
+
+    const CPUFeatures& features = getCPUFeatures();
+    std::cout << "CPU: ssse3=" << features.ssse3 << " avx2=" << features.avx2
+              << " neon=" << features.neon << std::endl;
+
+    std::string input(INPUT_SIZE, '\0');
+    std::mt19937 random(1);
+    for (char& c : input) {
+        c = static_cast<char>(random());
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(input.data());
+
+    std::vector<char> encoded(base64EncodedLength(INPUT_SIZE));
+    std::vector<unsigned char> decoded(base64DecodedMaxLength(encoded.size()));
+    volatile size_t sink = 0;
+
+    std::cout << "1. Encode..." << std::endl;
+    report("scalar", measure(INPUT_SIZE, [&]() {
+        sink = base64EncodeScalar(bytes, INPUT_SIZE, encoded.data());
+    }));
+    report("dispatch", measure(INPUT_SIZE, [&]() {
+        sink = base64Encode(bytes, INPUT_SIZE, encoded.data());
+    }));
+    report("dispatch (URL-safe, unpadded)", measure(INPUT_SIZE, [&]() {
+        sink = base64Encode(bytes, INPUT_SIZE, encoded.data(), Base64Variant::URL, false);
+    }));
+    report("OpenSSL EVP_EncodeBlock", measure(INPUT_SIZE, [&]() {
+        sink = static_cast<size_t>(EVP_EncodeBlock(reinterpret_cast<unsigned char*>(encoded.data()),
+                                                   bytes, static_cast<int>(INPUT_SIZE)));
+    }));
+    report("MIME lines, 256 KiB pieces", measure(INPUT_SIZE, [&]() {
+        Base64Encoder encoder(Base64Variant::STANDARD, 76);
+        std::string output;
+        size_t total = 0;
+        for (size_t pos = 0; pos < INPUT_SIZE; pos += PIECE_SIZE) {
+            output.clear();
+            encoder.encode(input.data() + pos, std::min(PIECE_SIZE, INPUT_SIZE - pos), output);
+            total += output.size();
+        }
+        sink = total;
+    }));
+
+    size_t encoded_size = base64Encode(bytes, INPUT_SIZE, encoded.data());
+    std::string wrapped;
+    Base64Encoder mime(Base64Variant::STANDARD, 76);
+    mime.encode(input.data(), INPUT_SIZE, wrapped);
+    mime.finish(wrapped);
+
+    std::cout << "2. Decode..." << std::endl;
+    size_t written = 0;
+    report("scalar", measure(INPUT_SIZE, [&]() {
+        base64DecodeScalar(encoded.data(), encoded_size, decoded.data(), written);
+    }));
+    report("dispatch", measure(INPUT_SIZE, [&]() {
+        base64Decode(encoded.data(), encoded_size, decoded.data(), written);
+    }));
+    report("dispatch (MIME lines)", measure(INPUT_SIZE, [&]() {
+        base64Decode(wrapped.data(), wrapped.size(), decoded.data(), written);
+    }));
+    report("OpenSSL EVP_DecodeBlock", measure(INPUT_SIZE, [&]() {
+        sink = static_cast<size_t>(EVP_DecodeBlock(decoded.data(),
+                                                   reinterpret_cast<const unsigned char*>(encoded.data()),
+                                                   static_cast<int>(encoded_size)));
+    }));
+
+    bool round_trip = base64Decode(encoded.data(), encoded_size, decoded.data(), written) &&
+                      written == INPUT_SIZE && std::equal(decoded.begin(), decoded.begin() + written, bytes);
+    std::cout << (round_trip ? "✓" : "✗") << " Round trip" << std::endl;
+
+    std::cout << "\nBenchmark completed!" << std::endl;
+    return round_trip ? 0 : 1;
+}
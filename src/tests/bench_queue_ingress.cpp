@@ -0,0 +1,146 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "core/queue/email_queue.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/mpmc_ring.hpp"
+
+using namespace ssmtp_mailer;
+
+namespace {
+
+const size_t OPERATIONS_PER_RUN = 400000;
+
+/**
+ * Run producers against a consumer until every item is through; returns items per second
+ */
+template <typename Push, typename Pop>
+double measure(size_t producers, Push push, Pop pop) {
+    std::atomic<size_t> consumed(0);
+    std::atomic<bool> go(false);
+    std::thread consumer([&]() {
+        while (consumed < OPERATIONS_PER_RUN) {
+            if (pop()) {
+                consumed++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t]() {
+            while (!go) {
+                std::this_thread::yield();
+            }
+            for (size_t i = t; i < OPERATIONS_PER_RUN; i += producers) {
+                while (!push(i)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    consumer.join();
+    return OPERATIONS_PER_RUN / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& name, size_t producers, double rate, const std::string& unit) {
+    std::cout << "   " << std::left << std::setw(24) << name << std::right << std::setw(3) << producers
+              << " producers " << std::fixed << std::setprecision(0) << std::setw(11) << rate << " " << unit
+              << std::endl;
+}
+
+/**
+ * Enqueue OPERATIONS_PER_RUN emails into a running queue whose workers drop them
+ */
+double measureQueue(size_t producers, bool& ok) {
+    QueueConfig config;
+    config.max_queue_size = OPERATIONS_PER_RUN;
+    config.max_workers = 2;
+    config.max_workers_per_destination = 2;
+    EmailQueue queue(config);
+    queue.setBatchSize(64);
+    queue.setSendCallback([](const Email*) { return SMTPResult::createSuccess(); });
+    queue.start();
+
+    std::atomic<size_t> rejected(0);
+    Email email("sender@example.com", "user@example.org", "Order confirmation", "Thank you for your order.");
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < producers; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < OPERATIONS_PER_RUN; i += producers) {
+                if (queue.enqueue(&email) != EnqueueStatus::ACCEPTED) {
+                    rejected++;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    while (queue.getTotalProcessed() + rejected < OPERATIONS_PER_RUN) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    queue.close();
+    if (rejected != 0 || queue.enqueue(&email) != EnqueueStatus::CLOSED) {
+        ok = false;
+    }
+    queue.stop();
+    return OPERATIONS_PER_RUN / seconds;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Queue Ingress Contention Benchmark" << std::endl;
+    std::cout << "==================================" << std::endl;
+    const size_t producer_counts[] = {1, 2, 4, 8, 16, 32, 64};
+    bool ok = true;
+    // Workers log every send at INFO
+    Logger::getInstance().setLogLevel(LogLevel::WARNING);
+
+    std::cout << "1. Hand-over between producers and one consumer..." << std::endl;
+    for (size_t producers : producer_counts) {
+        std::mutex mutex;
+        std::deque<size_t> items;
+        report("mutex + deque", producers, measure(producers,
+            [&](size_t i) { std::lock_guard<std::mutex> lock(mutex); items.push_back(i); return true; },
+            [&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (items.empty()) {
+                    return false;
+                }
+                items.pop_front();
+                return true;
+            }), "items/s");
+
+        MpmcRing<size_t> ring(1024);
+        report("lock-free ring", producers, measure(producers,
+            [&](size_t i) { return ring.tryPush(i); },
+            [&]() { size_t i; return ring.tryPop(i); }), "items/s");
+    }
+
+    std::cout << "2. EmailQueue::enqueue() into a running queue (in memory)..." << std::endl;
+    for (size_t producers : producer_counts) {
+        report("enqueue", producers, measureQueue(producers, ok), "enqueues/s");
+    }
+
+    std::cout << (ok ? "\n✓ " : "\n✗ ") << "Benchmark completed!" << std::endl;
+    return ok ? 0 : 1;
+}
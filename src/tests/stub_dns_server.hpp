@@ -0,0 +1,227 @@
+#pragma once
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdint>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace ssmtp_mailer {
+namespace testing {
+
+inline void put16(std::string& out, uint16_t value) {
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value & 0xFF));
+}
+
+inline void put32(std::string& out, uint32_t value) {
+    put16(out, static_cast<uint16_t>(value >> 16));
+    put16(out, static_cast<uint16_t>(value & 0xFFFF));
+}
+
+inline void putName(std::string& out, const std::string& name) {
+    size_t start = 0;
+    while (start < name.size()) {
+        size_t dot = name.find('.', start);
+        size_t end = dot == std::string::npos ? name.size() : dot;
+        out.push_back(static_cast<char>(end - start));
+        out.append(name, start, end - start);
+        start = end + 1;
+    }
+    out.push_back('\0');
+}
+
+/**
+ * Minimal authoritative-style DNS server on loopback answering a fixed zone
+ */
+class StubDNSServer {
+public:
+    StubDNSServer() : fd_(-1), port_(0), running_(false) {}
+
+    ~StubDNSServer() {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool start() {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (fd_ < 0 || bind(fd_, reinterpret_cast<struct sockaddr*>(&address), length) < 0 ||
+            getsockname(fd_, reinterpret_cast<struct sockaddr*>(&address), &length) < 0) {
+            return false;
+        }
+        port_ = ntohs(address.sin_port);
+        running_ = true;
+        thread_ = std::thread([this]() { run(); });
+        return true;
+    }
+
+    int port() const { return port_; }
+
+    int queries(const std::string& name, uint16_t type) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return counts_[name + "/" + std::to_string(type)];
+    }
+
+private:
+    void run() {
+        unsigned char buffer[512];
+        while (running_) {
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            struct sockaddr_storage peer;
+            socklen_t peer_length = sizeof(peer);
+            ssize_t received = recvfrom(fd_, buffer, sizeof(buffer), 0,
+                                        reinterpret_cast<struct sockaddr*>(&peer), &peer_length);
+            if (received < 12) {
+                continue;
+            }
+
+            // Question: uncompressed name, type, class
+            std::string name;
+            size_t pos = 12;
+            while (pos < static_cast<size_t>(received) && buffer[pos] != 0) {
+                if (!name.empty()) name += '.';
+                name.append(reinterpret_cast<char*>(buffer + pos + 1), buffer[pos]);
+                pos += 1 + buffer[pos];
+            }
+            pos++;
+            uint16_t type = static_cast<uint16_t>((buffer[pos] << 8) | buffer[pos + 1]);
+            size_t question_end = pos + 4;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                counts_[name + "/" + std::to_string(type)]++;
+            }
+
+            if (name == "slow.example.test") {
+                continue;
+            }
+
+            std::string response(reinterpret_cast<char*>(buffer), question_end);
+            response[2] = static_cast<char>(0x81);              // QR, RD
+            response[3] = static_cast<char>(0x80);              // RA, NOERROR
+            response[10] = response[11] = 0;                    // No additional records
+
+            std::string answers;
+            std::string authority;
+            int answer_count = 0;
+            const uint16_t question_pointer = 0xC00C;
+
+            auto addAddress = [&](uint16_t record_type, const char* text, uint32_t ttl) {
+                unsigned char raw[16];
+                int family = record_type == 1 ? AF_INET : AF_INET6;
+                inet_pton(family, text, raw);
+                put16(answers, question_pointer);
+                put16(answers, record_type);
+                put16(answers, 1);
+                put32(answers, ttl);
+                put16(answers, record_type == 1 ? 4 : 16);
+                answers.append(reinterpret_cast<char*>(raw), record_type == 1 ? 4 : 16);
+                answer_count++;
+            };
+            auto addMX = [&](uint16_t preference, const std::string& exchange) {
+                std::string rdata;
+                put16(rdata, preference);
+                putName(rdata, exchange);
+                put16(answers, question_pointer);
+                put16(answers, 15);
+                put16(answers, 1);
+                put32(answers, 300);
+                put16(answers, static_cast<uint16_t>(rdata.size()));
+                answers += rdata;
+                answer_count++;
+            };
+            auto addSOA = [&](uint32_t minimum) {
+                std::string rdata;
+                putName(rdata, "ns.example.test");
+                putName(rdata, "hostmaster.example.test");
+                put32(rdata, 1);
+                put32(rdata, 3600);
+                put32(rdata, 600);
+                put32(rdata, 86400);
+                put32(rdata, minimum);
+                putName(authority, "example.test");
+                put16(authority, 6);
+                put16(authority, 1);
+                put32(authority, 3600);
+                put16(authority, static_cast<uint16_t>(rdata.size()));
+                authority += rdata;
+            };
+
+            if (name == "mail.example.test" && type == 1) {
+                addAddress(1, "192.0.2.10", 300);
+            } else if (name == "mail.example.test" && type == 28) {
+                addAddress(28, "2001:db8::10", 300);
+            } else if (name == "short.example.test" && type == 1) {
+                addAddress(1, "192.0.2.20", 1);
+            } else if (name == "alias.example.test") {
+                std::string rdata;
+                putName(rdata, "mail.example.test");
+                put16(answers, question_pointer);
+                put16(answers, 5);
+                put16(answers, 1);
+                put32(answers, 60);
+                put16(answers, static_cast<uint16_t>(rdata.size()));
+                answers += rdata;
+                answer_count++;
+                if (type == 1) {
+                    putName(answers, "mail.example.test");
+                    put16(answers, 1);
+                    put16(answers, 1);
+                    put32(answers, 300);
+                    put16(answers, 4);
+                    answers.append("\xC0\x00\x02\x0A", 4);
+                    answer_count++;
+                }
+            } else if (name == "example.test" && type == 15) {
+                addMX(20, "mx2.example.test");
+                addMX(10, "mx1.example.test");
+                addMX(30, "mx3.example.test");
+            } else if (name == "nullmx.example.test" && type == 15) {
+                addMX(0, "");
+            } else if (name == "missing.example.test") {
+                response[3] = static_cast<char>(0x83);          // NXDOMAIN
+                addSOA(30);
+            } else {
+                addSOA(30);                                     // NODATA
+            }
+
+            response[6] = 0;
+            response[7] = static_cast<char>(answer_count);
+            response[8] = 0;
+            response[9] = authority.empty() ? 0 : 1;
+            response += answers + authority;
+            sendto(fd_, response.data(), response.size(), 0,
+                   reinterpret_cast<struct sockaddr*>(&peer), peer_length);
+        }
+    }
+
+    int fd_;
+    int port_;
+    std::atomic<bool> running_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::map<std::string, int> counts_;
+};
+
+} // namespace testing
+} // namespace ssmtp_mailer
@@ -0,0 +1,561 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <openssl/ssl.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+namespace ssmtp_mailer {
+namespace testing {
+
+/**
+ * Scripted SMTP server on loopback recording what clients send
+ *
+ * Each connection is served by its own thread. The server advertises the
+ * configured EHLO keywords, accepts DATA and BDAT, answers RSET and QUIT,
+ * and never checks credentials. After enableTLS() it also offers STARTTLS
+ * with a self-signed certificate for 127.0.0.1 and localhost. Everything
+ * it receives is recorded so tests can check the wire protocol, not just
+ * the result.
+ */
+class StubSMTPServer {
+public:
+    /**
+     * One mail transaction as the server saw it
+     */
+    struct Message {
+        std::string sender;
+        std::vector<std::string> recipients;
+        std::string data;               // Content with dot-stuffing removed (DATA) or as sent (BDAT)
+        std::string raw;                // Content exactly as it came over the wire, without the final dot
+        size_t chunks;                  // BDAT commands; 0 when sent with DATA
+        size_t envelope_batch;          // Commands that arrived before MAIL FROM was answered
+        int connection;                 // Connection the message came in on, counted from 1
+        bool secure;                    // Received after STARTTLS
+
+        Message() : chunks(0), envelope_batch(0), connection(0), secure(false) {}
+    };
+
+    StubSMTPServer()
+        : fd_(-1), port_(0), tls_context_(nullptr), running_(false), silent_(false), connections_(0), active_(0),
+          peak_(0), tls_handshakes_(0), resumed_handshakes_(0) {}
+
+    ~StubSMTPServer() {
+        stop();
+        SSL_CTX_free(tls_context_);
+    }
+
+    /**
+     * Listen on an ephemeral loopback port (or the given one) and start accepting
+     */
+    bool start(int port = 0) {
+        fd_ = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(fd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        struct sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        socklen_t length = sizeof(address);
+        if (fd_ < 0 || bind(fd_, reinterpret_cast<struct sockaddr*>(&address), length) < 0 ||
+            listen(fd_, 64) < 0 ||
+            getsockname(fd_, reinterpret_cast<struct sockaddr*>(&address), &length) < 0) {
+            return false;
+        }
+        port_ = ntohs(address.sin_port);
+        running_ = true;
+        acceptor_ = std::thread([this]() { acceptLoop(); });
+        return true;
+    }
+
+    void stop() {
+        if (!running_.exchange(false)) {
+            return;
+        }
+        acceptor_.join();
+        std::vector<std::thread> threads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads.swap(threads_);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        close(fd_);
+        fd_ = -1;
+    }
+
+    int port() const { return port_; }
+
+    /**
+     * EHLO keywords to advertise, e.g. "PIPELINING", "CHUNKING", "AUTH PLAIN"
+     */
+    void setCapabilities(const std::vector<std::string>& capabilities) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        capabilities_ = capabilities;
+    }
+
+    /**
+     * Answer RCPT TO for this address with 550
+     */
+    void rejectRecipient(const std::string& address) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        rejected_.insert(address);
+    }
+
+    /**
+     * Text sent after "334 " in reply to AUTH CRAM-MD5, already base64-encoded
+     */
+    void setCramChallenge(const std::string& challenge) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cram_challenge_ = challenge;
+    }
+
+    /**
+     * Offer STARTTLS with a new self-signed certificate; call before start()
+     * @param max_version Highest protocol version, e.g. TLS1_2_VERSION; 0 for the library's
+     */
+    bool enableTLS(int max_version = 0) {
+        EVP_PKEY* key = nullptr;
+        EVP_PKEY_CTX* key_context = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+        bool generated = key_context && EVP_PKEY_keygen_init(key_context) > 0 &&
+                         EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_context, NID_X9_62_prime256v1) > 0 &&
+                         EVP_PKEY_keygen(key_context, &key) > 0;
+        EVP_PKEY_CTX_free(key_context);
+        if (!generated) {
+            return false;
+        }
+
+        X509* certificate = X509_new();
+        X509_set_version(certificate, 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate), -3600);
+        X509_gmtime_adj(X509_getm_notAfter(certificate), 24 * 3600);
+        X509_set_pubkey(certificate, key);
+        X509_NAME* name = X509_get_subject_name(certificate);
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                                   reinterpret_cast<const unsigned char*>("stub.example.test"), -1, -1, 0);
+        X509_set_issuer_name(certificate, name);
+        X509V3_CTX extension_context;
+        X509V3_set_ctx_nodb(&extension_context);
+        X509V3_set_ctx(&extension_context, certificate, certificate, nullptr, nullptr, 0);
+        X509_EXTENSION* alt_names = X509V3_EXT_conf_nid(nullptr, &extension_context, NID_subject_alt_name,
+                                                        "IP:127.0.0.1,DNS:localhost");
+        X509_add_ext(certificate, alt_names, -1);
+        X509_EXTENSION_free(alt_names);
+        X509_sign(certificate, key, EVP_sha256());
+
+        BIO* pem = BIO_new(BIO_s_mem());
+        PEM_write_bio_X509(pem, certificate);
+        char* data = nullptr;
+        long length = BIO_get_mem_data(pem, &data);
+        certificate_pem_.assign(data, static_cast<size_t>(length));
+        BIO_free(pem);
+
+        tls_context_ = SSL_CTX_new(TLS_server_method());
+        bool ready = tls_context_ && SSL_CTX_use_certificate(tls_context_, certificate) == 1 &&
+                     SSL_CTX_use_PrivateKey(tls_context_, key) == 1 &&
+                     (max_version == 0 || SSL_CTX_set_max_proto_version(tls_context_, max_version) == 1);
+        X509_free(certificate);
+        EVP_PKEY_free(key);
+        return ready;
+    }
+
+    /**
+     * The certificate from enableTLS() in PEM form, for a client's CA file
+     */
+    const std::string& certificatePem() const { return certificate_pem_; }
+
+    int tlsHandshakes() const { return tls_handshakes_; }
+
+    /**
+     * Handshakes that resumed an earlier session instead of a full one
+     */
+    int resumedHandshakes() const { return resumed_handshakes_; }
+
+    /**
+     * Accept connections but never send the greeting
+     */
+    void setSilent(bool silent) { silent_ = silent; }
+
+    int connections() const { return connections_; }
+
+    /**
+     * Most connections that were open at the same time
+     */
+    int peakConnections() const { return peak_; }
+
+    std::vector<Message> messages() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return messages_;
+    }
+
+    std::vector<std::string> commands() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return commands_;
+    }
+
+    size_t countCommands(const std::string& verb) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = 0;
+        for (const auto& command : commands_) {
+            if (command.compare(0, verb.size(), verb) == 0) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Wait until the server has recorded the given number of messages
+     */
+    bool waitForMessages(size_t count, std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (messages_.size() >= count) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+private:
+    /**
+     * Buffered reader over one client socket; every wait gives up once the server stops
+     */
+    class Connection {
+    public:
+        Connection(int fd, const std::atomic<bool>& running) : fd_(fd), ssl_(nullptr), running_(running), offset_(0) {}
+        ~Connection() {
+            SSL_free(ssl_);
+            close(fd_);
+        }
+
+        /**
+         * Server side of the handshake after "220 Ready to start TLS"
+         */
+        bool startTLS(SSL_CTX* context) {
+            // A handshake the client never starts must not hold up stop()
+            struct timeval timeout = {5, 0};
+            setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            ssl_ = SSL_new(context);
+            SSL_set_fd(ssl_, fd_);
+            // Plaintext sent after STARTTLS would otherwise be read as if protected
+            return offset_ == buffer_.size() && SSL_accept(ssl_) == 1;
+        }
+
+        bool secure() const { return ssl_ != nullptr; }
+
+        bool resumed() const { return ssl_ && SSL_session_reused(ssl_); }
+
+        bool readLine(std::string& line) {
+            for (;;) {
+                size_t end = buffer_.find("\r\n", offset_);
+                if (end != std::string::npos) {
+                    line = buffer_.substr(offset_, end - offset_);
+                    offset_ = end + 2;
+                    return true;
+                }
+                if (!fill()) {
+                    return false;
+                }
+            }
+        }
+
+        bool readBytes(size_t count, std::string& out) {
+            while (buffer_.size() - offset_ < count) {
+                if (!fill()) {
+                    return false;
+                }
+            }
+            out.append(buffer_, offset_, count);
+            offset_ += count;
+            return true;
+        }
+
+        /**
+         * Complete lines already received but not yet read, after waiting briefly for more
+         */
+        size_t pendingLines(std::chrono::milliseconds wait) {
+            std::this_thread::sleep_for(wait);
+            char chunk[4096];
+            while (!ssl_ || SSL_pending(ssl_) > 0 || readable(0)) {
+                ssize_t received = ssl_ ? SSL_read(ssl_, chunk, sizeof(chunk))
+                                        : recv(fd_, chunk, sizeof(chunk), MSG_DONTWAIT);
+                if (received <= 0) {
+                    break;
+                }
+                buffer_.append(chunk, static_cast<size_t>(received));
+            }
+            size_t lines = 0;
+            for (size_t pos = buffer_.find("\r\n", offset_); pos != std::string::npos;
+                 pos = buffer_.find("\r\n", pos + 2)) {
+                lines++;
+            }
+            return lines;
+        }
+
+        bool write(const std::string& data) {
+            if (ssl_) {
+                return SSL_write(ssl_, data.data(), static_cast<int>(data.size())) == static_cast<int>(data.size());
+            }
+            return send(fd_, data.data(), data.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(data.size());
+        }
+
+    private:
+        bool fill() {
+            if (offset_ > 0) {
+                buffer_.erase(0, offset_);
+                offset_ = 0;
+            }
+            char chunk[4096];
+            while (running_) {
+                // Records already decrypted do not show up as readable on the socket
+                if ((!ssl_ || SSL_pending(ssl_) == 0) && !readable(50)) {
+                    continue;
+                }
+                ssize_t received = ssl_ ? SSL_read(ssl_, chunk, sizeof(chunk)) : recv(fd_, chunk, sizeof(chunk), 0);
+                if (received <= 0) {
+                    return false;
+                }
+                buffer_.append(chunk, static_cast<size_t>(received));
+                return true;
+            }
+            return false;
+        }
+
+        bool readable(int timeout_ms) {
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            return poll(&pfd, 1, timeout_ms) > 0;
+        }
+
+        int fd_;
+        SSL* ssl_;
+        const std::atomic<bool>& running_;
+        std::string buffer_;
+        size_t offset_;
+    };
+
+    static std::string upper(const std::string& text) {
+        std::string result = text;
+        for (auto& c : result) {
+            c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+        }
+        return result;
+    }
+
+    static std::string address(const std::string& command) {
+        size_t open = command.find('<');
+        size_t close = command.find('>', open);
+        if (open == std::string::npos || close == std::string::npos) {
+            return "";
+        }
+        return command.substr(open + 1, close - open - 1);
+    }
+
+    void acceptLoop() {
+        while (running_) {
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+            int client = accept(fd_, nullptr, nullptr);
+            if (client < 0) {
+                continue;
+            }
+            int id = ++connections_;
+            std::lock_guard<std::mutex> lock(mutex_);
+            threads_.emplace_back([this, client, id]() { serve(client, id); });
+        }
+    }
+
+    void serve(int fd, int id) {
+        Connection connection(fd, running_);
+        int active = ++active_;
+        for (int peak = peak_; active > peak && !peak_.compare_exchange_weak(peak, active);) {
+        }
+        struct Leave {
+            std::atomic<int>& active;
+            ~Leave() { active--; }
+        } leave{active_};
+
+        if (silent_) {
+            std::string ignored;
+            while (connection.readLine(ignored)) {
+            }
+            return;
+        }
+        connection.write("220 stub.example.test ESMTP\r\n");
+
+        Message message;
+        bool in_transaction = false;
+        std::string line;
+        while (connection.readLine(line)) {
+            std::string command = upper(line);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                commands_.push_back(line);
+            }
+
+            if (command.compare(0, 4, "EHLO") == 0) {
+                std::vector<std::string> capabilities;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    capabilities = capabilities_;
+                }
+                if (tls_context_ && !connection.secure()) {
+                    capabilities.push_back("STARTTLS");
+                }
+                std::string reply = "250";
+                reply += capabilities.empty() ? " " : "-";
+                reply += "stub.example.test\r\n";
+                for (size_t i = 0; i < capabilities.size(); ++i) {
+                    reply += (i + 1 == capabilities.size() ? "250 " : "250-") + capabilities[i] + "\r\n";
+                }
+                connection.write(reply);
+            } else if (command == "STARTTLS" && tls_context_ && !connection.secure()) {
+                connection.write("220 Ready to start TLS\r\n");
+                if (!connection.startTLS(tls_context_)) {
+                    return;
+                }
+                tls_handshakes_++;
+                resumed_handshakes_ += connection.resumed() ? 1 : 0;
+                // The session starts over after the upgrade (RFC 3207 section 4.2)
+                in_transaction = false;
+            } else if (command.compare(0, 4, "HELO") == 0 || command.compare(0, 4, "NOOP") == 0) {
+                connection.write("250 OK\r\n");
+            } else if (command == "AUTH CRAM-MD5") {
+                std::string challenge;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    challenge = cram_challenge_;
+                }
+                connection.write("334 " + challenge + "\r\n");
+                std::string reply;
+                if (!connection.readLine(reply)) {
+                    return;
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    commands_.push_back(reply);
+                }
+                connection.write(reply == "*" ? "501 Authentication cancelled\r\n"
+                                              : "235 Authentication successful\r\n");
+            } else if (command.compare(0, 4, "AUTH") == 0) {
+                connection.write("235 Authentication successful\r\n");
+            } else if (command.compare(0, 10, "MAIL FROM:") == 0) {
+                message = Message();
+                message.sender = address(line);
+                message.connection = id;
+                message.secure = connection.secure();
+                message.envelope_batch = 1 + connection.pendingLines(std::chrono::milliseconds(20));
+                in_transaction = true;
+                connection.write("250 OK\r\n");
+            } else if (command.compare(0, 8, "RCPT TO:") == 0) {
+                std::string recipient = address(line);
+                bool rejected;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    rejected = rejected_.count(recipient) > 0;
+                }
+                if (rejected) {
+                    connection.write("550 No such user\r\n");
+                } else {
+                    message.recipients.push_back(recipient);
+                    connection.write("250 OK\r\n");
+                }
+            } else if (command == "DATA") {
+                if (!in_transaction || message.recipients.empty()) {
+                    connection.write("554 No valid recipients\r\n");
+                    continue;
+                }
+                connection.write("354 End data with <CR><LF>.<CR><LF>\r\n");
+                std::string data_line;
+                bool complete = false;
+                while (connection.readLine(data_line)) {
+                    if (data_line == ".") {
+                        complete = true;
+                        break;
+                    }
+                    message.raw += data_line + "\r\n";
+                    message.data += (data_line[0] == '.' ? data_line.substr(1) : data_line) + "\r\n";
+                }
+                if (!complete) {
+                    return;
+                }
+                record(message);
+                in_transaction = false;
+                connection.write("250 OK queued\r\n");
+            } else if (command.compare(0, 5, "BDAT ") == 0) {
+                size_t size = static_cast<size_t>(strtoul(line.c_str() + 5, nullptr, 10));
+                bool last = command.find(" LAST") != std::string::npos;
+                if (!connection.readBytes(size, message.raw)) {
+                    return;
+                }
+                message.chunks++;
+                if (last) {
+                    message.data = message.raw;
+                    record(message);
+                    in_transaction = false;
+                    connection.write("250 OK queued\r\n");
+                } else {
+                    connection.write("250 " + std::to_string(size) + " octets received\r\n");
+                }
+            } else if (command == "RSET") {
+                in_transaction = false;
+                connection.write("250 OK\r\n");
+            } else if (command == "QUIT") {
+                connection.write("221 Bye\r\n");
+                return;
+            } else {
+                connection.write("502 Command not implemented\r\n");
+            }
+        }
+    }
+
+    void record(const Message& message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        messages_.push_back(message);
+    }
+
+    int fd_;
+    int port_;
+    SSL_CTX* tls_context_;
+    std::string certificate_pem_;
+    std::atomic<bool> running_;
+    std::atomic<bool> silent_;
+    std::atomic<int> connections_;
+    std::atomic<int> active_;
+    std::atomic<int> peak_;
+    std::atomic<int> tls_handshakes_;
+    std::atomic<int> resumed_handshakes_;
+    std::thread acceptor_;
+    std::mutex mutex_;
+    std::vector<std::thread> threads_;
+    std::vector<std::string> capabilities_;
+    std::set<std::string> rejected_;
+    std::string cram_challenge_;
+    std::vector<Message> messages_;
+    std::vector<std::string> commands_;
+};
+
+} // namespace testing
+} // namespace ssmtp_mailer
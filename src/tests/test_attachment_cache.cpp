@@ -0,0 +1,264 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <memory>
+#include <filesystem>
+#include <chrono>
+#include <cstdlib>
+#include "core/mime/attachment_cache.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+const size_t DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+
+std::string fileContent(size_t size, int seed) {
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; ++i) {
+        content[i] = static_cast<char>(i * 31 + seed);
+    }
+    return content;
+}
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << content;
+}
+
+/**
+ * Body of the attachment part of a message rendered without the cache
+ */
+std::string streamedBase64(const std::string& path) {
+    AttachmentCache& cache = AttachmentCache::getInstance();
+    cache.setMaxBytes(0);
+    Email email("sender@example.com", "user@example.org", "Subject", "Body");
+    email.attachments = {path};
+    std::string rendered;
+    std::string error;
+    MimeMessageStream::render(email, "<id@example.com>", rendered, error);
+    cache.setMaxBytes(DEFAULT_MAX_BYTES);
+
+    // The part body runs from its blank line to the CRLF before the closing delimiter
+    size_t start = rendered.find("Content-Transfer-Encoding: base64\r\n\r\n");
+    size_t end = rendered.rfind("\r\n--");
+    if (start == std::string::npos || end == std::string::npos) {
+        return "<not found>";
+    }
+    start += 37;
+    // The CRLF that ends the last line also precedes the delimiter
+    return rendered.substr(start, end + 2 - start);
+}
+
+bool sameFile(const std::shared_ptr<const std::string>& a, const std::shared_ptr<const std::string>& b) {
+    return a && a == b;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Attachment Cache" << std::endl;
+    std::cout << "========================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_attachment_cache_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a directory for attachments" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+    AttachmentCache& cache = AttachmentCache::getInstance();
+    std::string error;
+
+    std::cout << "1. Same text as MimeMessageStream..." << std::endl;
+    {
+        bool same = true;
+        std::string failed;
+        // Partial and whole lines, and more than one 57 KiB encoding block
+        for (size_t size : {size_t(1), size_t(2), size_t(56), size_t(57), size_t(58), size_t(5000),
+                            size_t(57 * 1024), size_t(57 * 1024 + 1), size_t(200000)}) {
+            std::string path = root + "/file" + std::to_string(size) + ".bin";
+            writeFile(path, fileContent(size, 1));
+            std::shared_ptr<const std::string> encoded;
+            if (!cache.getEncoded(path, encoded, error) || !encoded || *encoded != streamedBase64(path)) {
+                same = false;
+                failed += " " + std::to_string(size);
+            }
+        }
+        check(same, "cached text identical to the streamed encoding" + (failed.empty() ? "" : ", not for" + failed));
+
+        std::string path = root + "/empty.bin";
+        writeFile(path, "");
+        std::shared_ptr<const std::string> encoded;
+        check(cache.getEncoded(path, encoded, error) && encoded && encoded->empty(), "empty file encodes to nothing");
+
+        std::shared_ptr<const std::string> missing;
+        check(!cache.getEncoded(root + "/missing.bin", missing, error) && !missing && !error.empty(),
+              "missing file reported");
+    }
+
+    std::cout << "2. Hits..." << std::endl;
+    {
+        cache.clear();
+        std::string path = root + "/hit.bin";
+        writeFile(path, fileContent(3000, 2));
+        AttachmentCacheStats before = cache.getStats();
+        std::shared_ptr<const std::string> first;
+        std::shared_ptr<const std::string> second;
+        cache.getEncoded(path, first, error);
+        cache.getEncoded(path, second, error);
+        AttachmentCacheStats after = cache.getStats();
+        check(sameFile(first, second), "second lookup returns the cached text itself");
+        check(after.misses == before.misses + 1 && after.hits == before.hits + 1 && after.entries == 1,
+              "one miss, then one hit");
+
+        cache.clear();
+        check(first && first->size() > 4000 && cache.getStats().entries == 0 && cache.getStats().bytes == 0,
+              "holders keep the text after the entry is dropped");
+    }
+
+    std::cout << "3. Size limits..." << std::endl;
+    {
+        cache.clear();
+        std::string path = root + "/large.bin";
+        writeFile(path, fileContent(3000, 3));
+
+        cache.setMaxEntryBytes(1000);
+        std::shared_ptr<const std::string> encoded;
+        check(cache.getEncoded(path, encoded, error) && !encoded && cache.getStats().entries == 0,
+              "file over max_entry_bytes returns nullptr and is not cached");
+        cache.setMaxEntryBytes(8 * 1024 * 1024);
+
+        cache.setMaxBytes(1000);
+        check(cache.getEncoded(path, encoded, error) && !encoded && cache.getStats().entries == 0,
+              "file over max_bytes returns nullptr too");
+
+        cache.setMaxBytes(0);
+        cache.setBlobId(path, "provider", "blob");
+        std::string blob;
+        check(cache.getStats().entries == 0 && !cache.getBlobId(path, "provider", blob),
+              "max_bytes 0 disables caching");
+        cache.setMaxBytes(DEFAULT_MAX_BYTES);
+    }
+
+    std::cout << "4. Least recently used eviction..." << std::endl;
+    {
+        cache.clear();
+        std::string paths[5];
+        for (int i = 0; i < 5; ++i) {
+            paths[i] = root + "/lru" + std::to_string(i) + ".bin";
+            writeFile(paths[i], fileContent(3000, 10 + i));
+        }
+        std::shared_ptr<const std::string> encoded;
+        cache.getEncoded(paths[0], encoded, error);
+        size_t entry_bytes = cache.getStats().bytes;
+
+        // Room for three entries
+        size_t budget = entry_bytes * 3 + entry_bytes / 2;
+        cache.setMaxBytes(budget);
+        AttachmentCacheStats before = cache.getStats();
+        cache.getEncoded(paths[1], encoded, error);
+        cache.getEncoded(paths[2], encoded, error);
+        check(cache.getStats().entries == 3 && cache.getStats().evictions == before.evictions, "three entries fit");
+
+        // Touch the oldest, so the next insert evicts the second
+        cache.getEncoded(paths[0], encoded, error);
+        before = cache.getStats();
+        cache.getEncoded(paths[3], encoded, error);
+        AttachmentCacheStats after = cache.getStats();
+        check(after.entries == 3 && after.evictions == before.evictions + 1 && after.bytes <= budget,
+              "fourth entry evicts one and stays within max_bytes");
+
+        before = cache.getStats();
+        cache.getEncoded(paths[0], encoded, error);
+        cache.getEncoded(paths[2], encoded, error);
+        cache.getEncoded(paths[3], encoded, error);
+        after = cache.getStats();
+        check(after.hits == before.hits + 3 && after.misses == before.misses, "recently used entries kept");
+
+        before = cache.getStats();
+        cache.getEncoded(paths[1], encoded, error);
+        after = cache.getStats();
+        check(after.misses == before.misses + 1, "least recently used entry was the one evicted");
+
+        bool within = true;
+        for (int round = 0; round < 3; ++round) {
+            for (const std::string& path : paths) {
+                cache.getEncoded(path, encoded, error);
+                within = within && cache.getStats().bytes <= budget && cache.getStats().entries <= 3;
+            }
+        }
+        check(within, "bytes never exceed max_bytes");
+
+        cache.setMaxBytes(entry_bytes + entry_bytes / 2);
+        check(cache.getStats().entries == 1 && cache.getStats().bytes <= entry_bytes + entry_bytes / 2,
+              "lowering max_bytes evicts at once");
+        cache.setMaxBytes(DEFAULT_MAX_BYTES);
+    }
+
+    std::cout << "5. Changed files..." << std::endl;
+    {
+        cache.clear();
+        std::string path = root + "/changing.bin";
+        writeFile(path, fileContent(3000, 20));
+        std::shared_ptr<const std::string> original;
+        cache.getEncoded(path, original, error);
+
+        // Same size, new content and a later modification time
+        writeFile(path, fileContent(3000, 21));
+        fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(2));
+        AttachmentCacheStats before = cache.getStats();
+        std::shared_ptr<const std::string> rewritten;
+        cache.getEncoded(path, rewritten, error);
+        check(cache.getStats().misses == before.misses + 1 && rewritten && *rewritten != *original &&
+              *rewritten == streamedBase64(path), "new modification time misses and encodes the new content");
+
+        // Different size, modification time left as it was
+        fs::file_time_type mtime = fs::last_write_time(path);
+        writeFile(path, fileContent(3001, 21));
+        fs::last_write_time(path, mtime);
+        before = cache.getStats();
+        std::shared_ptr<const std::string> grown;
+        cache.getEncoded(path, grown, error);
+        check(cache.getStats().misses == before.misses + 1 && grown && *grown != *rewritten,
+              "new size misses even with the same modification time");
+    }
+
+    std::cout << "6. Blob IDs..." << std::endl;
+    {
+        cache.clear();
+        std::string path = root + "/upload.bin";
+        writeFile(path, fileContent(1000, 30));
+        std::string blob;
+
+        check(!cache.getBlobId(path, "gmail-api:alice@example.com", blob), "unknown before an upload");
+        cache.setBlobId(path, "gmail-api:alice@example.com", "blob-alice");
+        cache.setBlobId(path, "graph-api:alice@example.com", "blob-graph");
+        check(cache.getBlobId(path, "gmail-api:alice@example.com", blob) && blob == "blob-alice",
+              "found for the provider key that uploaded it");
+        check(!cache.getBlobId(path, "gmail-api:bob@example.com", blob),
+              "not shared with another account of the same provider");
+        check(cache.getBlobId(path, "graph-api:alice@example.com", blob) && blob == "blob-graph",
+              "each provider keeps its own ID");
+
+        std::shared_ptr<const std::string> encoded;
+        cache.getEncoded(path, encoded, error);
+        check(cache.getStats().entries == 1 && cache.getBlobId(path, "gmail-api:alice@example.com", blob),
+              "blob IDs and encoded text share the file's entry");
+
+        writeFile(path, fileContent(1000, 31));
+        fs::last_write_time(path, fs::last_write_time(path) + std::chrono::seconds(2));
+        check(!cache.getBlobId(path, "gmail-api:alice@example.com", blob),
+              "a changed file needs a new upload");
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
@@ -0,0 +1,232 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include "utils/base64.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+// Longest input compared, long enough for several passes of every vector loop
+const size_t MAX_LENGTH = 200;
+
+// Start offsets tried for input and output buffers
+const size_t MAX_OFFSET = 4;
+
+const char* kernelName(Base64Kernel kernel) {
+    switch (kernel) {
+    case Base64Kernel::SCALAR:
+        return "scalar";
+    case Base64Kernel::SSSE3:
+        return "SSSE3";
+    case Base64Kernel::AVX2:
+        return "AVX2";
+    case Base64Kernel::NEON:
+        return "NEON";
+    }
+    return "?";
+}
+
+std::vector<unsigned char> randomBytes(size_t length) {
+    std::mt19937 random(12345);
+    std::vector<unsigned char> bytes(length);
+    for (unsigned char& byte : bytes) {
+        byte = static_cast<unsigned char>(random());
+    }
+    return bytes;
+}
+
+std::string encodeWith(Base64Kernel kernel, const unsigned char* input, size_t length,
+                       Base64Variant variant, bool padding, size_t offset) {
+    std::vector<char> buffer(offset + base64EncodedLength(length, padding));
+    size_t written = base64EncodeWith(kernel, input, length, buffer.data() + offset, variant, padding);
+    return std::string(buffer.data() + offset, written);
+}
+
+/**
+ * Decoded bytes, or "<invalid>" if the kernel rejected the input
+ */
+std::string decodeWith(Base64Kernel kernel, const std::string& text, Base64Variant variant, size_t offset) {
+    std::string input(offset, '\0');
+    input += text;
+    std::vector<unsigned char> buffer(offset + base64DecodedMaxLength(text.size()));
+    size_t written = 0;
+    if (!base64DecodeWith(kernel, input.data() + offset, text.size(), buffer.data() + offset, written, variant)) {
+        return "<invalid>";
+    }
+    return std::string(reinterpret_cast<const char*>(buffer.data() + offset), written);
+}
+
+/**
+ * Split encoded text into lines of line_length characters, each ending in CRLF
+ */
+std::string wrap(const std::string& text, size_t line_length) {
+    std::string wrapped;
+    for (size_t pos = 0; pos < text.size(); pos += line_length) {
+        wrapped += text.substr(pos, line_length) + "\r\n";
+    }
+    return wrapped;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Base64" << std::endl;
+    std::cout << "==============" << std::endl;
+
+    const std::vector<Base64Kernel> kernels = base64Kernels();
+    const std::vector<unsigned char> data = randomBytes(MAX_LENGTH + MAX_OFFSET);
+    const Base64Variant variants[] = {Base64Variant::STANDARD, Base64Variant::URL};
+
+    std::cout << "Kernels:";
+    for (Base64Kernel kernel : kernels) {
+        std::cout << " " << kernelName(kernel);
+    }
+    std::cout << std::endl;
+
+    std::cout << "1. RFC 4648 test vectors..." << std::endl;
+    {
+        const char* vectors[][2] = {
+            {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+            {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}
+        };
+        for (Base64Kernel kernel : kernels) {
+            bool ok = true;
+            for (const auto& vector : vectors) {
+                std::string plain = vector[0];
+                const unsigned char* bytes = reinterpret_cast<const unsigned char*>(plain.data());
+                ok = ok && encodeWith(kernel, bytes, plain.size(), Base64Variant::STANDARD, true, 0) == vector[1] &&
+                     decodeWith(kernel, vector[1], Base64Variant::STANDARD, 0) == plain;
+            }
+            check(ok, std::string(kernelName(kernel)) + " encodes and decodes the examples");
+        }
+        check(base64UrlEncode("\xfb\xff\xbf") == "-_-_" && base64Encode("\xfb\xff\xbf") == "+/+/",
+              "URL alphabet replaces + and /");
+    }
+
+    std::cout << "2. Encoding matches the scalar code..." << std::endl;
+    for (Base64Kernel kernel : kernels) {
+        size_t mismatches = 0;
+        for (Base64Variant variant : variants) {
+            for (bool padding : {true, false}) {
+                for (size_t length = 0; length <= MAX_LENGTH; ++length) {
+                    for (size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+                        const unsigned char* input = data.data() + offset;
+                        std::string expected = encodeWith(Base64Kernel::SCALAR, input, length, variant, padding, 0);
+                        if (encodeWith(kernel, input, length, variant, padding, MAX_OFFSET - 1 - offset) != expected) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+        }
+        check(mismatches == 0, std::string(kernelName(kernel)) +
+              " output identical for lengths 0-200, both alphabets, with and without padding, misaligned");
+    }
+
+    std::cout << "3. Decoding matches the scalar code..." << std::endl;
+    for (Base64Kernel kernel : kernels) {
+        size_t mismatches = 0;
+        for (Base64Variant variant : variants) {
+            for (bool padding : {true, false}) {
+                for (size_t length = 0; length <= MAX_LENGTH; ++length) {
+                    std::string plain(reinterpret_cast<const char*>(data.data()), length);
+                    std::string text = encodeWith(Base64Kernel::SCALAR, data.data(), length, variant, padding, 0);
+                    for (size_t offset = 0; offset < MAX_OFFSET; ++offset) {
+                        if (decodeWith(kernel, text, variant, offset) != plain ||
+                            decodeWith(kernel, wrap(text, 76), variant, offset) != plain) {
+                            mismatches++;
+                        }
+                    }
+                }
+            }
+        }
+        check(mismatches == 0, std::string(kernelName(kernel)) +
+              " round-trips lengths 0-200, both alphabets, padded or not, wrapped or not, misaligned");
+    }
+
+    std::cout << "4. Invalid input..." << std::endl;
+    {
+        std::string text = encodeWith(Base64Kernel::SCALAR, data.data(), 150, Base64Variant::STANDARD, true, 0);
+        for (Base64Kernel kernel : kernels) {
+            // A bad character anywhere, including inside blocks the vector loops take
+            size_t accepted = 0;
+            for (size_t pos = 0; pos < text.size(); ++pos) {
+                for (char bad : {'*', '-', '\0', '\x80'}) {
+                    std::string corrupt = text;
+                    corrupt[pos] = bad;
+                    if (decodeWith(kernel, corrupt, Base64Variant::STANDARD, 0) != "<invalid>") {
+                        accepted++;
+                    }
+                }
+            }
+            std::string name = kernelName(kernel);
+            check(accepted == 0, name + " rejects a character outside the alphabet at every position");
+
+            std::string url = encodeWith(Base64Kernel::SCALAR, data.data(), 150, Base64Variant::URL, false, 0);
+            bool has_standard_only = text.find_first_of("+/") != std::string::npos;
+            check(!has_standard_only || decodeWith(kernel, text, Base64Variant::URL, 0) == "<invalid>",
+                  name + " rejects + and / in URL-safe input");
+            check(url.find_first_of("-_") == std::string::npos ||
+                  decodeWith(kernel, url, Base64Variant::STANDARD, 0) == "<invalid>",
+                  name + " rejects - and _ in standard input");
+
+            check(decodeWith(kernel, "Zm9vY", Base64Variant::STANDARD, 0) == "<invalid>" &&
+                  decodeWith(kernel, "Zm9vY===", Base64Variant::STANDARD, 0) == "<invalid>",
+                  name + " rejects a lone character in the last group");
+            check(decodeWith(kernel, "Zg==Zm8=", Base64Variant::STANDARD, 0) == "<invalid>" &&
+                  decodeWith(kernel, text.substr(0, 8) + "=" + text.substr(8), Base64Variant::STANDARD, 0) ==
+                      "<invalid>",
+                  name + " rejects data after padding");
+            check(decodeWith(kernel, "Zg== \r\n", Base64Variant::STANDARD, 0) == "f" &&
+                  decodeWith(kernel, "Zg", Base64Variant::STANDARD, 0) == "f",
+                  name + " accepts whitespace after padding and missing padding");
+        }
+    }
+
+    std::cout << "5. Line-wrapped encoder..." << std::endl;
+    {
+        for (Base64Variant variant : variants) {
+            for (size_t line_length : {size_t(0), size_t(4), size_t(76)}) {
+                size_t mismatches = 0;
+                for (size_t length = 0; length <= MAX_LENGTH; ++length) {
+                    std::string plain(reinterpret_cast<const char*>(data.data()), length);
+                    std::string text = encodeWith(Base64Kernel::SCALAR, data.data(), length, variant, true, 0);
+                    std::string expected = line_length > 0 ? wrap(text, line_length) : text;
+
+                    // Feed the input in pieces of every size from 1 to 7 bytes
+                    for (size_t piece = 1; piece <= 7; ++piece) {
+                        Base64Encoder encoder(variant, line_length);
+                        std::string output;
+                        for (size_t pos = 0; pos < length; pos += piece) {
+                            encoder.encode(plain.data() + pos, std::min(piece, length - pos), output);
+                        }
+                        encoder.finish(output);
+                        if (output != expected) {
+                            mismatches++;
+                        }
+                    }
+                }
+                check(mismatches == 0, std::string(variant == Base64Variant::URL ? "URL" : "standard") +
+                      " alphabet, line length " + std::to_string(line_length) +
+                      ": pieces encode like the whole input, every line ends in CRLF");
+            }
+        }
+
+        Base64Encoder encoder(Base64Variant::STANDARD, 76);
+        std::string first;
+        std::string second;
+        encoder.encode("abcd", 4, first);
+        encoder.reset();
+        encoder.encode("foo", 3, second);
+        encoder.finish(second);
+        check(first == "YWJj" && second == "Zm9v\r\n", "reset() drops held-back bytes and the line position");
+    }
+
+    return summary();
+}
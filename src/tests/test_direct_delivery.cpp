@@ -0,0 +1,142 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unistd.h>
+#include "core/smtp/direct_delivery.hpp"
+#include "core/logging/logger.hpp"
+#include "stub_dns_server.hpp"
+#include "stub_smtp_server.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::StubDNSServer;
+using ssmtp_mailer::testing::StubSMTPServer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+const RecipientStatus* findStatus(const SMTPResult& result, const std::string& address) {
+    for (const auto& status : result.recipients) {
+        if (status.address == address) {
+            return &status;
+        }
+    }
+    return nullptr;
+}
+
+std::string messageIdOf(const std::string& data) {
+    size_t start = data.find("Message-ID: ");
+    if (start == std::string::npos) {
+        return "";
+    }
+    return data.substr(start, data.find("\r\n", start) - start);
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Direct Delivery" << std::endl;
+    std::cout << "=======================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    StubDNSServer dns;
+    StubSMTPServer smtp;
+    if (!dns.start() || !smtp.start()) {
+        std::cout << "   ✗ Failed to start stub servers" << std::endl;
+        return 1;
+    }
+
+    // mx1 (preference 10) refuses connections, mx2 and the implicit MX reach the stub
+    char hosts[] = "/tmp/test_direct_delivery_XXXXXX";
+    int fd = mkstemp(hosts);
+    if (fd >= 0) {
+        close(fd);
+    }
+    {
+        std::ofstream file(hosts);
+        file << "127.0.0.2 mx1.example.test\n"
+             << "127.0.0.1 mx2.example.test nomx.example.test\n";
+    }
+
+    DNSResolverConfig resolver_config;
+    resolver_config.nameservers.push_back("127.0.0.1:" + std::to_string(dns.port()));
+    resolver_config.timeout = std::chrono::milliseconds(200);
+    resolver_config.attempts = 1;
+    resolver_config.hosts_file = hosts;
+    DNSResolver resolver(resolver_config);
+    unlink(hosts);
+
+    ConfigManager config;
+    DirectDeliveryConfig delivery_config;
+    delivery_config.port = smtp.port();
+    delivery_config.resolver = &resolver;
+    delivery_config.max_connections_per_domain = 2;
+    delivery_config.max_recipients_per_transaction = 2;
+    DirectDelivery delivery(config, delivery_config);
+
+    std::cout << "1. Grouping by domain..." << std::endl;
+    std::vector<std::string> invalid;
+    std::vector<DomainGroup> groups = DirectDelivery::groupByDomain(
+        {"a@Example.Test", "b@other.test", "c@example.test", "broken"}, invalid);
+    check(groups.size() == 2 && groups[0].domain == "example.test" && groups[0].recipients.size() == 2 &&
+          groups[1].domain == "other.test", "domains compared case-insensitively, in first-seen order");
+    check(invalid.size() == 1 && invalid[0] == "broken", "address without a domain reported");
+
+    std::cout << "2. Falling back to the next exchanger..." << std::endl;
+    Email single("sender@example.com", "user@example.test", "Fallback", "Body");
+    SMTPResult fallback = delivery.send(single);
+    check(fallback.success, "delivered through mx2 after mx1 refused");
+    check(smtp.messages().size() == 1 && smtp.messages()[0].recipients.size() == 1 &&
+          smtp.messages()[0].recipients[0] == "user@example.test", "stub received the message");
+
+    std::cout << "3. Fan-out across domains..." << std::endl;
+    Email fanout("sender@example.com",
+                 std::vector<std::string>{"one@example.test", "two@nomx.example.test",
+                                          "three@missing.example.test", "four@example.test"},
+                 "Fan-out", "Body");
+    size_t before = smtp.messages().size();
+    SMTPResult spread = delivery.send(fanout);
+    check(spread.success, "delivered to the reachable domains");
+    check(spread.recipients.size() == 4, "one status per recipient");
+    const RecipientStatus* missing = findStatus(spread, "three@missing.example.test");
+    check(missing && !missing->accepted, "unresolvable domain reported as failed");
+    const RecipientStatus* one = findStatus(spread, "one@example.test");
+    const RecipientStatus* two = findStatus(spread, "two@nomx.example.test");
+    check(one && one->accepted && two && two->accepted, "recipients of reachable domains accepted");
+    std::vector<StubSMTPServer::Message> messages = smtp.messages();
+    check(messages.size() == before + 2, "one transaction per reachable domain");
+    if (messages.size() == before + 2) {
+        std::string id = messageIdOf(messages[before].data);
+        check(!id.empty() && id == messageIdOf(messages[before + 1].data), "transactions share the Message-ID");
+        check(id.find(spread.message_id) != std::string::npos, "result carries the Message-ID");
+    }
+
+    std::cout << "4. Recipient and per-domain connection limits..." << std::endl;
+    std::vector<std::string> many;
+    for (int i = 0; i < 12; ++i) {
+        many.push_back("user" + std::to_string(i) + "@nomx.example.test");
+    }
+    Email bulk("sender@example.com", many, "Bulk", "Body");
+    before = smtp.messages().size();
+    SMTPResult limited = delivery.send(bulk);
+    messages = smtp.messages();
+    check(limited.success && limited.recipients.size() == 12, "every recipient delivered");
+    check(messages.size() == before + 6, "split into transactions of two recipients");
+    bool within_limit = true;
+    for (size_t i = before; i < messages.size(); ++i) {
+        within_limit = within_limit && messages[i].recipients.size() <= 2;
+    }
+    check(within_limit, "no transaction exceeds the recipient limit");
+    check(smtp.peakConnections() <= 2, "no more than two connections to one domain at a time");
+
+    std::cout << "5. Nothing deliverable..." << std::endl;
+    Email nowhere("sender@example.com", "user@missing.example.test", "Nowhere", "Body");
+    SMTPResult failed = delivery.send(nowhere);
+    check(!failed.success && failed.recipients.size() == 1 && !failed.recipients[0].accepted,
+          "failure reported with the recipient status");
+
+    return summary();
+}
@@ -0,0 +1,227 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/rsa.h>
+#include "core/dkim/dkim_signer.hpp"
+#include "utils/base64.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+/**
+ * Body hash of a message fed in pieces of the given size (0 = all at once)
+ */
+std::string bodyHash(const std::string& body, size_t piece) {
+    DKIMBodyHasher hasher;
+    if (piece == 0) {
+        hasher.update(body.data(), body.size());
+    } else {
+        for (size_t offset = 0; offset < body.size(); offset += piece) {
+            hasher.update(body.data() + offset, std::min(piece, body.size() - offset));
+        }
+    }
+    return hasher.finish();
+}
+
+bool hashesTo(const std::string& body, const std::string& expected) {
+    return bodyHash(body, 0) == expected && bodyHash(body, 1) == expected && bodyHash(body, 3) == expected;
+}
+
+/**
+ * Generate a key and write it as PEM; returns the key for verification
+ */
+EVP_PKEY* generateKey(int type, const std::string& path) {
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_CTX* context = EVP_PKEY_CTX_new_id(type, nullptr);
+    if (context && EVP_PKEY_keygen_init(context) == 1 &&
+        (type != EVP_PKEY_RSA || EVP_PKEY_CTX_set_rsa_keygen_bits(context, 2048) == 1)) {
+        EVP_PKEY_keygen(context, &key);
+    }
+    EVP_PKEY_CTX_free(context);
+
+    FILE* file = key ? fopen(path.c_str(), "w") : nullptr;
+    if (!file || PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr) != 1) {
+        EVP_PKEY_free(key);
+        key = nullptr;
+    }
+    if (file) {
+        fclose(file);
+    }
+    return key;
+}
+
+/**
+ * Relaxed header canonicalisation of a value, written independently of the signer
+ */
+std::string relax(const std::string& value) {
+    std::string result;
+    bool space = false;
+    for (char c : value) {
+        if (c == '\r' || c == '\n') {
+            continue;
+        }
+        if (c == ' ' || c == '\t') {
+            space = true;
+            continue;
+        }
+        if (space && !result.empty()) {
+            result += ' ';
+        }
+        space = false;
+        result += c;
+    }
+    return result;
+}
+
+std::string tag(const std::string& value, const std::string& name) {
+    std::string relaxed = relax(value);
+    size_t start = 0;
+    while (start < relaxed.size()) {
+        size_t end = relaxed.find(';', start);
+        std::string item = relaxed.substr(start, end == std::string::npos ? std::string::npos : end - start);
+        size_t first = item.find_first_not_of(' ');
+        if (first != std::string::npos && item.compare(first, name.size() + 1, name + "=") == 0) {
+            return item.substr(first + name.size() + 1);
+        }
+        if (end == std::string::npos) {
+            break;
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+/**
+ * Verify a DKIM-Signature header over the expected canonical headers (RFC 6376 section 3.7)
+ */
+bool verify(EVP_PKEY* key, bool ed25519, const std::string& signature, const std::string& canonical_headers) {
+    const std::string prefix = "DKIM-Signature: ";
+    if (signature.compare(0, prefix.size(), prefix) != 0 || signature.size() < 2 ||
+        signature.compare(signature.size() - 2, 2, "\r\n") != 0) {
+        return false;
+    }
+    std::string value = signature.substr(prefix.size(), signature.size() - prefix.size() - 2);
+    size_t b = value.rfind("b=");
+    std::string encoded = value.substr(b + 2);
+    std::string data = canonical_headers + "dkim-signature:" + relax(value.substr(0, b + 2));
+
+    std::string raw;
+    if (!base64Decode(encoded, raw)) {
+        return false;
+    }
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_length = 0;
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data.data());
+    size_t input_length = data.size();
+    if (ed25519) {
+        EVP_Digest(input, input_length, digest, &digest_length, EVP_sha256(), nullptr);
+        input = digest;
+        input_length = digest_length;
+    }
+    EVP_MD_CTX* context = EVP_MD_CTX_new();
+    bool ok = EVP_DigestVerifyInit(context, nullptr, ed25519 ? nullptr : EVP_sha256(), nullptr, key) == 1 &&
+              EVP_DigestVerify(context, reinterpret_cast<const unsigned char*>(raw.data()), raw.size(),
+                               input, input_length) == 1;
+    EVP_MD_CTX_free(context);
+    return ok;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing DKIM Signer" << std::endl;
+    std::cout << "===================" << std::endl;
+
+    std::cout << "1. Relaxed body hash (known answers)..." << std::endl;
+    check(hashesTo("", "47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU="), "empty body");
+    check(hashesTo("\r\n\r\n", "47DEQpj8HBSa+/TImW+5JCeuQeRkm5NMpJWZG3hSuFU="), "only empty lines");
+    check(hashesTo(" C \r\nD \t E\r\n\r\n\r\n", "unak6JHq0wL+Q1HP7dW1tjBx9FLA6DffoZ0qrLwbbpo="),
+          "RFC 6376 section 3.4.5 example");
+    check(hashesTo("Hello", "Ba3gj8+xBPQLJTahTfzW6RbWQ/XPgESxkCi2B66PSQg="), "missing final line break added");
+    check(hashesTo("line one  \nline\ttwo\n\n", "ZhLZyUwtqNJUThGINI/HuvcX//8brN5RkpoWZASkH/w="),
+          "bare LF line breaks and whitespace runs");
+
+    std::cout << "2. Message splitting..." << std::endl;
+    DKIMMessageHasher message;
+    std::string text = "Subject: Test\r\nTo: user@example.org\r\n\r\n C \r\nD \t E\r\n\r\n\r\n";
+    for (char c : text) {
+        message.update(&c, 1);
+    }
+    std::string headers;
+    std::string hash = message.finish(headers);
+    check(headers.find("Subject: Test") == 0 && headers.find("To: user@example.org") != std::string::npos &&
+          headers.find("\r\n\r\n") == std::string::npos, "header block separated from the body");
+    check(hash == "unak6JHq0wL+Q1HP7dW1tjBx9FLA6DffoZ0qrLwbbpo=", "body hashed from the empty line on");
+
+    // Messy whitespace, a folded Subject, an unsigned header and a repeated To (the last one counts)
+    std::string message_headers =
+        "From:  Sender   <sender@example.com> \r\n"
+        "To: old@example.org\r\n"
+        "Subject: Hello\r\n"
+        "\tWorld  \r\n"
+        "X-Mailer: test\r\n"
+        "TO : user@example.org\r\n";
+    std::string canonical =
+        "from:Sender <sender@example.com>\r\n"
+        "to:user@example.org\r\n"
+        "subject:Hello World\r\n";
+    std::string body_hash = bodyHash("Body\r\n", 0);
+
+    char directory[] = "/tmp/test_dkim_signer_XXXXXX";
+    if (!mkdtemp(directory)) {
+        std::cout << "   ✗ Failed to create a key directory" << std::endl;
+        return 1;
+    }
+    std::string rsa_path = std::string(directory) + "/rsa.pem";
+    std::string ed25519_path = std::string(directory) + "/ed25519.pem";
+
+    std::cout << "3. rsa-sha256 signature..." << std::endl;
+    EVP_PKEY* rsa_key = generateKey(EVP_PKEY_RSA, rsa_path);
+    std::string error;
+    std::shared_ptr<const DKIMSigner> rsa = DKIMSigner::create("example.com", "mail", rsa_path, error);
+    check(rsa && rsa->getAlgorithm() == DKIMAlgorithm::RSA_SHA256, "RSA key loaded");
+    std::string signature;
+    if (rsa && rsa->sign(message_headers, body_hash, signature, error)) {
+        check(tag(signature, "a") == "rsa-sha256" && tag(signature, "c") == "relaxed/relaxed" &&
+              tag(signature, "d") == "example.com" && tag(signature, "s") == "mail", "algorithm and identity tags");
+        check(tag(signature, "h") == "from:to:subject", "signed header list");
+        check(tag(signature, "bh") == body_hash, "body hash tag");
+        check(verify(rsa_key, false, signature, canonical), "signature verifies over the canonical headers");
+        check(!verify(rsa_key, false, signature, "from:Sender <sender@example.com>\r\n"),
+              "signature does not verify over other headers");
+    } else {
+        check(false, "message signed: " + error);
+    }
+
+    std::cout << "4. ed25519-sha256 signature..." << std::endl;
+    EVP_PKEY* ed25519_key = generateKey(EVP_PKEY_ED25519, ed25519_path);
+    std::shared_ptr<const DKIMSigner> ed25519 = DKIMSigner::create("example.com", "ed", ed25519_path, error);
+    check(ed25519 && ed25519->getAlgorithm() == DKIMAlgorithm::ED25519_SHA256, "Ed25519 key loaded");
+    if (ed25519 && ed25519->sign(message_headers, body_hash, signature, error)) {
+        check(tag(signature, "a") == "ed25519-sha256", "algorithm tag");
+        check(verify(ed25519_key, true, signature, canonical), "signature verifies over the canonical headers");
+    } else {
+        check(false, "message signed: " + error);
+    }
+
+    std::cout << "5. Key errors..." << std::endl;
+    check(!DKIMSigner::create("example.com", "mail", std::string(directory) + "/missing.pem", error) &&
+          !error.empty(), "missing key file reported");
+
+    EVP_PKEY_free(rsa_key);
+    EVP_PKEY_free(ed25519_key);
+    unlink(rsa_path.c_str());
+    unlink(ed25519_path.c_str());
+    rmdir(directory);
+
+    return summary();
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "core/dns/dns_resolver.hpp"
+#include "stub_dns_server.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::StubDNSServer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+int main() {
+    std::cout << "Testing DNS Resolver" << std::endl;
+    std::cout << "====================" << std::endl;
+
+    StubDNSServer server;
+    if (!server.start()) {
+        std::cout << "   ✗ Failed to start stub DNS server" << std::endl;
+        return 1;
+    }
+
+    DNSResolverConfig config;
+    config.nameservers.push_back("127.0.0.1:" + std::to_string(server.port()));
+    config.timeout = std::chrono::milliseconds(200);
+    config.attempts = 1;
+    config.hosts_file = "";
+    DNSResolver resolver(config);
+
+    std::cout << "1. Address literals..." << std::endl;
+    DNSAddressResult literal = resolver.lookupAddress("[2001:db8::1]");
+    check(literal.success() && literal.addresses.size() == 1 &&
+          literal.addresses[0].family == AF_INET6, "IPv6 literal needs no query");
+
+    std::cout << "2. A and AAAA lookup..." << std::endl;
+    DNSAddressResult mail = resolver.lookupAddress("Mail.Example.Test.");
+    check(mail.success() && mail.addresses.size() == 2, "both address families returned");
+    check(mail.addresses.size() == 2 && mail.addresses[0].toString() == "192.0.2.10" &&
+          mail.addresses[1].toString() == "2001:db8::10", "IPv4 listed before IPv6");
+
+    std::cout << "3. Positive caching..." << std::endl;
+    resolver.lookupAddress("mail.example.test");
+    check(server.queries("mail.example.test", 1) == 1, "second lookup served from cache");
+
+    std::cout << "4. CNAME chain..." << std::endl;
+    DNSAddressResult alias = resolver.lookupAddress("alias.example.test");
+    check(alias.success() && alias.addresses.size() == 1 &&
+          alias.addresses[0].toString() == "192.0.2.10", "alias resolves to target address");
+
+    std::cout << "5. MX preference ordering..." << std::endl;
+    DNSMXResult mx = resolver.lookupMX("example.test");
+    check(mx.success() && mx.records.size() == 3, "three exchangers returned");
+    check(mx.records.size() == 3 && mx.records[0].exchange == "mx1.example.test" &&
+          mx.records[1].exchange == "mx2.example.test" &&
+          mx.records[2].exchange == "mx3.example.test", "sorted by preference");
+
+    std::cout << "6. Implicit and null MX..." << std::endl;
+    DNSMXResult implicit = resolver.lookupMX("nomx.example.test");
+    check(implicit.success() && implicit.records.size() == 1 &&
+          implicit.records[0].exchange == "nomx.example.test", "domain without MX is its own exchanger");
+    DNSMXResult null_mx = resolver.lookupMX("nullmx.example.test");
+    check(null_mx.status == DNSStatus::NO_MAIL, "null MX reported as not accepting mail");
+
+    std::cout << "7. Negative caching..." << std::endl;
+    DNSAddressResult missing = resolver.lookupAddress("missing.example.test");
+    check(missing.status == DNSStatus::NOT_FOUND, "NXDOMAIN reported");
+    resolver.lookupAddress("missing.example.test");
+    check(server.queries("missing.example.test", 1) == 1, "NXDOMAIN served from cache");
+
+    std::cout << "8. TTL expiry..." << std::endl;
+    resolver.lookupAddress("short.example.test");
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    resolver.lookupAddress("short.example.test");
+    check(server.queries("short.example.test", 1) == 2, "expired answer queried again");
+
+    std::cout << "9. Concurrent lookups share one query..." << std::endl;
+    std::atomic<int> done(0);
+    for (int i = 0; i < 10; ++i) {
+        resolver.resolveMX("slow.example.test", [&done](const DNSMXResult& result) {
+            if (result.status == DNSStatus::TIMEOUT) {
+                done++;
+            }
+        });
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (done < 10 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(done == 10, "all callbacks report the timeout");
+    check(server.queries("slow.example.test", 15) == 1, "only one query sent");
+
+    DNSResolverStats stats = resolver.getStats();
+    std::cout << "   Queries sent: " << stats.queries_sent << ", cache hits: " << stats.cache_hits
+              << ", timeouts: " << stats.timeouts << std::endl;
+
+    return summary();
+}
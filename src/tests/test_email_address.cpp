@@ -0,0 +1,132 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <regex>
+#include <random>
+#include "utils/email.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+// The pattern the address functions used before the hand-written parser
+const std::regex email_regex(R"(([a-zA-Z0-9._%+-]+)@([a-zA-Z0-9.-]+\.[a-zA-Z]{2,}))");
+
+/**
+ * Whether parseEmailAddress() accepts exactly what the regex matches, with the same parts
+ */
+bool matchesRegex(const std::string& address) {
+    std::smatch match;
+    bool expected = std::regex_match(address, match, email_regex);
+    EmailAddressParts parts;
+    bool parsed = parseEmailAddress(address, parts);
+    if (parsed != expected) {
+        return false;
+    }
+    if (!parsed) {
+        return parts.local_part.empty() && parts.domain.empty();
+    }
+    return parts.local_part == match[1].str() && parts.domain == match[2].str() &&
+           parts.local_part.data() == address.data() && parts.domain.data() == address.data() + match.position(2);
+}
+
+/**
+ * Every string of up to max_length characters from the alphabet, shortest first
+ */
+std::vector<std::string> allStrings(const std::string& alphabet, size_t max_length) {
+    std::vector<std::string> strings = {""};
+    for (size_t start = 0; start < strings.size(); ++start) {
+        if (strings[start].size() == max_length) {
+            continue;
+        }
+        for (char c : alphabet) {
+            strings.push_back(strings[start] + c);
+        }
+    }
+    return strings;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Email Addresses" << std::endl;
+    std::cout << "=======================" << std::endl;
+
+    std::cout << "1. Same as the regex..." << std::endl;
+    {
+        // Short strings built from one byte of each class the pattern distinguishes
+        size_t mismatches = 0;
+        std::string first_mismatch;
+        for (const std::string& address : allStrings("aZ0.-_@ \xe9", 6)) {
+            if (!matchesRegex(address) && mismatches++ == 0) {
+                first_mismatch = address;
+            }
+        }
+        check(mismatches == 0, "every string of up to 6 characters" +
+              (mismatches == 0 ? std::string() : ", not \"" + first_mismatch + "\""));
+
+        // Long enough for the vectorised byte scan, one odd byte anywhere
+        std::mt19937 random(42);
+        const std::string local_bytes = "abcxyzABCXYZ0189._%+-";
+        const std::string domain_bytes = "abcxyzABCXYZ0189.-";
+        const std::string odd_bytes = std::string("@.-_ \t\"<>()[],;:\\\x7f\x80\xff") + '\0';
+        mismatches = 0;
+        for (int i = 0; i < 20000; ++i) {
+            std::string address;
+            for (size_t n = random() % 40; n > 0; --n) {
+                address.push_back(local_bytes[random() % local_bytes.size()]);
+            }
+            address += "@";
+            for (size_t n = random() % 40; n > 0; --n) {
+                address.push_back(domain_bytes[random() % domain_bytes.size()]);
+            }
+            address += random() % 4 ? ".com" : random() % 2 ? ".c" : "";
+            if (random() % 2) {
+                address[random() % address.size()] = odd_bytes[random() % odd_bytes.size()];
+            }
+            if (!matchesRegex(address) && mismatches++ == 0) {
+                first_mismatch = address;
+            }
+        }
+        check(mismatches == 0, "20,000 random addresses up to 85 characters" +
+              (mismatches == 0 ? std::string() : ", not \"" + first_mismatch + "\""));
+    }
+
+    std::cout << "2. Examples..." << std::endl;
+    {
+        EmailAddressParts parts;
+        check(parseEmailAddress("first.last+tag@mail.example.org", parts) && parts.local_part == "first.last+tag" &&
+              parts.domain == "mail.example.org", "local part and domain split at the '@'");
+        check(parseEmailAddress("user@xn--bcher-kva.ch", parts) && parseEmailAddress("a@b.co", parts),
+              "punycode domain and shortest top-level domain");
+
+        bool rejected = true;
+        for (const char* address : {"", "@example.com", "user@", "user@localhost", "user@example.c",
+                                    "user@example.c0m", "two@@example.com", "a@b@example.com", "user@.com",
+                                    "user@exa_mple.com", "spaces in@example.com", "user@example.com ",
+                                    "Name <user@example.com>"}) {
+            rejected = rejected && !parseEmailAddress(address, parts) && parts.local_part.empty() &&
+                       parts.domain.empty();
+        }
+        check(rejected, "malformed addresses rejected with empty parts");
+
+        check(isValidEmailAddress("user@example.com") && !isValidEmailAddress("user@example"),
+              "isValidEmailAddress() agrees");
+        check(extractDomain("user@Example.COM") == "Example.COM" && extractUsername("user@example.com") == "user" &&
+              extractDomain("not an address").empty(), "extractDomain() and extractUsername()");
+    }
+
+    std::cout << "3. Lists..." << std::endl;
+    {
+        std::vector<std::string> addresses = {"one@example.com", "bad", "two@example.org", "@example.com"};
+        std::vector<EmailAddressParts> parts;
+        check(parseEmailAddresses(addresses, parts) == 2 && parts.size() == 4, "valid addresses counted");
+        check(parts.size() == 4 && parts[0].domain == "example.com" && parts[2].local_part == "two" &&
+              parts[1].domain.empty() && parts[3].local_part.empty(), "one entry per address, empty when invalid");
+    }
+
+    return summary();
+}
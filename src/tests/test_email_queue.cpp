@@ -0,0 +1,317 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "core/queue/email_queue.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::waitFor;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+/**
+ * Tracks how many sends run at the same time
+ */
+class Concurrency {
+public:
+    Concurrency() : current_(0), peak_(0) {}
+
+    void enter() {
+        int current = ++current_;
+        for (int peak = peak_; current > peak && !peak_.compare_exchange_weak(peak, current);) {
+        }
+    }
+
+    void leave() { current_--; }
+    int peak() const { return peak_; }
+
+private:
+    std::atomic<int> current_;
+    std::atomic<int> peak_;
+};
+
+/**
+ * Domain part of an email's first recipient
+ */
+std::string destination(const Email* email) {
+    return email->to[0].substr(email->to[0].find('@') + 1);
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Email Queue" << std::endl;
+    std::cout << "===================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    std::cout << "1. Worker pool..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 4;
+        EmailQueue queue(config);
+        queue.setBatchSize(1);
+        Concurrency concurrency;
+        queue.setSendCallback([&concurrency](const Email*) {
+            concurrency.enter();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            concurrency.leave();
+            return SMTPResult::createSuccess();
+        });
+        // One domain each, so the per-destination limit does not get in the way
+        for (int i = 0; i < 8; ++i) {
+            Email email("sender@example.com", "user@domain" + std::to_string(i) + ".test", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        queue.start();
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 8; }, std::chrono::seconds(5)),
+              "every email sent");
+        check(concurrency.peak() == 4, "max_workers emails sent at the same time");
+        std::vector<QueueWorkerStats> workers = queue.getWorkerStats();
+        size_t processed = 0;
+        for (const auto& worker : workers) {
+            processed += worker.processed;
+        }
+        check(workers.size() == 4 && processed == 8, "per-worker statistics add up");
+        queue.stop();
+    }
+
+    std::cout << "2. Wakeup instead of polling..." << std::endl;
+    {
+        EmailQueue queue;
+        std::atomic<int> sent(0);
+        queue.setSendCallback([&sent](const Email*) {
+            sent++;
+            return SMTPResult::createSuccess();
+        });
+        queue.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        bool prompt = true;
+        for (int i = 1; i <= 5; ++i) {
+            Email email("sender@example.com", "user@example.org", "Subject", "Body");
+            auto enqueued = std::chrono::steady_clock::now();
+            queue.enqueue(&email);
+            prompt = waitFor([&sent, i]() { return sent == i; }, std::chrono::seconds(1)) && prompt &&
+                     std::chrono::steady_clock::now() - enqueued < std::chrono::milliseconds(50);
+        }
+        check(prompt, "an idle queue sends new mail at once");
+        queue.stop();
+    }
+
+    std::cout << "3. Shutdown with mail in flight..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 1;
+        EmailQueue queue(config);
+        queue.setBatchSize(5);
+        std::atomic<int> started(0);
+        std::atomic<int> finished(0);
+        queue.setSendCallback([&started, &finished](const Email*) {
+            started++;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            finished++;
+            return SMTPResult::createSuccess();
+        });
+        for (int i = 0; i < 5; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@example.org", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        queue.start();
+        waitFor([&started]() { return started > 0; }, std::chrono::seconds(1));
+        queue.stop();
+        check(started == finished && finished >= 1, "the email being sent is finished, not abandoned");
+        check(queue.getTotalProcessed() + queue.size() == 5, "claimed but unsent mail goes back to the queue");
+
+        std::vector<std::string> order;
+        queue.setSendCallback([&order](const Email* email) {
+            order.push_back(email->to[0]);
+            return SMTPResult::createSuccess();
+        });
+        size_t remaining = queue.size();
+        queue.start();
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 5; }, std::chrono::seconds(5)),
+              "restarted queue sends the rest");
+        queue.stop();
+        check(order.size() == remaining && !order.empty() &&
+              order[0] == "user" + std::to_string(5 - remaining) + "@example.org", "returned mail keeps its place");
+    }
+
+    std::cout << "4. Scheduled sends and retries..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 2;
+        EmailQueue queue(config);
+        queue.setMaxRetries(1);
+        queue.setRetryDelay(std::chrono::seconds(1));
+        std::mutex mutex;
+        std::vector<std::pair<std::string, std::chrono::steady_clock::time_point>> attempts;
+        queue.setSendCallback([&mutex, &attempts](const Email* email) {
+            std::lock_guard<std::mutex> lock(mutex);
+            attempts.emplace_back(email->to[0], std::chrono::steady_clock::now());
+            bool first_try = email->to[0] == "flaky@retry.test" && attempts.size() == 1;
+            return first_try ? SMTPResult::createError("Try again later") : SMTPResult::createSuccess();
+        });
+        queue.start();
+
+        auto start = std::chrono::steady_clock::now();
+        Email flaky("sender@example.com", "flaky@retry.test", "Subject", "Body");
+        queue.enqueue(&flaky);
+        Email later("sender@example.com", "later@scheduled.test", "Subject", "Body");
+        queue.enqueue(&later, EmailPriority::NORMAL, std::chrono::system_clock::now() + std::chrono::milliseconds(600));
+        waitFor([&queue]() { return queue.getTotalRetries() == 1; }, std::chrono::seconds(1));
+        for (int i = 0; i < 5; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@ready.test", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 5; }, std::chrono::milliseconds(300)),
+              "ready mail is not held up by a retry or a scheduled send");
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 7; }, std::chrono::seconds(3)),
+              "retry and scheduled send go out once due");
+        queue.stop();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::chrono::steady_clock::time_point retried;
+        std::chrono::steady_clock::time_point scheduled;
+        for (size_t i = 1; i < attempts.size(); ++i) {
+            if (attempts[i].first == "flaky@retry.test") {
+                retried = attempts[i].second;
+            } else if (attempts[i].first == "later@scheduled.test") {
+                scheduled = attempts[i].second;
+            }
+        }
+        check(attempts.size() == 8, "one attempt each, two for the retried email");
+        check(scheduled - start >= std::chrono::milliseconds(590), "scheduled send waits for its time");
+        check(retried - attempts[0].second >= std::chrono::milliseconds(990), "retry waits for its delay");
+    }
+
+    std::cout << "5. Fair share between destinations..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 2;
+        EmailQueue queue(config);
+        queue.setMaxQueueSize(1000);
+        queue.setBatchSize(5);
+        std::mutex mutex;
+        std::vector<std::string> order;
+        queue.setSendCallback([&mutex, &order](const Email* email) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            std::lock_guard<std::mutex> lock(mutex);
+            order.push_back(destination(email));
+            return SMTPResult::createSuccess();
+        });
+        for (int i = 0; i < 400; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@big.test", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        for (int i = 0; i < 10; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@small.test", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        check(queue.getDestinationStats().size() == 2, "one queue per destination");
+        queue.start();
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 410; }, std::chrono::seconds(10)),
+              "every email sent");
+        queue.stop();
+        size_t last_small = 0;
+        for (size_t i = 0; i < order.size(); ++i) {
+            if (order[i] == "small.test") {
+                last_small = i;
+            }
+        }
+        check(last_small < 60, "small destination not stuck behind a large backlog");
+        check(queue.getDestinationStats().empty(), "drained destinations forgotten");
+    }
+
+    std::cout << "6. Destination weights..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 1;
+        EmailQueue queue(config);
+        queue.setBatchSize(1);
+        queue.setDestinationWeight("heavy.test", 3);
+        std::vector<std::string> order;
+        queue.setSendCallback([&order](const Email* email) {
+            order.push_back(destination(email));
+            return SMTPResult::createSuccess();
+        });
+        for (int i = 0; i < 100; ++i) {
+            Email heavy("sender@example.com", "user@heavy.test", "Subject", "Body");
+            queue.enqueue(&heavy);
+            Email light("sender@example.com", "user@light.test", "Subject", "Body");
+            queue.enqueue(&light);
+        }
+        queue.start();
+        waitFor([&queue]() { return queue.getTotalProcessed() == 200; }, std::chrono::seconds(5));
+        queue.stop();
+        int heavy = 0;
+        for (size_t i = 0; i < 80 && i < order.size(); ++i) {
+            heavy += order[i] == "heavy.test";
+        }
+        check(order.size() == 200 && heavy >= 55 && heavy <= 65, "weight 3 gets three quarters of the sends");
+    }
+
+    std::cout << "7. Per-destination concurrency and backoff..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 4;
+        EmailQueue queue(config);
+        queue.setBatchSize(1);
+        queue.setDestinationConcurrency(1);
+        Concurrency concurrency;
+        queue.setSendCallback([&concurrency](const Email*) {
+            concurrency.enter();
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            concurrency.leave();
+            return SMTPResult::createSuccess();
+        });
+        for (int i = 0; i < 40; ++i) {
+            Email email("sender@example.com", "user@one.test", "Subject", "Body");
+            queue.enqueue(&email);
+        }
+        queue.start();
+        waitFor([&queue]() { return queue.getTotalProcessed() == 40; }, std::chrono::seconds(5));
+        queue.stop();
+        check(queue.getTotalProcessed() == 40 && concurrency.peak() == 1, "one send at a time to the destination");
+    }
+    {
+        QueueConfig config;
+        config.max_workers = 1;
+        EmailQueue queue(config);
+        queue.setMaxRetries(0);
+        queue.setDestinationBackoff(3, std::chrono::seconds(60), std::chrono::seconds(600));
+        std::atomic<int> failing(0);
+        queue.setSendCallback([&failing](const Email* email) {
+            if (destination(email) == "down.test") {
+                failing++;
+                return SMTPResult::createError("Connection refused");
+            }
+            return SMTPResult::createSuccess();
+        });
+        for (int i = 0; i < 20; ++i) {
+            Email down("sender@example.com", "user@down.test", "Subject", "Body");
+            queue.enqueue(&down);
+            Email up("sender@example.com", "user@up.test", "Subject", "Body");
+            queue.enqueue(&up);
+        }
+        queue.start();
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 20; }, std::chrono::seconds(5)),
+              "healthy destination keeps flowing");
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        queue.stop();
+        check(failing == 3, "failing destination paused after three failures in a row");
+        bool paused = false;
+        for (const auto& stats : queue.getDestinationStats()) {
+            paused = paused || (stats.destination == "down.test" && stats.paused && stats.ready == 17 &&
+                                stats.consecutive_failures == 3);
+        }
+        check(paused, "its mail waits out the backoff in the queue");
+    }
+
+    return summary();
+}
@@ -0,0 +1,147 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_set>
+#include <cstdlib>
+#include "core/queue/message_spool.hpp"
+#include "core/queue/email_queue.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::waitFor;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+QueueItem makeItem(const std::string& id, const std::string& subject) {
+    QueueItem item("sender@example.com", {"user@example.org"}, subject, std::string("Body of ") + subject);
+    item.id = id;
+    item.domain = "example.com";
+    return item;
+}
+
+QueueJournalConfig journalConfig(const std::string& directory) {
+    QueueJournalConfig config;
+    config.directory = directory;
+    config.sync = JournalSync::SYNC;
+    return config;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Message Spool" << std::endl;
+    std::cout << "=====================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_message_spool_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a spool directory" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+    std::string error;
+
+    std::cout << "1. Payload files..." << std::endl;
+    {
+        MessageSpool spool(root + "/files", true);
+        check(spool.open(error), "spool directories created");
+        QueueItem item = makeItem("item-1", "Stored");
+        item.html_body = "<p>Stored</p>";
+        check(spool.store(item, error), "payload stored");
+
+        QueueItem index = item;
+        MessageSpool::compact(index);
+        check(index.spooled && index.subject.empty() && index.body.empty() && index.html_body.empty() &&
+              index.to_addresses == item.to_addresses, "index record keeps the envelope, not the payload");
+
+        QueueItem loaded;
+        check(spool.load("item-1", loaded, error) && loaded.subject == "Stored" &&
+              loaded.body == "Body of Stored" && loaded.html_body == "<p>Stored</p>", "payload read back");
+
+        for (int i = 2; i <= 40; ++i) {
+            spool.store(makeItem("item-" + std::to_string(i), "Stored"), error);
+        }
+        std::unordered_set<std::string> known = {"item-1", "item-2"};
+        std::unordered_set<std::string> present;
+        std::vector<QueueItem> unknown;
+        check(spool.scan(known, 4, present, unknown) == 40 && present.size() == 40, "scan lists every file");
+        check(unknown.size() == 38 && unknown[0].spooled && unknown[0].subject.empty(),
+              "files without an index record rebuilt as index records");
+
+        spool.remove("item-1");
+        check(!spool.load("item-1", loaded, error) && !error.empty(), "removed payload is gone");
+    }
+
+    std::cout << "2. Reconciling the journal with the spool..." << std::endl;
+    {
+        std::string directory = root + "/queue";
+        std::vector<QueueItem> pending;
+        {
+            EmailQueue queue;
+            check(queue.enablePersistence(journalConfig(directory), error), "persistent queue opened");
+            for (const char* subject : {"Finished", "Waiting"}) {
+                Email email("sender@example.com", "user@example.org", subject, std::string("Body of ") + subject);
+                queue.enqueue(&email);
+            }
+            pending = queue.getPendingEmails();
+            check(pending.size() == 2 && pending[0].spooled && pending[0].subject.empty(),
+                  "queue holds index records only");
+        }
+
+        // A crash after a payload was deleted but before its completion was logged, and
+        // one after a payload was written but before it was logged
+        MessageSpool spool(directory + "/msg", true);
+        spool.open(error);
+        for (const auto& item : pending) {
+            QueueItem loaded;
+            if (spool.load(item.id, loaded, error) && loaded.subject == "Finished") {
+                spool.remove(item.id);
+            }
+        }
+        spool.store(makeItem("orphan-1", "Orphan"), error);
+
+        EmailQueue queue;
+        std::mutex mutex;
+        std::vector<std::string> sent;
+        queue.setSendCallback([&mutex, &sent](const Email* email) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sent.push_back(email->subject + "|" + email->body);
+            return SMTPResult::createSuccess();
+        });
+        check(queue.enablePersistence(journalConfig(directory), error), "persistent queue reopened");
+        check(queue.size() == 2, "finished item dropped, orphaned payload re-indexed");
+        queue.start();
+        check(waitFor([&queue]() { return queue.getTotalProcessed() == 2; }, std::chrono::seconds(5)),
+              "recovered mail sent");
+        queue.stop();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::sort(sent.begin(), sent.end());
+            check(sent.size() == 2 && sent[0] == "Orphan|Body of Orphan" && sent[1] == "Waiting|Body of Waiting",
+                  "payloads read back from the spool for the send");
+        }
+        std::unordered_set<std::string> present;
+        std::vector<QueueItem> unknown;
+        check(spool.scan({}, 1, present, unknown) == 0, "sent mail leaves no payload behind");
+    }
+
+    std::cout << "3. Nothing left after a restart..." << std::endl;
+    {
+        EmailQueue queue;
+        check(queue.enablePersistence(journalConfig(root + "/queue"), error) && queue.size() == 0,
+              "sent and reconciled mail not recovered again");
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
@@ -0,0 +1,334 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include "core/mime/message_stream.hpp"
+#include "core/mime/attachment_cache.hpp"
+#include "core/logging/logger.hpp"
+#include "utils/base64.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * One MIME entity; children are filled in for multipart types
+ */
+struct Part {
+    std::map<std::string, std::string> headers;     // Lower-case names, unfolded values
+    std::string body;
+    std::vector<Part> children;
+
+    std::string header(const std::string& name) const {
+        auto it = headers.find(name);
+        return it == headers.end() ? "" : it->second;
+    }
+
+    std::string type() const {
+        std::string value = header("content-type");
+        return value.substr(0, value.find(';'));
+    }
+
+    std::string typeParameter(const std::string& name) const {
+        std::string value = header("content-type");
+        size_t pos = value.find("; " + name + "=\"");
+        if (pos == std::string::npos) {
+            return "";
+        }
+        pos += name.size() + 4;
+        return value.substr(pos, value.find('"', pos) - pos);
+    }
+};
+
+/**
+ * Parse an entity strictly: every delimiter must start a line, the body of
+ * a multipart must begin with its first delimiter and end with the close
+ * delimiter (RFC 2046 section 5.1.1)
+ */
+bool parsePart(const std::string& text, Part& part, std::string& error) {
+    size_t header_end = text.find("\r\n\r\n");
+    if (header_end == std::string::npos) {
+        error = "no end of headers";
+        return false;
+    }
+    std::string name;
+    for (size_t pos = 0; pos < header_end + 2; ) {
+        size_t end = text.find("\r\n", pos);
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 2;
+        if (line[0] == ' ' || line[0] == '\t') {
+            part.headers[name] += line;
+            continue;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) {
+            error = "bad header line: " + line;
+            return false;
+        }
+        name = line.substr(0, colon);
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        part.headers[name] = line.substr(colon + 2);
+    }
+    part.body = text.substr(header_end + 4);
+
+    if (part.type().compare(0, 10, "multipart/") != 0) {
+        return true;
+    }
+
+    std::string delimiter = "--" + part.typeParameter("boundary");
+    if (delimiter == "--" || part.body.compare(0, delimiter.size() + 2, delimiter + "\r\n") != 0) {
+        error = "multipart body does not start with its delimiter";
+        return false;
+    }
+    for (size_t pos = delimiter.size() + 2; ; ) {
+        size_t end = part.body.find("\r\n" + delimiter, pos);
+        if (end == std::string::npos) {
+            error = "missing delimiter after a part";
+            return false;
+        }
+        Part child;
+        if (!parsePart(part.body.substr(pos, end - pos), child, error)) {
+            return false;
+        }
+        part.children.push_back(child);
+
+        pos = end + 2 + delimiter.size();
+        if (part.body.compare(pos, 2, "--") == 0) {
+            // A nested multipart's final CRLF is the one before its parent's next delimiter
+            if (part.body.size() != pos + 2 && part.body.compare(pos + 2, std::string::npos, "\r\n") != 0) {
+                error = "text after the close delimiter";
+                return false;
+            }
+            return true;
+        }
+        if (part.body.compare(pos, 2, "\r\n") != 0) {
+            error = "delimiter not followed by CRLF";
+            return false;
+        }
+        pos += 2;
+    }
+}
+
+int hexValue(char c) {
+    return c >= 'A' ? c - 'A' + 10 : c - '0';
+}
+
+/**
+ * Content of a leaf part after undoing its transfer encoding
+ */
+std::string decodeBody(const Part& part) {
+    std::string encoding = part.header("content-transfer-encoding");
+    if (encoding == "base64") {
+        std::string decoded;
+        return base64Decode(part.body, decoded) ? decoded : "<invalid base64>";
+    }
+    if (encoding == "quoted-printable") {
+        std::string decoded;
+        for (size_t i = 0; i < part.body.size(); ++i) {
+            if (part.body[i] != '=') {
+                decoded.push_back(part.body[i]);
+            } else if (part.body.compare(i, 3, "=\r\n") == 0) {
+                i += 2;
+            } else {
+                decoded.push_back(static_cast<char>(hexValue(part.body[i + 1]) * 16 + hexValue(part.body[i + 2])));
+                i += 2;
+            }
+        }
+        return decoded;
+    }
+    return part.body;
+}
+
+/**
+ * Render and parse a message; the message must use CRLF line breaks only
+ */
+bool renderAndParse(const Email& email, Part& message, std::string& error) {
+    std::string rendered;
+    if (!MimeMessageStream::render(email, "<id@example.com>", rendered, error)) {
+        return false;
+    }
+    for (size_t pos = 0; (pos = rendered.find_first_of("\r\n", pos)) != std::string::npos; pos += 2) {
+        if (rendered.compare(pos, 2, "\r\n") != 0) {
+            error = "bare CR or LF at " + std::to_string(pos);
+            return false;
+        }
+    }
+    return parsePart(rendered, message, error);
+}
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing MIME Message Stream" << std::endl;
+    std::cout << "===========================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_message_stream_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a directory for attachments" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+
+    std::string image;
+    for (int i = 0; i < 1000; ++i) {
+        image.push_back(static_cast<char>(i * 7));
+    }
+    std::string pdf = "%PDF-1.4\n" + std::string(200, 'p');
+    writeFile(root + "/image.png", image);
+    writeFile(root + "/report.pdf", pdf);
+    writeFile(root + "/empty.txt", "");
+
+    const std::string plain = "Hello,\nthis is the plain text.";
+    const std::string html = "<p>Caf\xc3\xa9 <img src=\"cid:image.png\"></p>";
+    const std::string cyrillic = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 \xd0\xbc\xd0\xb8\xd1\x80";
+    std::string error;
+
+    std::cout << "1. Single text part..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Plain", plain);
+        Part message;
+        check(renderAndParse(email, message, error), "message parses");
+        check(message.header("mime-version") == "1.0" && message.type() == "text/plain" &&
+              message.header("content-transfer-encoding") == "7bit", "text/plain, 7bit");
+        check(decodeBody(message) == "Hello,\r\nthis is the plain text.\r\n", "body in CRLF form");
+    }
+
+    std::cout << "2. Alternative..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Alternative", cyrillic);
+        email.html_body = html;
+        Part message;
+        check(renderAndParse(email, message, error), "message parses");
+        check(message.type() == "multipart/alternative" && message.children.size() == 2,
+              "multipart/alternative with two parts");
+        if (message.children.size() == 2) {
+            check(message.children[0].type() == "text/plain" &&
+                  message.children[0].header("content-transfer-encoding") == "base64" &&
+                  decodeBody(message.children[0]) == cyrillic, "plain text first, base64 round-trips");
+            check(message.children[1].type() == "text/html" &&
+                  message.children[1].header("content-transfer-encoding") == "quoted-printable" &&
+                  decodeBody(message.children[1]) == html, "HTML second, quoted-printable round-trips");
+        }
+    }
+
+    std::cout << "3. Related..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Related", plain);
+        email.html_body = html;
+        email.inline_attachments = {root + "/image.png"};
+        Part message;
+        check(renderAndParse(email, message, error), "message parses");
+        check(message.type() == "multipart/related" && message.typeParameter("type") == "multipart/alternative" &&
+              message.children.size() == 2, "multipart/related of the alternative and the image");
+        if (message.children.size() == 2) {
+            const Part& picture = message.children[1];
+            check(message.children[0].type() == "multipart/alternative" &&
+                  message.children[0].children.size() == 2, "alternative nested first");
+            check(picture.type() == "image/png" && picture.header("content-id") == "<image.png>" &&
+                  picture.header("content-disposition") == "inline; filename=\"image.png\"" &&
+                  decodeBody(picture) == image, "image inline with its Content-ID, bytes intact");
+        }
+    }
+
+    std::cout << "4. Mixed..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Mixed", plain);
+        email.html_body = html;
+        email.inline_attachments = {root + "/image.png"};
+        email.attachments = {root + "/report.pdf"};
+        Part message;
+        check(renderAndParse(email, message, error), "message parses");
+        check(message.type() == "multipart/mixed" && message.children.size() == 2 &&
+              message.children[0].type() == "multipart/related" &&
+              message.children[0].children.size() == 2 &&
+              message.children[0].children[0].type() == "multipart/alternative",
+              "mixed > related > alternative");
+        if (message.children.size() == 2) {
+            const Part& report = message.children[1];
+            check(report.type() == "application/pdf" &&
+                  report.header("content-disposition") == "attachment; filename=\"report.pdf\"" &&
+                  decodeBody(report) == pdf, "attachment after the related part, bytes intact");
+        }
+
+        // Inline files cannot be referenced from a plain text body
+        email.html_body.clear();
+        Part plain_message;
+        check(renderAndParse(email, plain_message, error) && plain_message.type() == "multipart/mixed" &&
+              plain_message.children.size() == 3 && plain_message.children[0].type() == "text/plain" &&
+              plain_message.children[1].type() == "image/png" &&
+              plain_message.children[2].type() == "application/pdf",
+              "without HTML, inline files are parts of the mixed message");
+    }
+
+    std::cout << "5. Empty attachment..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Empty", plain);
+        for (bool cached : {true, false}) {
+            // A zero budget streams every file from disk instead of the cache
+            AttachmentCache::getInstance().clear();
+            AttachmentCache::getInstance().setMaxBytes(cached ? 64 * 1024 * 1024 : 0);
+            std::string source = cached ? "cached" : "streamed";
+            error.clear();
+
+            email.attachments = {root + "/empty.txt", root + "/report.pdf"};
+            Part message;
+            check(renderAndParse(email, message, error) && message.children.size() == 3 &&
+                  message.children[1].type() == "text/plain" && decodeBody(message.children[1]).empty() &&
+                  decodeBody(message.children[2]) == pdf,
+                  source + " empty file before another part: " + (error.empty() ? "parses" : error));
+
+            error.clear();
+            email.attachments = {root + "/report.pdf", root + "/empty.txt"};
+            Part last;
+            check(renderAndParse(email, last, error) && last.children.size() == 3 &&
+                  decodeBody(last.children[2]).empty(),
+                  source + " empty file as the last part: " + (error.empty() ? "parses" : error));
+            error.clear();
+        }
+        AttachmentCache::getInstance().setMaxBytes(64 * 1024 * 1024);
+    }
+
+    std::cout << "6. Reading..." << std::endl;
+    {
+        Email email("sender@example.com", "user@example.org", "Reading", cyrillic);
+        email.html_body = html;
+        email.inline_attachments = {root + "/image.png"};
+        email.attachments = {root + "/report.pdf", root + "/empty.txt"};
+
+        MimeMessageStream stream(email, "<id@example.com>");
+        std::string pieces;
+        ConstBuffer piece;
+        bool transient = false;
+        while (stream.next(piece, transient)) {
+            pieces.append(piece.data, piece.size);
+        }
+
+        stream.rewind();
+        std::string reads;
+        char buffer[7];
+        for (size_t count; (count = stream.read(buffer, sizeof(buffer))) > 0; ) {
+            reads.append(buffer, count);
+        }
+        check(stream.good() && !pieces.empty() && reads == pieces,
+              "read() in small pieces after rewind() gives the bytes next() gave");
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
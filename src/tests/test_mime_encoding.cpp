@@ -0,0 +1,285 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "core/mime/mime_encoding.hpp"
+#include "utils/base64.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+std::string encodeQuotedPrintable(const std::string& text, size_t piece) {
+    QuotedPrintableEncoder encoder;
+    std::string output;
+    for (size_t pos = 0; pos < text.size(); pos += piece) {
+        encoder.encode(text.data() + pos, std::min(piece, text.size() - pos), output);
+    }
+    encoder.finish(output);
+    return output;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Decode quoted-printable text, dropping the CRLF finish() appends;
+ * "<invalid>" for a bad escape
+ */
+std::string decodeQuotedPrintable(const std::string& text) {
+    std::string decoded;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '=') {
+            decoded.push_back(text[i]);
+        } else if (text.compare(i, 3, "=\r\n") == 0) {
+            i += 2;
+        } else if (i + 2 < text.size() && hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            decoded.push_back(static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2])));
+            i += 2;
+        } else {
+            return "<invalid>";
+        }
+    }
+    if (decoded.size() < 2 || decoded.compare(decoded.size() - 2, 2, "\r\n") != 0) {
+        return "<invalid>";
+    }
+    return decoded.substr(0, decoded.size() - 2);
+}
+
+std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = text.find("\r\n", start)) != std::string::npos; start = end + 2) {
+        lines.push_back(text.substr(start, end - start));
+    }
+    lines.push_back(text.substr(start));
+    return lines;
+}
+
+/**
+ * Whether every line is at most 76 characters and no line but a soft break ends in whitespace
+ */
+bool validQuotedPrintableLines(const std::string& encoded) {
+    for (const std::string& line : splitLines(encoded)) {
+        if (line.size() > 76 || (!line.empty() && (line.back() == ' ' || line.back() == '\t'))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Whether text is a sequence of complete UTF-8 characters
+ */
+bool completeUtf8(const std::string& text) {
+    for (size_t i = 0; i < text.size(); ) {
+        unsigned char lead = static_cast<unsigned char>(text[i]);
+        size_t length = lead < 0x80 ? 1 : lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+        if (length == 0 || i + length > text.size()) {
+            return false;
+        }
+        for (size_t j = 1; j < length; ++j) {
+            if ((static_cast<unsigned char>(text[i + j]) & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+struct DecodedHeader {
+    std::string text;           // Concatenated words
+    size_t words = 0;
+    size_t longest_line = 0;    // Including the header name
+    bool valid = true;          // Every word well formed and whole UTF-8
+};
+
+/**
+ * Unfold an encoded header value and decode its encoded-words (RFC 2047)
+ */
+DecodedHeader decodeHeader(const std::string& name, const std::string& value) {
+    DecodedHeader result;
+    for (const std::string& line : splitLines(name + value)) {
+        result.longest_line = std::max(result.longest_line, line.size());
+    }
+
+    std::string unfolded;
+    for (const std::string& line : splitLines(value)) {
+        unfolded += line;
+    }
+    for (size_t pos = 0; pos < unfolded.size(); ) {
+        if (unfolded[pos] == ' ') {
+            ++pos;
+            continue;
+        }
+        size_t end = unfolded.find("?=", pos + 10);
+        if (unfolded.compare(pos, 8, "=?UTF-8?") != 0 || end == std::string::npos || unfolded[pos + 9] != '?' ||
+            end + 2 - pos > 75) {
+            result.valid = false;
+            return result;
+        }
+        std::string payload = unfolded.substr(pos + 10, end - pos - 10);
+        std::string word;
+        if (unfolded[pos + 8] == 'B') {
+            if (!base64Decode(payload, word)) {
+                result.valid = false;
+            }
+        } else {
+            for (size_t i = 0; i < payload.size(); ++i) {
+                if (payload[i] == '_') {
+                    word.push_back(' ');
+                } else if (payload[i] == '=' && i + 2 < payload.size()) {
+                    word.push_back(static_cast<char>(hexValue(payload[i + 1]) * 16 + hexValue(payload[i + 2])));
+                    i += 2;
+                } else {
+                    word.push_back(payload[i]);
+                }
+            }
+        }
+        if (!completeUtf8(word)) {
+            result.valid = false;
+        }
+        result.text += word;
+        result.words++;
+        pos = end + 2;
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing MIME Encoding" << std::endl;
+    std::cout << "=====================" << std::endl;
+
+    std::cout << "1. Transfer encoding choice..." << std::endl;
+    {
+        auto choose = [](const std::string& text) { return chooseTransferEncoding(text.data(), text.size()); };
+        std::string latin = "The caf\xc3\xa9 on the corner serves cr\xc3\xa8me br\xc3\xbbl\xc3\xa9" "e every day.\r\n";
+        std::string cyrillic;
+        for (int i = 0; i < 20; ++i) {
+            cyrillic += "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 ";
+        }
+
+        check(choose("") == TransferEncoding::SEVEN_BIT && choose("Hello,\r\nworld\n") == TransferEncoding::SEVEN_BIT,
+              "ASCII text is 7bit");
+        check(choose(std::string(998, 'a') + "\r\n") == TransferEncoding::SEVEN_BIT &&
+              choose(std::string(999, 'a') + "\r\n") == TransferEncoding::QUOTED_PRINTABLE,
+              "a line over 998 characters needs quoted-printable");
+        check(choose(latin) == TransferEncoding::QUOTED_PRINTABLE, "mostly ASCII with accents is quoted-printable");
+        check(choose(cyrillic) == TransferEncoding::BASE64, "mostly 8-bit text is base64");
+        check(choose(std::string(100, 'a') + '\0') == TransferEncoding::QUOTED_PRINTABLE &&
+              choose(std::string("a\0b", 3)) == TransferEncoding::BASE64, "NUL bytes count as 8-bit");
+        check(std::string(transferEncodingName(TransferEncoding::SEVEN_BIT)) == "7bit" &&
+              std::string(transferEncodingName(TransferEncoding::QUOTED_PRINTABLE)) == "quoted-printable" &&
+              std::string(transferEncodingName(TransferEncoding::BASE64)) == "base64", "header names");
+    }
+
+    std::cout << "2. Quoted-printable..." << std::endl;
+    {
+        check(encodeQuotedPrintable("", 1) == "\r\n" && encodeQuotedPrintable("abc", 1) == "abc\r\n",
+              "text ends with a CRLF of its own");
+        check(encodeQuotedPrintable("a=b caf\xc3\xa9", 64) == "a=3Db caf=C3=A9\r\n", "'=' and 8-bit bytes escaped");
+        check(encodeQuotedPrintable("a\nb\rc\r\nd", 64) == "a\r\nb\r\nc\r\nd\r\n", "LF, CR and CRLF become CRLF");
+        check(encodeQuotedPrintable("a \r\nb\t\nc  ", 64) == "a=20\r\nb=09\r\nc =20\r\n",
+              "whitespace before a line break or the end is escaped");
+        check(encodeQuotedPrintable("a b\tc", 64) == "a b\tc\r\n", "whitespace inside a line stays literal");
+
+        std::string line(200, 'x');
+        std::string encoded = encodeQuotedPrintable(line, 64);
+        check(encoded.compare(0, 78, std::string(75, 'x') + "=\r\n") == 0 && validQuotedPrintableLines(encoded) &&
+              decodeQuotedPrintable(encoded) == line, "long lines get soft breaks at 76 characters");
+
+        std::string escapes(100, '\xff');
+        encoded = encodeQuotedPrintable(escapes, 64);
+        check(validQuotedPrintableLines(encoded) && decodeQuotedPrintable(encoded) == escapes,
+              "soft breaks never split an escape");
+
+        std::string spaces = std::string(74, 'x') + "  \r\n" + std::string(75, 'y') + " ";
+        encoded = encodeQuotedPrintable(spaces, 64);
+        check(validQuotedPrintableLines(encoded) &&
+              decodeQuotedPrintable(encoded) == std::string(74, 'x') + "  \r\n" + std::string(75, 'y') + " ",
+              "escaped trailing whitespace at the line limit");
+
+        std::string mixed;
+        for (int i = 0; i < 300; ++i) {
+            mixed += i % 7 == 0 ? "\r\n" : i % 5 == 0 ? " \t" : i % 3 == 0 ? "caf\xc3\xa9=" : "word ";
+        }
+        std::string whole = encodeQuotedPrintable(mixed, mixed.size());
+        bool same = true;
+        for (size_t piece = 1; piece <= 9; ++piece) {
+            same = same && encodeQuotedPrintable(mixed, piece) == whole;
+        }
+        check(same && validQuotedPrintableLines(whole) && decodeQuotedPrintable(whole) == mixed,
+              "pieces of any size encode like the whole text, CR and LF split across pieces");
+    }
+
+    std::cout << "3. Header encoded-words..." << std::endl;
+    {
+        check(encodeHeaderText("Plain subject", 9) == "Plain subject", "printable ASCII unchanged");
+        check(encodeHeaderText("Caf\xc3\xa9 au lait", 9) == "=?UTF-8?Q?Caf=C3=A9_au_lait?=" &&
+              encodeHeaderText("\xd0\x9f\xd1\x80\xd0\xb8", 9) == "=?UTF-8?B?0J/RgNC4?=",
+              "short value is one word, Q or B whichever is shorter");
+        check(decodeHeader("Subject: ", encodeHeaderText("a =?x?= b", 9)).text == "a =?x?= b",
+              "text that looks like an encoded-word is encoded");
+
+        std::string latin;
+        std::string cyrillic;
+        std::string emoji;
+        for (int i = 0; i < 12; ++i) {
+            latin += "Caf\xc3\xa9 au lait and cr\xc3\xa8me ";
+            cyrillic += "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82 ";
+            emoji += "\xf0\x9f\x93\xa7\xe2\x9c\x89";
+        }
+        const std::string samples[] = {latin, cyrillic, emoji, std::string(300, '\xc3')};
+        const char* names[] = {"Q", "B", "4-byte", "malformed"};
+        for (size_t s = 0; s < 4; ++s) {
+            bool ok = true;
+            for (size_t column = 0; column <= 72; ++column) {
+                std::string prefix(column, 'h');
+                DecodedHeader decoded = decodeHeader(prefix, encodeHeaderText(samples[s], column));
+                ok = ok && decoded.text == samples[s] && decoded.words > 1 && decoded.longest_line <= 76 &&
+                     (s == 3 || decoded.valid);
+            }
+            check(ok, std::string(names[s]) +
+                  " words: lines within 76 after any header name, UTF-8 never split, text preserved");
+        }
+
+        std::string subject = encodeHeaderText(latin, 9);
+        check(splitLines("Subject: " + subject)[0].size() > 60, "first word uses the room after \"Subject: \"");
+        check(encodeHeaderText(latin, 70).compare(0, 3, "\r\n ") == 0,
+              "folded before the first word when it has no room");
+    }
+
+    std::cout << "4. Addresses..." << std::endl;
+    {
+        check(encodeAddress("zoe@example.com", 4) == "zoe@example.com" &&
+              encodeAddress("Zoe <zoe@example.com>", 4) == "Zoe <zoe@example.com>", "ASCII addresses unchanged");
+        check(encodeAddress("Zo\xc3\xab <zoe@example.com>", 4) == "=?UTF-8?Q?Zo=C3=AB?= <zoe@example.com>",
+              "display name encoded");
+        check(encodeAddress("\"Zo\xc3\xab \\\"Z\\\"\" <zoe@example.com>", 4) ==
+              "=?UTF-8?B?Wm/DqyAiWiI=?= <zoe@example.com>", "quoted display name unquoted first");
+
+        std::string name;
+        for (int i = 0; i < 6; ++i) {
+            name += "Zo\xc3\xab ";
+        }
+        std::string address = name + "Example <zoe.example@long-domain.example.com>";
+        std::string encoded = encodeAddress(address, 4);
+        size_t longest = 0;
+        for (const std::string& line : splitLines("To: " + encoded)) {
+            longest = std::max(longest, line.size());
+        }
+        check(longest <= 76 && encoded.find("\r\n <zoe.example@long-domain.example.com>") != std::string::npos,
+              "address moved to its own line to keep the encoded-word line within 76");
+    }
+
+    return summary();
+}
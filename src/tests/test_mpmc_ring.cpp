@@ -0,0 +1,228 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include "utils/mpmc_ring.hpp"
+#include "core/queue/email_queue.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::waitFor;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+const size_t PRODUCERS = 4;
+const size_t CONSUMERS = 4;
+const size_t ITEMS_PER_PRODUCER = 100000;
+
+/**
+ * Items in the ring, oldest first, as peek() sees them
+ */
+std::vector<int> peekAll(const MpmcRing<int>& ring) {
+    std::vector<int> items;
+    ring.peek([&items](int item) { items.push_back(item); });
+    return items;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing MPMC Ring" << std::endl;
+    std::cout << "=================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    std::cout << "1. Single thread..." << std::endl;
+    {
+        check(MpmcRing<int>(1).capacity() == 2 && MpmcRing<int>(3).capacity() == 4 &&
+              MpmcRing<int>(8).capacity() == 8, "capacity rounded up to a power of two");
+
+        MpmcRing<int> ring(4);
+        int item = 0;
+        check(ring.empty() && !ring.tryPop(item) && peekAll(ring).empty(), "new ring is empty");
+
+        bool pushed = true;
+        for (int i = 1; i <= 4; ++i) {
+            int value = i;
+            pushed = ring.tryPush(value) && pushed;
+        }
+        int extra = 5;
+        check(pushed && ring.size() == 4, "holds its capacity");
+        check(!ring.tryPush(extra) && extra == 5, "full ring refuses an item and leaves it intact");
+        check(peekAll(ring) == std::vector<int>({1, 2, 3, 4}) && ring.size() == 4,
+              "peek() lists the items oldest first without removing them");
+
+        check(ring.tryPop(item) && item == 1 && ring.tryPush(extra), "pop makes room for one more");
+        check(peekAll(ring) == std::vector<int>({2, 3, 4, 5}), "peek() follows the head across the wrap");
+
+        std::vector<int> popped;
+        while (ring.tryPop(item)) {
+            popped.push_back(item);
+        }
+        check(popped == std::vector<int>({2, 3, 4, 5}) && ring.empty(), "items come out in FIFO order");
+
+        // Many laps, so every slot's sequence number is reused
+        bool fifo = true;
+        for (int i = 0; i < 1000; ++i) {
+            int a = i * 2;
+            int b = i * 2 + 1;
+            fifo = ring.tryPush(a) && ring.tryPush(b) && fifo;
+            fifo = ring.tryPop(item) && item == i * 2 && fifo;
+            fifo = ring.tryPop(item) && item == i * 2 + 1 && fifo;
+        }
+        check(fifo && ring.empty(), "order kept over many laps");
+    }
+
+    std::cout << "2. Popped slots release their items..." << std::endl;
+    {
+        MpmcRing<std::shared_ptr<int>> ring(2);
+        std::shared_ptr<int> owner = std::make_shared<int>(42);
+        std::shared_ptr<int> copy = owner;
+        ring.tryPush(copy);
+        check(!copy && owner.use_count() == 2, "push moves the item in");
+        std::shared_ptr<int> out;
+        ring.tryPop(out);
+        out.reset();
+        check(owner.use_count() == 1, "nothing kept in the slot after the pop");
+    }
+
+    std::cout << "3. Producers and consumers..." << std::endl;
+    {
+        MpmcRing<size_t> ring(64);
+        std::vector<std::atomic<int>> seen(PRODUCERS * ITEMS_PER_PRODUCER);
+        std::atomic<size_t> consumed(0);
+        std::atomic<bool> ordered(true);
+
+        std::vector<std::thread> threads;
+        for (size_t p = 0; p < PRODUCERS; ++p) {
+            threads.emplace_back([&ring, p]() {
+                for (size_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+                    size_t item = p * ITEMS_PER_PRODUCER + i;
+                    while (!ring.tryPush(item)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (size_t c = 0; c < CONSUMERS; ++c) {
+            threads.emplace_back([&]() {
+                // Each producer's items must reach any one consumer in the order pushed
+                std::vector<size_t> last(PRODUCERS, 0);
+                std::vector<bool> any(PRODUCERS, false);
+                size_t item = 0;
+                while (consumed < PRODUCERS * ITEMS_PER_PRODUCER) {
+                    if (!ring.tryPop(item)) {
+                        std::this_thread::yield();
+                        continue;
+                    }
+                    size_t producer = item / ITEMS_PER_PRODUCER;
+                    if (any[producer] && item <= last[producer]) {
+                        ordered = false;
+                    }
+                    any[producer] = true;
+                    last[producer] = item;
+                    seen[item]++;
+                    consumed++;
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        size_t missing = 0;
+        size_t duplicated = 0;
+        for (const auto& count : seen) {
+            missing += count == 0 ? 1 : 0;
+            duplicated += count > 1 ? 1 : 0;
+        }
+        check(consumed == PRODUCERS * ITEMS_PER_PRODUCER && missing == 0 && duplicated == 0 && ring.empty(),
+              "every item popped exactly once by 4 consumers from 4 producers");
+        check(ordered, "each producer's items popped in the order pushed");
+    }
+
+    std::cout << "4. Queue ingress..." << std::endl;
+    {
+        // A ring smaller than the queue: producers drain it themselves when it fills
+        QueueConfig config;
+        config.max_queue_size = 10;
+        config.ingress_capacity = 2;
+        EmailQueue queue(config);
+
+        size_t accepted = 0;
+        for (int i = 0; i < 10; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@example.org", "Subject", "Body");
+            accepted += queue.enqueue(&email, i % 2 ? EmailPriority::HIGH : EmailPriority::NORMAL) ==
+                        EnqueueStatus::ACCEPTED ? 1 : 0;
+        }
+        Email overflow("sender@example.com", "late@example.org", "Subject", "Body");
+        check(accepted == 10 && queue.size() == 10, "mail beyond the ring's capacity accepted");
+        check(queue.enqueue(&overflow) == EnqueueStatus::FULL, "FULL at max_queue_size");
+
+        std::vector<QueueItem> pending = queue.getPendingEmails();
+        check(pending.size() == 10 && pending[0].priority == EmailPriority::HIGH &&
+              pending[0].to_addresses[0] == "user1@example.org" &&
+              pending.back().to_addresses[0] == "user8@example.org",
+              "pending mail includes what is still in the ring, most urgent first");
+
+        queue.close();
+        check(queue.enqueue(&overflow) == EnqueueStatus::CLOSED, "CLOSED after close()");
+    }
+
+    std::cout << "5. Concurrent enqueue while workers drain..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 4;
+        config.max_workers_per_destination = 4;
+        config.ingress_capacity = 8;
+        EmailQueue queue(config);
+
+        const int per_producer = 500;
+        std::mutex mutex;
+        std::vector<int> sends(PRODUCERS * per_producer, 0);
+        queue.setSendCallback([&mutex, &sends](const Email* email) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sends[std::stoi(email->subject)]++;
+            return SMTPResult::createSuccess();
+        });
+        queue.start();
+
+        std::atomic<int> rejected(0);
+        std::vector<std::thread> producers;
+        for (size_t p = 0; p < PRODUCERS; ++p) {
+            producers.emplace_back([&queue, &rejected, p, per_producer]() {
+                for (int i = 0; i < per_producer; ++i) {
+                    Email email("sender@example.com", "user@example.org",
+                                std::to_string(p * per_producer + i), "Body");
+                    if (queue.enqueue(&email) != EnqueueStatus::ACCEPTED) {
+                        rejected++;
+                    }
+                }
+            });
+        }
+        for (auto& producer : producers) {
+            producer.join();
+        }
+
+        size_t total = PRODUCERS * per_producer;
+        check(rejected == 0, "every enqueue accepted");
+        check(waitFor([&queue, total]() { return queue.getTotalProcessed() == total; }, std::chrono::seconds(10)),
+              "every email sent");
+        queue.stop();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t wrong = 0;
+        for (int count : sends) {
+            wrong += count == 1 ? 0 : 1;
+        }
+        check(wrong == 0, "each email sent exactly once");
+    }
+
+    return summary();
+}
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <filesystem>
+#include <cctype>
+#include <cstdlib>
+#include "core/mime/prepared_message.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/dkim/dkim_signer.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+// Boundaries are "=_" and a 26-character unique ID
+const size_t BOUNDARY_ID_LENGTH = 26;
+
+/**
+ * Replace each distinct boundary with a name numbered by first appearance,
+ * so two renderings of one email can be compared byte for byte
+ */
+std::string normalizeBoundaries(const std::string& message) {
+    std::map<std::string, std::string> names;
+    std::string result;
+    size_t pos = 0;
+    for (size_t found; (found = message.find("=_", pos)) != std::string::npos; ) {
+        std::string id = message.substr(found + 2, BOUNDARY_ID_LENGTH);
+        bool boundary = id.size() == BOUNDARY_ID_LENGTH;
+        for (char c : id) {
+            boundary = boundary && std::isalnum(static_cast<unsigned char>(c));
+        }
+        if (!boundary) {
+            result.append(message, pos, found + 2 - pos);
+            pos = found + 2;
+            continue;
+        }
+        auto it = names.emplace(id, "boundary" + std::to_string(names.size())).first;
+        result.append(message, pos, found + 2 - pos);
+        result += it->second;
+        pos = found + 2 + BOUNDARY_ID_LENGTH;
+    }
+    result.append(message, pos, std::string::npos);
+    return result;
+}
+
+/**
+ * Drop the header lines that differ per recipient
+ */
+std::string withoutRecipientHeaders(const std::string& message) {
+    size_t header_end = message.find("\r\n\r\n");
+    std::string result;
+    bool in_to = false;
+    for (size_t pos = 0; pos < header_end + 2; ) {
+        size_t end = message.find("\r\n", pos) + 2;
+        std::string line = message.substr(pos, end - pos);
+        // A folded To header continues on lines starting with a space
+        if (line[0] != ' ') {
+            in_to = line.compare(0, 4, "To: ") == 0;
+        }
+        if (!in_to && line.compare(0, 6, "Date: ") != 0 && line.compare(0, 12, "Message-ID: ") != 0) {
+            result += line;
+        }
+        pos = end;
+    }
+    return result + message.substr(header_end + 2);
+}
+
+std::string readAll(MessageStream& stream, size_t buffer_size) {
+    std::string message;
+    std::vector<char> buffer(buffer_size);
+    for (size_t count; (count = stream.read(buffer.data(), buffer.size())) > 0; ) {
+        message.append(buffer.data(), count);
+    }
+    return message;
+}
+
+void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path, std::ios::binary);
+    file << content;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Prepared Message" << std::endl;
+    std::cout << "========================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_prepared_message_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a directory for attachments" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+    std::string attachment;
+    for (int i = 0; i < 5000; ++i) {
+        attachment.push_back(static_cast<char>(i * 13));
+    }
+    writeFile(root + "/data.bin", attachment);
+    writeFile(root + "/logo.png", attachment.substr(0, 700));
+
+    const std::string to = "Zo\xc3\xab Example <zoe@example.org>";
+    Email email("sender@example.com", to, "Quarterly caf\xc3\xa9 report",
+                "Hello,\nplease find the report attached.\n\n\n");
+    email.cc = {"copy@example.net"};
+    email.html_body = "<p>Caf\xc3\xa9 <img src=\"cid:logo.png\"></p>";
+    email.inline_attachments = {root + "/logo.png"};
+    email.attachments = {root + "/data.bin"};
+
+    std::string error;
+    std::shared_ptr<const PreparedMessage> prepared = PreparedMessage::create(email, error);
+    if (!prepared) {
+        std::cout << "   ✗ Failed to prepare the message: " << error << std::endl;
+        return 1;
+    }
+    const std::string message_id = prepared->generateMessageId();
+
+    std::cout << "1. Same bytes as MimeMessageStream..." << std::endl;
+    {
+        PreparedMessageStream stream(*prepared, to, message_id);
+        std::string copy = readAll(stream, 4096);
+        std::string rendered;
+        check(MimeMessageStream::render(email, message_id, rendered, error), "message rendered directly");
+
+        check(copy.compare(0, stream.getRecipientHeaders().size(), stream.getRecipientHeaders()) == 0 &&
+              stream.getRecipientHeaders().compare(0, 4, "To: ") == 0 &&
+              stream.getRecipientHeaders().find("\r\nMessage-ID: " + message_id + "\r\n") != std::string::npos,
+              "copy starts with the recipient's To, Date and Message-ID");
+        check(normalizeBoundaries(withoutRecipientHeaders(copy)) ==
+              normalizeBoundaries(withoutRecipientHeaders(rendered)),
+              "identical apart from To, Date, Message-ID and boundaries");
+        check(prepared->getContent().find("\r\nTo: ") == std::string::npos &&
+              prepared->getHeaders().compare(0, 6, "From: ") == 0 &&
+              prepared->getHeaders().find("\r\nCc: copy@example.net\r\n") != std::string::npos,
+              "shared content holds From and Cc but no To");
+
+        Email plain_email("sender@example.com", "user@example.org", "Plain", "Body text");
+        std::shared_ptr<const PreparedMessage> simple = PreparedMessage::create(plain_email, error);
+        PreparedMessageStream simple_stream(*simple, "user@example.org", "<id@example.com>");
+        std::string simple_rendered;
+        MimeMessageStream::render(plain_email, "<id@example.com>", simple_rendered, error);
+        check(withoutRecipientHeaders(readAll(simple_stream, 4096)) == withoutRecipientHeaders(simple_rendered),
+              "single-part message identical without any normalising");
+    }
+
+    std::cout << "2. Body hash..." << std::endl;
+    {
+        PreparedMessageStream stream(*prepared, to, message_id);
+        std::string copy = readAll(stream, 4096);
+        DKIMMessageHasher hasher;
+        hasher.update(copy.data(), copy.size());
+        std::string headers;
+        std::string body_hash = hasher.finish(headers);
+        check(!body_hash.empty() && prepared->getBodyHash() == body_hash,
+              "getBodyHash() matches hashing the whole copy");
+        check(headers == copy.substr(0, copy.find("\r\n\r\n") + 2), "hasher found the same header block");
+
+        // Bytes in small pieces, so the split between header and body lands anywhere
+        DKIMMessageHasher pieces;
+        for (size_t pos = 0; pos < copy.size(); pos += 3) {
+            pieces.update(copy.data() + pos, std::min<size_t>(3, copy.size() - pos));
+        }
+        std::string piece_headers;
+        check(pieces.finish(piece_headers) == body_hash, "same hash when fed three bytes at a time");
+
+        std::shared_ptr<const PreparedMessage> restored =
+            PreparedMessage::restore(prepared->getSender(), prepared->getContent());
+        check(restored->getBodyHash() == body_hash && restored->getHeaders() == prepared->getHeaders(),
+              "restored message gives the same headers and hash");
+    }
+
+    std::cout << "3. Two-piece stream..." << std::endl;
+    {
+        PreparedMessageStream stream(*prepared, to, message_id);
+        ConstBuffer first;
+        ConstBuffer second;
+        ConstBuffer none;
+        bool transient_first = true;
+        bool transient_second = true;
+        bool transient_none = false;
+        check(stream.next(first, transient_first) && stream.next(second, transient_second) &&
+              !stream.next(none, transient_none), "exactly two pieces");
+        check(std::string(first.data, first.size) == stream.getRecipientHeaders() &&
+              second.data == prepared->getContent().data() && second.size == prepared->getContent().size(),
+              "recipient headers, then the shared content itself, not a copy");
+        check(!transient_first && !transient_second, "neither piece is transient");
+        check(stream.good() && stream.getLastError().empty(), "stream never fails");
+
+        std::string expected = stream.getRecipientHeaders() + prepared->getContent();
+        bool same = true;
+        for (size_t size : {size_t(1), size_t(7), size_t(64), expected.size() + 10}) {
+            PreparedMessageStream sized(*prepared, to, message_id);
+            same = same && readAll(sized, size) == expected;
+        }
+        check(same, "read() with any buffer size gives headers then content");
+
+        // read() and next() share the position
+        PreparedMessageStream mixed(*prepared, to, message_id);
+        char buffer[5];
+        size_t count = mixed.read(buffer, sizeof(buffer));
+        ConstBuffer rest;
+        ConstBuffer content;
+        bool transient = false;
+        check(count == 5 && mixed.next(rest, transient) &&
+              std::string(buffer, count) + std::string(rest.data, rest.size) == stream.getRecipientHeaders() &&
+              mixed.next(content, transient) && content.data == prepared->getContent().data(),
+              "next() continues where read() stopped");
+
+        PreparedMessageStream split(*prepared, to, message_id);
+        std::vector<char> head(stream.getRecipientHeaders().size() + 10);
+        count = split.read(head.data(), head.size());
+        check(count == head.size() && split.next(rest, transient) &&
+              rest.data == prepared->getContent().data() + 10,
+              "a read() across the piece boundary leaves next() inside the content");
+    }
+
+    std::cout << "4. Message-ID..." << std::endl;
+    {
+        std::string other = prepared->generateMessageId();
+        check(message_id.front() == '<' && message_id.size() > 15 &&
+              message_id.compare(message_id.size() - 13, 13, "@example.com>") == 0,
+              "in the sender's domain");
+        check(other != message_id, "a new ID for each copy");
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include "core/queue/priority_buckets.hpp"
+#include "core/queue/email_queue.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+QueueItem makeItem(const std::string& id, EmailPriority priority) {
+    QueueItem item("sender@example.com", {"user@example.org"}, "Subject", "Body");
+    item.id = id;
+    item.priority = priority;
+    return item;
+}
+
+/**
+ * IDs in the order the buckets hand them out, checking front() agrees with pop()
+ */
+std::string drain(PriorityBuckets& buckets) {
+    std::string order;
+    while (!buckets.empty()) {
+        std::string expected = buckets.front().id;
+        QueueItem item = buckets.pop();
+        order += item.id == expected ? item.id : "?";
+    }
+    return order;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Priority Buckets" << std::endl;
+    std::cout << "========================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    std::cout << "1. Strict priority..." << std::endl;
+    {
+        PriorityBuckets buckets;
+        buckets.push(makeItem("l", EmailPriority::LOW));
+        buckets.push(makeItem("n", EmailPriority::NORMAL));
+        buckets.push(makeItem("h", EmailPriority::HIGH));
+        buckets.push(makeItem("u", EmailPriority::URGENT));
+        buckets.push(makeItem("m", EmailPriority::NORMAL));
+        buckets.push(makeItem("v", EmailPriority::URGENT));
+        check(buckets.size() == 6 && buckets.level(EmailPriority::NORMAL).size() == 2, "items kept per level");
+        check(drain(buckets) == "uvhnml", "most urgent first, oldest first within a level");
+    }
+
+    std::cout << "2. Aging..." << std::endl;
+    {
+        PriorityBuckets buckets(3);
+        buckets.push(makeItem("l", EmailPriority::LOW));
+        for (char id = 'a'; id <= 'f'; ++id) {
+            buckets.push(makeItem(std::string(1, id), EmailPriority::URGENT));
+        }
+        check(drain(buckets) == "abcldef", "low priority served after being passed over three times");
+
+        buckets.setAgingLimit(2);
+        buckets.push(makeItem("l", EmailPriority::LOW));
+        buckets.push(makeItem("n", EmailPriority::NORMAL));
+        for (char id = 'a'; id <= 'e'; ++id) {
+            buckets.push(makeItem(std::string(1, id), EmailPriority::URGENT));
+        }
+        check(drain(buckets) == "abnlcde", "overdue levels served in turn, more urgent first on a tie");
+
+        buckets.setAgingLimit(0);
+        buckets.push(makeItem("l", EmailPriority::LOW));
+        for (char id = 'a'; id <= 'e'; ++id) {
+            buckets.push(makeItem(std::string(1, id), EmailPriority::URGENT));
+        }
+        check(drain(buckets) == "abcdel", "aging limit 0 serves strictly by priority");
+    }
+
+    std::cout << "3. Putting items back..." << std::endl;
+    {
+        PriorityBuckets buckets;
+        buckets.push(makeItem("a", EmailPriority::NORMAL));
+        buckets.push(makeItem("b", EmailPriority::NORMAL));
+        QueueItem first = buckets.pop();
+        buckets.push(makeItem("c", EmailPriority::NORMAL));
+        buckets.pushFront(first);
+        check(drain(buckets) == "abc", "returned item goes ahead of its level");
+    }
+
+    std::cout << "4. Aging in the email queue..." << std::endl;
+    {
+        QueueConfig config;
+        config.max_workers = 1;
+        EmailQueue queue(config);
+        queue.setBatchSize(1);
+        queue.setPriorityAging(2);
+        std::vector<std::string> order;
+        queue.setSendCallback([&order](const Email* email) {
+            order.push_back(email->to[0]);
+            return SMTPResult::createSuccess();
+        });
+        Email bulk("sender@example.com", "bulk@example.org", "Newsletter", "Body");
+        queue.enqueue(&bulk, EmailPriority::LOW);
+        for (int i = 0; i < 5; ++i) {
+            Email alert("sender@example.com", "alert" + std::to_string(i) + "@example.org", "Alert", "Body");
+            queue.enqueue(&alert, EmailPriority::URGENT);
+        }
+        std::vector<QueueItem> pending = queue.getPendingEmails();
+        check(pending.size() == 6 && pending[0].priority == EmailPriority::URGENT &&
+              pending.back().to_addresses[0] == "bulk@example.org", "pending mail listed most urgent first");
+
+        queue.start();
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (queue.getTotalProcessed() < 6 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        queue.stop();
+        check(order.size() == 6 && order[0] == "alert0@example.org" && order[2] == "bulk@example.org",
+              "low priority mail sent after two urgent sends, not last");
+    }
+
+    return summary();
+}
@@ -0,0 +1,207 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <cstdlib>
+#include "core/queue/queue_journal.hpp"
+#include "core/logging/logger.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+QueueItem makeItem(int number, size_t body_size = 64) {
+    QueueItem item("sender@example.com", {"user" + std::to_string(number) + "@example.org"},
+                   "Subject " + std::to_string(number), std::string(body_size, 'x'));
+    char id[16];
+    snprintf(id, sizeof(id), "item-%05d", number);
+    item.id = id;
+    item.domain = "example.com";
+    return item;
+}
+
+QueueJournalConfig journalConfig(const std::string& directory) {
+    QueueJournalConfig config;
+    config.directory = directory;
+    config.sync = JournalSync::SYNC;
+    return config;
+}
+
+/**
+ * What a crash would leave behind: the spool files as they are on disk right now
+ */
+std::string crashImage(const std::string& directory, const std::string& name) {
+    std::string image = directory + "-" + name;
+    fs::remove_all(image);
+    fs::copy(directory, image, fs::copy_options::recursive);
+    return image;
+}
+
+std::vector<fs::path> files(const std::string& directory, const std::string& prefix) {
+    std::vector<fs::path> found;
+    for (const auto& entry : fs::directory_iterator(directory)) {
+        if (entry.path().filename().string().compare(0, prefix.size(), prefix) == 0) {
+            found.push_back(entry.path());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    return found;
+}
+
+std::vector<QueueItem> recover(const std::string& directory, std::string& error) {
+    QueueJournal journal(journalConfig(directory));
+    std::vector<QueueItem> recovered;
+    if (!journal.open(recovered, error)) {
+        recovered.clear();
+    }
+    journal.close();
+    return recovered;
+}
+
+bool hasIds(const std::vector<QueueItem>& items, int first, int last) {
+    if (items.size() != static_cast<size_t>(last - first + 1)) {
+        return false;
+    }
+    for (int number = first; number <= last; ++number) {
+        if (items[static_cast<size_t>(number - first)].id != makeItem(number).id) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Queue Journal" << std::endl;
+    std::cout << "=====================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_queue_journal_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a spool directory" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+    std::string error;
+
+    std::cout << "1. Clean restart..." << std::endl;
+    {
+        std::string spool = root + "/clean";
+        QueueJournal journal(journalConfig(spool));
+        std::vector<QueueItem> recovered;
+        check(journal.open(recovered, error) && recovered.empty() && journal.isOwner(), "new spool opened");
+        for (int i = 1; i <= 3; ++i) {
+            journal.recordEnqueue(makeItem(i));
+        }
+        journal.recordDone(makeItem(1));
+        QueueItem retried = makeItem(2);
+        retried.status = EmailStatus::RETRY;
+        retried.retry_count = 1;
+        retried.error_message = "Try again later";
+        journal.recordRetry(retried);
+        journal.close();
+
+        recovered = recover(spool, error);
+        check(hasIds(recovered, 2, 3), "sent item gone, the others restored");
+        check(!recovered.empty() && recovered[0].retry_count == 1 && recovered[0].status == EmailStatus::RETRY &&
+              recovered[0].error_message == "Try again later", "retry state restored");
+        check(recovered.size() == 2 && recovered[1].to_addresses[0] == "user3@example.org" &&
+              recovered[1].subject == "Subject 3" && recovered[1].body == std::string(64, 'x'), "content restored");
+        check(files(spool, "segment-").size() == 1, "closing checkpoints, leaving one empty segment");
+    }
+
+    std::cout << "2. Crash and replay..." << std::endl;
+    std::string crashed = root + "/crash";
+    QueueJournal journal(journalConfig(crashed));
+    std::vector<QueueItem> recovered;
+    journal.open(recovered, error);
+    for (int i = 1; i <= 5; ++i) {
+        journal.recordEnqueue(makeItem(i));
+    }
+    std::string image = crashImage(crashed, "intact");
+    std::string torn = crashImage(crashed, "torn");
+    std::string corrupt = crashImage(crashed, "corrupt");
+    journal.close();
+
+    recovered = recover(image, error);
+    check(hasIds(recovered, 1, 5), "every synced record replayed without a checkpoint");
+
+    std::cout << "3. Torn and corrupt records..." << std::endl;
+    std::vector<fs::path> segments = files(torn, "segment-");
+    if (!segments.empty()) {
+        fs::resize_file(segments.back(), fs::file_size(segments.back()) - 3);
+    }
+    recovered = recover(torn, error);
+    check(hasIds(recovered, 1, 4), "record cut short by the crash ignored, earlier ones kept");
+    recovered = recover(torn, error);
+    check(hasIds(recovered, 1, 4), "recovery is repeatable after its own checkpoint");
+
+    segments = files(corrupt, "segment-");
+    if (!segments.empty()) {
+        std::fstream file(segments.back(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(static_cast<std::streamoff>(fs::file_size(segments.back()) - 20));
+        file.put('#');
+    }
+    recovered = recover(corrupt, error);
+    check(hasIds(recovered, 1, 4), "record failing its CRC ends the replay");
+
+    std::cout << "4. Checkpoints bound the log..." << std::endl;
+    {
+        std::string spool = root + "/checkpoint";
+        QueueJournalConfig config = journalConfig(spool);
+        config.segment_bytes = 4096;
+        config.checkpoint_bytes = 16384;
+        QueueJournal busy(config);
+        busy.open(recovered, error);
+        for (int i = 1; i <= 500; ++i) {
+            busy.recordEnqueue(makeItem(i, 200));
+            if (i > 10) {
+                busy.recordDone(makeItem(i - 10));
+            }
+        }
+        busy.recordEnqueue(makeItem(501));      // Its commit also makes the last done record durable
+        QueueJournalStats stats = busy.getStats();
+        check(stats.checkpoints >= 5, "checkpoints written as the log grows");
+        check(stats.live_items == 11, "only live items tracked");
+        check(files(spool, "segment-").size() <= 5 && files(spool, "checkpoint-").size() == 1,
+              "covered segments and checkpoints deleted");
+
+        std::string busy_image = crashImage(spool, "image");
+        recovered = recover(busy_image, error);
+        check(hasIds(recovered, 491, 501), "crash after checkpoints restores exactly the live items");
+
+        check(busy.checkpoint(error), "explicit checkpoint");
+        std::string checkpointed = crashImage(spool, "checkpointed");
+        fs::path leftover = fs::path(checkpointed) / ".checkpoint-00000000000000ff.chk.tmp";
+        std::ofstream(leftover.string()) << "partial";
+        recovered = recover(checkpointed, error);
+        check(hasIds(recovered, 491, 501), "recovered from the checkpoint alone");
+        check(!fs::exists(leftover), "interrupted checkpoint file removed");
+        busy.close();
+    }
+
+    std::cout << "5. One owner per spool..." << std::endl;
+    {
+        std::string spool = root + "/owned";
+        QueueJournal owner(journalConfig(spool));
+        QueueJournal other(journalConfig(spool));
+        owner.open(recovered, error);
+        check(other.open(recovered, error) && !other.isOwner(), "second journal opens for submission only");
+        check(!other.acquire(recovered, error) && error.find("another process") != std::string::npos,
+              "takeover refused while the owner holds the spool");
+        owner.close();
+        check(other.acquire(recovered, error) && other.isOwner(), "takeover once the owner has gone");
+        other.close();
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
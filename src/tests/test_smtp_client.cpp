@@ -0,0 +1,284 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "core/smtp/smtp_client.hpp"
+#include "core/smtp/smtp_connection_pool.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/logging/logger.hpp"
+#include "stub_smtp_server.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::StubSMTPServer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+/**
+ * Relay settings for the stub: plaintext, AUTH PLAIN
+ */
+DomainConfig stubRelay(int port) {
+    DomainConfig relay;
+    relay.name = "example.com";
+    relay.smtp_server = "127.0.0.1";
+    relay.smtp_port = port;
+    relay.auth_method = "PLAIN";
+    relay.username = "user";
+    relay.password = "secret";
+    relay.use_starttls = false;
+    return relay;
+}
+
+bool contains(const std::vector<std::string>& commands, const std::string& command) {
+    for (const auto& line : commands) {
+        if (line == command) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Content as DATA must send it: every line starting with a dot gets another
+ */
+std::string dotStuffed(const std::string& content) {
+    std::string stuffed;
+    for (size_t pos = 0; pos < content.size(); ) {
+        size_t end = content.find("\r\n", pos);
+        end = end == std::string::npos ? content.size() : end + 2;
+        if (content[pos] == '.') {
+            stuffed.push_back('.');
+        }
+        stuffed.append(content, pos, end - pos);
+        pos = end;
+    }
+    return stuffed;
+}
+
+/**
+ * Drop the Date header, which depends on when the message was rendered
+ */
+std::string withoutDate(const std::string& message) {
+    size_t start = message.find("\r\nDate: ");
+    if (start == std::string::npos) {
+        return message;
+    }
+    return message.substr(0, start) + message.substr(message.find("\r\n", start + 2));
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing SMTP Client" << std::endl;
+    std::cout << "===================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    ConfigManager config;
+    std::vector<std::string> recipients = {"one@example.org", "two@example.org", "three@example.org"};
+
+    std::cout << "1. Native session..." << std::endl;
+    {
+        StubSMTPServer server;
+        server.setCapabilities({"AUTH PLAIN LOGIN", "8BITMIME"});
+        server.start();
+        SMTPClient client(config);
+        check(client.openSession(stubRelay(server.port())), "session opens");
+        check(client.hasCapability("8BITMIME") && !client.hasCapability("PIPELINING"),
+              "EHLO capabilities parsed");
+        Email email("sender@example.com", "user@example.org", "Hello", "Plain body");
+        SMTPResult result = client.sendEmail(email);
+        check(result.success && !result.message_id.empty(), "message accepted");
+        client.closeSession();
+        std::vector<std::string> commands = server.commands();
+        check(contains(commands, "AUTH PLAIN AHVzZXIAc2VjcmV0"), "credentials sent with AUTH PLAIN");
+        check(!commands.empty() && commands.back() == "QUIT", "session ends with QUIT");
+        std::vector<StubSMTPServer::Message> messages = server.messages();
+        check(messages.size() == 1 && messages[0].sender == "sender@example.com" &&
+              messages[0].recipients.size() == 1 && messages[0].chunks == 0, "sent with DATA");
+        check(messages.size() == 1 && messages[0].data.find("Subject: Hello\r\n") != std::string::npos &&
+              messages[0].data.find("\r\n\r\nPlain body\r\n") != std::string::npos, "headers and body received");
+    }
+
+    std::cout << "2. CRAM-MD5..." << std::endl;
+    {
+        // RFC 2195 section 2 example exchange
+        StubSMTPServer server;
+        server.setCapabilities({"AUTH CRAM-MD5"});
+        server.setCramChallenge("PDE4OTYuNjk3MTcwOTUyQHBvc3RvZmZpY2UucmVzdG9uLm1jaS5uZXQ+");
+        server.start();
+        DomainConfig relay = stubRelay(server.port());
+        relay.auth_method = "CRAM-MD5";
+        relay.username = "tim";
+        relay.password = "tanstaaftanstaaf";
+        SMTPClient client(config);
+        check(client.openSession(relay), "session opens");
+        client.closeSession();
+        check(contains(server.commands(), "dGltIGI5MTNhNjAyYzdlZGE3YTQ5NWI0ZTZlNzMzNGQzODkw"),
+              "keyed digest of the challenge sent");
+
+        StubSMTPServer malformed;
+        malformed.setCapabilities({"AUTH CRAM-MD5"});
+        malformed.setCramChallenge("not*base64");
+        malformed.start();
+        relay.smtp_port = malformed.port();
+        SMTPClient refused(config);
+        check(!refused.openSession(relay) &&
+              refused.getLastError().find("malformed challenge") != std::string::npos,
+              "malformed challenge fails the AUTH");
+        check(contains(malformed.commands(), "*"), "exchange cancelled instead of answered");
+    }
+
+    std::cout << "3. Dot-stuffing..." << std::endl;
+    {
+        StubSMTPServer server;
+        server.start();
+        SMTPClient client(config);
+        client.openSession(stubRelay(server.port()));
+        Email email("sender@example.com", "user@example.org", "Dots", ".first\nmiddle\n.\n..two\nlast");
+        check(client.sendEmail(email).success, "message accepted");
+        client.closeSession();
+        std::vector<StubSMTPServer::Message> messages = server.messages();
+        check(messages.size() == 1 && messages[0].raw.find("\r\n\r\n..first\r\nmiddle\r\n..\r\n...two\r\n") !=
+              std::string::npos, "every leading dot doubled on the wire");
+        check(messages.size() == 1 && messages[0].data.find("\r\n\r\n.first\r\nmiddle\r\n.\r\n..two\r\nlast\r\n") !=
+              std::string::npos, "a lone dot does not end the message early");
+    }
+
+    std::cout << "4. Session reuse through the pool..." << std::endl;
+    {
+        StubSMTPServer server;
+        server.start();
+        server.rejectRecipient("nobody@example.org");
+        SMTPConnectionPool pool(config);
+        DomainConfig relay = stubRelay(server.port());
+        bool all_sent = true;
+        for (int i = 0; i < 3; ++i) {
+            Email email("sender@example.com", "user" + std::to_string(i) + "@example.org", "Pooled", "Body");
+            all_sent = pool.send(relay, email).success && all_sent;
+        }
+        check(all_sent, "every message accepted");
+        check(server.connections() == 1, "one connection for three messages");
+        check(server.countCommands("AUTH") == 1, "authenticated once");
+        check(server.countCommands("RSET") == 0, "completed transactions need no RSET");
+
+        Email rejected("sender@example.com", "nobody@example.org", "Pooled", "Body");
+        check(!pool.send(relay, rejected).success, "transaction with no valid recipient fails");
+        check(server.countCommands("RSET") == 1, "failed transaction cleared with RSET");
+        Email after("sender@example.com", "user@example.org", "Pooled", "Body");
+        check(pool.send(relay, after).success && server.connections() == 1, "session reused after the RSET");
+        SMTPPoolStats stats = pool.getStats();
+        check(stats.sessions_opened == 1 && stats.sessions_reused == 4, "pool statistics count the reuse");
+        pool.closeAll();
+        check(server.commands().back() == "QUIT", "closing the pool ends the session");
+    }
+
+    std::cout << "5. Pipelined envelope..." << std::endl;
+    {
+        StubSMTPServer pipelining;
+        pipelining.setCapabilities({"PIPELINING"});
+        pipelining.rejectRecipient("two@example.org");
+        pipelining.start();
+        SMTPClient client(config);
+        client.openSession(stubRelay(pipelining.port()));
+        Email email("sender@example.com", recipients, "Pipelined", "Body");
+        SMTPResult result = client.sendEmail(email);
+        client.closeSession();
+        std::vector<StubSMTPServer::Message> messages = pipelining.messages();
+        check(messages.size() == 1 && messages[0].envelope_batch == 5,
+              "MAIL FROM, three RCPT TO and DATA sent in one batch");
+        check(result.success && result.getRejectedRecipients().size() == 1 &&
+              result.getRejectedRecipients()[0].address == "two@example.org", "rejected recipient reported");
+        check(messages.size() == 1 && messages[0].recipients.size() == 2, "accepted recipients delivered");
+
+        StubSMTPServer lockstep;
+        lockstep.start();
+        SMTPClient plain(config);
+        plain.openSession(stubRelay(lockstep.port()));
+        check(plain.sendEmail(email).success, "message accepted without PIPELINING");
+        plain.closeSession();
+        messages = lockstep.messages();
+        check(messages.size() == 1 && messages[0].envelope_batch == 1, "commands wait for replies");
+    }
+
+    std::cout << "6. BDAT chunks..." << std::endl;
+    {
+        StubSMTPServer server;
+        server.setCapabilities({"CHUNKING", "8BITMIME"});
+        server.start();
+        std::string body;
+        for (int i = 0; body.size() < 600 * 1024; ++i) {
+            body += "Line " + std::to_string(i) + " of a message large enough for several chunks\n";
+        }
+        body += ".leading dot\n";
+        SMTPClient client(config);
+        client.openSession(stubRelay(server.port()));
+        Email email("sender@example.com", "user@example.org", "Chunked", body);
+        check(client.sendEmail(email).success, "message accepted");
+        client.closeSession();
+        std::vector<StubSMTPServer::Message> messages = server.messages();
+        std::vector<std::string> commands = server.commands();
+        check(messages.size() == 1 && messages[0].chunks >= 3, "sent as several BDAT chunks");
+        check(server.countCommands("DATA") == 0, "DATA not used");
+        bool last_marked = false;
+        for (const auto& command : commands) {
+            if (command.compare(0, 5, "BDAT ") == 0) {
+                last_marked = command.find(" LAST") != std::string::npos;
+            }
+        }
+        check(last_marked, "final chunk marked LAST");
+        check(messages.size() == 1 && messages[0].raw.find("\r\n.leading dot\r\n") != std::string::npos,
+              "content sent without dot-stuffing");
+        check(messages.size() == 1 && messages[0].raw.find("Line 0 of") != std::string::npos &&
+              messages[0].raw.find("Line 9000 of") != std::string::npos, "chunks reassemble the whole message");
+    }
+
+    std::cout << "7. Gathered writes..." << std::endl;
+    {
+        // Each line starting with a dot splits the content into another buffer, so a
+        // single write holds far more buffers than one sendmsg() takes (IOV_MAX)
+        std::string body;
+        for (int i = 0; body.size() < 2 * 1024 * 1024; ++i) {
+            body += i % 3 == 0 ? ".\n" : i % 3 == 1 ? "..x\n" : "y\n";
+            // Runs without dots, some long enough to be written in place under TLS
+            if (i % 1000 == 0) {
+                for (int line = 0; line < i / 1000 % 40; ++line) {
+                    body += std::string(900, static_cast<char>('a' + line % 26)) + "\n";
+                }
+            }
+        }
+
+        Email email("sender@example.com", "user@example.org", "Gathered", body);
+        std::string rendered;
+        std::string error;
+        MimeMessageStream::render(email, "<gathered@example.com>", rendered, error);
+
+        for (bool tls : {false, true}) {
+            for (bool chunking : {false, true}) {
+                StubSMTPServer server;
+                server.setCapabilities(chunking ? std::vector<std::string>{"CHUNKING"} : std::vector<std::string>{});
+                if (tls) {
+                    server.enableTLS();
+                }
+                server.start();
+                DomainConfig relay = stubRelay(server.port());
+                relay.use_starttls = tls;
+                relay.ssl_verify_peer = false;
+                SMTPClient client(config);
+                client.openSession(relay);
+                bool sent = client.sendEmail(email, {"user@example.org"}, "<gathered@example.com>").success;
+                client.closeSession();
+
+                std::vector<StubSMTPServer::Message> messages = server.messages();
+                std::string expected = chunking ? rendered : dotStuffed(rendered);
+                std::string name = std::string(tls ? "STARTTLS" : "plain TCP") + (chunking ? ", BDAT" : ", DATA");
+                check(sent && messages.size() == 1 && messages[0].secure == tls &&
+                      (chunking ? messages[0].chunks > 0 : messages[0].chunks == 0), name + ": message accepted");
+                check(messages.size() == 1 && withoutDate(messages[0].raw) == withoutDate(expected),
+                      name + ": bytes received are the rendered message");
+            }
+        }
+    }
+
+    return summary();
+}
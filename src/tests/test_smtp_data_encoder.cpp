@@ -0,0 +1,228 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include "core/smtp/smtp_data_encoder.hpp"
+#include "utils/byte_scan.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+const char* kernelName(ScanKernel kernel) {
+    switch (kernel) {
+    case ScanKernel::SCALAR:
+        return "scalar";
+    case ScanKernel::SSE2:
+        return "SSE2";
+    case ScanKernel::AVX2:
+        return "AVX2";
+    case ScanKernel::NEON:
+        return "NEON";
+    }
+    return "unknown";
+}
+
+/**
+ * Byte-at-a-time canonicalisation: every CR, LF or CRLF becomes CRLF, a
+ * leading dot is doubled when dot-stuffing, and the content ends with CRLF
+ */
+std::string referenceEncode(const std::string& input, bool dot_stuff) {
+    std::string output;
+    bool line_start = true;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (c == '\r' || c == '\n') {
+            output += "\r\n";
+            if (c == '\r' && i + 1 < input.size() && input[i + 1] == '\n') {
+                i++;
+            }
+            line_start = true;
+            continue;
+        }
+        if (line_start && dot_stuff && c == '.') {
+            output += '.';
+        }
+        output += c;
+        line_start = false;
+    }
+    if (!line_start) {
+        output += "\r\n";
+    }
+    return output;
+}
+
+/**
+ * Encode input split at the given offsets, through the copying form
+ */
+std::string encodeCopying(const std::string& input, const std::vector<size_t>& splits, bool dot_stuff) {
+    SMTPDataEncoder encoder(dot_stuff);
+    std::string output;
+    size_t start = 0;
+    for (size_t split : splits) {
+        encoder.encode(input.data() + start, split - start, output);
+        start = split;
+    }
+    encoder.encode(input.data() + start, input.size() - start, output);
+    encoder.finish(output);
+    return output;
+}
+
+/**
+ * Encode input split at the given offsets, through the buffer form, checking the returned counts
+ */
+std::string encodeViews(const std::string& input, const std::vector<size_t>& splits, bool dot_stuff) {
+    SMTPDataEncoder encoder(dot_stuff);
+    std::vector<ConstBuffer> buffers;
+    size_t produced = 0;
+    size_t start = 0;
+    for (size_t split : splits) {
+        produced += encoder.encode(input.data() + start, split - start, buffers);
+        start = split;
+    }
+    produced += encoder.encode(input.data() + start, input.size() - start, buffers);
+    produced += encoder.finish(buffers);
+
+    std::string output;
+    for (const auto& buffer : buffers) {
+        output.append(buffer.data, buffer.size);
+    }
+    return output.size() == produced ? output : "<count mismatch>";
+}
+
+/**
+ * Whether both forms match the reference for the input in one piece, split
+ * once at every offset, and cut into pieces of 1 to 7 bytes
+ */
+bool encodesLikeReference(const std::string& input, bool dot_stuff) {
+    std::string expected = referenceEncode(input, dot_stuff);
+    std::vector<std::vector<size_t>> splittings = {{}};
+    for (size_t split = 0; split <= input.size(); ++split) {
+        splittings.push_back({split});
+    }
+    for (size_t piece = 1; piece <= 7; ++piece) {
+        std::vector<size_t> splits;
+        for (size_t split = piece; split < input.size(); split += piece) {
+            splits.push_back(split);
+        }
+        splittings.push_back(splits);
+    }
+    for (const auto& splits : splittings) {
+        if (encodeCopying(input, splits, dot_stuff) != expected ||
+            encodeViews(input, splits, dot_stuff) != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool encodesLikeReference(const std::string& input) {
+    return encodesLikeReference(input, true) && encodesLikeReference(input, false);
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing SMTP Data Encoder" << std::endl;
+    std::cout << "=========================" << std::endl;
+
+    const std::vector<ScanKernel> kernels = scanKernels();
+
+    std::cout << "Kernels:";
+    for (ScanKernel kernel : kernels) {
+        std::cout << " " << kernelName(kernel);
+    }
+    std::cout << std::endl;
+
+    std::cout << "1. Line break scan..." << std::endl;
+    {
+        // Bytes that differ from CR or LF in one bit, or only in the sign bit
+        std::string text;
+        for (size_t i = 0; i < 200; ++i) {
+            const char filler[] = {'a', '\x0b', '\x0c', '\x8a', '\x8d', '\x0e', '\x09', ' '};
+            text.push_back(filler[i % sizeof(filler)]);
+        }
+        for (ScanKernel kernel : kernels) {
+            bool same = true;
+            for (size_t offset = 0; offset < 32; ++offset) {
+                for (size_t length = 0; length + offset <= text.size(); ++length) {
+                    const char* data = text.data() + offset;
+                    same = same && findLineBreakWith(kernel, data, length) == length;
+                }
+            }
+            for (char line_break : {'\r', '\n'}) {
+                for (size_t offset = 0; offset < 32; ++offset) {
+                    for (size_t position = offset; position < 140; ++position) {
+                        std::string marked = text;
+                        marked[position] = line_break;
+                        // A later break must not hide the first one
+                        marked[position + 1 + position % 40] = line_break == '\r' ? '\n' : '\r';
+                        const char* data = marked.data() + offset;
+                        size_t length = marked.size() - offset;
+                        same = same && findLineBreakWith(kernel, data, length) == position - offset &&
+                               findLineBreakWith(kernel, data, position - offset) == position - offset;
+                    }
+                }
+            }
+            check(same, std::string(kernelName(kernel)) + " finds the first CR or LF at every position and alignment");
+        }
+    }
+
+    std::cout << "2. Line breaks..." << std::endl;
+    {
+        check(encodesLikeReference("one\r\ntwo\r\n"), "CRLF kept");
+        check(encodesLikeReference("one\ntwo\nthree"), "bare LF becomes CRLF");
+        check(encodesLikeReference("one\rtwo\rthree"), "bare CR becomes CRLF");
+        check(encodesLikeReference("a\n\rb\r\r\nc\n\n\r\r"), "mixed and repeated breaks");
+        check(encodesLikeReference("\r") && encodesLikeReference("\n") && encodesLikeReference(""),
+              "break alone, and no content at all");
+        check(encodesLikeReference("no final break") && encodesLikeReference("final CR\r"),
+              "content ended with CRLF");
+    }
+
+    std::cout << "3. Dot-stuffing..." << std::endl;
+    {
+        check(encodesLikeReference(".leading dot") && encodesLikeReference("..two dots"), "leading dot doubled");
+        check(encodesLikeReference("a\n.\nb\r.\r\n.\r\n") && encodesLikeReference(".\r\n.\r\n"),
+              "lines of a single dot");
+        check(encodesLikeReference("a.b\n x.\n"), "only a dot that starts a line");
+        check(referenceEncode(".a\n", true) == "..a\r\n" && referenceEncode(".a\n", false) == ".a\r\n",
+              "reference stuffs for DATA only");
+    }
+
+    std::cout << "4. Vector block boundaries..." << std::endl;
+    {
+        // A break, and then a dot, at and around the ends of 16- and 32-byte blocks
+        bool same = true;
+        for (size_t position = 0; position < 70; ++position) {
+            for (const char* line_break : {"\r\n", "\n", "\r"}) {
+                std::string input = std::string(position, 'x') + line_break + ".dot" + std::string(40, 'y') + "\n";
+                same = same && encodesLikeReference(input);
+            }
+            // CR as the last byte of a block, LF as the first of the next
+            std::string split_pair = std::string(position, 'x') + "\r\n" + std::string(position % 7, 'z');
+            same = same && encodesLikeReference(split_pair);
+        }
+        check(same, "breaks and dots at every offset from a block boundary");
+    }
+
+    std::cout << "5. Random content..." << std::endl;
+    {
+        std::mt19937 random(5);
+        const char alphabet[] = {'a', 'b', '.', '.', '\r', '\n', ' ', '\x80'};
+        bool same = true;
+        for (int round = 0; round < 300 && same; ++round) {
+            std::string input(random() % 120, '\0');
+            for (char& c : input) {
+                c = alphabet[random() % sizeof(alphabet)];
+            }
+            same = encodesLikeReference(input);
+        }
+        check(same, "300 random inputs match the reference in every split");
+    }
+
+    return summary();
+}
@@ -0,0 +1,200 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include "core/smtp/smtp_event_loop.hpp"
+#include "core/mime/message_stream.hpp"
+#include "core/logging/logger.hpp"
+#include "stub_smtp_server.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::StubSMTPServer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+/**
+ * Relay settings for the stub: plaintext, no authentication
+ */
+DomainConfig stubRelay(int port) {
+    DomainConfig relay;
+    relay.name = "example.com";
+    relay.smtp_server = "127.0.0.1";
+    relay.smtp_port = port;
+    relay.auth_method = "none";
+    relay.use_starttls = false;
+    return relay;
+}
+
+/**
+ * Collects completion callbacks from worker threads
+ */
+class Results {
+public:
+    SMTPEventLoop::CompletionCallback add() {
+        return [this](const SMTPResult& result) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            results_.push_back(result);
+        };
+    }
+
+    bool wait(size_t count, std::chrono::milliseconds timeout) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (results_.size() >= count) {
+                    return true;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        return false;
+    }
+
+    std::vector<SMTPResult> get() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return results_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<SMTPResult> results_;
+};
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing SMTP Event Loop" << std::endl;
+    std::cout << "=======================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    StubSMTPServer server;
+    if (!server.start()) {
+        std::cout << "   ✗ Failed to start stub SMTP server" << std::endl;
+        return 1;
+    }
+    server.setCapabilities({"PIPELINING", "8BITMIME"});
+
+    ConfigManager config;
+    SMTPEventLoopConfig loop_config;
+    loop_config.worker_threads = 2;
+    SMTPEventLoop loop(config, loop_config);
+    check(loop.start(), "loop starts");
+    DomainConfig relay = stubRelay(server.port());
+
+    std::cout << "1. Concurrent sessions..." << std::endl;
+    const size_t count = 20;
+    Results concurrent;
+    size_t accepted = 0;
+    for (size_t i = 0; i < count; ++i) {
+        Email email("sender@example.com", "user" + std::to_string(i) + "@example.org",
+                    "Message " + std::to_string(i), "Body " + std::to_string(i));
+        accepted += loop.submit(relay, email, concurrent.add()) ? 1 : 0;
+    }
+    check(accepted == count, "every submission accepted");
+    check(concurrent.wait(count, std::chrono::seconds(10)), "every session completes");
+    size_t succeeded = 0;
+    for (const auto& result : concurrent.get()) {
+        succeeded += result.success ? 1 : 0;
+    }
+    check(succeeded == count, "every message delivered");
+    check(server.messages().size() == count, "server received every message");
+    check(server.connections() == static_cast<int>(count), "one connection per session");
+    check(loop.getActiveSessions() == 0, "no sessions left active");
+
+    std::cout << "2. Pipelined envelope..." << std::endl;
+    bool batched = true;
+    for (const auto& message : server.messages()) {
+        batched = batched && message.envelope_batch == 3;
+    }
+    check(batched, "MAIL FROM, RCPT TO and DATA sent without waiting");
+
+    std::cout << "3. Explicit envelope with a signature..." << std::endl;
+    Email email("From Header <header@example.com>", "shown@example.org", "Envelope",
+                "First line\n.leading dot\n..two dots\nLast line");
+    SMTPOutgoingMessage outgoing;
+    outgoing.sender = "bounce@example.com";
+    outgoing.recipients = {"one@example.org", "two@example.org"};
+    outgoing.message_id = "<envelope@example.com>";
+    outgoing.signature = "DKIM-Signature: v=1; a=rsa-sha256; d=example.com; s=test; b=stub\r\n";
+    outgoing.content.reset(new MimeMessageStream(email, outgoing.message_id));
+    Results signed_result;
+    size_t before = server.messages().size();
+    check(loop.submit(relay, outgoing, signed_result.add()), "transaction accepted");
+    check(signed_result.wait(1, std::chrono::seconds(5)) && signed_result.get()[0].success,
+          "transaction delivered");
+    std::vector<StubSMTPServer::Message> messages = server.messages();
+    if (messages.size() > before) {
+        const StubSMTPServer::Message& message = messages.back();
+        check(message.sender == "bounce@example.com", "MAIL FROM uses the envelope sender");
+        check(message.recipients.size() == 2 && message.recipients[0] == "one@example.org" &&
+              message.recipients[1] == "two@example.org", "RCPT TO uses the envelope recipients");
+        check(message.data.compare(0, outgoing.signature.size(), outgoing.signature) == 0,
+              "signature sent ahead of the content");
+        check(message.raw.find("\r\n..leading dot\r\n") != std::string::npos &&
+              message.raw.find("\r\n...two dots\r\n") != std::string::npos, "leading dots stuffed");
+        check(message.data.find("\r\n.leading dot\r\n") != std::string::npos &&
+              message.data.find("\r\n..two dots\r\n") != std::string::npos, "content intact after unstuffing");
+    } else {
+        check(false, "server received the transaction");
+    }
+
+    std::cout << "4. Rejected recipient..." << std::endl;
+    server.rejectRecipient("nobody@example.org");
+    Results partial;
+    Email mixed("sender@example.com", std::vector<std::string>{"nobody@example.org", "somebody@example.org"},
+                "Partial", "Body");
+    loop.submit(relay, mixed, partial.add());
+    check(partial.wait(1, std::chrono::seconds(5)), "session completes");
+    if (!partial.get().empty()) {
+        SMTPResult result = partial.get()[0];
+        check(result.success, "delivered to the remaining recipient");
+        check(result.getRejectedRecipients().size() == 1 &&
+              result.getRejectedRecipients()[0].address == "nobody@example.org" &&
+              result.getRejectedRecipients()[0].reply_code == 550, "rejection reported per recipient");
+    }
+    loop.stop();
+
+    std::cout << "5. Unresponsive server..." << std::endl;
+    StubSMTPServer silent;
+    silent.setSilent(true);
+    silent.start();
+    char path[] = "/tmp/test_smtp_event_loop_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        close(fd);
+    }
+    {
+        std::ofstream file(path);
+        file << "[global]\nread_timeout = 1\ndomains_dir = " << path << ".missing\n";
+    }
+    ConfigManager timeout_config;
+    check(timeout_config.loadFromFile(path), "configuration with read_timeout = 1 loads");
+    unlink(path);
+    SMTPEventLoop timeout_loop(timeout_config);
+    timeout_loop.start();
+    Results timed_out;
+    Email waiting("sender@example.com", "user@example.org", "Waiting", "Body");
+    auto started = std::chrono::steady_clock::now();
+    timeout_loop.submit(stubRelay(silent.port()), waiting, timed_out.add());
+    check(timed_out.wait(1, std::chrono::seconds(5)) && !timed_out.get()[0].success,
+          "missing greeting fails the session");
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    check(seconds >= 0.9 && seconds < 3, "failure comes after the read timeout");
+    timeout_loop.stop();
+
+    std::cout << "6. Stopped loop..." << std::endl;
+    Results refused;
+    check(!timeout_loop.submit(relay, waiting, refused.add()), "submission refused");
+    check(!timeout_loop.getLastError().empty(), "error reported");
+
+    return summary();
+}
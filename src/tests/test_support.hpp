@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+namespace ssmtp_mailer {
+namespace testing {
+
+/**
+ * Number of failed checks so far in this test program
+ */
+inline int failures = 0;
+
+/**
+ * Print one check's outcome and count it if it failed
+ */
+inline void check(bool condition, const std::string& description) {
+    std::cout << "   " << (condition ? "✓ " : "✗ ") << description << std::endl;
+    if (!condition) {
+        failures++;
+    }
+}
+
+/**
+ * Poll a condition every millisecond until it holds or the timeout passes
+ */
+template <typename Condition>
+bool waitFor(Condition condition, std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/**
+ * Print the final line and return the program's exit status
+ */
+inline int summary() {
+    if (failures > 0) {
+        std::cout << "\n" << failures << " test(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "\nAll tests completed!" << std::endl;
+    return 0;
+}
+
+} // namespace testing
+} // namespace ssmtp_mailer
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include "utils/timer_wheel.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+std::chrono::milliseconds ms(int64_t count) {
+    return std::chrono::milliseconds(count);
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Timer Wheel" << std::endl;
+    std::cout << "===================" << std::endl;
+
+    // Time is simulated: every call passes an explicit "now" relative to base
+    std::cout << "1. Deadlines round up to the tick..." << std::endl;
+    {
+        TimerWheel wheel(ms(10), 8);
+        auto base = TimerWheel::Clock::now();
+        std::vector<uint64_t> expired;
+        wheel.schedule(base + ms(25), 1);
+        wheel.advance(base + ms(20), expired);
+        check(expired.empty(), "not fired before its deadline");
+        wheel.advance(base + ms(40), expired);
+        check(expired.size() == 1 && expired[0] == 1, "fired on the first advance past its deadline");
+        check(wheel.empty(), "fired timer removed");
+
+        wheel.schedule(base - ms(100), 2);
+        wheel.advance(base + ms(60), expired);
+        check(expired.size() == 2 && expired[1] == 2, "deadline in the past fires on the next tick");
+    }
+
+    std::cout << "2. Several revolutions..." << std::endl;
+    {
+        TimerWheel wheel(ms(10), 8);
+        auto base = TimerWheel::Clock::now();
+        std::vector<uint64_t> expired;
+        wheel.schedule(base + ms(1000), 1);
+        wheel.schedule(base + ms(15), 2);
+        wheel.advance(base + ms(500), expired);
+        check(expired.size() == 1 && expired[0] == 2, "timer many revolutions away keeps waiting");
+        wheel.advance(base + ms(1020), expired);
+        check(expired.size() == 2 && expired[1] == 1, "and fires when its revolution comes");
+    }
+
+    std::cout << "3. Cancellation..." << std::endl;
+    {
+        TimerWheel wheel(ms(10), 8);
+        auto base = TimerWheel::Clock::now();
+        std::vector<uint64_t> expired;
+        TimerWheel::TimerId first = wheel.schedule(base + ms(30), 1);
+        wheel.schedule(base + ms(30), 2);
+        check(wheel.size() == 2, "two timers pending");
+        check(wheel.cancel(first) && !wheel.cancel(first), "cancel succeeds once");
+        wheel.advance(base + ms(50), expired);
+        check(expired.size() == 1 && expired[0] == 2, "cancelled timer does not fire");
+    }
+
+    std::cout << "4. Time until the next expiry..." << std::endl;
+    {
+        TimerWheel wheel(ms(10), 8);
+        auto base = TimerWheel::Clock::now();
+        check(wheel.millisecondsUntilNextExpiry(base) == -1, "nothing pending");
+        TimerWheel::TimerId soon = wheel.schedule(base + ms(40), 1);
+        wheel.schedule(base + ms(2000), 2);
+        int wait = wheel.millisecondsUntilNextExpiry(base);
+        check(wait >= 40 && wait <= 51, "earliest deadline, not the next tick");
+        wheel.cancel(soon);
+        wait = wheel.millisecondsUntilNextExpiry(base);
+        check(wait >= 2000 && wait <= 2011, "recomputed after the earliest is cancelled");
+        check(wheel.millisecondsUntilNextExpiry(base + ms(3000)) == 0, "overdue timer needs no wait");
+    }
+
+    std::cout << "5. Many timers..." << std::endl;
+    {
+        TimerWheel wheel(ms(10), 64);
+        auto base = TimerWheel::Clock::now();
+        std::mt19937 random(42);
+        std::uniform_int_distribution<int> delay(0, 5000);
+        std::map<uint64_t, int> deadlines;
+        for (uint64_t token = 0; token < 2000; ++token) {
+            deadlines[token] = delay(random);
+            wheel.schedule(base + ms(deadlines[token]), token);
+        }
+        size_t fired = 0;
+        bool early = false;
+        bool late = false;
+        std::vector<uint64_t> expired;
+        for (int now = 0; now <= 5100; now += 7) {
+            expired.clear();
+            wheel.advance(base + ms(now), expired);
+            for (uint64_t token : expired) {
+                early = early || deadlines[token] > now;
+                late = late || now - deadlines[token] > 10 + 7;
+                fired++;
+            }
+        }
+        check(fired == 2000, "every timer fired once");
+        check(!early, "no timer fired before its deadline");
+        check(!late, "no timer fired more than a tick late");
+    }
+
+    return summary();
+}
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <cstdlib>
+#include "core/smtp/smtp_client.hpp"
+#include "core/smtp/tls_context_cache.hpp"
+#include "core/logging/logger.hpp"
+#include "stub_smtp_server.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::StubSMTPServer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+namespace fs = std::filesystem;
+
+namespace {
+
+/**
+ * Relay settings for the stub: STARTTLS required, verified against the stub's certificate
+ */
+DomainConfig stubRelay(int port, const std::string& ca_file) {
+    DomainConfig relay;
+    relay.name = "example.com";
+    relay.smtp_server = "127.0.0.1";
+    relay.smtp_port = port;
+    relay.auth_method = "PLAIN";
+    relay.username = "user";
+    relay.password = "secret";
+    relay.use_starttls = true;
+    relay.require_starttls = true;
+    relay.ssl_ca_file = ca_file;
+    return relay;
+}
+
+/**
+ * Open a session, send one message and close it again
+ */
+bool deliver(ConfigManager& config, const DomainConfig& relay, std::string& error) {
+    SMTPClient client(config);
+    if (!client.openSession(relay)) {
+        error = client.getLastError();
+        return false;
+    }
+    Email email("sender@example.com", "user@example.org", "Secure", "Body");
+    bool sent = client.sendEmail(email).success;
+    client.closeSession();
+    return sent;
+}
+
+bool startServer(StubSMTPServer& server, const std::string& ca_file, int max_version = 0) {
+    if (!server.enableTLS(max_version) || !server.start()) {
+        return false;
+    }
+    std::ofstream file(ca_file, std::ios::trunc);
+    file << server.certificatePem();
+    return true;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing TLS Context Cache" << std::endl;
+    std::cout << "=========================" << std::endl;
+    Logger::getInstance().setLogLevel(LogLevel::CRITICAL);
+
+    char base[] = "/tmp/test_tls_context_cache_XXXXXX";
+    if (!mkdtemp(base)) {
+        std::cout << "   ✗ Failed to create a directory for certificates" << std::endl;
+        return 1;
+    }
+    std::string root = base;
+    TLSContextCache& cache = TLSContextCache::getInstance();
+    ConfigManager config;
+    std::string error;
+
+    std::cout << "1. STARTTLS..." << std::endl;
+    {
+        StubSMTPServer server;
+        std::string ca_file = root + "/first.pem";
+        check(startServer(server, ca_file), "server started with a self-signed certificate");
+        check(deliver(config, stubRelay(server.port(), ca_file), error),
+              "message sent" + (error.empty() ? "" : ": " + error));
+
+        std::vector<std::string> commands = server.commands();
+        std::vector<StubSMTPServer::Message> messages = server.messages();
+        check(commands.size() >= 4 && commands[1] == "STARTTLS" && server.countCommands("EHLO") == 2 &&
+              commands[3].compare(0, 5, "AUTH ") == 0, "EHLO again after the upgrade, then AUTH");
+        check(messages.size() == 1 && messages[0].secure, "message sent over TLS");
+
+        // A new process-wide cache: the first connection is this test's first handshake
+        TLSCacheStats stats = cache.getStats();
+        check(stats.full_handshakes == 1 && stats.resumed_handshakes == 0 && stats.cached_sessions == 1,
+              "full handshake, session kept for the server");
+
+        check(deliver(config, stubRelay(server.port(), ca_file), error), "second message sent");
+        stats = cache.getStats();
+        check(stats.resumed_handshakes == 1 && stats.full_handshakes == 1 && stats.sessions_offered == 1,
+              "second connection resumes the session");
+        check(server.tlsHandshakes() == 2 && server.resumedHandshakes() == 1, "server agrees it resumed");
+        check(stats.contexts == 1, "both connections share one context");
+    }
+
+    std::cout << "2. TLS 1.2..." << std::endl;
+    {
+        StubSMTPServer server;
+        std::string ca_file = root + "/tls12.pem";
+        startServer(server, ca_file, TLS1_2_VERSION);
+        DomainConfig relay = stubRelay(server.port(), ca_file);
+        TLSCacheStats before = cache.getStats();
+        bool sent = deliver(config, relay, error) && deliver(config, relay, error);
+        TLSCacheStats after = cache.getStats();
+        check(sent && after.full_handshakes == before.full_handshakes + 1 &&
+              after.resumed_handshakes == before.resumed_handshakes + 1 && server.resumedHandshakes() == 1,
+              "one full handshake, then one resumed");
+    }
+
+    std::cout << "3. Sessions kept apart..." << std::endl;
+    {
+        StubSMTPServer first;
+        StubSMTPServer second;
+        std::string first_ca = root + "/apart1.pem";
+        std::string second_ca = root + "/apart2.pem";
+        startServer(first, first_ca);
+        startServer(second, second_ca);
+        DomainConfig relay = stubRelay(first.port(), first_ca);
+        deliver(config, relay, error);
+
+        TLSCacheStats before = cache.getStats();
+        check(deliver(config, stubRelay(second.port(), second_ca), error) && second.resumedHandshakes() == 0 &&
+              cache.getStats().resumed_handshakes == before.resumed_handshakes,
+              "a session is not offered to another server");
+
+        // Without verification the profile, and so the context, differ
+        DomainConfig unverified = relay;
+        unverified.ssl_ca_file.clear();
+        unverified.ssl_verify_peer = false;
+        before = cache.getStats();
+        check(deliver(config, unverified, error) && first.resumedHandshakes() == 0 &&
+              cache.getStats().contexts == before.contexts + 1, "a session is not offered to another profile");
+
+        cache.clear();
+        check(cache.getStats().cached_sessions == 0 && cache.getStats().contexts == 0, "clear() drops everything");
+        before = cache.getStats();
+        check(deliver(config, relay, error) && first.resumedHandshakes() == 0 &&
+              cache.getStats().full_handshakes == before.full_handshakes + 1, "full handshake after clear()");
+        check(deliver(config, relay, error) && first.resumedHandshakes() == 1, "and resumption after that");
+    }
+
+    std::cout << "4. Verification..." << std::endl;
+    {
+        StubSMTPServer server;
+        std::string ca_file = root + "/untrusted.pem";
+        startServer(server, ca_file);
+        cache.clear();
+
+        // The system trust store does not know the self-signed certificate
+        DomainConfig relay = stubRelay(server.port(), "");
+        SMTPClient client(config);
+        check(!client.openSession(relay) && client.getLastError().find("handshake") != std::string::npos,
+              "untrusted certificate fails the handshake");
+        check(server.messages().empty() && cache.getStats().cached_sessions == 0, "nothing sent, nothing cached");
+
+        relay.require_starttls = false;
+        relay.use_starttls = false;
+        check(deliver(config, relay, error) && !server.messages().empty() && !server.messages()[0].secure,
+              "plaintext only when STARTTLS is turned off");
+    }
+
+    fs::remove_all(root);
+
+    return summary();
+}
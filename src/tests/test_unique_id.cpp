@@ -0,0 +1,170 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unordered_set>
+#include "utils/unique_id.hpp"
+#include "test_support.hpp"
+
+using namespace ssmtp_mailer;
+using ssmtp_mailer::testing::check;
+using ssmtp_mailer::testing::summary;
+
+namespace {
+
+// More threads than the 65,536 thread slots, so slots must be reused
+const size_t SHORT_LIVED_THREADS = 70000;
+const size_t CONCURRENT_THREADS = 8;
+
+uint32_t threadSlot(const UniqueId& id) {
+    return static_cast<uint32_t>((id.low >> 32) & 0xFFFF);
+}
+
+UniqueId makeId(uint64_t high, uint64_t low) {
+    UniqueId id;
+    id.high = high;
+    id.low = low;
+    return id;
+}
+
+/**
+ * Whether both text forms compare like the IDs themselves
+ */
+bool textOrderMatches(const UniqueId& a, const UniqueId& b) {
+    int base32 = a.toBase32().compare(b.toBase32());
+    int hex = a.toHex().compare(b.toHex());
+    int expected = a < b ? -1 : b < a ? 1 : 0;
+    auto sign = [](int value) { return value < 0 ? -1 : value > 0 ? 1 : 0; };
+    return sign(base32) == expected && sign(hex) == expected;
+}
+
+} // anonymous namespace
+
+int main() {
+    std::cout << "Testing Unique IDs" << std::endl;
+    std::cout << "==================" << std::endl;
+
+    std::cout << "1. One thread..." << std::endl;
+    {
+        uint64_t before = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        std::vector<UniqueId> ids;
+        for (int i = 0; i < 200000; ++i) {
+            ids.push_back(nextUniqueId());
+        }
+        uint64_t after = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+
+        bool increasing = true;
+        bool strings_increasing = true;
+        for (size_t i = 1; i < ids.size(); ++i) {
+            increasing = increasing && ids[i - 1] < ids[i];
+            strings_increasing = strings_increasing && ids[i - 1].toBase32() < ids[i].toBase32() &&
+                                 ids[i - 1].toHex() < ids[i].toHex();
+        }
+        check(increasing, "200,000 IDs strictly increasing");
+        check(strings_increasing, "their base32 and hex forms strictly increasing too");
+        check(ids.front().getTimestamp() >= before && ids.back().getTimestamp() <= after + 1,
+              "timestamp is the creation time in milliseconds");
+    }
+
+    std::cout << "2. Text forms..." << std::endl;
+    {
+        UniqueId id = nextUniqueId();
+        std::string base32 = id.toBase32();
+        std::string hex = id.toHex();
+        check(base32.size() == 26 && base32[0] <= '7' &&
+              base32.find_first_not_of("0123456789ABCDEFGHJKMNPQRSTVWXYZ") == std::string::npos,
+              "26 Crockford base32 digits, the first below 8");
+        check(hex.size() == 32 && hex.find_first_not_of("0123456789abcdef") == std::string::npos,
+              "32 lower-case hex digits");
+        check(makeId(0, 0).toBase32() == std::string(26, '0') &&
+              makeId(~0ull, ~0ull).toBase32() == "7" + std::string(25, 'Z') &&
+              makeId(0x0123456789abcdefull, 0xfedcba9876543210ull).toHex() == "0123456789abcdeffedcba9876543210",
+              "known values");
+
+        // Edge cases and random pairs, including pairs equal in one half
+        std::vector<UniqueId> samples = {
+            makeId(0, 0), makeId(0, 1), makeId(1, 0), makeId(0, ~0ull), makeId(~0ull, 0), makeId(~0ull, ~0ull),
+            makeId(1ull << 63, 0), makeId(0, 1ull << 63), makeId(0x1F, 0), makeId(0, 0x1F)
+        };
+        std::mt19937_64 random(7);
+        for (int i = 0; i < 200; ++i) {
+            uint64_t high = random();
+            samples.push_back(makeId(high, random()));
+            samples.push_back(makeId(high, random() >> (random() % 64)));
+            samples.push_back(makeId(random() >> (random() % 64), samples.back().low));
+        }
+        bool ordered = true;
+        for (const UniqueId& a : samples) {
+            for (const UniqueId& b : samples) {
+                ordered = ordered && textOrderMatches(a, b);
+            }
+        }
+        check(ordered, "string order of both forms matches operator< for every pair");
+    }
+
+    std::cout << "3. Concurrent threads..." << std::endl;
+    {
+        std::vector<std::vector<UniqueId>> per_thread(CONCURRENT_THREADS);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < CONCURRENT_THREADS; ++t) {
+            threads.emplace_back([&per_thread, t]() {
+                for (int i = 0; i < 50000; ++i) {
+                    per_thread[t].push_back(nextUniqueId());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        std::unordered_set<std::string> seen;
+        bool increasing = true;
+        for (const auto& ids : per_thread) {
+            for (size_t i = 0; i < ids.size(); ++i) {
+                increasing = increasing && (i == 0 || ids[i - 1] < ids[i]);
+                seen.insert(ids[i].toHex());
+            }
+        }
+        check(seen.size() == CONCURRENT_THREADS * 50000, "no collisions between threads");
+        check(increasing, "each thread's IDs strictly increasing");
+    }
+
+    std::cout << "4. Short-lived threads..." << std::endl;
+    {
+        std::mutex mutex;
+        std::unordered_set<std::string> seen;
+        size_t generated = 0;
+        uint32_t highest_slot = 0;
+
+        // Waves of threads that each make a few IDs and exit, more in total than there are slots
+        for (size_t started = 0; started < SHORT_LIVED_THREADS; started += CONCURRENT_THREADS) {
+            std::vector<std::thread> wave;
+            for (size_t t = 0; t < CONCURRENT_THREADS; ++t) {
+                wave.emplace_back([&]() {
+                    UniqueId ids[3] = {nextUniqueId(), nextUniqueId(), nextUniqueId()};
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (const UniqueId& id : ids) {
+                        seen.insert(id.toHex());
+                        highest_slot = std::max(highest_slot, threadSlot(id));
+                        generated++;
+                    }
+                });
+            }
+            for (auto& thread : wave) {
+                thread.join();
+            }
+        }
+        check(generated == SHORT_LIVED_THREADS * 3 && seen.size() == generated,
+              "no collisions across 70,000 threads");
+        // Slots 0-8 went to threads of earlier sections; exited threads hand theirs back
+        check(highest_slot < 2 * CONCURRENT_THREADS + 2, "slots of exited threads reused, not a growing counter");
+    }
+
+    return summary();
+}
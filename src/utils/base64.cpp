@@ -0,0 +1,657 @@
+#include "utils/base64.hpp"
+#include "utils/cpu_features.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSMTP_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SSMTP_BASE64_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__)
+#define SSMTP_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define SSMTP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SSMTP_TARGET_SSSE3
+#define SSMTP_TARGET_AVX2
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const char STANDARD_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char URL_ALPHABET[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Characters the bytewise decoder handles besides the alphabet
+const signed char INVALID = -1;
+const signed char WHITESPACE = -2;
+const signed char PADDING = -3;
+
+// Characters the bytewise decoder takes before trying the vector loop again
+const size_t SCALAR_RUN = 8;
+
+// Input bytes Base64Encoder encodes per step (4096 characters)
+const size_t ENCODER_STEP = 3072;
+
+const char* alphabetFor(Base64Variant variant) {
+    return variant == Base64Variant::URL ? URL_ALPHABET : STANDARD_ALPHABET;
+}
+
+struct DecodeTable {
+    signed char values[256];
+
+    explicit DecodeTable(const char* alphabet) {
+        std::fill(values, values + 256, INVALID);
+        for (int i = 0; i < 64; ++i) {
+            values[static_cast<unsigned char>(alphabet[i])] = static_cast<signed char>(i);
+        }
+        values[static_cast<unsigned char>(' ')] = WHITESPACE;
+        values[static_cast<unsigned char>('\t')] = WHITESPACE;
+        values[static_cast<unsigned char>('\r')] = WHITESPACE;
+        values[static_cast<unsigned char>('\n')] = WHITESPACE;
+        values[static_cast<unsigned char>('=')] = PADDING;
+    }
+};
+
+const DecodeTable& decodeTableFor(Base64Variant variant) {
+    static const DecodeTable standard(STANDARD_ALPHABET);
+    static const DecodeTable url(URL_ALPHABET);
+    return variant == Base64Variant::URL ? url : standard;
+}
+
+/*
+ * Vector kernels. Encoders consume whole 3-byte groups and return the
+ * number of input bytes consumed; decoders consume whole 4-character
+ * groups, stop at the first block holding anything outside the alphabet
+ * and return the number of characters consumed. The bytewise code
+ * finishes whatever they leave.
+ */
+using EncodeBlocksFunction = size_t (*)(const unsigned char*, size_t, char*, Base64Variant);
+using DecodeBlocksFunction = size_t (*)(const char*, size_t, unsigned char*, Base64Variant);
+
+#ifdef SSMTP_BASE64_X86
+
+// Offsets from a 6-bit value to its character, indexed by the value's range
+// (W. Muła and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2
+// Instructions", 2018)
+const signed char ENCODE_SHIFT_STANDARD[16] = {
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0
+};
+const signed char ENCODE_SHIFT_URL[16] = {
+    'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+    '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0
+};
+
+// Character classes by low and high nibble; a non-zero AND marks an invalid
+// character. The roll table maps each class to its offset from the value.
+const signed char DECODE_LUT_LO[16] = {
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+};
+const signed char DECODE_LUT_HI[16] = {
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+};
+const signed char DECODE_LUT_ROLL[16] = {
+    0, 16, 19, 4, -65, -65, -71, -71,
+    0, 0, 0, 0, 0, 0, 0, 0
+};
+
+inline __m128i loadTable(const signed char* table) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(table));
+}
+
+SSMTP_TARGET_SSSE3
+size_t encodeBlocksSSSE3(const unsigned char* input, size_t length, char* output, Base64Variant variant) {
+    const __m128i shift_lut = loadTable(variant == Base64Variant::URL ? ENCODE_SHIFT_URL : ENCODE_SHIFT_STANDARD);
+    const __m128i spread = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+
+    size_t i = 0;
+    // Each step loads 16 bytes and encodes the first 12
+    for (; i + 16 <= length; i += 12) {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i)), spread);
+
+        // Move each 6-bit field into its own byte
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t0, t1);
+
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        range = _mm_or_si128(range, _mm_and_si128(upper, _mm_set1_epi8(13)));
+        __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, range), indices);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output), chars);
+        output += 16;
+    }
+    return i;
+}
+
+SSMTP_TARGET_AVX2
+size_t encodeBlocksAVX2(const unsigned char* input, size_t length, char* output, Base64Variant variant) {
+    const __m256i shift_lut = _mm256_broadcastsi128_si256(
+        loadTable(variant == Base64Variant::URL ? ENCODE_SHIFT_URL : ENCODE_SHIFT_STANDARD));
+    const __m256i spread = _mm256_broadcastsi128_si256(
+        _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+
+    size_t i = 0;
+    // Each lane encodes 12 bytes from its own 16-byte load
+    for (; i + 28 <= length; i += 24) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 12));
+        __m256i in = _mm256_shuffle_epi8(_mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1), spread);
+
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00)),
+                                        _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0)),
+                                        _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i upper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(upper, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, range), indices);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), chars);
+        output += 32;
+    }
+    return i;
+}
+
+SSMTP_TARGET_SSSE3
+size_t decodeBlocksSSSE3(const char* input, size_t length, unsigned char* output, Base64Variant variant) {
+    if (variant != Base64Variant::STANDARD) {
+        return 0;
+    }
+    const __m128i lut_lo = loadTable(DECODE_LUT_LO);
+    const __m128i lut_hi = loadTable(DECODE_LUT_HI);
+    const __m128i lut_roll = loadTable(DECODE_LUT_ROLL);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    size_t i = 0;
+    // Each step stores 16 bytes of which 12 are valid; the 8 characters
+    // left over guarantee the output buffer has room for the other 4
+    for (; i + 24 <= length; i += 16) {
+        __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+        __m128i lo_nibbles = _mm_and_si128(in, mask_2f);
+        __m128i classes = _mm_and_si128(_mm_shuffle_epi8(lut_lo, lo_nibbles), _mm_shuffle_epi8(lut_hi, hi_nibbles));
+        if (_mm_movemask_epi8(_mm_cmpgt_epi8(classes, _mm_setzero_si128())) != 0) {
+            break;
+        }
+
+        __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles));
+        __m128i values = _mm_add_epi8(in, roll);
+
+        // Pack four 6-bit values into three bytes, then drop the gaps
+        __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+        merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output), merged);
+        output += 12;
+    }
+    return i;
+}
+
+SSMTP_TARGET_AVX2
+size_t decodeBlocksAVX2(const char* input, size_t length, unsigned char* output, Base64Variant variant) {
+    if (variant != Base64Variant::STANDARD) {
+        return 0;
+    }
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(loadTable(DECODE_LUT_LO));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(loadTable(DECODE_LUT_HI));
+    const __m256i lut_roll = _mm256_broadcastsi128_si256(loadTable(DECODE_LUT_ROLL));
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack = _mm256_broadcastsi128_si256(
+        _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+
+    size_t i = 0;
+    // Each step stores 32 bytes of which 24 are valid; see decodeBlocksSSSE3()
+    for (; i + 44 <= length; i += 32) {
+        __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(in, mask_2f);
+        __m256i classes = _mm256_and_si256(_mm256_shuffle_epi8(lut_lo, lo_nibbles),
+                                           _mm256_shuffle_epi8(lut_hi, hi_nibbles));
+        if (_mm256_movemask_epi8(_mm256_cmpgt_epi8(classes, _mm256_setzero_si256())) != 0) {
+            break;
+        }
+
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask_2f), hi_nibbles));
+        __m256i values = _mm256_add_epi8(in, roll);
+
+        __m256i merged = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack);
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output), merged);
+        output += 24;
+    }
+    return i;
+}
+
+#endif
+
+#ifdef SSMTP_BASE64_NEON
+
+size_t encodeBlocksNEON(const unsigned char* input, size_t length, char* output, Base64Variant variant) {
+    const uint8_t* alphabet = reinterpret_cast<const uint8_t*>(alphabetFor(variant));
+    uint8x16x4_t table;
+    table.val[0] = vld1q_u8(alphabet);
+    table.val[1] = vld1q_u8(alphabet + 16);
+    table.val[2] = vld1q_u8(alphabet + 32);
+    table.val[3] = vld1q_u8(alphabet + 48);
+    const uint8x16_t low6 = vdupq_n_u8(0x3f);
+
+    size_t i = 0;
+    for (; i + 48 <= length; i += 48) {
+        // De-interleave 16 groups so each register holds one byte of every group
+        uint8x16x3_t in = vld3q_u8(input + i);
+        uint8x16x4_t indices;
+        indices.val[0] = vshrq_n_u8(in.val[0], 2);
+        indices.val[1] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), low6);
+        indices.val[2] = vandq_u8(vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), low6);
+        indices.val[3] = vandq_u8(in.val[2], low6);
+
+        uint8x16x4_t chars;
+        chars.val[0] = vqtbl4q_u8(table, indices.val[0]);
+        chars.val[1] = vqtbl4q_u8(table, indices.val[1]);
+        chars.val[2] = vqtbl4q_u8(table, indices.val[2]);
+        chars.val[3] = vqtbl4q_u8(table, indices.val[3]);
+        vst4q_u8(reinterpret_cast<uint8_t*>(output), chars);
+        output += 64;
+    }
+    return i;
+}
+
+/**
+ * Map characters to 6-bit values; valid is set to all-ones per lane for
+ * alphabet characters
+ */
+inline uint8x16_t decodeLanesNEON(uint8x16_t c, uint8_t char62, uint8_t char63, uint8x16_t& valid) {
+    uint8x16_t upper = vsubq_u8(c, vdupq_n_u8('A'));
+    uint8x16_t lower = vsubq_u8(c, vdupq_n_u8('a'));
+    uint8x16_t digit = vsubq_u8(c, vdupq_n_u8('0'));
+    uint8x16_t is_upper = vcltq_u8(upper, vdupq_n_u8(26));
+    uint8x16_t is_lower = vcltq_u8(lower, vdupq_n_u8(26));
+    uint8x16_t is_digit = vcltq_u8(digit, vdupq_n_u8(10));
+    uint8x16_t is_62 = vceqq_u8(c, vdupq_n_u8(char62));
+    uint8x16_t is_63 = vceqq_u8(c, vdupq_n_u8(char63));
+
+    valid = vorrq_u8(vorrq_u8(is_upper, is_lower), vorrq_u8(is_digit, vorrq_u8(is_62, is_63)));
+
+    uint8x16_t value = vandq_u8(upper, is_upper);
+    value = vorrq_u8(value, vandq_u8(vaddq_u8(lower, vdupq_n_u8(26)), is_lower));
+    value = vorrq_u8(value, vandq_u8(vaddq_u8(digit, vdupq_n_u8(52)), is_digit));
+    value = vorrq_u8(value, vandq_u8(vdupq_n_u8(62), is_62));
+    value = vorrq_u8(value, vandq_u8(vdupq_n_u8(63), is_63));
+    return value;
+}
+
+size_t decodeBlocksNEON(const char* input, size_t length, unsigned char* output, Base64Variant variant) {
+    const char* alphabet = alphabetFor(variant);
+    const uint8_t char62 = static_cast<uint8_t>(alphabet[62]);
+    const uint8_t char63 = static_cast<uint8_t>(alphabet[63]);
+
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        uint8x16x4_t in = vld4q_u8(reinterpret_cast<const uint8_t*>(input + i));
+        uint8x16_t valid[4];
+        uint8x16_t a = decodeLanesNEON(in.val[0], char62, char63, valid[0]);
+        uint8x16_t b = decodeLanesNEON(in.val[1], char62, char63, valid[1]);
+        uint8x16_t c = decodeLanesNEON(in.val[2], char62, char63, valid[2]);
+        uint8x16_t d = decodeLanesNEON(in.val[3], char62, char63, valid[3]);
+        uint8x16_t all = vandq_u8(vandq_u8(valid[0], valid[1]), vandq_u8(valid[2], valid[3]));
+        if (vminvq_u8(all) == 0) {
+            break;
+        }
+
+        uint8x16x3_t out;
+        out.val[0] = vorrq_u8(vshlq_n_u8(a, 2), vshrq_n_u8(b, 4));
+        out.val[1] = vorrq_u8(vshlq_n_u8(b, 4), vshrq_n_u8(c, 2));
+        out.val[2] = vorrq_u8(vshlq_n_u8(c, 6), d);
+        vst3q_u8(output, out);
+        output += 48;
+    }
+    return i;
+}
+
+#endif
+
+EncodeBlocksFunction encodeBlocksFor(Base64Kernel kernel) {
+    switch (kernel) {
+#ifdef SSMTP_BASE64_X86
+    case Base64Kernel::SSSE3:
+        return encodeBlocksSSSE3;
+    case Base64Kernel::AVX2:
+        return encodeBlocksAVX2;
+#endif
+#ifdef SSMTP_BASE64_NEON
+    case Base64Kernel::NEON:
+        return encodeBlocksNEON;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+DecodeBlocksFunction decodeBlocksFor(Base64Kernel kernel) {
+    switch (kernel) {
+#ifdef SSMTP_BASE64_X86
+    case Base64Kernel::SSSE3:
+        return decodeBlocksSSSE3;
+    case Base64Kernel::AVX2:
+        return decodeBlocksAVX2;
+#endif
+#ifdef SSMTP_BASE64_NEON
+    case Base64Kernel::NEON:
+        return decodeBlocksNEON;
+#endif
+    default:
+        return nullptr;
+    }
+}
+
+size_t encodeWith(EncodeBlocksFunction blocks, const unsigned char* input, size_t length, char* output,
+                  Base64Variant variant, bool padding) {
+    size_t consumed = blocks ? blocks(input, length, output, variant) : 0;
+    size_t written = consumed / 3 * 4;
+    return written + base64EncodeScalar(input + consumed, length - consumed, output + written, variant, padding);
+}
+
+bool decodeWith(DecodeBlocksFunction blocks, const char* input, size_t length,
+                unsigned char* output, size_t& written, Base64Variant variant) {
+    const DecodeTable& table = decodeTableFor(variant);
+    unsigned char* out = output;
+    uint32_t group = 0;
+    size_t count = 0;
+    size_t i = 0;
+    bool padded = false;
+
+    while (i < length && !padded) {
+        if (count == 0) {
+            if (blocks) {
+                size_t consumed = blocks(input + i, length - i, out, variant);
+                i += consumed;
+                out += consumed / 4 * 3;
+            }
+
+            // Whole groups of alphabet characters, up to the first other character
+            for (; i + 4 <= length; i += 4) {
+                int32_t a = table.values[static_cast<unsigned char>(input[i])];
+                int32_t b = table.values[static_cast<unsigned char>(input[i + 1])];
+                int32_t c = table.values[static_cast<unsigned char>(input[i + 2])];
+                int32_t d = table.values[static_cast<unsigned char>(input[i + 3])];
+                if ((a | b | c | d) < 0) {
+                    break;
+                }
+                uint32_t quad = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12) |
+                                (static_cast<uint32_t>(c) << 6) | static_cast<uint32_t>(d);
+                *out++ = static_cast<unsigned char>(quad >> 16);
+                *out++ = static_cast<unsigned char>(quad >> 8);
+                *out++ = static_cast<unsigned char>(quad);
+            }
+        }
+
+        // Bytewise past the character that stopped the loops above, until a group boundary
+        size_t stop = std::min(length, i + SCALAR_RUN);
+        for (; i < length && (i < stop || count != 0); ++i) {
+            signed char value = table.values[static_cast<unsigned char>(input[i])];
+            if (value >= 0) {
+                group = (group << 6) | static_cast<uint32_t>(value);
+                if (++count == 4) {
+                    *out++ = static_cast<unsigned char>(group >> 16);
+                    *out++ = static_cast<unsigned char>(group >> 8);
+                    *out++ = static_cast<unsigned char>(group);
+                    group = 0;
+                    count = 0;
+                }
+            } else if (value == PADDING) {
+                padded = true;
+                break;
+            } else if (value != WHITESPACE) {
+                return false;
+            }
+        }
+    }
+
+    if (padded) {
+        // Padding completes a group of two or three characters and ends the data
+        if (count < 2) {
+            return false;
+        }
+        for (; i < length; ++i) {
+            signed char value = table.values[static_cast<unsigned char>(input[i])];
+            if (value != PADDING && value != WHITESPACE) {
+                return false;
+            }
+        }
+    }
+
+    if (count == 1) {
+        return false;
+    }
+    if (count > 1) {
+        group <<= 6 * (4 - count);
+        *out++ = static_cast<unsigned char>(group >> 16);
+        if (count == 3) {
+            *out++ = static_cast<unsigned char>(group >> 8);
+        }
+    }
+
+    written = static_cast<size_t>(out - output);
+    return true;
+}
+
+} // anonymous namespace
+
+std::vector<Base64Kernel> base64Kernels() {
+    std::vector<Base64Kernel> kernels{Base64Kernel::SCALAR};
+    const CPUFeatures& features = getCPUFeatures();
+#ifdef SSMTP_BASE64_X86
+    if (features.ssse3) {
+        kernels.push_back(Base64Kernel::SSSE3);
+    }
+    if (features.avx2) {
+        kernels.push_back(Base64Kernel::AVX2);
+    }
+#elif defined(SSMTP_BASE64_NEON)
+    (void)features;
+    kernels.push_back(Base64Kernel::NEON);
+#else
+    (void)features;
+#endif
+    return kernels;
+}
+
+size_t base64EncodedLength(size_t length, bool padding) {
+    if (padding) {
+        return (length + 2) / 3 * 4;
+    }
+    size_t remainder = length % 3;
+    return length / 3 * 4 + (remainder ? remainder + 1 : 0);
+}
+
+size_t base64DecodedMaxLength(size_t length) {
+    return (length + 3) / 4 * 3;
+}
+
+size_t base64Encode(const unsigned char* input, size_t length, char* output,
+                    Base64Variant variant, bool padding) {
+    static const EncodeBlocksFunction blocks = encodeBlocksFor(base64Kernels().back());
+    return encodeWith(blocks, input, length, output, variant, padding);
+}
+
+size_t base64EncodeScalar(const unsigned char* input, size_t length, char* output,
+                          Base64Variant variant, bool padding) {
+    const char* alphabet = alphabetFor(variant);
+    char* out = output;
+    size_t i = 0;
+
+    for (; i + 3 <= length; i += 3) {
+        unsigned int triple = (static_cast<unsigned int>(input[i]) << 16) |
+                              (static_cast<unsigned int>(input[i + 1]) << 8) |
+                              input[i + 2];
+        *out++ = alphabet[(triple >> 18) & 0x3F];
+        *out++ = alphabet[(triple >> 12) & 0x3F];
+        *out++ = alphabet[(triple >> 6) & 0x3F];
+        *out++ = alphabet[triple & 0x3F];
+    }
+
+    size_t remaining = length - i;
+    if (remaining > 0) {
+        unsigned int triple = static_cast<unsigned int>(input[i]) << 16;
+        if (remaining == 2) {
+            triple |= static_cast<unsigned int>(input[i + 1]) << 8;
+        }
+        *out++ = alphabet[(triple >> 18) & 0x3F];
+        *out++ = alphabet[(triple >> 12) & 0x3F];
+        if (remaining == 2) {
+            *out++ = alphabet[(triple >> 6) & 0x3F];
+        } else if (padding) {
+            *out++ = '=';
+        }
+        if (padding) {
+            *out++ = '=';
+        }
+    }
+
+    return static_cast<size_t>(out - output);
+}
+
+std::string base64Encode(const std::string& input) {
+    std::string result(base64EncodedLength(input.size()), '\0');
+    if (!input.empty()) {
+        base64Encode(reinterpret_cast<const unsigned char*>(input.data()), input.size(), &result[0]);
+    }
+    return result;
+}
+
+std::string base64UrlEncode(const std::string& input) {
+    std::string result(base64EncodedLength(input.size(), false), '\0');
+    if (!input.empty()) {
+        base64Encode(reinterpret_cast<const unsigned char*>(input.data()), input.size(), &result[0],
+                     Base64Variant::URL, false);
+    }
+    return result;
+}
+
+bool base64Decode(const char* input, size_t length, unsigned char* output, size_t& written,
+                  Base64Variant variant) {
+    static const DecodeBlocksFunction blocks = decodeBlocksFor(base64Kernels().back());
+    return decodeWith(blocks, input, length, output, written, variant);
+}
+
+bool base64DecodeScalar(const char* input, size_t length, unsigned char* output, size_t& written,
+                        Base64Variant variant) {
+    return decodeWith(nullptr, input, length, output, written, variant);
+}
+
+size_t base64EncodeWith(Base64Kernel kernel, const unsigned char* input, size_t length, char* output,
+                        Base64Variant variant, bool padding) {
+    return encodeWith(encodeBlocksFor(kernel), input, length, output, variant, padding);
+}
+
+bool base64DecodeWith(Base64Kernel kernel, const char* input, size_t length, unsigned char* output,
+                      size_t& written, Base64Variant variant) {
+    return decodeWith(decodeBlocksFor(kernel), input, length, output, written, variant);
+}
+
+bool base64Decode(const std::string& input, std::string& output, Base64Variant variant) {
+    output.resize(base64DecodedMaxLength(input.size()));
+    size_t written = 0;
+    if (!input.empty() &&
+        !base64Decode(input.data(), input.size(), reinterpret_cast<unsigned char*>(&output[0]), written, variant)) {
+        output.clear();
+        return false;
+    }
+    output.resize(written);
+    return true;
+}
+
+Base64Encoder::Base64Encoder(Base64Variant variant, size_t line_length)
+    : variant_(variant), line_length_(line_length), column_(0), pending_size_(0) {
+}
+
+void Base64Encoder::encode(const char* data, size_t length, std::string& output) {
+    const unsigned char* input = reinterpret_cast<const unsigned char*>(data);
+    char chars[ENCODER_STEP / 3 * 4];
+
+    // Complete the group held back by the previous call
+    if (pending_size_ > 0) {
+        while (pending_size_ < 3 && length > 0) {
+            pending_[pending_size_++] = *input++;
+            length--;
+        }
+        if (pending_size_ < 3) {
+            return;
+        }
+        emit(chars, base64Encode(pending_, 3, chars, variant_), output);
+        pending_size_ = 0;
+    }
+
+    size_t whole = length / 3 * 3;
+    for (size_t pos = 0; pos < whole; pos += ENCODER_STEP) {
+        size_t step = std::min(ENCODER_STEP, whole - pos);
+        emit(chars, base64Encode(input + pos, step, chars, variant_), output);
+    }
+
+    for (size_t pos = whole; pos < length; ++pos) {
+        pending_[pending_size_++] = input[pos];
+    }
+}
+
+void Base64Encoder::finish(std::string& output) {
+    if (pending_size_ > 0) {
+        char chars[4];
+        emit(chars, base64Encode(pending_, pending_size_, chars, variant_), output);
+    }
+    if (line_length_ > 0 && column_ > 0) {
+        output.append("\r\n", 2);
+    }
+    reset();
+}
+
+void Base64Encoder::reset() {
+    column_ = 0;
+    pending_size_ = 0;
+}
+
+void Base64Encoder::emit(const char* chars, size_t count, std::string& output) {
+    if (line_length_ == 0) {
+        output.append(chars, count);
+        return;
+    }
+    size_t breaks = (column_ + count) / line_length_;
+    size_t start = output.size();
+    output.resize(start + count + breaks * 2);
+
+    char* out = &output[start];
+    while (count > 0) {
+        size_t take = std::min(count, line_length_ - column_);
+        std::memcpy(out, chars, take);
+        out += take;
+        chars += take;
+        count -= take;
+        column_ += take;
+        if (column_ == line_length_) {
+            *out++ = '\r';
+            *out++ = '\n';
+            column_ = 0;
+        }
+    }
+}
+
+} // namespace ssmtp_mailer
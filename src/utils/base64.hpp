@@ -0,0 +1,176 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+#include <vector>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Base64 alphabets (RFC 4648)
+ */
+enum class Base64Variant {
+    STANDARD,       // "+/" (section 4), used by MIME and SASL
+    URL             // "-_" (section 5), used by JWT
+};
+
+/**
+ * @brief Implementations of the encode and decode loops
+ */
+enum class Base64Kernel {
+    SCALAR,
+    SSSE3,
+    AVX2,
+    NEON
+};
+
+/**
+ * @brief Kernels this build and CPU can run, from the portable one to the fastest
+ *
+ * base64Encode() and base64Decode() use the last one.
+ */
+std::vector<Base64Kernel> base64Kernels();
+
+/**
+ * @brief Number of characters produced by base64-encoding a buffer
+ * @param length Input length in bytes
+ * @param padding Whether the final group is padded with '='
+ * @return Encoded length
+ */
+size_t base64EncodedLength(size_t length, bool padding = true);
+
+/**
+ * @brief Upper bound on the bytes produced by decoding base64 text
+ * @param length Encoded length in characters
+ * @return Size the output buffer of base64Decode() must have
+ */
+size_t base64DecodedMaxLength(size_t length);
+
+/**
+ * @brief Base64-encode a buffer
+ *
+ * Uses AVX2, SSSE3 or NEON when the CPU has them (see getCPUFeatures()).
+ *
+ * @param input Input bytes
+ * @param length Input length
+ * @param output Destination of at least base64EncodedLength(length, padding) characters
+ * @param variant Alphabet to encode with
+ * @param padding Whether to pad the final group with '='
+ * @return Number of characters written
+ */
+size_t base64Encode(const unsigned char* input, size_t length, char* output,
+                    Base64Variant variant = Base64Variant::STANDARD, bool padding = true);
+
+/**
+ * @brief Portable form of base64Encode(), for comparison and testing
+ */
+size_t base64EncodeScalar(const unsigned char* input, size_t length, char* output,
+                          Base64Variant variant = Base64Variant::STANDARD, bool padding = true);
+
+/**
+ * @brief Base64-encode a string (standard alphabet, padded)
+ * @param input Input data
+ * @return Encoded string
+ */
+std::string base64Encode(const std::string& input);
+
+/**
+ * @brief Base64url-encode a string without padding, as JWT requires
+ * @param input Input data
+ * @return Encoded string
+ */
+std::string base64UrlEncode(const std::string& input);
+
+/**
+ * @brief Decode base64 text
+ *
+ * Whitespace (including the CRLF of MIME line wrapping) is skipped.
+ * Padding is optional, but nothing except whitespace may follow it.
+ * Standard-alphabet input is decoded with AVX2, SSSE3 or NEON when the
+ * CPU has them; URL-safe input uses NEON or the portable decoder.
+ *
+ * @param input Encoded characters
+ * @param length Input length
+ * @param output Destination of at least base64DecodedMaxLength(length) bytes
+ * @param written Number of bytes decoded
+ * @param variant Alphabet the input uses
+ * @return true if the input was valid base64, false otherwise
+ */
+bool base64Decode(const char* input, size_t length, unsigned char* output, size_t& written,
+                  Base64Variant variant = Base64Variant::STANDARD);
+
+/**
+ * @brief Portable form of base64Decode(), for comparison and testing
+ */
+bool base64DecodeScalar(const char* input, size_t length, unsigned char* output, size_t& written,
+                        Base64Variant variant = Base64Variant::STANDARD);
+
+/**
+ * @brief base64Encode() with a given kernel, one of base64Kernels(); for testing
+ */
+size_t base64EncodeWith(Base64Kernel kernel, const unsigned char* input, size_t length, char* output,
+                        Base64Variant variant = Base64Variant::STANDARD, bool padding = true);
+
+/**
+ * @brief base64Decode() with a given kernel, one of base64Kernels(); for testing
+ */
+bool base64DecodeWith(Base64Kernel kernel, const char* input, size_t length, unsigned char* output,
+                      size_t& written, Base64Variant variant = Base64Variant::STANDARD);
+
+/**
+ * @brief Decode base64 text into a string
+ * @param input Encoded text
+ * @param output Decoded bytes
+ * @param variant Alphabet the input uses
+ * @return true if the input was valid base64, false otherwise
+ */
+bool base64Decode(const std::string& input, std::string& output,
+                  Base64Variant variant = Base64Variant::STANDARD);
+
+/**
+ * @brief Incremental base64 encoder with optional line wrapping
+ *
+ * Input may arrive in pieces of any size; up to two bytes are held back
+ * between calls so the output is identical to encoding the concatenation.
+ * With a line length (76 for MIME, RFC 2045) every line, including the
+ * last, is terminated by CRLF.
+ */
+class Base64Encoder {
+public:
+    /**
+     * @brief Constructor
+     * @param variant Alphabet to encode with
+     * @param line_length Characters per line, a multiple of 4; 0 for no wrapping
+     */
+    explicit Base64Encoder(Base64Variant variant = Base64Variant::STANDARD, size_t line_length = 0);
+
+    /**
+     * @brief Encode the next piece of input
+     * @param data Input bytes
+     * @param length Input length
+     * @param output Encoded characters are appended here
+     */
+    void encode(const char* data, size_t length, std::string& output);
+
+    /**
+     * @brief Encode any held-back bytes with padding and end the last line
+     * @param output Encoded characters are appended here
+     */
+    void finish(std::string& output);
+
+    /**
+     * @brief Discard held-back bytes and start a new encoding
+     */
+    void reset();
+
+private:
+    void emit(const char* chars, size_t count, std::string& output);
+
+    Base64Variant variant_;
+    size_t line_length_;
+    size_t column_;
+    unsigned char pending_[3];
+    size_t pending_size_;
+};
+
+} // namespace ssmtp_mailer
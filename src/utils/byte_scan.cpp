@@ -0,0 +1,497 @@
+#include "utils/byte_scan.hpp"
+#include "utils/cpu_features.hpp"
+#include <algorithm>
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SSMTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SSMTP_SCAN_NEON 1
+#include <arm_neon.h>
+#endif
+
+#if defined(__GNUC__)
+#define SSMTP_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SSMTP_TARGET_AVX2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+inline unsigned countTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+inline bool isQuotedPrintableSpecial(unsigned char c) {
+    return c < 0x20 || c >= 0x7F || c == '=';
+}
+
+size_t findQuotedPrintableSpecialScalar(const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (isQuotedPrintableSpecial(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return length;
+}
+
+inline bool isAddressByte(unsigned char c) {
+    // Folding to lower case maps only 'A'-'Z' onto 'a'-'z'
+    return static_cast<unsigned char>((c | 0x20) - 'a') < 26 ||
+           static_cast<unsigned char>(c - '0') < 10 ||
+           c == '.' || c == '-' || c == '_' || c == '%' || c == '+' || c == '@';
+}
+
+size_t findNonAddressByteScalar(const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (!isAddressByte(static_cast<unsigned char>(data[i]))) {
+            return i;
+        }
+    }
+    return length;
+}
+
+ByteClassCounts countByteClassesScalar(const char* data, size_t length) {
+    ByteClassCounts counts;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        counts.eight_bit += c >> 7;
+        counts.nul += c == 0;
+    }
+    return counts;
+}
+
+// Vector byte counters are summed before any lane can overflow
+const size_t MAX_COUNTER_BLOCKS = 255;
+
+#ifdef SSMTP_SCAN_X86
+
+/**
+ * Sum of the 16 bytes of a vector
+ */
+inline size_t sumBytes(__m128i counters) {
+    __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+    return static_cast<size_t>(_mm_cvtsi128_si32(sums)) + static_cast<size_t>(_mm_extract_epi16(sums, 4));
+}
+
+size_t findLineBreakSSE2(const char* data, size_t length) {
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(block, cr), _mm_cmpeq_epi8(block, lf));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findLineBreakScalar(data + i, length - i);
+}
+
+SSMTP_TARGET_AVX2
+size_t findLineBreakAVX2(const char* data, size_t length) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(block, cr), _mm256_cmpeq_epi8(block, lf));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findLineBreakSSE2(data + i, length - i);
+}
+
+size_t findQuotedPrintableSpecialSSE2(const char* data, size_t length) {
+    // Signed comparison with ' ' also catches the 8-bit bytes
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i del = _mm_set1_epi8(0x7F);
+    const __m128i equals = _mm_set1_epi8('=');
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i hits = _mm_or_si128(_mm_cmplt_epi8(block, space),
+                                    _mm_or_si128(_mm_cmpeq_epi8(block, del), _mm_cmpeq_epi8(block, equals)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findQuotedPrintableSpecialScalar(data + i, length - i);
+}
+
+SSMTP_TARGET_AVX2
+size_t findQuotedPrintableSpecialAVX2(const char* data, size_t length) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i del = _mm256_set1_epi8(0x7F);
+    const __m256i equals = _mm256_set1_epi8('=');
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i hits = _mm256_or_si256(_mm256_cmpgt_epi8(space, block),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(block, del),
+                                                       _mm256_cmpeq_epi8(block, equals)));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findQuotedPrintableSpecialScalar(data + i, length - i);
+}
+
+/**
+ * Lanes of a block holding address bytes. Signed comparisons put the 8-bit
+ * bytes below every range, so they are never accepted.
+ */
+inline __m128i addressBytesSSE2(__m128i block) {
+    __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+    // '-' and '.' are adjacent
+    __m128i dash_dot = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('-' - 1)),
+                                     _mm_cmplt_epi8(block, _mm_set1_epi8('.' + 1)));
+    __m128i other = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('_')),
+                                              _mm_cmpeq_epi8(block, _mm_set1_epi8('%'))),
+                                 _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('+')),
+                                              _mm_cmpeq_epi8(block, _mm_set1_epi8('@'))));
+    return _mm_or_si128(_mm_or_si128(letter, digit), _mm_or_si128(dash_dot, other));
+}
+
+size_t findNonAddressByteSSE2(const char* data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(addressBytesSSE2(block))) & 0xFFFF;
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findNonAddressByteScalar(data + i, length - i);
+}
+
+SSMTP_TARGET_AVX2
+size_t findNonAddressByteAVX2(const char* data, size_t length) {
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i before_a = _mm256_set1_epi8('a' - 1);
+    const __m256i after_z = _mm256_set1_epi8('z' + 1);
+    const __m256i before_0 = _mm256_set1_epi8('0' - 1);
+    const __m256i after_9 = _mm256_set1_epi8('9' + 1);
+    const __m256i before_dash = _mm256_set1_epi8('-' - 1);
+    const __m256i after_dot = _mm256_set1_epi8('.' + 1);
+    const __m256i underscore = _mm256_set1_epi8('_');
+    const __m256i percent = _mm256_set1_epi8('%');
+    const __m256i plus = _mm256_set1_epi8('+');
+    const __m256i at = _mm256_set1_epi8('@');
+
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        __m256i lower = _mm256_or_si256(block, case_bit);
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, before_a),
+                                          _mm256_cmpgt_epi8(after_z, lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, before_0),
+                                         _mm256_cmpgt_epi8(after_9, block));
+        __m256i dash_dot = _mm256_and_si256(_mm256_cmpgt_epi8(block, before_dash),
+                                            _mm256_cmpgt_epi8(after_dot, block));
+        __m256i other = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, underscore),
+                                                        _mm256_cmpeq_epi8(block, percent)),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(block, plus),
+                                                        _mm256_cmpeq_epi8(block, at)));
+        __m256i accepted = _mm256_or_si256(_mm256_or_si256(letter, digit),
+                                           _mm256_or_si256(dash_dot, other));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(accepted));
+        if (mask != 0) {
+            return i + countTrailingZeros(mask);
+        }
+    }
+    return i + findNonAddressByteSSE2(data + i, length - i);
+}
+
+ByteClassCounts countByteClassesSSE2(const char* data, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    ByteClassCounts counts;
+
+    size_t i = 0;
+    while (i + 16 <= length) {
+        // Comparison masks are -1, so subtracting them counts matches per lane
+        __m128i eight_bit = zero;
+        __m128i nul = zero;
+        for (size_t n = 0; n < MAX_COUNTER_BLOCKS && i + 16 <= length; ++n, i += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            eight_bit = _mm_sub_epi8(eight_bit, _mm_cmplt_epi8(block, zero));
+            nul = _mm_sub_epi8(nul, _mm_cmpeq_epi8(block, zero));
+        }
+        counts.eight_bit += sumBytes(eight_bit);
+        counts.nul += sumBytes(nul);
+    }
+
+    ByteClassCounts tail = countByteClassesScalar(data + i, length - i);
+    counts.eight_bit += tail.eight_bit;
+    counts.nul += tail.nul;
+    return counts;
+}
+
+SSMTP_TARGET_AVX2
+ByteClassCounts countByteClassesAVX2(const char* data, size_t length) {
+    const __m256i zero = _mm256_setzero_si256();
+    ByteClassCounts counts;
+
+    size_t i = 0;
+    while (i + 32 <= length) {
+        __m256i eight_bit = zero;
+        __m256i nul = zero;
+        for (size_t n = 0; n < MAX_COUNTER_BLOCKS && i + 32 <= length; ++n, i += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            eight_bit = _mm256_sub_epi8(eight_bit, _mm256_cmpgt_epi8(zero, block));
+            nul = _mm256_sub_epi8(nul, _mm256_cmpeq_epi8(block, zero));
+        }
+        __m256i sums = _mm256_add_epi64(_mm256_sad_epu8(eight_bit, zero),
+                                        _mm256_slli_epi64(_mm256_sad_epu8(nul, zero), 32));
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sums);
+        for (uint64_t lane : lanes) {
+            counts.eight_bit += static_cast<size_t>(lane & 0xFFFFFFFF);
+            counts.nul += static_cast<size_t>(lane >> 32);
+        }
+    }
+
+    ByteClassCounts tail = countByteClassesScalar(data + i, length - i);
+    counts.eight_bit += tail.eight_bit;
+    counts.nul += tail.nul;
+    return counts;
+}
+
+#endif
+
+#ifdef SSMTP_SCAN_NEON
+
+size_t findLineBreakNEON(const char* data, size_t length) {
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        uint8x16_t hits = vorrq_u8(vceqq_u8(block, cr), vceqq_u8(block, lf));
+        // Narrow each byte to a nibble so the match mask fits in 64 bits
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+        if (mask != 0) {
+            return i + countTrailingZeros(mask) / 4;
+        }
+    }
+    return i + findLineBreakScalar(data + i, length - i);
+}
+
+size_t findQuotedPrintableSpecialNEON(const char* data, size_t length) {
+    const uint8x16_t space = vdupq_n_u8(' ');
+    const uint8x16_t del = vdupq_n_u8(0x7F);
+    const uint8x16_t equals = vdupq_n_u8('=');
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        uint8x16_t hits = vorrq_u8(vorrq_u8(vcltq_u8(block, space), vcgeq_u8(block, del)),
+                                   vceqq_u8(block, equals));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+        if (mask != 0) {
+            return i + countTrailingZeros(mask) / 4;
+        }
+    }
+    return i + findQuotedPrintableSpecialScalar(data + i, length - i);
+}
+
+size_t findNonAddressByteNEON(const char* data, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+        // Unsigned range checks: subtract the range start and compare with its width
+        uint8x16_t lower = vorrq_u8(block, vdupq_n_u8(0x20));
+        uint8x16_t letter = vcltq_u8(vsubq_u8(lower, vdupq_n_u8('a')), vdupq_n_u8(26));
+        uint8x16_t digit = vcltq_u8(vsubq_u8(block, vdupq_n_u8('0')), vdupq_n_u8(10));
+        uint8x16_t dash_dot = vcltq_u8(vsubq_u8(block, vdupq_n_u8('-')), vdupq_n_u8(2));
+        uint8x16_t other = vorrq_u8(vorrq_u8(vceqq_u8(block, vdupq_n_u8('_')), vceqq_u8(block, vdupq_n_u8('%'))),
+                                    vorrq_u8(vceqq_u8(block, vdupq_n_u8('+')), vceqq_u8(block, vdupq_n_u8('@'))));
+        uint8x16_t rejected = vmvnq_u8(vorrq_u8(vorrq_u8(letter, digit), vorrq_u8(dash_dot, other)));
+        uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(
+            vshrn_n_u16(vreinterpretq_u16_u8(rejected), 4)), 0);
+        if (mask != 0) {
+            return i + countTrailingZeros(mask) / 4;
+        }
+    }
+    return i + findNonAddressByteScalar(data + i, length - i);
+}
+
+ByteClassCounts countByteClassesNEON(const char* data, size_t length) {
+    const uint8x16_t zero = vdupq_n_u8(0);
+    ByteClassCounts counts;
+
+    size_t i = 0;
+    while (i + 16 <= length) {
+        uint8x16_t eight_bit = zero;
+        uint8x16_t nul = zero;
+        for (size_t n = 0; n < MAX_COUNTER_BLOCKS && i + 16 <= length; ++n, i += 16) {
+            uint8x16_t block = vld1q_u8(reinterpret_cast<const uint8_t*>(data + i));
+            eight_bit = vaddq_u8(eight_bit, vshrq_n_u8(block, 7));
+            nul = vsubq_u8(nul, vceqq_u8(block, zero));
+        }
+        counts.eight_bit += vaddlvq_u8(eight_bit);
+        counts.nul += vaddlvq_u8(nul);
+    }
+
+    ByteClassCounts tail = countByteClassesScalar(data + i, length - i);
+    counts.eight_bit += tail.eight_bit;
+    counts.nul += tail.nul;
+    return counts;
+}
+
+#endif
+
+using ScanFunction = size_t (*)(const char*, size_t);
+
+ScanFunction lineBreakScanFor(ScanKernel kernel) {
+    switch (kernel) {
+#ifdef SSMTP_SCAN_X86
+    case ScanKernel::SSE2:
+        return findLineBreakSSE2;
+    case ScanKernel::AVX2:
+        return findLineBreakAVX2;
+#endif
+#ifdef SSMTP_SCAN_NEON
+    case ScanKernel::NEON:
+        return findLineBreakNEON;
+#endif
+    default:
+        return findLineBreakScalar;
+    }
+}
+
+using QuotedPrintableScanFunction = size_t (*)(const char*, size_t);
+using CountFunction = ByteClassCounts (*)(const char*, size_t);
+
+QuotedPrintableScanFunction selectQuotedPrintableScan() {
+    const CPUFeatures& features = getCPUFeatures();
+#ifdef SSMTP_SCAN_X86
+    if (features.avx2) {
+        return findQuotedPrintableSpecialAVX2;
+    }
+    return findQuotedPrintableSpecialSSE2;
+#elif defined(SSMTP_SCAN_NEON)
+    (void)features;
+    return findQuotedPrintableSpecialNEON;
+#else
+    (void)features;
+    return findQuotedPrintableSpecialScalar;
+#endif
+}
+
+ScanFunction selectAddressScan() {
+    const CPUFeatures& features = getCPUFeatures();
+#ifdef SSMTP_SCAN_X86
+    if (features.avx2) {
+        return findNonAddressByteAVX2;
+    }
+    return findNonAddressByteSSE2;
+#elif defined(SSMTP_SCAN_NEON)
+    (void)features;
+    return findNonAddressByteNEON;
+#else
+    (void)features;
+    return findNonAddressByteScalar;
+#endif
+}
+
+CountFunction selectByteClassCount() {
+    const CPUFeatures& features = getCPUFeatures();
+#ifdef SSMTP_SCAN_X86
+    if (features.avx2) {
+        return countByteClassesAVX2;
+    }
+    return countByteClassesSSE2;
+#elif defined(SSMTP_SCAN_NEON)
+    (void)features;
+    return countByteClassesNEON;
+#else
+    (void)features;
+    return countByteClassesScalar;
+#endif
+}
+
+} // anonymous namespace
+
+std::vector<ScanKernel> scanKernels() {
+    std::vector<ScanKernel> kernels{ScanKernel::SCALAR};
+    const CPUFeatures& features = getCPUFeatures();
+#ifdef SSMTP_SCAN_X86
+    kernels.push_back(ScanKernel::SSE2);
+    if (features.avx2) {
+        kernels.push_back(ScanKernel::AVX2);
+    }
+#elif defined(SSMTP_SCAN_NEON)
+    (void)features;
+    kernels.push_back(ScanKernel::NEON);
+#else
+    (void)features;
+#endif
+    return kernels;
+}
+
+size_t findLineBreak(const char* data, size_t length) {
+    static const ScanFunction scan = lineBreakScanFor(scanKernels().back());
+    return scan(data, length);
+}
+
+size_t findLineBreakScalar(const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        if (data[i] == '\r' || data[i] == '\n') {
+            return i;
+        }
+    }
+    return length;
+}
+
+size_t findLineBreakWith(ScanKernel kernel, const char* data, size_t length) {
+    return lineBreakScanFor(kernel)(data, length);
+}
+
+size_t findQuotedPrintableSpecial(const char* data, size_t length) {
+    static const QuotedPrintableScanFunction scan = selectQuotedPrintableScan();
+    return scan(data, length);
+}
+
+size_t findNonAddressByte(const char* data, size_t length) {
+    static const ScanFunction scan = selectAddressScan();
+    return scan(data, length);
+}
+
+ByteClassCounts countByteClasses(const char* data, size_t length) {
+    static const CountFunction count = selectByteClassCount();
+    return count(data, length);
+}
+
+} // namespace ssmtp_mailer
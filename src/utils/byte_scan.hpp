@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Implementations of the scanning loops
+ */
+enum class ScanKernel {
+    SCALAR,
+    SSE2,
+    AVX2,
+    NEON
+};
+
+/**
+ * @brief Kernels this build and CPU can run, from the portable one to the fastest
+ *
+ * findLineBreak() uses the last one.
+ */
+std::vector<ScanKernel> scanKernels();
+
+/**
+ * @brief Find the first CR or LF in a buffer
+ *
+ * Uses AVX2, SSE2 or NEON when the CPU has them (see getCPUFeatures()),
+ * so long runs of ordinary text are skipped 16 or 32 bytes at a time.
+ *
+ * @param data Input bytes
+ * @param length Input length
+ * @return Offset of the first '\r' or '\n', or length if there is none
+ */
+size_t findLineBreak(const char* data, size_t length);
+
+/**
+ * @brief Portable form of findLineBreak(), for comparison and testing
+ * @param data Input bytes
+ * @param length Input length
+ * @return Offset of the first '\r' or '\n', or length if there is none
+ */
+size_t findLineBreakScalar(const char* data, size_t length);
+
+/**
+ * @brief findLineBreak() with a given kernel, one of scanKernels(); for testing
+ */
+size_t findLineBreakWith(ScanKernel kernel, const char* data, size_t length);
+
+/**
+ * @brief Find the first byte quoted-printable cannot copy as it is
+ *
+ * That is any control character (including TAB, CR and LF), DEL, an 8-bit
+ * byte or '='. Vectorised like findLineBreak().
+ *
+ * @param data Input bytes
+ * @param length Input length
+ * @return Offset of the first such byte, or length if there is none
+ */
+size_t findQuotedPrintableSpecial(const char* data, size_t length);
+
+/**
+ * @brief Find the first byte that cannot occur in an email address
+ *
+ * Addresses are accepted in the form [A-Za-z0-9._%+-]+@[A-Za-z0-9.-]+,
+ * so this is any byte other than an ASCII letter, a digit or one of
+ * "._%+-@". Vectorised like findLineBreak().
+ *
+ * @param data Input bytes
+ * @param length Input length
+ * @return Offset of the first such byte, or length if there is none
+ */
+size_t findNonAddressByte(const char* data, size_t length);
+
+/**
+ * @brief Byte counts that decide how text may be transferred
+ */
+struct ByteClassCounts {
+    size_t eight_bit;   // Bytes 0x80-0xFF
+    size_t nul;         // NUL bytes
+
+    ByteClassCounts() : eight_bit(0), nul(0) {}
+};
+
+/**
+ * @brief Count 8-bit and NUL bytes in a buffer, vectorised like findLineBreak()
+ * @param data Input bytes
+ * @param length Input length
+ * @return Counts
+ */
+ByteClassCounts countByteClasses(const char* data, size_t length);
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Non-owning view of bytes to be transmitted
+ *
+ * Used to describe outgoing data as a list of pieces that are written with a
+ * single gathering call instead of being concatenated first. The viewed
+ * memory must stay valid until the write completes.
+ */
+struct ConstBuffer {
+    const char* data;
+    size_t size;
+
+    ConstBuffer() : data(nullptr), size(0) {}
+    ConstBuffer(const char* bytes, size_t length) : data(bytes), size(length) {}
+    explicit ConstBuffer(const std::string& text) : data(text.data()), size(text.size()) {}
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,48 @@
+#include "utils/cpu_features.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+CPUFeatures detectFeatures() {
+    CPUFeatures features;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    features.sse2 = __builtin_cpu_supports("sse2");
+    features.ssse3 = __builtin_cpu_supports("ssse3");
+    features.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    features.sse2 = (info[3] & (1 << 26)) != 0;
+    features.ssse3 = (info[2] & (1 << 9)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+
+    // AVX2 also needs the OS to save YMM state across context switches
+    if (max_leaf >= 7 && osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        features.avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    features.neon = true;           // Mandatory in AArch64
+#endif
+
+    return features;
+}
+
+} // anonymous namespace
+
+const CPUFeatures& getCPUFeatures() {
+    static const CPUFeatures features = detectFeatures();
+    return features;
+}
+
+} // namespace ssmtp_mailer
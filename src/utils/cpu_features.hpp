@@ -0,0 +1,28 @@
+#pragma once
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Instruction set extensions usable on this machine
+ *
+ * The library is built for the baseline of its target architecture;
+ * kernels with wider implementations consult this at run time to choose
+ * one. Flags already include operating system support (e.g. AVX state
+ * saving), so a set flag means the instructions can be executed.
+ */
+struct CPUFeatures {
+    bool sse2;
+    bool ssse3;
+    bool avx2;
+    bool neon;
+
+    CPUFeatures() : sse2(false), ssse3(false), avx2(false), neon(false) {}
+};
+
+/**
+ * @brief Get the features of the running CPU, detected once
+ * @return Detected features
+ */
+const CPUFeatures& getCPUFeatures();
+
+} // namespace ssmtp_mailer
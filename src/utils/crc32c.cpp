@@ -0,0 +1,56 @@
+#include "utils/crc32c.hpp"
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;    // Reflected 0x1EDC6F41
+
+struct Crc32cTables {
+    uint32_t table[8][256];
+
+    Crc32cTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            }
+            table[0][i] = crc;
+        }
+        // table[k][i]: the CRC of byte i followed by k zero bytes
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const Crc32cTables& tables() {
+    static const Crc32cTables instance;
+    return instance;
+}
+
+} // anonymous namespace
+
+uint32_t crc32c(const void* data, size_t length, uint32_t crc) {
+    const uint32_t (&t)[8][256] = tables().table;
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+
+    // Slicing-by-8: fold eight input bytes per step through eight tables
+    while (length >= 8) {
+        uint32_t low = crc ^ (static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+                              static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        length -= 8;
+    }
+    while (length-- > 0) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    }
+    return ~crc;
+}
+
+} // namespace ssmtp_mailer
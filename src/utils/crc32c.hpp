@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief CRC-32C (Castagnoli) checksum of a buffer
+ *
+ * The polynomial used by iSCSI, ext4 and most write-ahead logs; it detects
+ * the short bursts a torn write leaves behind better than the zlib CRC.
+ * Table-driven, eight bytes per step.
+ *
+ * @param data Input bytes
+ * @param length Input length
+ * @param crc Checksum of the preceding bytes, to continue a running checksum
+ * @return Checksum
+ */
+uint32_t crc32c(const void* data, size_t length, uint32_t crc = 0);
+
+} // namespace ssmtp_mailer
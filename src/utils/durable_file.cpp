@@ -0,0 +1,166 @@
+#include "utils/durable_file.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+std::string systemError(const std::string& what, const std::string& path) {
+    return what + " " + path + ": " + std::strerror(errno);
+}
+
+#ifdef O_TMPFILE
+/**
+ * Write through an unnamed inode, then link it in
+ * @return 1 if written, 0 if the file system cannot do this (use a rename), -1 on error
+ */
+int writeTmpfile(const std::string& directory, const std::string& final_path, const std::string& content,
+                 bool sync, std::string& error) {
+    int fd = ::open(directory.c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        if (errno == EOPNOTSUPP || errno == EISDIR || errno == EINVAL) {
+            return 0;
+        }
+        error = systemError("Cannot create file in", directory);
+        return -1;
+    }
+    if (!writeFully(fd, content.data(), content.size()) || (sync && !syncFileData(fd))) {
+        error = systemError("Cannot write", final_path);
+        ::close(fd);
+        return -1;
+    }
+
+    // linkat() with AT_EMPTY_PATH needs a capability; the /proc link does not
+    char proc_path[64];
+    std::snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+    int linked = ::linkat(AT_FDCWD, proc_path, AT_FDCWD, final_path.c_str(), AT_SYMLINK_FOLLOW);
+    int saved = errno;
+    ::close(fd);
+    if (linked != 0) {
+        // EEXIST: replacing needs a rename; ENOENT: no /proc
+        if (saved == EEXIST || saved == ENOENT) {
+            return 0;
+        }
+        errno = saved;
+        error = systemError("Cannot link", final_path);
+        return -1;
+    }
+    return 1;
+}
+#endif
+
+} // anonymous namespace
+
+int createFile(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_CREAT | _O_TRUNC | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    return ::open(path.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_CLOEXEC, 0600);
+#endif
+}
+
+void closeFile(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+bool writeFully(int fd, const void* data, size_t size) {
+    const char* p = static_cast<const char*>(data);
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(fd, p, static_cast<unsigned int>(std::min<size_t>(size, 1 << 30)));
+#else
+        ssize_t written = ::write(fd, p, size);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool syncFileData(int fd) {
+#ifdef _WIN32
+    return _commit(fd) == 0;
+#elif defined(__APPLE__)
+    return ::fsync(fd) == 0;
+#else
+    return ::fdatasync(fd) == 0;
+#endif
+}
+
+bool syncDirectory(const std::string& path) {
+#ifdef _WIN32
+    return true;    // NTFS journals directory updates itself
+#else
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+bool writeFileDurably(const std::string& directory, const std::string& name, const std::string& content,
+                      bool sync, std::string& error) {
+    std::string final_path = directory + "/" + name;
+
+    int written = 0;
+#ifdef O_TMPFILE
+    written = writeTmpfile(directory, final_path, content, sync, error);
+    if (written < 0) {
+        return false;
+    }
+#endif
+
+    if (written == 0) {
+        std::string temp_path = directory + "/." + name + ".tmp";
+        int fd = createFile(temp_path);
+        if (fd < 0) {
+            error = systemError("Cannot create", temp_path);
+            return false;
+        }
+        bool ok = writeFully(fd, content.data(), content.size()) && (!sync || syncFileData(fd));
+        if (!ok) {
+            error = systemError("Cannot write", temp_path);
+        }
+        closeFile(fd);
+        if (ok && std::rename(temp_path.c_str(), final_path.c_str()) != 0) {
+            error = systemError("Cannot rename", temp_path);
+            ok = false;
+        }
+        if (!ok) {
+            std::remove(temp_path.c_str());
+            return false;
+        }
+    }
+
+    if (sync && !syncDirectory(directory)) {
+        error = systemError("Cannot sync", directory);
+        return false;
+    }
+    return true;
+}
+
+} // namespace ssmtp_mailer
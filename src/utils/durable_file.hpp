@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Create (or truncate) a file for writing, readable by the owner only
+ * @param path File path
+ * @return File descriptor, or -1 with errno set
+ */
+int createFile(const std::string& path);
+
+/**
+ * @brief Close a file descriptor
+ * @param fd File descriptor
+ */
+void closeFile(int fd);
+
+/**
+ * @brief Write a whole buffer, continuing after short writes and EINTR
+ * @param fd File descriptor
+ * @param data Bytes to write
+ * @param size Number of bytes
+ * @return true on success; errno is set on failure
+ */
+bool writeFully(int fd, const void* data, size_t size);
+
+/**
+ * @brief Flush a file's data to stable storage (fdatasync where available)
+ * @param fd File descriptor
+ * @return true on success
+ */
+bool syncFileData(int fd);
+
+/**
+ * @brief Make the creation, rename or removal of entries in a directory durable
+ * @param path Directory path
+ * @return true on success
+ */
+bool syncDirectory(const std::string& path);
+
+/**
+ * @brief Write a file so that it appears complete or not at all
+ *
+ * On Linux the data goes to an unnamed O_TMPFILE inode that is linked
+ * into place once written, so a crash never leaves a partial file or a
+ * temporary to clean up. Elsewhere, or if the file system lacks
+ * O_TMPFILE, it is written under a hidden temporary name (".name.tmp")
+ * and renamed. An existing file of the same name is replaced.
+ *
+ * @param directory Directory to create the file in
+ * @param name File name
+ * @param content File contents
+ * @param sync Whether to fsync the file and the directory before returning
+ * @param error Error message on failure
+ * @return true on success
+ */
+bool writeFileDurably(const std::string& directory, const std::string& name, const std::string& content,
+                      bool sync, std::string& error);
+
+} // namespace ssmtp_mailer
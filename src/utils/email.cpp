@@ -1,40 +1,88 @@
 #include "utils/email.hpp"
+#include "utils/byte_scan.hpp"
+#include "utils/unique_id.hpp"
 #include <sstream>
 #include <iomanip>
 #include <chrono>
-#include <random>
 #include <algorithm>
 #include <cctype>
 
 namespace ssmtp_mailer {
 
-// Static member initialization
-static const std::regex email_regex_(
-    R"(([a-zA-Z0-9._%+-]+)@([a-zA-Z0-9.-]+\.[a-zA-Z]{2,}))"
-);
+namespace {
+
+inline bool isAsciiLetter(unsigned char c) {
+    return static_cast<unsigned char>((c | 0x20) - 'a') < 26;
+}
+
+inline bool isDomainByte(unsigned char c) {
+    return isAsciiLetter(c) || static_cast<unsigned char>(c - '0') < 10 || c == '.' || c == '-';
+}
+
+} // anonymous namespace
+
+bool parseEmailAddress(std::string_view address, EmailAddressParts& parts) {
+    parts = EmailAddressParts();
+
+    // Every byte must belong to the local part or the domain alphabet
+    if (findNonAddressByte(address.data(), address.size()) != address.size()) {
+        return false;
+    }
+
+    size_t at = address.find('@');
+    if (at == 0 || at == std::string_view::npos) {
+        return false;
+    }
+
+    // The top-level label is letters only, so it follows the last dot
+    std::string_view domain = address.substr(at + 1);
+    size_t dot = domain.rfind('.');
+    if (dot == std::string_view::npos || dot == 0 || domain.size() - dot - 1 < 2) {
+        return false;
+    }
+    // Also rejects a second '@' and the local-part-only "_%+"
+    for (size_t i = 0; i < dot; ++i) {
+        if (!isDomainByte(static_cast<unsigned char>(domain[i]))) {
+            return false;
+        }
+    }
+    for (size_t i = dot + 1; i < domain.size(); ++i) {
+        if (!isAsciiLetter(static_cast<unsigned char>(domain[i]))) {
+            return false;
+        }
+    }
+
+    parts.local_part = address.substr(0, at);
+    parts.domain = domain;
+    return true;
+}
+
+size_t parseEmailAddresses(const std::vector<std::string>& addresses, std::vector<EmailAddressParts>& parts) {
+    parts.resize(addresses.size());
+
+    size_t valid = 0;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        valid += parseEmailAddress(addresses[i], parts[i]);
+    }
+    return valid;
+}
 
 // Utility functions
 bool isValidEmailAddress(const std::string& address) {
-    if (address.empty()) return false;
-    
-    std::smatch match;
-    return std::regex_match(address, match, email_regex_);
+    EmailAddressParts parts;
+    return parseEmailAddress(address, parts);
 }
 
 std::string extractDomain(const std::string& address) {
-    std::smatch match;
-    if (std::regex_match(address, match, email_regex_)) {
-        return match[2].str();
-    }
-    return "";
+    EmailAddressParts parts;
+    parseEmailAddress(address, parts);
+    return std::string(parts.domain);
 }
 
 std::string extractUsername(const std::string& address) {
-    std::smatch match;
-    if (std::regex_match(address, match, email_regex_)) {
-        return match[1].str();
-    }
-    return "";
+    EmailAddressParts parts;
+    parseEmailAddress(address, parts);
+    return std::string(parts.local_part);
 }
 
 std::string normalizeEmailAddress(const std::string& address) {
@@ -51,18 +99,7 @@ std::string normalizeEmailAddress(const std::string& address) {
 }
 
 std::string generateUniqueId() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 15);
-    
-    std::ostringstream oss;
-    oss << std::hex;
-    
-    for (int i = 0; i < 32; ++i) {
-        oss << dis(gen);
-    }
-    
-    return oss.str();
+    return nextUniqueId().toBase32();
 }
 
 std::string getCurrentTimestamp() {
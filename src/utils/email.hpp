@@ -1,14 +1,46 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
-#include <regex>
+#include <cstddef>
 
 namespace ssmtp_mailer {
 
 // Note: SMTPResult and Email structs are defined in include/ssmtp-mailer/mailer.hpp
 // This file provides utility functions for email operations
 
+/**
+ * @brief Local part and domain of an address, viewing the parsed string
+ *
+ * Both views are empty when the address did not parse.
+ */
+struct EmailAddressParts {
+    std::string_view local_part;
+    std::string_view domain;
+};
+
+/**
+ * @brief Split an address into local part and domain in one pass
+ *
+ * Accepts exactly what the pattern
+ * ([a-zA-Z0-9._%+-]+)@([a-zA-Z0-9.-]+\.[a-zA-Z]{2,}) matches in full.
+ *
+ * @param address Address to parse
+ * @param parts Local part and domain, viewing address
+ * @return true if the address is valid, false otherwise
+ */
+bool parseEmailAddress(std::string_view address, EmailAddressParts& parts);
+
+/**
+ * @brief Validate and split a list of addresses
+ * @param addresses Addresses to parse
+ * @param parts One entry per address, viewing the strings in addresses;
+ *        empty views for addresses that are not valid
+ * @return Number of valid addresses
+ */
+size_t parseEmailAddresses(const std::vector<std::string>& addresses, std::vector<EmailAddressParts>& parts);
+
 /**
  * @brief Check if address is valid email format
  * @param address Email address to validate
@@ -39,7 +71,11 @@ std::string normalizeEmailAddress(const std::string& address);
 
 /**
  * @brief Generate unique identifier
- * @return Unique identifier string
+ *
+ * Used for Message-IDs, MIME boundaries and queue item IDs. IDs sort by
+ * creation time (see UniqueId).
+ *
+ * @return 26-character base32 identifier
  */
 std::string generateUniqueId();
 
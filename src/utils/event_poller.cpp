@@ -0,0 +1,195 @@
+#include "utils/event_poller.hpp"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+#ifdef __linux__
+// Token of the wake pipe, never reported to the caller
+const uint64_t WAKE_TOKEN = UINT64_MAX;
+const int MAX_EVENTS = 256;
+
+static_assert(EPOLLIN == POLLIN && EPOLLOUT == POLLOUT && EPOLLERR == POLLERR && EPOLLHUP == POLLHUP,
+              "epoll and poll event bits differ");
+#endif
+
+} // anonymous namespace
+
+#ifdef __linux__
+
+EventPoller::EventPoller() : epoll_fd_(-1) {
+}
+
+EventPoller::~EventPoller() {
+    close();
+}
+
+bool EventPoller::open(std::string& error) {
+    if (!wake_pipe_.open(error)) {
+        return false;
+    }
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0 || !add(wake_pipe_.fd(), POLLIN, WAKE_TOKEN)) {
+        error = "Failed to create event poller: " + std::string(strerror(errno));
+        close();
+        return false;
+    }
+    return true;
+}
+
+void EventPoller::close() {
+    if (epoll_fd_ >= 0) {
+        ::close(epoll_fd_);
+        epoll_fd_ = -1;
+    }
+    wake_pipe_.close();
+}
+
+bool EventPoller::add(int fd, uint32_t events, uint64_t token) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = token;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+bool EventPoller::modify(int fd, uint32_t events, uint64_t token) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u64 = token;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) == 0;
+}
+
+void EventPoller::remove(int fd) {
+    // Closing the descriptor has usually removed it already
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, &event);
+}
+
+bool EventPoller::wait(std::vector<Event>& events, int timeout_ms) {
+    struct epoll_event ready[MAX_EVENTS];
+    events.clear();
+    int count = epoll_wait(epoll_fd_, ready, MAX_EVENTS, timeout_ms);
+    if (count < 0) {
+        return errno == EINTR;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (ready[i].data.u64 == WAKE_TOKEN) {
+            wake_pipe_.drain();
+            continue;
+        }
+        events.push_back(Event{ready[i].data.u64, ready[i].events});
+    }
+    return true;
+}
+
+#else
+
+EventPoller::EventPoller() {
+}
+
+EventPoller::~EventPoller() {
+    close();
+}
+
+bool EventPoller::open(std::string& error) {
+    if (!wake_pipe_.open(error)) {
+        return false;
+    }
+    struct pollfd wake;
+    wake.fd = wake_pipe_.fd();
+    wake.events = POLLIN;
+    wake.revents = 0;
+    fds_.assign(1, wake);
+    tokens_.assign(1, 0);
+    index_.clear();
+    return true;
+}
+
+void EventPoller::close() {
+    fds_.clear();
+    tokens_.clear();
+    index_.clear();
+    wake_pipe_.close();
+}
+
+bool EventPoller::add(int fd, uint32_t events, uint64_t token) {
+    if (index_.count(fd) > 0) {
+        errno = EEXIST;
+        return false;
+    }
+    struct pollfd entry;
+    entry.fd = fd;
+    entry.events = static_cast<short>(events);
+    entry.revents = 0;
+    index_[fd] = fds_.size();
+    fds_.push_back(entry);
+    tokens_.push_back(token);
+    return true;
+}
+
+bool EventPoller::modify(int fd, uint32_t events, uint64_t token) {
+    auto it = index_.find(fd);
+    if (it == index_.end()) {
+        errno = ENOENT;
+        return false;
+    }
+    fds_[it->second].events = static_cast<short>(events);
+    tokens_[it->second] = token;
+    return true;
+}
+
+void EventPoller::remove(int fd) {
+    auto it = index_.find(fd);
+    if (it == index_.end()) {
+        return;
+    }
+    // Move the last entry into the hole
+    size_t slot = it->second;
+    index_.erase(it);
+    size_t last = fds_.size() - 1;
+    if (slot != last) {
+        fds_[slot] = fds_[last];
+        tokens_[slot] = tokens_[last];
+        index_[fds_[slot].fd] = slot;
+    }
+    fds_.pop_back();
+    tokens_.pop_back();
+}
+
+bool EventPoller::wait(std::vector<Event>& events, int timeout_ms) {
+    events.clear();
+    int count = poll(fds_.data(), static_cast<nfds_t>(fds_.size()), timeout_ms);
+    if (count < 0) {
+        return errno == EINTR;
+    }
+    for (size_t i = 0; i < fds_.size() && count > 0; ++i) {
+        if (fds_[i].revents == 0) {
+            continue;
+        }
+        count--;
+        if (i == 0) {
+            wake_pipe_.drain();
+        } else {
+            events.push_back(Event{tokens_[i], static_cast<uint32_t>(fds_[i].revents)});
+        }
+        fds_[i].revents = 0;
+    }
+    return true;
+}
+
+#endif
+
+bool EventPoller::wake() {
+    return wake_pipe_.wake();
+}
+
+} // namespace ssmtp_mailer
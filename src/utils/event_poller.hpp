@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <poll.h>
+#include "utils/socket_util.hpp"
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Readiness notification for many descriptors: epoll on Linux, poll() elsewhere
+ *
+ * Event masks are the poll() bits (POLLIN, POLLOUT, POLLERR, POLLHUP) on
+ * every platform. epoll forgets a descriptor when it is closed but poll()
+ * does not, so owners remove() a descriptor right after closing it, before
+ * the next wait(). Only wake() may be called from other threads.
+ */
+class EventPoller {
+public:
+    struct Event {
+        uint64_t token;
+        uint32_t events;
+    };
+
+    EventPoller();
+    ~EventPoller();
+
+    EventPoller(const EventPoller&) = delete;
+    EventPoller& operator=(const EventPoller&) = delete;
+
+    /**
+     * @brief Create the poller and its wake pipe
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool open(std::string& error);
+
+    void close();
+
+    /**
+     * @brief Start watching a descriptor
+     * @param fd Descriptor
+     * @param events Events to wait for
+     * @param token Value reported with the descriptor's events; not UINT64_MAX
+     * @return true on success, false with errno set
+     */
+    bool add(int fd, uint32_t events, uint64_t token);
+
+    /**
+     * @brief Change the events a watched descriptor waits for
+     * @return true on success, false with errno set
+     */
+    bool modify(int fd, uint32_t events, uint64_t token);
+
+    /**
+     * @brief Stop watching a descriptor, which may already be closed
+     */
+    void remove(int fd);
+
+    /**
+     * @brief Wait for readiness or a wake()
+     * @param events Ready descriptors, replaced on each call; empty after a wake() alone
+     * @param timeout_ms Longest wait in milliseconds, -1 = no limit
+     * @return true on success (including timeout and EINTR), false with errno set
+     */
+    bool wait(std::vector<Event>& events, int timeout_ms);
+
+    /**
+     * @brief Interrupt wait(); safe from any thread
+     * @return true on success, false with errno set
+     */
+    bool wake();
+
+private:
+#ifdef __linux__
+    int epoll_fd_;
+#else
+    std::vector<struct pollfd> fds_;            // [0] is the wake pipe
+    std::vector<uint64_t> tokens_;
+    std::unordered_map<int, size_t> index_;
+#endif
+    WakePipe wake_pipe_;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,139 @@
+#include "utils/mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace ssmtp_mailer {
+
+MappedFile::MappedFile()
+    : data_(nullptr), size_(0), open_(false)
+#ifdef _WIN32
+    , mapping_(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        error = "Cannot open " + path;
+        return false;
+    }
+
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length)) {
+        CloseHandle(file);
+        error = "Cannot determine size of " + path;
+        return false;
+    }
+
+    // An empty file cannot be mapped, but is a valid (empty) mapping
+    if (length.QuadPart > 0) {
+        mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping_) {
+            data_ = static_cast<const char*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (!data_) {
+            if (mapping_) {
+                CloseHandle(mapping_);
+                mapping_ = nullptr;
+            }
+            CloseHandle(file);
+            error = "Cannot map " + path;
+            return false;
+        }
+        size_ = static_cast<size_t>(length.QuadPart);
+    }
+
+    CloseHandle(file);
+    open_ = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+    }
+    if (mapping_) {
+        CloseHandle(mapping_);
+    }
+    data_ = nullptr;
+    mapping_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
+
+void MappedFile::adviseSequential() {
+}
+
+#else
+
+bool MappedFile::open(const std::string& path, std::string& error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Cannot open " + path + ": " + std::strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        error = "Not a regular file: " + path;
+        return false;
+    }
+
+    // An empty file cannot be mapped, but is a valid (empty) mapping
+    if (info.st_size > 0) {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            error = "Cannot map " + path + ": " + std::strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        data_ = static_cast<const char*>(address);
+        size_ = static_cast<size_t>(info.st_size);
+    }
+
+    // The mapping keeps the file contents reachable without the descriptor
+    ::close(fd);
+    open_ = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
+
+void MappedFile::adviseSequential() {
+    if (data_) {
+        madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+    }
+}
+
+#endif
+
+} // namespace ssmtp_mailer
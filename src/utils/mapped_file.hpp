@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Read-only memory mapping of a whole file
+ *
+ * Lets large files be consumed in place: pages are faulted in on access
+ * and can be dropped by the kernel under memory pressure, so a mapped
+ * attachment never needs a heap copy of its contents.
+ */
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /**
+     * @brief Map a file, replacing any current mapping
+     * @param path File path
+     * @param error Error message on failure
+     * @return true if mapped, false otherwise
+     */
+    bool open(const std::string& path, std::string& error);
+
+    /**
+     * @brief Unmap the file
+     */
+    void close();
+
+    /**
+     * @brief Hint that the mapping will be read front to back
+     */
+    void adviseSequential();
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool isOpen() const { return open_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    bool open_;
+#ifdef _WIN32
+    void* mapping_;
+#endif
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer queue
+ *
+ * A ring of slots, each with a sequence number that says whose turn it is:
+ * a producer claims the tail position with one compare-and-swap, fills the
+ * slot and publishes it by bumping the sequence; consumers do the same at
+ * the head. Threads contend on a single atomic per side rather than a
+ * mutex, and nobody waits for a thread that was descheduled mid-operation
+ * unless the ring is full or empty at exactly its slot.
+ *
+ * The capacity is rounded up to a power of two. T must be default
+ * constructible and move assignable.
+ */
+template <typename T>
+class MpmcRing {
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Minimum number of items the ring holds
+     */
+    explicit MpmcRing(size_t capacity)
+        : mask_(roundUp(capacity) - 1), slots_(new Slot[mask_ + 1]), head_(0), tail_(0) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    /**
+     * @brief Add an item unless the ring is full
+     * @param item Item, moved from on success
+     * @return false if the ring is full
+     */
+    bool tryPush(T& item) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[position & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t turn = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (turn == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = std::move(item);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (turn < 0) {
+                return false;
+            } else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the oldest item unless the ring is empty
+     * @param item Receives the item
+     * @return false if the ring is empty
+     */
+    bool tryPop(T& item) {
+        size_t position = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots_[position & mask_];
+            size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            intptr_t turn = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (turn == 0) {
+                if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(slot.value);
+                    slot.value = T();
+                    slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (turn < 0) {
+                return false;
+            } else {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Read the queued items, oldest first, without removing them
+     *
+     * Only safe while no tryPop() runs; the caller has to keep consumers
+     * out (EmailQueue pops under its queue lock). Producers may carry on:
+     * the visit stops at the first item still being written.
+     *
+     * @param visit Called with each item
+     */
+    template <typename Visitor>
+    void peek(Visitor visit) const {
+        for (size_t position = head_.load(std::memory_order_acquire);; ++position) {
+            const Slot& slot = slots_[position & mask_];
+            if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+                return;
+            }
+            visit(slot.value);
+        }
+    }
+
+    /**
+     * @brief Approximate number of items; exact when no push or pop is in progress
+     */
+    size_t size() const {
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    // Producers and consumers write different cache lines
+    static const size_t CACHE_LINE = 64;
+
+    struct alignas(CACHE_LINE) Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundUp(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(CACHE_LINE) std::atomic<size_t> head_;
+    alignas(CACHE_LINE) std::atomic<size_t> tail_;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,94 @@
+#include "utils/socket_util.hpp"
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+
+namespace ssmtp_mailer {
+
+namespace {
+
+bool setCloseOnExec(int fd) {
+    int flags = fcntl(fd, F_GETFD);
+    return flags >= 0 && fcntl(fd, F_SETFD, flags | FD_CLOEXEC) == 0;
+}
+
+} // anonymous namespace
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+int openSocket(int family, int type, bool non_blocking) {
+    int fd = socket(family, type, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    bool ok = setCloseOnExec(fd) && (!non_blocking || setNonBlocking(fd));
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+    if (ok && type == SOCK_STREAM) {
+        int on = 1;
+        ok = setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on)) == 0;
+    }
+#endif
+    if (!ok) {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+WakePipe::WakePipe() {
+    fds_[0] = -1;
+    fds_[1] = -1;
+}
+
+WakePipe::~WakePipe() {
+    close();
+}
+
+bool WakePipe::open(std::string& error) {
+    if (fds_[0] >= 0) {
+        return true;
+    }
+    if (pipe(fds_) < 0) {
+        error = "Failed to create wake pipe: " + std::string(strerror(errno));
+        fds_[0] = -1;
+        fds_[1] = -1;
+        return false;
+    }
+    for (int fd : fds_) {
+        if (!setCloseOnExec(fd) || !setNonBlocking(fd)) {
+            error = "Failed to configure wake pipe: " + std::string(strerror(errno));
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void WakePipe::close() {
+    for (int& fd : fds_) {
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+bool WakePipe::wake() {
+    char byte = 1;
+    return fds_[1] >= 0 && (write(fds_[1], &byte, 1) == 1 || errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+void WakePipe::drain() {
+    char buffer[64];
+    while (fds_[0] >= 0 && read(fds_[0], buffer, sizeof(buffer)) > 0) {
+    }
+}
+
+} // namespace ssmtp_mailer
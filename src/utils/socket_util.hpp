@@ -0,0 +1,72 @@
+#pragma once
+
+#include <string>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Create a close-on-exec socket, portably
+ *
+ * Sets the descriptor flags with fcntl() after socket() instead of the
+ * Linux-only SOCK_NONBLOCK and SOCK_CLOEXEC type bits. Stream sockets also
+ * get SO_NOSIGPIPE where the platform has it but lacks MSG_NOSIGNAL.
+ *
+ * @param family Address family
+ * @param type SOCK_STREAM or SOCK_DGRAM
+ * @param non_blocking Whether to set O_NONBLOCK
+ * @return Descriptor, or -1 with errno set
+ */
+int openSocket(int family, int type, bool non_blocking);
+
+/**
+ * @brief Set O_NONBLOCK on a descriptor
+ * @param fd Descriptor
+ * @return true on success, false with errno set
+ */
+bool setNonBlocking(int fd);
+
+/**
+ * @brief Self-pipe used to interrupt a thread waiting in poll() or epoll_wait()
+ *
+ * Both ends are non-blocking, so wake() never blocks on a full pipe: a
+ * full pipe already guarantees a pending wakeup.
+ */
+class WakePipe {
+public:
+    WakePipe();
+    ~WakePipe();
+
+    WakePipe(const WakePipe&) = delete;
+    WakePipe& operator=(const WakePipe&) = delete;
+
+    /**
+     * @brief Create the pipe
+     * @param error Error message on failure
+     * @return true on success
+     */
+    bool open(std::string& error);
+
+    void close();
+
+    /**
+     * @brief Make the read end readable; safe from any thread
+     * @return true on success or if a wakeup is already pending
+     */
+    bool wake();
+
+    /**
+     * @brief Consume all pending wakeups
+     */
+    void drain();
+
+    /**
+     * @brief Get the descriptor to wait on for readability
+     * @return Read end, or -1 if not open
+     */
+    int fd() const { return fds_[0]; }
+
+private:
+    int fds_[2];
+};
+
+} // namespace ssmtp_mailer
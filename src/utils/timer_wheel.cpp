@@ -0,0 +1,130 @@
+#include "utils/timer_wheel.hpp"
+#include <algorithm>
+#include <cstdint>
+
+namespace ssmtp_mailer {
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, size_t slot_count)
+    : tick_(tick.count() > 0 ? tick : std::chrono::milliseconds(1)),
+      slots_(slot_count > 0 ? slot_count : 1),
+      start_(Clock::now()), current_tick_(0), next_id_(1), earliest_tick_(0), earliest_known_(true) {
+}
+
+uint64_t TimerWheel::tickAt(Clock::time_point time, bool round_up) const {
+    if (time <= start_) {
+        return 0;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(time - start_).count();
+    uint64_t ticks = static_cast<uint64_t>(elapsed / tick_.count());
+    if (round_up && elapsed % tick_.count() != 0) {
+        ticks++;
+    }
+    return ticks;
+}
+
+TimerWheel::TimerId TimerWheel::schedule(Clock::time_point deadline, uint64_t token) {
+    // Never place a timer in the slot being processed; the earliest is the next tick
+    uint64_t target = tickAt(deadline, true);
+    if (target <= current_tick_) {
+        target = current_tick_ + 1;
+    }
+
+    uint64_t delta = target - current_tick_;
+    size_t slot = static_cast<size_t>(target % slots_.size());
+
+    Entry entry;
+    entry.id = next_id_++;
+    entry.token = token;
+    entry.rounds = (delta - 1) / slots_.size();
+    entry.tick = target;
+
+    if (index_.empty()) {
+        earliest_tick_ = target;
+        earliest_known_ = true;
+    } else if (earliest_known_ && target < earliest_tick_) {
+        earliest_tick_ = target;
+    }
+
+    auto& list = slots_[slot];
+    list.push_back(entry);
+    index_[entry.id] = std::make_pair(slot, std::prev(list.end()));
+    return entry.id;
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    auto it = index_.find(id);
+    if (it == index_.end()) {
+        return false;
+    }
+    if (it->second.second->tick == earliest_tick_) {
+        earliest_known_ = false;
+    }
+    slots_[it->second.first].erase(it->second.second);
+    index_.erase(it);
+    return true;
+}
+
+void TimerWheel::advance(Clock::time_point now, std::vector<uint64_t>& expired) {
+    uint64_t target = tickAt(now, false);
+
+    while (current_tick_ < target) {
+        current_tick_++;
+        if (index_.empty()) {
+            // Nothing can fire; skip the remaining slot visits
+            current_tick_ = target;
+            break;
+        }
+
+        auto& list = slots_[static_cast<size_t>(current_tick_ % slots_.size())];
+        for (auto it = list.begin(); it != list.end();) {
+            if (it->rounds > 0) {
+                it->rounds--;
+                ++it;
+                continue;
+            }
+            expired.push_back(it->token);
+            if (it->tick == earliest_tick_) {
+                earliest_known_ = false;
+            }
+            index_.erase(it->id);
+            it = list.erase(it);
+        }
+    }
+}
+
+int TimerWheel::millisecondsUntilNextTick(Clock::time_point now) const {
+    if (index_.empty()) {
+        return -1;
+    }
+    auto next_tick = start_ + tick_ * static_cast<int64_t>(current_tick_ + 1);
+    if (next_tick <= now) {
+        return 0;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(next_tick - now).count();
+    // Round up so the wheel is not woken just before the tick boundary
+    return static_cast<int>(remaining + 1);
+}
+
+int TimerWheel::millisecondsUntilNextExpiry(Clock::time_point now) const {
+    if (index_.empty()) {
+        return -1;
+    }
+    if (!earliest_known_) {
+        earliest_tick_ = UINT64_MAX;
+        for (const auto& slot : slots_) {
+            for (const auto& entry : slot) {
+                earliest_tick_ = std::min(earliest_tick_, entry.tick);
+            }
+        }
+        earliest_known_ = true;
+    }
+
+    auto deadline = start_ + tick_ * static_cast<int64_t>(std::max(earliest_tick_, current_tick_ + 1));
+    if (deadline <= now) {
+        return 0;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+    return static_cast<int>(std::min<long long>(remaining + 1, INT32_MAX));
+}
+
+} // namespace ssmtp_mailer
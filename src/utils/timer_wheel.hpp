@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief Hashed timing wheel for large numbers of coarse timers
+ *
+ * Scheduling and cancelling are O(1); advancing costs one slot visit per
+ * elapsed tick plus the timers that fire. Deadlines are rounded up to the
+ * tick, so a timer never fires early. Not thread-safe: each wheel belongs
+ * to the thread that advances it.
+ */
+class TimerWheel {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+
+    /**
+     * @brief Constructor
+     * @param tick Timer resolution
+     * @param slot_count Number of wheel slots (one revolution = tick * slot_count)
+     */
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(100),
+                        size_t slot_count = 512);
+
+    /**
+     * @brief Schedule a timer
+     * @param deadline Time at which the timer fires
+     * @param token Caller value returned when the timer fires
+     * @return Timer identifier for cancel()
+     */
+    TimerId schedule(Clock::time_point deadline, uint64_t token);
+
+    /**
+     * @brief Cancel a pending timer
+     * @param id Timer identifier
+     * @return true if the timer was pending, false otherwise
+     */
+    bool cancel(TimerId id);
+
+    /**
+     * @brief Advance the wheel to the given time and collect expired timers
+     * @param now Current time
+     * @param expired Output vector the tokens of fired timers are appended to
+     */
+    void advance(Clock::time_point now, std::vector<uint64_t>& expired);
+
+    /**
+     * @brief Time until the wheel next needs to be advanced
+     * @param now Current time
+     * @return Milliseconds until the next tick, or -1 if no timer is pending
+     */
+    int millisecondsUntilNextTick(Clock::time_point now) const;
+
+    /**
+     * @brief Time until the earliest pending timer fires
+     *
+     * Lets an idle owner sleep through ticks at which nothing fires. The
+     * earliest deadline is cached; it is recomputed, by visiting every
+     * pending timer, only after the timer it named fired or was cancelled.
+     *
+     * @param now Current time
+     * @return Milliseconds until advance() would fire a timer, or -1 if none is pending
+     */
+    int millisecondsUntilNextExpiry(Clock::time_point now) const;
+
+    /**
+     * @brief Get number of pending timers
+     * @return Pending timer count
+     */
+    size_t size() const { return index_.size(); }
+
+    /**
+     * @brief Check whether no timer is pending
+     * @return true if empty, false otherwise
+     */
+    bool empty() const { return index_.empty(); }
+
+private:
+    struct Entry {
+        TimerId id;
+        uint64_t token;
+        uint64_t rounds;
+        uint64_t tick;          // Tick at which it fires
+    };
+
+    std::chrono::milliseconds tick_;
+    std::vector<std::list<Entry>> slots_;
+    std::unordered_map<TimerId, std::pair<size_t, std::list<Entry>::iterator>> index_;
+    Clock::time_point start_;
+    uint64_t current_tick_;
+    TimerId next_id_;
+
+    // Earliest pending tick, when known (a cache, so updated from const methods)
+    mutable uint64_t earliest_tick_;
+    mutable bool earliest_known_;
+
+    uint64_t tickAt(Clock::time_point time, bool round_up) const;
+};
+
+} // namespace ssmtp_mailer
@@ -0,0 +1,135 @@
+#include "utils/unique_id.hpp"
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace ssmtp_mailer {
+
+namespace {
+
+const char BASE32_DIGITS[] = "0123456789ABCDEFGHJKMNPQRSTVWXYZ";    // Crockford
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+/**
+ * Random per process, so IDs from processes started in the same
+ * millisecond do not collide
+ */
+uint32_t processNode() {
+    static const uint32_t node = []() {
+        std::random_device random;
+#ifdef _WIN32
+        uint32_t pid = static_cast<uint32_t>(_getpid());
+#else
+        uint32_t pid = static_cast<uint32_t>(getpid());
+#endif
+        return static_cast<uint32_t>(random()) ^ (pid * 0x9E3779B1u);
+    }();
+    return node;
+}
+
+const uint32_t THREAD_SLOTS = 0x10000;
+
+struct ThreadState {
+    uint64_t thread;
+    uint64_t last_millis;
+    uint32_t sequence;
+};
+
+/**
+ * Thread slots with the state last used in them. A slot goes back to the
+ * pool when its thread exits and is handed out again with that state, so
+ * its sequence carries on and a new thread cannot repeat IDs the old one
+ * made in the same millisecond.
+ */
+struct SlotPool {
+    std::mutex mutex;
+    std::vector<ThreadState> free_slots;
+    uint32_t next_slot;
+
+    SlotPool() : next_slot(0) {}
+};
+
+SlotPool& slotPool() {
+    // Never destroyed: threads may still exit after static destructors ran
+    static SlotPool* pool = new SlotPool();
+    return *pool;
+}
+
+class ThreadSlot {
+public:
+    ThreadSlot() {
+        SlotPool& pool = slotPool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if (!pool.free_slots.empty()) {
+            state = pool.free_slots.back();
+            pool.free_slots.pop_back();
+            return;
+        }
+        state.thread = pool.next_slot++ % THREAD_SLOTS;
+        state.last_millis = 0;
+        // With more live threads than slots, slots are shared; a random start makes a clash unlikely
+        state.sequence = pool.next_slot > THREAD_SLOTS ? static_cast<uint32_t>(std::random_device()()) : 0;
+    }
+
+    ~ThreadSlot() {
+        SlotPool& pool = slotPool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.free_slots.push_back(state);
+    }
+
+    ThreadState state;
+};
+
+} // anonymous namespace
+
+UniqueId nextUniqueId() {
+    thread_local ThreadSlot slot;
+    ThreadState& state = slot.state;
+
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    // Never go back in time within a thread; a wrapped sequence moves on a millisecond
+    if (now > state.last_millis) {
+        state.last_millis = now;
+    }
+    if (++state.sequence == 0) {
+        state.last_millis++;
+    }
+
+    uint64_t node = processNode();
+    UniqueId id;
+    id.high = ((state.last_millis & 0xFFFFFFFFFFFFull) << 16) | (node >> 16);
+    id.low = ((node & 0xFFFF) << 48) | (state.thread << 32) | state.sequence;
+    return id;
+}
+
+std::string UniqueId::toBase32() const {
+    // 26 digits of 5 bits hold 130 bits; the two leading bits are always zero
+    std::string text(26, '0');
+    uint64_t h = high;
+    uint64_t l = low;
+    for (size_t i = 26; i-- > 0; ) {
+        text[i] = BASE32_DIGITS[l & 0x1F];
+        l = (l >> 5) | (h << 59);
+        h >>= 5;
+    }
+    return text;
+}
+
+std::string UniqueId::toHex() const {
+    std::string text(32, '0');
+    for (size_t i = 0; i < 16; ++i) {
+        text[15 - i] = HEX_DIGITS[(high >> (4 * i)) & 0xF];
+        text[31 - i] = HEX_DIGITS[(low >> (4 * i)) & 0xF];
+    }
+    return text;
+}
+
+} // namespace ssmtp_mailer
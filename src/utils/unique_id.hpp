@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace ssmtp_mailer {
+
+/**
+ * @brief 128-bit identifier that sorts by creation time (ULID layout)
+ *
+ *   48 bits  milliseconds since the Unix epoch
+ *   32 bits  node: random per process
+ *   16 bits  generating thread's slot, reused after the thread exits
+ *   32 bits  per-thread sequence number
+ *
+ * IDs from one thread are strictly increasing, even if the clock steps
+ * back; IDs from different threads are ordered by millisecond. Both text
+ * forms keep the numeric order when compared as strings, so IDs work as
+ * naturally ordered keys in indexes.
+ */
+struct UniqueId {
+    uint64_t high;      // Timestamp and node
+    uint64_t low;       // Node, thread and sequence
+
+    UniqueId() : high(0), low(0) {}
+
+    /**
+     * @brief Get the creation time
+     * @return Milliseconds since the Unix epoch
+     */
+    uint64_t getTimestamp() const { return high >> 16; }
+
+    /**
+     * @brief Format as 26 Crockford base32 characters, as ULIDs are written
+     * @return Upper-case base32 text
+     */
+    std::string toBase32() const;
+
+    /**
+     * @brief Format as 32 lower-case hex digits
+     * @return Hex text
+     */
+    std::string toHex() const;
+
+    bool operator<(const UniqueId& other) const {
+        return high < other.high || (high == other.high && low < other.low);
+    }
+    bool operator==(const UniqueId& other) const { return high == other.high && low == other.low; }
+    bool operator!=(const UniqueId& other) const { return !(*this == other); }
+};
+
+/**
+ * @brief Generate the next identifier
+ *
+ * Lock-free: each thread keeps its own sequence; only a thread's first
+ * call and its exit touch shared state (the pool of thread slots).
+ *
+ * @return New identifier
+ */
+UniqueId nextUniqueId();
+
+} // namespace ssmtp_mailer